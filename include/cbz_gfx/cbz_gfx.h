@@ -14,6 +14,19 @@ struct CBZ_API InitDesc {
   uint32_t width;
   uint32_t height;
   CBZNetworkStatus netStatus;
+
+  // Threads used for background loading and for encoding large frames in
+  // parallel. 0 selects (cores - 1).
+  uint32_t workerThreadCount = 0;
+
+  // Falls back to CBZ_PRESENT_MODE_FIFO if the surface does not support it.
+  CBZPresentMode presentMode = CBZ_PRESENT_MODE_FIFO;
+
+  // Frames the CPU may record ahead of the GPU, up to MAX_FRAMES_IN_FLIGHT.
+  // Lower values reduce input latency.
+  uint32_t maxFramesInFlight = 2;
+
+  bool resizable = false;
 };
 
 CBZ_API Result Init(InitDesc initDesc);
@@ -25,6 +38,8 @@ VertexBufferCreate(const VertexLayout &vertexLayout, uint32_t vertexCount,
 CBZ_API void VertexBufferUpdate(VertexBufferHandle vbh, uint32_t elementCount,
                                 const void *data, uint32_t offset = 0);
 
+/// @param instances Instances drawn; instance indices start at the transform
+/// of the submission.
 CBZ_API void VertexBufferSet(VertexBufferHandle vbh, uint32_t instances = 1);
 
 CBZ_API void VertexBufferDestroy(VertexBufferHandle vbh);
@@ -45,8 +60,10 @@ CBZ_API void StructuredBufferUpdate(StructuredBufferHandle sbh,
                                     uint32_t elementCount, const void *data,
                                     uint32_t offset = 0);
 
+/// @param group Slang register space of the binding. Parameter blocks bind in
+/// their own space, where slots are numbered from 0 again.
 CBZ_API void StructuredBufferSet(CBZBufferSlot slot, StructuredBufferHandle sbh,
-                                 CBZBool32 dynamic = false);
+                                 CBZBool32 dynamic = false, uint8_t group = 0);
 
 CBZ_API void StructuredBufferDestroy(StructuredBufferHandle ibh);
 
@@ -64,27 +81,119 @@ CBZ_API void UniformSet(UniformHandle uh, const void *data, uint16_t num = 0);
 /// @brief Destroys a uniform.
 CBZ_API void UniformDestroy(UniformHandle uh);
 
+/// @brief Sets the push constants of the next graphics submission.
+///
+/// Push constants are recorded with the draw, so small per draw data needs no
+/// buffer upload or bind group. Shaders declare them as a Slang
+/// `[[vk::push_constant]]` constant buffer visible to the vertex and fragment
+/// stages.
+///
+/// @param size multiple of 4, at most MAX_PUSH_CONSTANT_SIZE bytes. Bytes past
+/// the block the program declares are ignored.
+///
+/// @note Needs the wgpu native push constants feature; shaders declaring
+/// push constants fail to load without it.
+CBZ_API void PushConstantsSet(const void *data, uint32_t size);
+
+/// @param sampleCount 1 or 4. Multisampled images can only be used as
+/// CBZ_IMAGE_RENDER_ATTACHMENT of targets with the same sample count.
 [[nodiscard]] CBZ_API ImageHandle Image2DCreate(CBZTextureFormat format,
                                                 uint32_t w, uint32_t h,
-                                                int flags = 0);
+                                                int flags = 0,
+                                                uint32_t sampleCount = 1);
 
 [[nodiscard]] CBZ_API ImageHandle Image2DCubeMapCreate(CBZTextureFormat format,
                                                        uint32_t w, uint32_t h,
                                                        uint32_t depth,
                                                        int flags = 0);
 
+/// @brief Creates a 2D image sized 'scale' times the surface.
+///
+/// The image is resized with the surface and, with
+/// CBZ_IMAGE_DYNAMIC_RESOLUTION, by the dynamic resolution scale. Its handle
+/// stays valid across resizes; contents are undefined after one.
+[[nodiscard]] CBZ_API ImageHandle Image2DCreateRelative(CBZTextureFormat format,
+                                                        float scale = 1.0f,
+                                                        int flags = 0);
+
 CBZ_API void ImageSetName(ImageHandle imgh, const char *name, uint32_t len);
 
+/// @returns whether images of 'format' can be created. Compressed formats
+/// depend on the texture compression features of the device.
+[[nodiscard]] CBZ_API bool ImageFormatIsSupported(CBZTextureFormat format);
+
+/// @brief Creates an image from a KTX2 file and uploads its mip levels.
+/// @note Files without pre-built levels may request CBZ_IMAGE_MIPMAPS.
+/// @returns invalid handle if the file or its format is unsupported.
+[[nodiscard]] CBZ_API ImageHandle ImageLoadKTX2(const char *path,
+                                                int flags = CBZ_IMAGE_BINDING);
+
+/// @brief Creates an image whose mip levels stream from a KTX2 file with
+/// pre-built levels.
+/// @note Levels up to STREAMING_RESIDENT_SIZE are uploaded immediately. Higher
+/// levels load on worker threads while draws sample the image and are evicted
+/// again to stay within the streaming budget. The image keeps its full size;
+/// shaders sample the resident levels only.
+[[nodiscard]] CBZ_API ImageHandle
+ImageStreamKTX2(const char *path, int flags = CBZ_IMAGE_BINDING);
+
+/// @brief Overrides the priority of a streamed image. Higher priorities load
+/// first and are evicted last; negative restores the priority derived from
+/// draw coverage. Images no draw samples keep the levels their priority
+/// resolves as a screen fraction.
+CBZ_API void ImageStreamPrioritySet(ImageHandle imgh, float priority);
+
+/// @brief Fraction [0, 1] of the screen covered by the next submitted draw.
+/// Streamed images it samples only load the levels that coverage resolves.
+CBZ_API void DrawCoverageSet(float coverage);
+
+/// @brief Uploads mip 0. Images created with CBZ_IMAGE_MIPMAPS regenerate the
+/// remaining levels on the GPU before the next frame samples them.
 CBZ_API void Image2DUpdate(ImageHandle imgh, void *data, uint32_t count);
 
+/// @param group Slang register space of the texture and its sampler, as for
+/// `StructuredBufferSet`.
 CBZ_API void TextureSet(CBZTextureSlot slot, ImageHandle imgh,
-                        TextureBindingDesc desc = {});
+                        TextureBindingDesc desc = {}, uint8_t group = 0);
+
+/// @brief Registers a 2D color image in the global texture table.
+///
+/// Shaders declare the table as a `Texture2D` array and index it with the
+/// returned value, so draws differing only in textures share one bind group.
+///
+/// @returns index of the image in the table, UINT32_MAX if the table is full.
+///
+/// @note Needs the wgpu native texture binding array and non uniform indexing
+/// features; shaders declaring texture arrays fail to load without them.
+CBZ_NO_DISCARD CBZ_API uint32_t TextureTableAdd(ImageHandle imgh);
+
+/// @brief Frees 'index'. Destroyed images read as a placeholder until removed.
+CBZ_API void TextureTableRemove(uint32_t index);
+
+/// @brief Binds the texture table at 'slot' of the next submission, and a
+/// sampler described by 'desc' after it as `TextureSet` does.
+CBZ_API void TextureTableSet(CBZTextureSlot slot, TextureBindingDesc desc = {},
+                             uint8_t group = 0);
 
 CBZ_API void ImageDestroy(ImageHandle imgh);
 
 CBZ_NO_DISCARD CBZ_API ShaderHandle ShaderCreate(const char *path,
                                                  int flags = 0);
 
+/// @brief Creates a shader without blocking the caller.
+///
+/// The returned handle is pending until file loading and reflection parsing
+/// finish on a worker thread and the module is created during `Frame()`.
+/// Programs may be created from a pending shader.
+///
+/// @note Submissions with pending programs are skipped, see
+/// `GraphicsProgramPlaceholderSet`.
+CBZ_NO_DISCARD CBZ_API ShaderHandle ShaderCreateAsync(const char *path,
+                                                      int flags = 0);
+
+/// @returns true once the shader module has been created.
+CBZ_NO_DISCARD CBZ_API CBZBool32 ShaderIsReady(ShaderHandle sh);
+
 CBZ_API void ShaderSetName(ShaderHandle sh, const char *name, uint32_t len);
 
 CBZ_API void ShaderDestroy(ShaderHandle sh);
@@ -97,6 +206,11 @@ CBZ_API void GraphicsProgramSetName(GraphicsProgramHandle gph, const char *name,
 
 CBZ_API void GraphicsProgramDestroy(GraphicsProgramHandle gph);
 
+/// @brief Sets the program drawn in place of graphics programs whose shader is
+/// still pending. An invalid handle (default) skips such submissions instead.
+/// Handles of destroyed programs are rejected.
+CBZ_API void GraphicsProgramPlaceholderSet(GraphicsProgramHandle gph);
+
 CBZ_API ComputeProgramHandle ComputeProgramCreate(ShaderHandle sh,
                                                   const char *name = "");
 
@@ -108,18 +222,59 @@ CBZ_API void ProjectionSet(const float *projection);
 
 CBZ_API void ViewSet(const float *projection);
 
-CBZ_API void ReadBufferAsync(StructuredBufferHandle sbh,
-                             std::function<void(const void *data)> callback);
-
-// [[deprecated("not really, just incomplete :)")]]
-CBZ_API void TextureReadAsync(ImageHandle imgh, const Origin3D *origin,
-                              const TextureExtent *extent,
-                              std::function<void(const void *data)> callback);
-
+/// @brief Copies a range of a structured buffer back to the CPU.
+///
+/// The copy is recorded after the next frame's GPU work. Up to
+/// `MAX_READBACKS_IN_FLIGHT` reads may be outstanding at once.
+///
+/// @param callback Invoked on the calling thread during a later `Frame()`
+/// with the requested bytes. Data is only valid for the duration of the call.
+/// If null, the result is kept until fetched with `ReadbackDataCopy`.
+/// @param offset Offset in bytes.
+/// @param size Size in bytes. 0 reads to the end of the buffer.
+/// @returns handle for polling, invalid if the queue is full.
+CBZ_API ReadbackHandle
+ReadBufferAsync(StructuredBufferHandle sbh,
+                std::function<void(const void *data)> callback,
+                uint32_t offset = 0, uint32_t size = 0);
+
+/// @returns the state of an asynchronous read.
+CBZ_NO_DISCARD CBZ_API CBZReadbackStatus
+ReadbackStatusGet(ReadbackHandle rbh);
+
+/// @brief Copies a ready result without callback into dst and releases it.
+/// @returns number of bytes copied; 0 if the result is not ready.
+CBZ_API uint32_t ReadbackDataCopy(ReadbackHandle rbh, void *dst,
+                                  uint32_t dstSize);
+
+/// @brief Copies a region of an image back to the CPU.
+///
+/// The copy is recorded after the next frame's GPU work and repacked to a
+/// tight row pitch (`width * TextureFormatGetSize(format)`) on a worker
+/// thread. Shares the `MAX_READBACKS_IN_FLIGHT` slots with buffer reads.
+///
+/// @param callback Invoked on the calling thread during a later `Frame()`
+/// with ownership of the texels. If null, the result is kept until fetched
+/// with `ReadbackDataCopy`.
+/// @returns handle for polling, invalid if the queue is full.
+CBZ_API ReadbackHandle
+TextureReadAsync(ImageHandle imgh, const Origin3D *origin,
+                 const TextureExtent *extent,
+                 std::function<void(std::vector<uint8_t> &&data)> callback);
+
+/// @brief Sets the attachments of an offscreen target.
+///
+/// @param sampleCount 1 or 4. Single sample color attachments of a
+/// multisampled target render to a multisampled companion that is resolved
+/// into them at the end of each pass. Companion samples are discarded unless
+/// the attachment is loaded by CBZ_RENDER_ATTACHMENT_LOAD. Depth can not be
+/// resolved, so a single sample depth attachment is left unwritten; create it
+/// with the target's sample count to keep it.
 CBZ_API void
 RenderTargetSet(uint8_t target, const AttachmentDescription *colorAttachments,
                 uint32_t colorAttachmentCount,
-                const AttachmentDescription *depthAttachment = NULL);
+                const AttachmentDescription *depthAttachment = NULL,
+                uint32_t sampleCount = 1);
 
 /// @brief Submits a graphics program for rendering on the given target.
 ///
@@ -145,6 +300,158 @@ CBZ_API void Submit(uint8_t target, GraphicsProgramHandle gph);
 CBZ_API void Submit(uint8_t target, ComputeProgramHandle cph, uint32_t x,
                     uint32_t y, uint32_t z);
 
+/// @brief Submits an indexed graphics program drawn with arguments read from
+/// a buffer on the GPU.
+///
+/// @param argsSBH CBZ_BUFFER_INDIRECT buffer holding index count, instance
+/// count, first index, base vertex and first instance (0) as uint32s.
+/// @param argsOffset Offset of the arguments in bytes; a multiple of 4.
+///
+/// @note The index count set by `IndexBufferSet` is ignored.
+CBZ_API void SubmitIndirect(uint8_t target, GraphicsProgramHandle gph,
+                            StructuredBufferHandle argsSBH,
+                            uint32_t argsOffset = 0);
+
+/// @brief Submits an indexed graphics program drawn once per argument record
+/// of a buffer, in one encoder call where the device supports it.
+///
+/// @param argsSBH CBZ_BUFFER_INDIRECT buffer of `maxCount` tightly packed
+/// records laid out as for `SubmitIndirect`.
+/// @param countSBH Optional CBZ_BUFFER_INDIRECT buffer whose first uint32
+/// limits the records drawn.
+///
+/// @note Uses native multi draw indirect (count) when the adapter has it,
+/// otherwise one indirect draw per record. The fallback can not read the
+/// count, so records past it are drawn too and must have an instance count
+/// of 0.
+CBZ_API void
+SubmitMultiIndirect(uint8_t target, GraphicsProgramHandle gph,
+                    StructuredBufferHandle argsSBH, uint32_t maxCount,
+                    StructuredBufferHandle countSBH = {CBZ_INVALID_HANDLE});
+
+/// @brief Culls a batch of objects on the GPU and writes the draw arguments
+/// of the visible ones for `SubmitIndirect`.
+///
+/// Bounds are transformed by the transform set with `TransformSet`, tested
+/// against the frustum of the view and projection set for this submission,
+/// then against a hierarchical depth pyramid built from the previous frame's
+/// contents of `desc.depthIMGH`. Vertex shaders find their object through
+/// the visible buffer at `instance_index`.
+///
+/// @param target Compute target. Culling runs after the compute programs
+/// submitted to it, and must precede the target drawing the batch.
+///
+/// @note Occlusion assumes depth increases with distance and tests with the
+/// view projection of the previous cull of the same depth image, so objects
+/// may appear one frame late while the camera moves. Cull each batch once per
+/// frame; its arguments are reset before any pass runs.
+CBZ_API void CullSubmit(uint8_t target, const CullDesc &desc);
+
+/// @brief Creates an empty draw list. Draw lists record graphics submissions
+/// once and replay them each frame without sorting or encoding them again.
+[[nodiscard]] CBZ_API DrawListHandle DrawListCreate(const char *name = "");
+
+/// @brief Replaces the contents of 'dlh' with the graphics submissions made
+/// by 'record'. Recorded submissions are not drawn this frame.
+///
+/// Each submission keeps the transform set for it. Targets passed to `Submit`
+/// are ignored; compute submissions, culls and submissions setting push
+/// constants are dropped.
+///
+/// @note Record once programs are ready; submissions skipped while a program
+/// loads are not recorded.
+CBZ_API void DrawListRecord(DrawListHandle dlh,
+                            const std::function<void()> &record);
+
+/// @brief Replays 'dlh' on 'target' before the target's other draws, with the
+/// view and projection set for this submission.
+///
+/// @note The list is encoded once per target and camera into a render bundle,
+/// and again only after a resource it references is destroyed or replaced.
+/// Submitting it under several cameras in one frame is supported.
+CBZ_API void DrawListSubmit(uint8_t target, DrawListHandle dlh);
+
+CBZ_API void DrawListDestroy(DrawListHandle dlh);
+
+/// @brief Creates a persistent draw of 'gph' on 'target' from the state and
+/// transform set for the next submission, which it consumes as `Submit` does.
+///
+/// Items of a target are kept sorted in chunks of 256, each drawn through its
+/// own draw list. Creating, changing or destroying an item encodes its chunk
+/// again, and no other. Moving an item uploads its transform alone and moving
+/// the camera uploads the camera alone, so frames cost what changed, not the
+/// scene.
+///
+/// @note Push constants are not supported. Items of loading programs are
+/// drawn once their program is ready.
+[[nodiscard]] CBZ_API DrawItemHandle DrawItemCreate(uint8_t target,
+                                                    GraphicsProgramHandle gph);
+
+/// @brief Replaces the program and state of 'dih' with the state set for the
+/// next submission, e.g. after its material changed. Keeps its transform.
+CBZ_API void DrawItemUpdate(DrawItemHandle dih, GraphicsProgramHandle gph);
+
+CBZ_API void DrawItemTransformSet(DrawItemHandle dih, const float *transform);
+
+/// @brief Draws the items of 'target' before its other draws, with the view
+/// and projection set for this submission. Call once per frame per target.
+CBZ_API void DrawItemsSubmit(uint8_t target);
+
+CBZ_API void DrawItemDestroy(DrawItemHandle dih);
+
+/// @brief Limits how many GPU objects (pipelines, bind group layouts, bind
+/// groups, samplers) are lazily created per frame.
+///
+/// Submissions whose objects do not fit in the budget are deferred to a later
+/// frame and reported in `RendererStats::submissionsDeferred`.
+///
+/// @note Texture views are not budgeted. They are cheap, and attachment views
+/// can not be deferred without dropping the pass.
+///
+/// @param maxCreations Maximum creations per frame. 0 is unlimited.
+/// @param maxMilliseconds Maximum time spent creating per frame. 0 is
+/// unlimited.
+CBZ_API void CreationBudgetSet(uint32_t maxCreations, float maxMilliseconds);
+
+/// @returns statistics of the last submitted frame.
+CBZ_NO_DISCARD CBZ_API RendererStats GetStats();
+
+/// @brief Reconfigures the surface with a new present mode.
+CBZ_API void PresentModeSet(CBZPresentMode presentMode);
+
+/// @brief Scales images created with CBZ_IMAGE_DYNAMIC_RESOLUTION to keep the
+/// slower of CPU and GPU frame time within `targetFrameMs`.
+/// @note Textures of previous sizes are pooled, so oscillating scales reuse
+/// allocations.
+CBZ_API void DynamicResolutionSet(const DynamicResolutionDesc &desc);
+
+/// @brief Upscales an image to the surface with linear filtering before the
+/// draws of CBZ_DEFAULT_RENDER_TARGET.
+/// @param imgh CBZ_IMAGE_BINDING image; invalid handle disables the upscale.
+CBZ_API void UpscaleSourceSet(ImageHandle imgh);
+
+/// @brief Limits GPU memory held by the mip levels of streamed images.
+CBZ_API void TextureStreamingBudgetSet(uint64_t bytes);
+
+CBZ_NO_DISCARD CBZ_API TextureStreamingStats TextureStreamingStatsGet();
+
+/// @returns utilization of the pool vertex, index or structured buffers are
+/// suballocated from.
+CBZ_NO_DISCARD CBZ_API BufferPoolStats BufferPoolStatsGet(CBZBufferPool pool);
+
+/// @brief Starts streaming frames of an image to disk.
+///
+/// Each `Frame()` reads the image back asynchronously and hands it to a
+/// background writer. Frames are dropped rather than stalling the renderer.
+/// Supports RGBA8 and BGRA8 images.
+CBZ_NO_DISCARD CBZ_API Result CaptureBegin(const CaptureDesc &desc);
+
+/// @brief Stops capturing, writes queued frames and closes the output.
+CBZ_API void CaptureEnd();
+
+/// @returns statistics of the current or last capture.
+CBZ_NO_DISCARD CBZ_API CaptureStats CaptureStatsGet();
+
 // @returns the frame number.
 CBZ_API uint32_t Frame();
 
@@ -185,6 +185,12 @@ typedef enum {
 
   // Image can be used as a color/depth attachment
   CBZ_IMAGE_RENDER_ATTACHMENT = 1 << 2,
+
+  // Allocates a full mip chain, regenerated from mip 0 on each update
+  CBZ_IMAGE_MIPMAPS = 1 << 3,
+
+  // Surface relative image is also scaled by the dynamic resolution scale
+  CBZ_IMAGE_DYNAMIC_RESOLUTION = 1 << 4,
 } CBZImageFlags;
 
 typedef enum {
@@ -195,6 +201,17 @@ typedef enum {
   CBZ_RENDER_ATTACHMENT_DEPTH_WRITE_DISABLE = 1 << 1,
 
   CBZ_RENDER_ATTACHMENT_LOAD = 1 << 2, // Keep contents of attachment
+
+  // Contents are not needed after the pass and are not stored
+  CBZ_RENDER_ATTACHMENT_DISCARD = 1 << 3,
+
+  // Previous contents are not needed and the clear value is irrelevant.
+  // WebGPU has no undefined load, so this clears; clears are free on
+  // tile-based GPUs. Ignored with CBZ_RENDER_ATTACHMENT_LOAD.
+  CBZ_RENDER_ATTACHMENT_DONT_CARE = 1 << 4,
+
+  // Depth/stencil is tested but neither loaded, cleared nor written
+  CBZ_RENDER_ATTACHMENT_READ_ONLY = 1 << 5,
 } CBZRenderAttachmentFlags;
 
 // @note one to one mapping with 'WGPUTextureDimension'
@@ -254,6 +271,13 @@ typedef enum {
   CBZ_BUFFER = 0,
   CBZ_BUFFER_COPY_SRC = 1 << 0,
   CBZ_BUFFER_COPY_DST = 1 << 1,
+
+  // Usable as indirect draw arguments.
+  CBZ_BUFFER_INDIRECT = 1 << 2,
+
+  // Only bound read-only; shares backing blocks with other read-only buffers.
+  // Other structured buffers get a block of their own.
+  CBZ_BUFFER_READ_ONLY = 1 << 3,
 } CBZBufferFlags;
 
 typedef enum {
@@ -271,6 +295,10 @@ typedef enum {
 
   CBZ_BUFFER_GLOBAL_TRANSFORM = 3,
   CBZ_BUFFER_COUNT,
+
+  // View and projection of the submission, bound per distinct camera so draw
+  // lists replay under the camera of each submit. Follows the texture slots.
+  CBZ_BUFFER_GLOBAL_CAMERA = CBZ_BUFFER_COUNT + 18,
 } CBZBufferSlot;
 
 typedef enum : uint8_t {
@@ -289,6 +317,33 @@ constexpr CBZTextureSlot CBZ_TEXTURE_SLOTS[9]{
     CBZ_TEXTURE_0, CBZ_TEXTURE_1, CBZ_TEXTURE_2, CBZ_TEXTURE_3, CBZ_TEXTURE_4,
     CBZ_TEXTURE_5, CBZ_TEXTURE_6, CBZ_TEXTURE_7, CBZ_TEXTURE_8};
 
+typedef enum {
+  CBZ_READBACK_STATUS_INVALID = 0, // Unknown, consumed or recycled request.
+  CBZ_READBACK_STATUS_PENDING,
+  CBZ_READBACK_STATUS_READY,
+  CBZ_READBACK_STATUS_FAILED,
+} CBZReadbackStatus;
+
+typedef enum {
+  CBZ_CAPTURE_FORMAT_PNG = 0, // One '<path>_<frame>.png' per frame.
+  CBZ_CAPTURE_FORMAT_Y4M,     // YUV4MPEG2 4:4:4 stream at '<path>'.
+  CBZ_CAPTURE_FORMAT_RAW,     // Tightly packed RGBA8 frames at '<path>'.
+} CBZCaptureFormat;
+
+typedef enum {
+  CBZ_PRESENT_MODE_FIFO = 0,     // VSync; always supported.
+  CBZ_PRESENT_MODE_FIFO_RELAXED, // VSync, tears when a frame is late.
+  CBZ_PRESENT_MODE_IMMEDIATE,    // No VSync; tears.
+  CBZ_PRESENT_MODE_MAILBOX,      // Latest frame replaces the queued one.
+} CBZPresentMode;
+
+typedef enum {
+  CBZ_BUFFER_POOL_VERTEX = 0,
+  CBZ_BUFFER_POOL_INDEX,
+  CBZ_BUFFER_POOL_STORAGE,
+  CBZ_BUFFER_POOL_COUNT,
+} CBZBufferPool;
+
 typedef enum {
   CBZ_NETWORK_NONE = 0,
   CBZ_NETWORK_HOST,
@@ -307,6 +362,19 @@ typedef enum : uint32_t {
   MAX_COMMAND_TEXTURES = 32,
   MAX_COMMAND_BINDINGS = 24,
   COPY_BYTES_PER_ROW_ALIGNMENT = 256,
+  STAGING_BELT_CHUNK_SIZE = 1 << 20,
+  MAX_READBACKS_IN_FLIGHT = 32,
+  MAX_STREAMING_LOADS_IN_FLIGHT = 4,
+  STREAMING_RESIDENT_SIZE = 64, // Levels this size or smaller stay resident.
+  STREAMING_IDLE_FRAMES = 120,  // Unused images drop to the lowest priority.
+  STREAMING_DEFAULT_BUDGET = 256u << 20,
+  BUFFER_POOL_BLOCK_SIZE = 16u << 20, // Larger buffers get their own block.
+  MAX_FRAMES_IN_FLIGHT = 3,
+  DYNAMIC_RESOLUTION_ADJUST_FRAMES = 30, // Frames between scale changes.
+  MAX_POOLED_RESOLUTION_IMAGES = 16,     // Textures kept for resizes.
+  MAX_PUSH_CONSTANT_SIZE = 128,
+  MAX_BIND_GROUPS = 3, // Frame, material and draw sets.
+  MAX_TEXTURE_TABLE_SIZE = 1024,
 } CBZRendererLimits;
 
 CBZ_NO_DISCARD constexpr uint32_t VertexFormatGetSize(CBZVertexFormat format) {
@@ -378,6 +446,21 @@ struct CBZ_API TextureBindingDesc {
   CBZFilterMode filterMode;
   CBZAddressMode addressMode;
   CBZTextureViewDimension viewDimension;
+
+  // Filter between mip levels; maps one to one with 'WGPUMipmapFilterMode'.
+  CBZFilterMode mipmapFilter;
+
+  // 0 or 1 disables anisotropic filtering. Requires linear filters.
+  uint32_t maxAnisotropy;
+
+  // lodMaxClamp <= lodMinClamp leaves the mip chain unclamped.
+  float lodMinClamp;
+  float lodMaxClamp;
+
+  // Mip range visible to the shader; mipLevelCount 0 selects the remaining
+  // levels.
+  uint32_t baseMipLevel;
+  uint32_t mipLevelCount;
 };
 
 CBZ_NO_DISCARD constexpr uint32_t
@@ -481,11 +564,126 @@ TextureFormatGetSize(CBZTextureFormat format) {
   case CBZ_TEXTURE_FORMAT_BC7RGBAUNORMSRGB:
     return 16;
 
+  // ETC2/EAC (SIZE PER 4X4 BLOCK)
+  case CBZ_TEXTURE_FORMAT_ETC2RGB8UNORM:
+  case CBZ_TEXTURE_FORMAT_ETC2RGB8UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ETC2RGB8A1UNORM:
+  case CBZ_TEXTURE_FORMAT_ETC2RGB8A1UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_EACR11UNORM:
+  case CBZ_TEXTURE_FORMAT_EACR11SNORM:
+    return 8;
+  case CBZ_TEXTURE_FORMAT_ETC2RGBA8UNORM:
+  case CBZ_TEXTURE_FORMAT_ETC2RGBA8UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_EACRG11UNORM:
+  case CBZ_TEXTURE_FORMAT_EACRG11SNORM:
+    return 16;
+
   default:
+    // ASTC (SIZE PER BLOCK OF ANY FOOTPRINT)
+    if (format >= CBZ_TEXTURE_FORMAT_ASTC4X4UNORM &&
+        format <= CBZ_TEXTURE_FORMAT_ASTC12X12UNORMSRGB) {
+      return 16;
+    }
+
     return 0; // UNKNOWN OR UNDEFINED
   }
 }
 
+// @returns texel footprint of one block; 1x1 for uncompressed formats.
+CBZ_NO_DISCARD constexpr uint32_t
+TextureFormatGetBlockWidth(CBZTextureFormat format) {
+  if (format >= CBZ_TEXTURE_FORMAT_BC1RGBAUNORM &&
+      format <= CBZ_TEXTURE_FORMAT_EACRG11SNORM) {
+    return 4;
+  }
+
+  switch (format) {
+  case CBZ_TEXTURE_FORMAT_ASTC4X4UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC4X4UNORMSRGB:
+    return 4;
+  case CBZ_TEXTURE_FORMAT_ASTC5X4UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC5X4UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC5X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC5X5UNORMSRGB:
+    return 5;
+  case CBZ_TEXTURE_FORMAT_ASTC6X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC6X5UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC6X6UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC6X6UNORMSRGB:
+    return 6;
+  case CBZ_TEXTURE_FORMAT_ASTC8X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC8X5UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC8X6UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC8X6UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC8X8UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC8X8UNORMSRGB:
+    return 8;
+  case CBZ_TEXTURE_FORMAT_ASTC10X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X5UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC10X6UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X6UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC10X8UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X8UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC10X10UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X10UNORMSRGB:
+    return 10;
+  case CBZ_TEXTURE_FORMAT_ASTC12X10UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC12X10UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC12X12UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC12X12UNORMSRGB:
+    return 12;
+  default:
+    return 1;
+  }
+}
+
+CBZ_NO_DISCARD constexpr uint32_t
+TextureFormatGetBlockHeight(CBZTextureFormat format) {
+  if (format >= CBZ_TEXTURE_FORMAT_BC1RGBAUNORM &&
+      format <= CBZ_TEXTURE_FORMAT_EACRG11SNORM) {
+    return 4;
+  }
+
+  switch (format) {
+  case CBZ_TEXTURE_FORMAT_ASTC4X4UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC4X4UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC5X4UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC5X4UNORMSRGB:
+    return 4;
+  case CBZ_TEXTURE_FORMAT_ASTC5X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC5X5UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC6X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC6X5UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC8X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC8X5UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC10X5UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X5UNORMSRGB:
+    return 5;
+  case CBZ_TEXTURE_FORMAT_ASTC6X6UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC6X6UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC8X6UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC8X6UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC10X6UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X6UNORMSRGB:
+    return 6;
+  case CBZ_TEXTURE_FORMAT_ASTC8X8UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC8X8UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC10X8UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X8UNORMSRGB:
+    return 8;
+  case CBZ_TEXTURE_FORMAT_ASTC10X10UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC10X10UNORMSRGB:
+  case CBZ_TEXTURE_FORMAT_ASTC12X10UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC12X10UNORMSRGB:
+    return 10;
+  case CBZ_TEXTURE_FORMAT_ASTC12X12UNORM:
+  case CBZ_TEXTURE_FORMAT_ASTC12X12UNORMSRGB:
+    return 12;
+  default:
+    return 1;
+  }
+}
+
 struct CBZ_API VertexAttribute {
   CBZVertexFormat format;
   uint64_t offset;
@@ -523,6 +721,12 @@ struct CBZ_API SamplerHandle {
   uint32_t idx;
 };
 
+// @brief Identifies an asynchronous GPU to CPU read. 0 is invalid.
+struct CBZ_API ReadbackHandle {
+  uint32_t idx;
+  explicit operator bool() const { return idx != 0; }
+};
+
 struct CBZ_API AttachmentDescription {
   // Color clear values
   struct Color {
@@ -540,6 +744,10 @@ struct CBZ_API AttachmentDescription {
 
   // CBZRenderAttachmentFlags
   int flags = 0;
+
+  // Depth/stencil clear values
+  float depthClearValue = 1.0f;
+  uint32_t stencilClearValue = 0;
 };
 
 CBZ_HANDLE(UniformHandle);
@@ -548,8 +756,92 @@ CBZ_HANDLE(ShaderHandle);
 CBZ_HANDLE(GraphicsProgramHandle);
 CBZ_HANDLE(ComputeProgramHandle);
 
+CBZ_HANDLE(DrawListHandle);
+CBZ_HANDLE(DrawItemHandle);
+
 CBZ_HANDLE(FramebufferHandle);
 
+struct CBZ_API CaptureDesc {
+  const char *path;
+  CBZCaptureFormat format;
+
+  // Image to capture. Invalid captures the default render target.
+  ImageHandle imgh;
+
+  // Frames waiting for disk before new ones are dropped. 0 defaults to 8.
+  uint32_t maxQueuedFrames;
+
+  // Y4M only. 0 defaults to 60.
+  uint32_t frameRate;
+};
+
+struct CBZ_API TextureStreamingStats {
+  uint64_t residentBytes;
+  uint64_t budgetBytes;
+  uint32_t streamedImages;
+  uint32_t loadsInFlight;
+  uint32_t levelsLoaded;
+  uint32_t levelsEvicted;
+};
+
+struct CBZ_API BufferPoolStats {
+  uint64_t reservedBytes;  // Size of all backing buffers.
+  uint64_t allocatedBytes; // Including alignment padding.
+  uint64_t largestFreeRange;
+  uint32_t blockCount;
+  uint32_t allocationCount;
+
+  // 1 - largest free range / free bytes; 0 when free space is contiguous.
+  float fragmentation;
+};
+
+struct CBZ_API CaptureStats {
+  uint32_t framesWritten;
+
+  // Frames lost to full queues or failed reads and writes.
+  uint32_t framesDropped;
+};
+
+// @brief Frame time controller of surface relative images created with
+// CBZ_IMAGE_DYNAMIC_RESOLUTION.
+struct CBZ_API DynamicResolutionDesc {
+  bool enabled = false;
+
+  // Budget of the slower of CPU and GPU frame time.
+  float targetFrameMs = 16.6f;
+
+  // Bounds of the scale applied on top of each image's own scale.
+  float minScale = 0.5f;
+  float maxScale = 1.0f;
+};
+
+// @brief Batch of objects sharing one mesh, culled on the GPU.
+struct CBZ_API CullDesc {
+  // CBZ_UNIFORM_TYPE_VEC4 bounding spheres (xyz center, w radius) in the
+  // space of the submission's transform.
+  StructuredBufferHandle boundsSBH = {CBZ_INVALID_HANDLE};
+
+  // CBZ_UNIFORM_TYPE_UINT, one per object. Receives the indices of visible
+  // objects, compacted.
+  StructuredBufferHandle visibleSBH = {CBZ_INVALID_HANDLE};
+
+  // CBZ_BUFFER_INDIRECT buffer of at least 5 CBZ_UNIFORM_TYPE_UINT. Receives
+  // indexed indirect draw arguments; the instance count is the number of
+  // visible objects.
+  StructuredBufferHandle argsSBH = {CBZ_INVALID_HANDLE};
+
+  uint32_t objectCount = 0;
+
+  // Mesh drawn per visible object.
+  uint32_t indexCount = 0;
+  uint32_t firstIndex = 0;
+  int32_t baseVertex = 0;
+
+  // CBZ_IMAGE_BINDING depth attachment the batch is drawn to. Its contents
+  // from the previous frame occlude objects; invalid disables the test.
+  ImageHandle depthIMGH = {CBZ_INVALID_HANDLE};
+};
+
 }; // namespace cbz
 
 // TODO: Remove stl from public fns
@@ -575,6 +867,44 @@ public:
   uint32_t stride = 0;
 };
 
+// @brief Per frame renderer statistics.
+struct CBZ_API RendererStats {
+  uint32_t drawCalls;
+  uint32_t dispatches;
+
+  // Lazily created pipelines, layouts, bind groups and samplers.
+  uint32_t objectsCreated;
+
+  // Creations postponed because the frame budget was exhausted.
+  uint32_t creationsDeferred;
+
+  // Submissions skipped because their GPU objects were deferred.
+  uint32_t submissionsDeferred;
+
+  // Target switches that continued the open pass.
+  uint32_t passesCoalesced;
+
+  // Bind groups set; sets whose bindings did not change stay bound.
+  uint32_t bindGroupsSet;
+
+  // Submissions drawn as instances of an identical preceding submission.
+  uint32_t submissionsInstanced;
+
+  // Command buffers submitted; passes encoded in parallel use one per range.
+  uint32_t commandBuffers;
+
+  // Draw lists replayed from their render bundles.
+  uint32_t bundlesExecuted;
+
+  // Smoothed frame times. CPU excludes waiting for the surface; GPU spans
+  // the frame's commands, from timestamp queries where supported.
+  float cpuFrameMs;
+  float gpuFrameMs;
+
+  // Dynamic resolution scale; 1 when disabled.
+  float resolutionScale;
+};
+
 // @brief Represents a RGBA8 color.
 struct CBZ_API ColorRGBA {
   uint8_t r;
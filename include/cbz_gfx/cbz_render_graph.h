@@ -0,0 +1,225 @@
+#ifndef CBZ_RENDER_GRAPH_H_
+#define CBZ_RENDER_GRAPH_H_
+
+#include "cbz_gfx_defines.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace cbz {
+
+typedef uint32_t RenderGraphResource;
+
+/// @brief Image owned by a render graph.
+struct CBZ_API RenderGraphImageDesc {
+  CBZTextureFormat format = CBZ_TEXTURE_FORMAT_RGBA8UNORM;
+
+  // Fixed size; 0 sizes the image 'scale' times the surface.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  float scale = 1.0f;
+
+  // CBZImageFlags; CBZ_IMAGE_RENDER_ATTACHMENT is implied.
+  int flags = CBZ_IMAGE_BINDING;
+
+  // Fixed size images only.
+  uint32_t sampleCount = 1;
+};
+
+struct CBZ_API RenderGraphStats {
+  uint32_t passCount;
+  uint32_t culledPassCount;
+
+  // Graph owned images and the images backing them after aliasing.
+  uint32_t transientImageCount;
+  uint32_t physicalImageCount;
+};
+
+class RenderGraph;
+
+/// @brief Declares the resources a pass accesses.
+class CBZ_API RenderGraphBuilder {
+public:
+  /// @brief Declares a sampled image or a read only buffer.
+  void read(RenderGraphResource resource);
+
+  /// @brief Declares a storage image or buffer written by a compute pass.
+  void write(RenderGraphResource resource);
+
+  /// @param flags CBZRenderAttachmentFlags. CBZ_RENDER_ATTACHMENT_LOAD also
+  /// reads the attachment.
+  void colorAttachment(RenderGraphResource image, int flags = 0);
+
+  void depthAttachment(RenderGraphResource image, int flags = 0);
+
+  /// @brief Draws to CBZ_DEFAULT_RENDER_TARGET. Surface passes are never
+  /// culled.
+  void surface();
+
+  /// @brief Keeps the pass even if nothing reads its outputs.
+  void sideEffect();
+
+private:
+  friend class RenderGraph;
+
+  RenderGraphBuilder(RenderGraph &graph, uint32_t pass)
+      : mGraph(graph), mPass(pass) {}
+
+  [[nodiscard]] bool isValid(RenderGraphResource resource, bool image) const;
+
+private:
+  RenderGraph &mGraph;
+  uint32_t mPass;
+};
+
+/// @brief Schedules passes from their declared resource accesses.
+///
+/// Passes writing imported resources or the surface are kept; passes whose
+/// outputs no kept pass reads are culled. Each write makes a new version of
+/// a resource and readers see the version left by the passes declared before
+/// them: they run after its writer and before the next write. Imported
+/// resources read before any write hold their incoming contents; graph owned
+/// images see their first write. Each kept pass is assigned its own target in
+/// execution order. Graph owned images whose lifetimes do not overlap share
+/// one image.
+///
+/// @note The graph is meant to be rebuilt each frame: reset(), add passes,
+/// compile() and execute(). Images are pooled across builds, so unchanged
+/// graphs reuse the same images.
+class CBZ_API RenderGraph {
+public:
+  static constexpr RenderGraphResource INVALID_RESOURCE = UINT32_MAX;
+
+  using SetupFunc = std::function<void(RenderGraphBuilder &builder)>;
+
+  // Submits the pass' work to 'target'.
+  using ExecuteFunc =
+      std::function<void(const RenderGraph &graph, uint8_t target)>;
+
+  /// @param firstTarget target of the first pass; later passes take the
+  /// following targets.
+  explicit RenderGraph(uint8_t firstTarget = 0);
+
+  RenderGraph(const RenderGraph &) = delete;
+  RenderGraph &operator=(const RenderGraph &) = delete;
+
+  /// @note Destroys pooled images; destroy graphs before Shutdown().
+  ~RenderGraph();
+
+  [[nodiscard]] RenderGraphResource
+  createImage(const char *name, const RenderGraphImageDesc &desc);
+
+  [[nodiscard]] RenderGraphResource importImage(const char *name,
+                                                ImageHandle imgh);
+
+  [[nodiscard]] RenderGraphResource importBuffer(const char *name,
+                                                 StructuredBufferHandle sbh);
+
+  /// @param type CBZ_TARGET_TYPE_GRAPHICS or CBZ_TARGET_TYPE_COMPUTE.
+  void addPass(const char *name, CBZTargetType type, const SetupFunc &setup,
+               ExecuteFunc execute);
+
+  /// @brief Culls and orders passes, assigns images and sets the render
+  /// targets of graphics passes.
+  [[nodiscard]] Result compile();
+
+  /// @brief Invokes the kept passes in execution order.
+  void execute() const;
+
+  /// @brief Clears passes and resources. Pooled images are kept.
+  void reset();
+
+  /// @returns image of 'resource', invalid if it is unused.
+  [[nodiscard]] ImageHandle getImage(RenderGraphResource resource) const;
+
+  [[nodiscard]] StructuredBufferHandle
+  getBuffer(RenderGraphResource resource) const;
+
+  [[nodiscard]] RenderGraphStats getStats() const;
+
+private:
+  friend class RenderGraphBuilder;
+
+  static constexpr uint32_t UNUSED = UINT32_MAX;
+
+  struct Resource {
+    std::string name;
+    bool imported;
+    bool buffer;
+    RenderGraphImageDesc desc;
+    ImageHandle imgh;
+    StructuredBufferHandle sbh;
+
+    // Positions of the first and last kept pass using the resource.
+    uint32_t firstUse;
+    uint32_t lastUse;
+
+    uint32_t pooledImage;
+  };
+
+  struct Attachment {
+    RenderGraphResource resource;
+    int flags;
+  };
+
+  struct Pass {
+    std::string name;
+    CBZTargetType type;
+    ExecuteFunc execute;
+
+    std::vector<RenderGraphResource> reads;
+    std::vector<RenderGraphResource> writes;
+    std::vector<Attachment> colorAttachments;
+    Attachment depthAttachment = {INVALID_RESOURCE, 0};
+
+    bool surface = false;
+    bool sideEffect = false;
+    bool kept = false;
+    uint8_t target = CBZ_INVALID_RENDER_TARGET;
+  };
+
+  struct PooledImage {
+    RenderGraphImageDesc desc;
+    ImageHandle imgh;
+    uint32_t idleBuilds;
+
+    // Position of the last pass using the image in this build.
+    uint32_t busyUntil;
+  };
+
+  [[nodiscard]] bool reads(const Pass &pass,
+                           RenderGraphResource resource) const;
+
+  [[nodiscard]] bool writes(const Pass &pass,
+                            RenderGraphResource resource) const;
+
+  void cull();
+
+  // @returns pass writing the version of 'resource' that 'passIdx' reads,
+  // UNUSED if it reads the imported contents.
+  [[nodiscard]] uint32_t findProducer(uint32_t passIdx,
+                                      RenderGraphResource resource) const;
+
+  [[nodiscard]] Result sort();
+
+  [[nodiscard]] Result allocateImages();
+
+  [[nodiscard]] Result assignTargets();
+
+private:
+  uint8_t mFirstTarget;
+
+  std::vector<Resource> mResources;
+  std::vector<Pass> mPasses;
+
+  // Kept passes in execution order.
+  std::vector<uint32_t> mOrder;
+  bool mCompiled = false;
+
+  std::vector<PooledImage> mImages;
+};
+
+} // namespace cbz
+
+#endif
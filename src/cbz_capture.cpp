@@ -0,0 +1,241 @@
+#include "cbz_capture.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <glfw/deps/stb_image_write.h>
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace cbz {
+
+// BT.601 limited range.
+static inline void RGBToYUV(uint8_t r, uint8_t g, uint8_t b, uint8_t *y,
+                            uint8_t *u, uint8_t *v) {
+  *y = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+  *u = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+  *v = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+Result CaptureEncoder::begin(const CaptureDesc &desc, uint32_t width,
+                             uint32_t height, CBZTextureFormat format) {
+  if (mActive) {
+    spdlog::warn("CaptureEncoder::begin() called on active capture!");
+    return Result::eFailure;
+  }
+
+  switch (format) {
+  case CBZ_TEXTURE_FORMAT_RGBA8UNORM:
+  case CBZ_TEXTURE_FORMAT_RGBA8UNORMSRGB:
+    mSwizzleBGRA = false;
+    break;
+
+  case CBZ_TEXTURE_FORMAT_BGRA8UNORM:
+  case CBZ_TEXTURE_FORMAT_BGRA8UNORMSRGB:
+    mSwizzleBGRA = true;
+    break;
+
+  default:
+    spdlog::error("Capture supports RGBA8 and BGRA8 images only!");
+    return Result::eFailure;
+  }
+
+  mDesc = desc;
+  mPath = desc.path ? desc.path : "capture";
+  mDesc.path = mPath.c_str();
+  mWidth = width;
+  mHeight = height;
+
+  if (mDesc.maxQueuedFrames == 0) {
+    mDesc.maxQueuedFrames = 8;
+  }
+
+  if (mDesc.frameRate == 0) {
+    mDesc.frameRate = 60;
+  }
+
+  switch (mDesc.format) {
+  case CBZ_CAPTURE_FORMAT_PNG:
+    break;
+
+  case CBZ_CAPTURE_FORMAT_Y4M:
+  case CBZ_CAPTURE_FORMAT_RAW: {
+    mFile = fopen(mPath.c_str(), "wb");
+    if (!mFile) {
+      spdlog::error("Failed to open capture file '{}'!", mPath);
+      return Result::eFailure;
+    }
+
+    if (mDesc.format == CBZ_CAPTURE_FORMAT_Y4M) {
+      fprintf(mFile, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", mWidth,
+              mHeight, mDesc.frameRate);
+    }
+  } break;
+  }
+
+  mNextIndex = 0;
+  mWritten = 0;
+  mDropped = 0;
+  mActive = true;
+
+#ifndef __EMSCRIPTEN__
+  mRunning = true;
+  mThread = std::thread(&CaptureEncoder::writerMain, this);
+#endif
+
+  spdlog::info("Capturing {}x{} to '{}'", mWidth, mHeight, mPath);
+  return Result::eSuccess;
+}
+
+bool CaptureEncoder::push(std::vector<uint8_t> &&texels) {
+  if (!mActive) {
+    return false;
+  }
+
+  if (texels.size() != static_cast<size_t>(mWidth) * mHeight * 4) {
+    spdlog::error("Captured frame size mismatch!");
+    mDropped++;
+    return false;
+  }
+
+  Frame frame = {mNextIndex++, std::move(texels)};
+
+#ifdef __EMSCRIPTEN__
+  write(frame);
+#else
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFrames.size() >= mDesc.maxQueuedFrames) {
+      mDropped++;
+      return false;
+    }
+
+    mFrames.push_back(std::move(frame));
+  }
+
+  mFrameAvailable.notify_one();
+#endif
+
+  return true;
+}
+
+void CaptureEncoder::end() {
+  if (!mActive) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRunning = false;
+  }
+
+  mFrameAvailable.notify_all();
+
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+
+  if (mFile) {
+    fclose(mFile);
+    mFile = nullptr;
+  }
+
+  mActive = false;
+
+  const CaptureStats stats = getStats();
+  spdlog::info("Capture finished: {} frames written, {} dropped.",
+               stats.framesWritten, stats.framesDropped);
+}
+
+CaptureStats CaptureEncoder::getStats() const {
+  CaptureStats stats = {};
+  stats.framesWritten = mWritten;
+  stats.framesDropped = mDropped;
+  return stats;
+}
+
+void CaptureEncoder::writerMain() {
+  while (true) {
+    Frame frame;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mFrameAvailable.wait(lock,
+                           [this]() { return !mRunning || !mFrames.empty(); });
+
+      // Drain queued frames before exiting.
+      if (mFrames.empty()) {
+        return;
+      }
+
+      frame = std::move(mFrames.front());
+      mFrames.pop_front();
+    }
+
+    write(frame);
+  }
+}
+
+void CaptureEncoder::write(Frame &frame) {
+  uint8_t *texels = frame.texels.data();
+  const size_t pixelCount = static_cast<size_t>(mWidth) * mHeight;
+
+  if (mSwizzleBGRA) {
+    for (size_t i = 0; i < pixelCount; i++) {
+      std::swap(texels[i * 4 + 0], texels[i * 4 + 2]);
+    }
+  }
+
+  bool written = false;
+  switch (mDesc.format) {
+  case CBZ_CAPTURE_FORMAT_PNG: {
+    char fileName[512];
+    snprintf(fileName, sizeof(fileName), "%s_%06u.png", mPath.c_str(),
+             frame.index);
+
+    written = stbi_write_png(fileName, static_cast<int>(mWidth),
+                             static_cast<int>(mHeight), 4, texels,
+                             static_cast<int>(mWidth * 4)) != 0;
+  } break;
+
+  case CBZ_CAPTURE_FORMAT_Y4M: {
+    // Planar 4:4:4
+    mScratch.resize(pixelCount * 3);
+    uint8_t *y = mScratch.data();
+    uint8_t *u = y + pixelCount;
+    uint8_t *v = u + pixelCount;
+
+    for (size_t i = 0; i < pixelCount; i++) {
+      RGBToYUV(texels[i * 4 + 0], texels[i * 4 + 1], texels[i * 4 + 2], &y[i],
+               &u[i], &v[i]);
+    }
+
+    written = fputs("FRAME\n", mFile) >= 0 &&
+              fwrite(mScratch.data(), 1, mScratch.size(), mFile) ==
+                  mScratch.size();
+  } break;
+
+  case CBZ_CAPTURE_FORMAT_RAW: {
+    written = fwrite(texels, 1, frame.texels.size(), mFile) ==
+              frame.texels.size();
+  } break;
+  }
+
+  if (written) {
+    mWritten++;
+  } else {
+    spdlog::error("Failed to write capture frame {}!", frame.index);
+    mDropped++;
+  }
+}
+
+}; // namespace cbz
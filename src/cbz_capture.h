@@ -0,0 +1,72 @@
+#ifndef CBZ_CAPTURE_H_
+#define CBZ_CAPTURE_H_
+
+#include "cbz_gfx/cbz_gfx_defines.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cbz {
+
+// @brief Writes captured frames to disk on a dedicated thread.
+// @note Frames are dropped instead of blocking once the queue is full.
+class CaptureEncoder {
+public:
+  [[nodiscard]] Result begin(const CaptureDesc &desc, uint32_t width,
+                             uint32_t height, CBZTextureFormat format);
+
+  // @brief Queues tightly packed texels of one frame.
+  // @returns false if the frame was dropped.
+  bool push(std::vector<uint8_t> &&texels);
+
+  // @brief Counts a frame lost before reaching the encoder.
+  inline void drop() { mDropped++; }
+
+  // @brief Writes queued frames and closes the output.
+  void end();
+
+  [[nodiscard]] inline bool isActive() const { return mActive; }
+
+  [[nodiscard]] CaptureStats getStats() const;
+
+private:
+  struct Frame {
+    uint32_t index;
+    std::vector<uint8_t> texels;
+  };
+
+  void writerMain();
+
+  void write(Frame &frame);
+
+private:
+  CaptureDesc mDesc = {};
+  std::string mPath;
+  uint32_t mWidth = 0;
+  uint32_t mHeight = 0;
+  bool mSwizzleBGRA = false;
+
+  FILE *mFile = nullptr;
+  std::vector<uint8_t> mScratch;
+
+  std::thread mThread;
+  std::deque<Frame> mFrames;
+  std::mutex mMutex;
+  std::condition_variable mFrameAvailable;
+  bool mActive = false;
+  bool mRunning = false;
+
+  uint32_t mNextIndex = 0;
+  std::atomic<uint32_t> mWritten = 0;
+  std::atomic<uint32_t> mDropped = 0;
+};
+
+}; // namespace cbz
+
+#endif
@@ -1,6 +1,8 @@
 #include "cbz_gfx/cbz_gfx.h"
 
 #include "cbz_gfx/cbz_gfx_defines.h"
+#include "cbz_capture.h"
+#include "cbz_ktx2.h"
 #include "cbz_gfx/net/cbz_net.h"
 #include "cbz_irenderer_context.h"
 
@@ -11,6 +13,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <cstdint>
 #include <murmurhash/MurmurHash3.h>
 
@@ -157,6 +160,8 @@ double GetAxis(Axis axis) {
 }; // namespace input
 
 // --- Renderer ---
+// Camera fields are those of the submission; replayed draw lists read the
+// camera of their submit from the camera buffer instead.
 struct TransformData {
   float transform[16];
   float view[16];
@@ -167,6 +172,19 @@ struct TransformData {
   float inverseProj[16];
 };
 
+constexpr uint32_t MAT4_PER_TRANSFORM =
+    sizeof(TransformData) / (sizeof(float) * 16);
+
+struct CameraData {
+  float view[16];
+  float proj[16];
+
+  float inverseView[16];
+  float inverseProj[16];
+};
+
+constexpr uint32_t MAT4_PER_CAMERA = sizeof(CameraData) / (sizeof(float) * 16);
+
 // TODO: Safe draw count
 static uint32_t sNextShaderProgramCmdIdx;
 static std::vector<ShaderProgramCommand> sShaderProgramCmds;
@@ -176,8 +194,151 @@ static std::unique_ptr<cbz::IRendererContext> sRenderer;
 static StructuredBufferHandle sTransformSBH;
 static std::array<TransformData, MAX_COMMAND_SUBMISSIONS> sTransforms;
 
+// --- Cameras ---
+// Each distinct camera of a frame is bound from a buffer of its own. Buffers
+// are reused in order of first use, so steady frames bind the same ones.
+struct CameraBuffer {
+  CameraData camera = {};
+  StructuredBufferHandle sbh = {CBZ_INVALID_HANDLE};
+};
+
+static std::vector<CameraBuffer> sCameraBuffers;
+static uint32_t sCameraBufferCount = 0;
+
 static std::vector<RenderTarget> sRenderTargets;
 
+static GraphicsProgramHandle sPlaceholderGPH = {CBZ_INVALID_HANDLE};
+
+static ImageHandle sSurfaceIMGH = {CBZ_INVALID_HANDLE};
+
+// --- Texture table ---
+static uint32_t sTextureTableCount = 0;
+static std::vector<uint32_t> sTextureTableFreeIndices;
+
+// --- Draw lists ---
+struct DrawList {
+  // Transforms of the recorded submissions, indexed by their position.
+  std::vector<TransformData> transforms;
+  StructuredBufferHandle transformSBH = {CBZ_INVALID_HANDLE};
+};
+
+static std::vector<DrawList> sDrawLists;
+static bool sDrawListRecording = false;
+
+// --- Draw items ---
+// Items of a chunk share a list and a transform buffer of fixed size, so a
+// change re-encodes one chunk and buffers never move.
+constexpr uint32_t DRAW_ITEM_CHUNK_SIZE = 256;
+
+struct DrawItem {
+  // Submission ID is the item's transform slot in its chunk's list.
+  ShaderProgramCommand cmd;
+  uint32_t chunk = 0;
+};
+
+struct DrawItemChunk {
+  // Items are drawn through a list, re-encoded only after items change.
+  DrawListHandle dlh = {CBZ_INVALID_HANDLE};
+
+  // Items in list order; patched as items are inserted and removed.
+  std::vector<uint32_t> order;
+
+  std::vector<uint32_t> freeSlots;
+  uint32_t slotCount = 0;
+
+  // Order or item state changed since the list was last updated.
+  bool dirty = false;
+};
+
+struct DrawItemTarget {
+  std::vector<DrawItemChunk> chunks;
+};
+
+static std::vector<DrawItem> sDrawItems;
+static std::vector<DrawItemTarget> sDrawItemTargets;
+
+// --- Capture ---
+// Leaves the remaining readback slots to the application.
+constexpr uint32_t MAX_CAPTURE_READS_IN_FLIGHT = 3;
+
+static CaptureEncoder sCaptureEncoder;
+static CaptureDesc sCaptureDesc;
+static std::string sCapturePath;
+static bool sCapturePending = false;
+static uint32_t sCaptureWidth = 0;
+static uint32_t sCaptureHeight = 0;
+static std::vector<ReadbackHandle> sCaptureReads;
+
+static void ShaderProgramCommandClear(ShaderProgramCommand &cmd) {
+  // Clear program data
+  memset(&cmd.program, 0, sizeof(cmd.program));
+  cmd.programType = CBZ_TARGET_TYPE_NONE;
+  cmd.isCull = false;
+  cmd.isDrawList = false;
+  cmd.pushConstantsSize = 0;
+
+  // Clear binding data
+  cmd.bindings.clear();
+
+  // Set sort key to invalid
+  cmd.sortKey = std::numeric_limits<uint64_t>::max();
+
+  cmd.coverage = -1.0f;
+}
+
+// @brief Orders draws by program, first vertex buffer and bindings.
+static uint64_t GraphicsSortKey(const ShaderProgramCommand &cmd,
+                                GraphicsProgramHandle gph) {
+  uint32_t uniformHash;
+  MurmurHash3_x86_32(cmd.bindings.data(),
+                     static_cast<uint32_t>(cmd.bindings.size()) *
+                         sizeof(Binding),
+                     0, &uniformHash);
+
+  return (uint64_t)(gph.idx & 0xFFFF) << 48 |
+         (uint64_t)(cmd.program.graphics.vbhs[0].idx & 0xFFFF) << 32 |
+         (uint64_t)(uniformHash & 0xFFFFFFFF);
+}
+
+static void Mat4Identity(float *mat) {
+  memset(mat, 0, sizeof(float) * 16);
+  mat[0] = 1;
+  mat[5] = 1;
+  mat[10] = 1;
+  mat[15] = 1;
+}
+
+// @returns buffer holding the camera of 'transform' this frame.
+static StructuredBufferHandle CameraBufferGet(const TransformData &transform) {
+  CameraData camera;
+  memcpy(camera.view, transform.view, sizeof(camera.view));
+  memcpy(camera.proj, transform.proj, sizeof(camera.proj));
+  memcpy(camera.inverseView, transform.inverseView, sizeof(camera.inverseView));
+  memcpy(camera.inverseProj, transform.inverseProj, sizeof(camera.inverseProj));
+
+  for (uint32_t bufferIdx = 0; bufferIdx < sCameraBufferCount; bufferIdx++) {
+    if (memcmp(&sCameraBuffers[bufferIdx].camera, &camera, sizeof(camera)) ==
+        0) {
+      return sCameraBuffers[bufferIdx].sbh;
+    }
+  }
+
+  if (sCameraBufferCount == sCameraBuffers.size()) {
+    CameraBuffer &cameraBuffer = sCameraBuffers.emplace_back();
+    cameraBuffer.camera = camera;
+    cameraBuffer.sbh = StructuredBufferCreate(
+        CBZ_UNIFORM_TYPE_MAT4, MAT4_PER_CAMERA, &camera, CBZ_BUFFER_READ_ONLY,
+        "CameraBuffer");
+  } else if (memcmp(&sCameraBuffers[sCameraBufferCount].camera, &camera,
+                    sizeof(camera)) != 0) {
+    CameraBuffer &cameraBuffer = sCameraBuffers[sCameraBufferCount];
+    cameraBuffer.camera = camera;
+    StructuredBufferUpdate(cameraBuffer.sbh, MAT4_PER_CAMERA, &camera);
+  }
+
+  return sCameraBuffers[sCameraBufferCount++].sbh;
+}
+
 Result Init(InitDesc initDesc) {
   Result result = Result::eSuccess;
 
@@ -207,7 +368,7 @@ Result Init(InitDesc initDesc) {
   }
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_RESIZABLE, initDesc.resizable ? GLFW_TRUE : GLFW_FALSE);
   sWindow = glfwCreateWindow(initDesc.width, initDesc.height, initDesc.name,
                              NULL, NULL);
 
@@ -220,32 +381,24 @@ Result Init(InitDesc initDesc) {
   InputInit();
 
   sRenderer = RendererContextCreate();
-  if (sRenderer->init(initDesc.width, initDesc.height, sWindow,
-                      HandleProvider<ImageHandle>::write(
-                          "CurrentSurfaceImage")) != Result::eSuccess) {
+  sSurfaceIMGH = HandleProvider<ImageHandle>::write("CurrentSurfaceImage");
+  if (sRenderer->init(initDesc, sWindow, sSurfaceIMGH) != Result::eSuccess) {
     return Result::eFailure;
   }
 
   // Initialize transform array to identity
-  TransformData data = {};
-  data.transform[0] = 1;
-  data.transform[5] = 1;
-  data.transform[10] = 1;
-  data.transform[15] = 1;
-  data.view[0] = 1;
-  data.view[5] = 1;
-  data.view[10] = 1;
-  data.view[15] = 1;
-  data.proj[0] = 1;
-  data.proj[5] = 1;
-  data.proj[10] = 1;
-  data.proj[15] = 1;
-  sTransforms.fill(data);
+  TransformData transform = {};
+  Mat4Identity(transform.transform);
+  Mat4Identity(transform.view);
+  Mat4Identity(transform.proj);
+  Mat4Identity(transform.inverseTransform);
+  Mat4Identity(transform.inverseView);
+  Mat4Identity(transform.inverseProj);
+  sTransforms.fill(transform);
 
   sTransformSBH = StructuredBufferCreate(
-      CBZ_UNIFORM_TYPE_MAT4,
-      MAX_COMMAND_SUBMISSIONS * (sizeof(TransformData) / (sizeof(float) * 16)),
-      sTransforms.data());
+      CBZ_UNIFORM_TYPE_MAT4, MAX_COMMAND_SUBMISSIONS * MAT4_PER_TRANSFORM,
+      sTransforms.data(), CBZ_BUFFER_READ_ONLY);
 
   sShaderProgramCmds.resize(MAX_COMMAND_SUBMISSIONS);
   sNextShaderProgramCmdIdx = 0;
@@ -345,8 +498,9 @@ void StructuredBufferUpdate(StructuredBufferHandle sbh, uint32_t elementCount,
 }
 
 void StructuredBufferSet(CBZBufferSlot slot, StructuredBufferHandle sbh,
-                         CBZBool32 dynamic) {
+                         CBZBool32 dynamic, uint8_t group) {
   Binding binding = {};
+  binding.group = group;
 
   binding.type = dynamic ? BindingType::eRWStructuredBuffer
                          : BindingType::eStructuredBuffer;
@@ -410,14 +564,36 @@ void UniformDestroy(UniformHandle uh) {
   HandleProvider<UniformHandle>::free(uh);
 }
 
+void PushConstantsSet(const void *data, uint32_t size) {
+  if (!data || size == 0 || size % sizeof(uint32_t) != 0) {
+    sLogger->error("Push constants size must be a non zero multiple of 4!");
+    return;
+  }
+
+  if (size > MAX_PUSH_CONSTANT_SIZE) {
+    sLogger->error("Push constants exceed {} bytes!",
+                   static_cast<uint32_t>(MAX_PUSH_CONSTANT_SIZE));
+    return;
+  }
+
+  ShaderProgramCommand &cmd = sShaderProgramCmds[sNextShaderProgramCmdIdx];
+  memcpy(cmd.pushConstants, data, size);
+  cmd.pushConstantsSize = size;
+}
+
 ImageHandle Image2DCreate(CBZTextureFormat format, uint32_t w, uint32_t h,
-                          int flags) {
+                          int flags, uint32_t sampleCount) {
+  if (sampleCount != 1 && sampleCount != 4) {
+    sLogger->error("Unsupported sample count {}!", sampleCount);
+    return {CBZ_INVALID_HANDLE};
+  }
+
   ImageHandle uh = HandleProvider<ImageHandle>::write();
 
   // Prefer uniform buffer
   if (sRenderer->imageCreate(uh, format, w, h, 1, CBZ_TEXTURE_DIMENSION_2D,
-                             static_cast<CBZImageFlags>(flags)) !=
-      Result::eSuccess) {
+                             static_cast<CBZImageFlags>(flags), 1,
+                             sampleCount) != Result::eSuccess) {
     HandleProvider<ImageHandle>::free(uh);
     return {CBZ_INVALID_HANDLE};
   }
@@ -425,6 +601,25 @@ ImageHandle Image2DCreate(CBZTextureFormat format, uint32_t w, uint32_t h,
   return uh;
 }
 
+ImageHandle Image2DCreateRelative(CBZTextureFormat format, float scale,
+                                  int flags) {
+  if (scale <= 0.0f) {
+    sLogger->error("Invalid relative image scale {}!", scale);
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  ImageHandle imgh = HandleProvider<ImageHandle>::write();
+
+  if (sRenderer->imageCreateRelative(imgh, format, scale,
+                                     static_cast<CBZImageFlags>(flags)) !=
+      Result::eSuccess) {
+    HandleProvider<ImageHandle>::free(imgh);
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  return imgh;
+}
+
 ImageHandle Image2DCubeMapCreate(CBZTextureFormat format, uint32_t w,
                                  uint32_t h, uint32_t depth, int flags) {
   ImageHandle uh = HandleProvider<ImageHandle>::write();
@@ -453,16 +648,99 @@ void Image2DUpdate(ImageHandle th, void *data, uint32_t count) {
   sRenderer->imageUpdate(th, data, count);
 }
 
-static void SamplerBind(CBZTextureSlot textureSlot, TextureBindingDesc desc) {
+bool ImageFormatIsSupported(CBZTextureFormat format) {
+  return sRenderer->imageFormatIsSupported(format);
+}
+
+ImageHandle ImageStreamKTX2(const char *path, int flags) {
+  ImageHandle imgh = HandleProvider<ImageHandle>::write();
+  HandleProvider<ImageHandle>::setName(imgh, path);
+
+  if (sRenderer->imageStreamCreate(imgh, path,
+                                   static_cast<CBZImageFlags>(flags)) !=
+      Result::eSuccess) {
+    HandleProvider<ImageHandle>::free(imgh);
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  return imgh;
+}
+
+void ImageStreamPrioritySet(ImageHandle imgh, float priority) {
+  if (!HandleProvider<ImageHandle>::isValid(imgh)) {
+    sLogger->error("Attempting to prioritize invalid image handle!");
+    return;
+  }
+
+  sRenderer->imageStreamPrioritySet(imgh, priority);
+}
+
+void DrawCoverageSet(float coverage) {
+  sShaderProgramCmds[sNextShaderProgramCmdIdx].coverage =
+      std::clamp(coverage, 0.0f, 1.0f);
+}
+
+ImageHandle ImageLoadKTX2(const char *path, int flags) {
+  KTX2Image image = {};
+  if (KTX2Load(path, &image) != Result::eSuccess) {
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  if (!sRenderer->imageFormatIsSupported(image.format)) {
+    sLogger->error("'{}' format {} is not supported by the device!", path,
+                   static_cast<uint32_t>(image.format));
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  const uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+  if (levelCount > 1) {
+    flags &= ~CBZ_IMAGE_MIPMAPS;
+  }
+
+  ImageHandle imgh = HandleProvider<ImageHandle>::write();
+  HandleProvider<ImageHandle>::setName(imgh, path);
+
+  if (sRenderer->imageCreate(imgh, image.format, image.width, image.height,
+                             image.layerCount, CBZ_TEXTURE_DIMENSION_2D,
+                             static_cast<CBZImageFlags>(flags),
+                             levelCount) != Result::eSuccess) {
+    HandleProvider<ImageHandle>::free(imgh);
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  if (levelCount == 1) {
+    sRenderer->imageUpdate(imgh, image.data.data() + image.levels[0].offset,
+                           static_cast<uint32_t>(image.levels[0].size));
+    return imgh;
+  }
+
+  for (uint32_t level = 0; level < levelCount; level++) {
+    const KTX2Level &mip = image.levels[level];
+    if (sRenderer->imageUpdateMip(imgh, level, image.data.data() + mip.offset,
+                                  static_cast<uint32_t>(mip.size)) !=
+        Result::eSuccess) {
+      sRenderer->imageDestroy(imgh);
+      HandleProvider<ImageHandle>::free(imgh);
+      return {CBZ_INVALID_HANDLE};
+    }
+  }
+
+  return imgh;
+}
+
+static void SamplerBind(CBZTextureSlot textureSlot, TextureBindingDesc desc,
+                        uint8_t group) {
   Binding binding = {};
   binding.type = BindingType::eSampler;
+  binding.group = group;
   binding.value.sampler.slot = static_cast<uint8_t>(textureSlot) + 1;
   binding.value.sampler.handle = sRenderer->getSampler(desc);
 
   sShaderProgramCmds[sNextShaderProgramCmdIdx].bindings.push_back(binding);
 }
 
-void TextureSet(CBZTextureSlot slot, ImageHandle th, TextureBindingDesc desc) {
+void TextureSet(CBZTextureSlot slot, ImageHandle th, TextureBindingDesc desc,
+                uint8_t group) {
   if (th.idx == CBZ_INVALID_HANDLE) {
     sLogger->error("Attempting to bind invalid handle at texture slot @{}!",
                    static_cast<uint32_t>(slot));
@@ -480,12 +758,65 @@ void TextureSet(CBZTextureSlot slot, ImageHandle th, TextureBindingDesc desc) {
   } break;
   }
 
+  binding.group = group;
   binding.value.texture.slot = static_cast<uint8_t>(slot);
   binding.value.texture.handle = th;
+  binding.value.texture.baseMipLevel =
+      static_cast<uint16_t>(desc.baseMipLevel);
+  binding.value.texture.mipLevelCount =
+      static_cast<uint16_t>(desc.mipLevelCount);
   sShaderProgramCmds[sNextShaderProgramCmdIdx].bindings.push_back(binding);
 
   if (desc.addressMode != CBZ_ADDRESS_MODE_COUNT) {
-    SamplerBind(slot, desc);
+    SamplerBind(slot, desc, group);
+  }
+}
+
+uint32_t TextureTableAdd(ImageHandle imgh) {
+  if (!HandleProvider<ImageHandle>::isValid(imgh)) {
+    sLogger->error("Attempting to add invalid image to the texture table!");
+    return UINT32_MAX;
+  }
+
+  uint32_t index;
+  if (!sTextureTableFreeIndices.empty()) {
+    index = sTextureTableFreeIndices.back();
+    sTextureTableFreeIndices.pop_back();
+  } else if (sTextureTableCount < MAX_TEXTURE_TABLE_SIZE) {
+    index = sTextureTableCount++;
+  } else {
+    sLogger->error("Texture table is full!");
+    return UINT32_MAX;
+  }
+
+  sRenderer->textureTableSet(index, imgh);
+  return index;
+}
+
+void TextureTableRemove(uint32_t index) {
+  if (index >= sTextureTableCount ||
+      std::find(sTextureTableFreeIndices.begin(),
+                sTextureTableFreeIndices.end(),
+                index) != sTextureTableFreeIndices.end()) {
+    sLogger->warn("Attempting to remove unused texture table index {}!",
+                  index);
+    return;
+  }
+
+  sRenderer->textureTableSet(index, {CBZ_INVALID_HANDLE});
+  sTextureTableFreeIndices.push_back(index);
+}
+
+void TextureTableSet(CBZTextureSlot slot, TextureBindingDesc desc,
+                     uint8_t group) {
+  Binding binding = {};
+  binding.type = BindingType::eTextureTable;
+  binding.group = group;
+  binding.value.textureTable.slot = static_cast<uint8_t>(slot);
+  sShaderProgramCmds[sNextShaderProgramCmdIdx].bindings.push_back(binding);
+
+  if (desc.addressMode != CBZ_ADDRESS_MODE_COUNT) {
+    SamplerBind(slot, desc, group);
   }
 }
 
@@ -512,6 +843,27 @@ ShaderHandle ShaderCreate(const char *path, int flags) {
   return sh;
 }
 
+ShaderHandle ShaderCreateAsync(const char *path, int flags) {
+  ShaderHandle sh = HandleProvider<ShaderHandle>::write();
+
+  if (sRenderer->shaderCreateAsync(sh, static_cast<CBZShaderFlags>(flags),
+                                   path) != Result::eSuccess) {
+    sLogger->error("Failed to queue shader '{}'!", path);
+    HandleProvider<ShaderHandle>::free(sh);
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  return sh;
+}
+
+CBZBool32 ShaderIsReady(ShaderHandle sh) {
+  if (!HandleProvider<ShaderHandle>::isValid(sh)) {
+    return false;
+  }
+
+  return sRenderer->shaderIsReady(sh);
+}
+
 void ShaderSetName(ShaderHandle sh, const char *name, uint32_t len) {
   if (!HandleProvider<ShaderHandle>::isValid(sh)) {
     sLogger->error("Attempting to name invalid shader handle!");
@@ -561,10 +913,24 @@ void GraphicsProgramDestroy(GraphicsProgramHandle gph) {
     return;
   }
 
+  if (sPlaceholderGPH.idx == gph.idx) {
+    sPlaceholderGPH = {CBZ_INVALID_HANDLE};
+  }
+
   sRenderer->graphicsProgramDestroy(gph);
   HandleProvider<GraphicsProgramHandle>::free(gph);
 }
 
+void GraphicsProgramPlaceholderSet(GraphicsProgramHandle gph) {
+  if (gph.idx != CBZ_INVALID_HANDLE &&
+      !HandleProvider<GraphicsProgramHandle>::isValid(gph)) {
+    sLogger->error("Attempting to set invalid placeholder program handle!");
+    return;
+  }
+
+  sPlaceholderGPH = gph;
+}
+
 ComputeProgramHandle ComputeProgramCreate(ShaderHandle sh, const char *name) {
   ComputeProgramHandle cph = HandleProvider<ComputeProgramHandle>::write(name);
 
@@ -611,7 +977,14 @@ void ProjectionSet(const float *proj) {
 void RenderTargetSet(uint8_t target,
                      const AttachmentDescription *colorAttachments,
                      uint32_t colorAttachmentCount,
-                     const AttachmentDescription *depthAttachment) {
+                     const AttachmentDescription *depthAttachment,
+                     uint32_t sampleCount) {
+  if (sampleCount != 1 && sampleCount != 4) {
+    sLogger->error("Unsupported sample count {} for target {}!", sampleCount,
+                   target);
+    return;
+  }
+
   if (target >= sRenderTargets.size()) {
     sRenderTargets.resize(target + 1u);
   }
@@ -624,6 +997,8 @@ void RenderTargetSet(uint8_t target,
   if (depthAttachment) {
     sRenderTargets[target].depthAttachment = *depthAttachment;
   }
+
+  sRenderTargets[target].sampleCount = sampleCount;
 }
 
 void Submit(uint8_t target, GraphicsProgramHandle gph) {
@@ -640,7 +1015,20 @@ void Submit(uint8_t target, GraphicsProgramHandle gph) {
     return;
   }
 
+  if (!sRenderer->graphicsProgramIsReady(gph)) {
+    if (sPlaceholderGPH.idx == CBZ_INVALID_HANDLE ||
+        !sRenderer->graphicsProgramIsReady(sPlaceholderGPH)) {
+      // Skip; slot is reused by the next submission.
+      ShaderProgramCommandClear(sShaderProgramCmds[sNextShaderProgramCmdIdx]);
+      return;
+    }
+
+    gph = sPlaceholderGPH;
+  }
+
   StructuredBufferSet(CBZ_BUFFER_GLOBAL_TRANSFORM, sTransformSBH);
+  StructuredBufferSet(CBZ_BUFFER_GLOBAL_CAMERA,
+                      CameraBufferGet(sTransforms[sNextShaderProgramCmdIdx]));
 
   ShaderProgramCommand *currentCommand =
       &sShaderProgramCmds[sNextShaderProgramCmdIdx];
@@ -654,21 +1042,11 @@ void Submit(uint8_t target, GraphicsProgramHandle gph) {
   }
 
   currentCommand->programType = CBZ_TARGET_TYPE_GRAPHICS;
-
-  uint32_t uniformHash;
-  MurmurHash3_x86_32(currentCommand->bindings.data(),
-                     static_cast<uint32_t>(currentCommand->bindings.size()) *
-                         sizeof(Binding),
-                     0, &uniformHash);
-
   currentCommand->program.graphics.ph = gph;
 
   currentCommand->target = target;
 
-  currentCommand->sortKey =
-      (uint64_t)(gph.idx & 0xFFFF) << 48 |
-      (uint64_t)(currentCommand->program.graphics.vbhs[0].idx & 0xFFFF) << 32 |
-      (uint64_t)(uniformHash & 0xFFFFFFFF);
+  currentCommand->sortKey = GraphicsSortKey(*currentCommand, gph);
   currentCommand->submissionID = sNextShaderProgramCmdIdx++;
 }
 
@@ -680,6 +1058,12 @@ void Submit(uint8_t target, ComputeProgramHandle cph, uint32_t x, uint32_t y,
     return;
   }
 
+  if (!sRenderer->computeProgramIsReady(cph)) {
+    // Skip; slot is reused by the next submission.
+    ShaderProgramCommandClear(sShaderProgramCmds[sNextShaderProgramCmdIdx]);
+    return;
+  }
+
   ShaderProgramCommand *currentCommand =
       &sShaderProgramCmds[sNextShaderProgramCmdIdx];
 
@@ -710,36 +1094,700 @@ void Submit(uint8_t target, ComputeProgramHandle cph, uint32_t x, uint32_t y,
   currentCommand->submissionID = sNextShaderProgramCmdIdx++;
 }
 
-void ReadBufferAsync(StructuredBufferHandle sbh,
-                     std::function<void(const void *data)> callback) {
+void SubmitIndirect(uint8_t target, GraphicsProgramHandle gph,
+                    StructuredBufferHandle argsSBH, uint32_t argsOffset) {
+  if (!HandleProvider<StructuredBufferHandle>::isValid(argsSBH)) {
+    sLogger->error("Attempting to submit with invalid arguments buffer!");
+    return;
+  }
+
+  if (argsOffset % sizeof(uint32_t) != 0) {
+    sLogger->error("Indirect arguments offset {} is not a multiple of 4!",
+                   argsOffset);
+    return;
+  }
+
+  ShaderProgramCommand &cmd = sShaderProgramCmds[sNextShaderProgramCmdIdx];
+  cmd.program.graphics.argsSBH = argsSBH;
+  cmd.program.graphics.argsOffset = argsOffset;
+  cmd.program.graphics.indirectCount = 1;
+
+  Submit(target, gph);
+}
+
+void SubmitMultiIndirect(uint8_t target, GraphicsProgramHandle gph,
+                         StructuredBufferHandle argsSBH, uint32_t maxCount,
+                         StructuredBufferHandle countSBH) {
+  if (!HandleProvider<StructuredBufferHandle>::isValid(argsSBH)) {
+    sLogger->error("Attempting to submit with invalid arguments buffer!");
+    return;
+  }
+
+  if (maxCount == 0) {
+    sLogger->error("Attempting to submit multi draw of 0 draws!");
+    return;
+  }
+
+  ShaderProgramCommand &cmd = sShaderProgramCmds[sNextShaderProgramCmdIdx];
+  cmd.program.graphics.argsSBH = argsSBH;
+  cmd.program.graphics.argsOffset = 0;
+  cmd.program.graphics.indirectCount = maxCount;
+
+  if (HandleProvider<StructuredBufferHandle>::isValid(countSBH)) {
+    cmd.program.graphics.countSBH = countSBH;
+    cmd.program.graphics.indirectCounted = true;
+  }
+
+  Submit(target, gph);
+}
+
+void CullSubmit(uint8_t target, const CullDesc &desc) {
+  if (!HandleProvider<StructuredBufferHandle>::isValid(desc.boundsSBH) ||
+      !HandleProvider<StructuredBufferHandle>::isValid(desc.visibleSBH) ||
+      !HandleProvider<StructuredBufferHandle>::isValid(desc.argsSBH)) {
+    sLogger->error("Attempting to cull with invalid buffer handles!");
+    return;
+  }
+
+  if (sShaderProgramCmds.size() > MAX_COMMAND_SUBMISSIONS) {
+    sLogger->error("Application has exceeded maximum submits calls!");
+    return;
+  }
+
+  ShaderProgramCommand *currentCommand =
+      &sShaderProgramCmds[sNextShaderProgramCmdIdx];
+
+  // Culling binds its own resources.
+  currentCommand->bindings.clear();
+  currentCommand->programType = CBZ_TARGET_TYPE_COMPUTE;
+  currentCommand->isCull = true;
+
+  auto &cull = currentCommand->program.cull;
+  cull.boundsSBH = desc.boundsSBH;
+  cull.visibleSBH = desc.visibleSBH;
+  cull.argsSBH = desc.argsSBH;
+  cull.transformSBH = sTransformSBH;
+  cull.depthIMGH = desc.depthIMGH;
+  cull.objectCount = desc.objectCount;
+  cull.indexCount = desc.indexCount;
+  cull.firstIndex = desc.firstIndex;
+  cull.baseVertex = desc.baseVertex;
+
+  const TransformData &transform = sTransforms[sNextShaderProgramCmdIdx];
+  const glm::mat4 viewProj =
+      glm::make_mat4(transform.proj) * glm::make_mat4(transform.view);
+  memcpy(cull.viewProj, glm::value_ptr(viewProj), sizeof(cull.viewProj));
+
+  currentCommand->target = target;
+
+  // After the compute programs of the target, in submission order.
+  currentCommand->sortKey =
+      (uint64_t)0xFFFF << 48 | (uint64_t)sNextShaderProgramCmdIdx;
+  currentCommand->submissionID = sNextShaderProgramCmdIdx++;
+}
+
+DrawListHandle DrawListCreate(const char *name) {
+  DrawListHandle dlh = HandleProvider<DrawListHandle>::write(name);
+  if (dlh.idx == CBZ_INVALID_HANDLE) {
+    sLogger->error("Failed to create draw list '{}'!", name);
+    return dlh;
+  }
+
+  if (sDrawLists.size() < dlh.idx + 1u) {
+    sDrawLists.resize(dlh.idx + 1u);
+  }
+
+  sDrawLists[dlh.idx] = {};
+  sRenderer->drawListUpdate(dlh, {});
+  return dlh;
+}
+
+void DrawListRecord(DrawListHandle dlh, const std::function<void()> &record) {
+  if (!HandleProvider<DrawListHandle>::isValid(dlh)) {
+    sLogger->error("Attempting to record invalid draw list handle!");
+    return;
+  }
+
+  if (sDrawListRecording) {
+    sLogger->error("Attempting to record a draw list while recording!");
+    return;
+  }
+
+  // State set for the next submission survives the recording.
+  const uint32_t first = sNextShaderProgramCmdIdx;
+  ShaderProgramCommand pendingCmd = sShaderProgramCmds[first];
+  const TransformData pendingTransform = sTransforms[first];
+
+  // Recorded submissions start from cleared state.
+  ShaderProgramCommandClear(sShaderProgramCmds[first]);
+  Mat4Identity(sTransforms[first].transform);
+  Mat4Identity(sTransforms[first].inverseTransform);
+
+  sDrawListRecording = true;
+  record();
+  sDrawListRecording = false;
+
+  DrawList &drawList = sDrawLists[dlh.idx];
+  drawList.transforms.clear();
+
+  std::vector<ShaderProgramCommand> cmds;
+  for (uint32_t cmdIdx = first; cmdIdx < sNextShaderProgramCmdIdx; cmdIdx++) {
+    ShaderProgramCommand &cmd = sShaderProgramCmds[cmdIdx];
+
+    if (cmd.programType != CBZ_TARGET_TYPE_GRAPHICS || cmd.isDrawList) {
+      sLogger->warn("Draw lists record graphics submissions only!");
+    } else if (cmd.pushConstantsSize > 0) {
+      // Render bundles can not set push constants.
+      sLogger->warn("Draw lists can not record push constants!");
+    } else {
+      // Draws read their transform at their position in the list.
+      cmd.submissionID = static_cast<uint32_t>(cmds.size());
+      cmds.push_back(std::move(cmd));
+      drawList.transforms.push_back(sTransforms[cmdIdx]);
+    }
+
+    ShaderProgramCommandClear(cmd);
+  }
+
+  sNextShaderProgramCmdIdx = first;
+  sShaderProgramCmds[first] = std::move(pendingCmd);
+  sTransforms[first] = pendingTransform;
+
+  StructuredBufferDestroy(drawList.transformSBH);
+  drawList.transformSBH = {CBZ_INVALID_HANDLE};
+
+  if (!cmds.empty()) {
+    drawList.transformSBH = StructuredBufferCreate(
+        CBZ_UNIFORM_TYPE_MAT4,
+        static_cast<uint32_t>(drawList.transforms.size()) * MAT4_PER_TRANSFORM,
+        drawList.transforms.data(), CBZ_BUFFER_READ_ONLY);
+
+    for (ShaderProgramCommand &cmd : cmds) {
+      for (Binding &binding : cmd.bindings) {
+        if (binding.type == BindingType::eStructuredBuffer &&
+            binding.value.storageBuffer.handle.idx == sTransformSBH.idx) {
+          binding.value.storageBuffer.handle = drawList.transformSBH;
+        }
+      }
+    }
+  }
+
+  // Ordered as frames are; identical draws stay adjacent for instancing.
+  std::sort(cmds.begin(), cmds.end(),
+            [](const ShaderProgramCommand &a, const ShaderProgramCommand &b) {
+              if (a.sortKey != b.sortKey) {
+                return a.sortKey < b.sortKey;
+              }
+
+              return a.submissionID < b.submissionID;
+            });
+
+  sRenderer->drawListUpdate(dlh, std::move(cmds));
+}
+
+// @brief Submits 'dlh' drawing with the camera in 'cameraSBH'.
+static void DrawListSubmit(uint8_t target, DrawListHandle dlh,
+                           StructuredBufferHandle cameraSBH) {
+  ShaderProgramCommand &cmd = sShaderProgramCmds[sNextShaderProgramCmdIdx];
+
+  // The list binds its own resources.
+  ShaderProgramCommandClear(cmd);
+  cmd.programType = CBZ_TARGET_TYPE_GRAPHICS;
+  cmd.isDrawList = true;
+  cmd.program.drawList.dlh = dlh;
+  cmd.program.drawList.cameraSBH = cameraSBH;
+
+  cmd.target = target;
+
+  // Before the other draws of the target.
+  cmd.sortKey = 0;
+  cmd.submissionID = sNextShaderProgramCmdIdx++;
+}
+
+void DrawListSubmit(uint8_t target, DrawListHandle dlh) {
+  if (!HandleProvider<DrawListHandle>::isValid(dlh)) {
+    sLogger->error("Attempting to submit invalid draw list handle!");
+    return;
+  }
+
+  if (sDrawLists[dlh.idx].transforms.empty()) {
+    // Nothing to draw; state set for this submission is consumed all the same.
+    ShaderProgramCommandClear(sShaderProgramCmds[sNextShaderProgramCmdIdx]);
+    return;
+  }
+
+  // Recorded draws read the camera of this submission, not their own.
+  DrawListSubmit(target, dlh,
+                 CameraBufferGet(sTransforms[sNextShaderProgramCmdIdx]));
+}
+
+void DrawListDestroy(DrawListHandle dlh) {
+  if (!HandleProvider<DrawListHandle>::isValid(dlh)) {
+    sLogger->warn("Attempting to destroy invalid 'DrawListHandle'!");
+    return;
+  }
+
+  StructuredBufferDestroy(sDrawLists[dlh.idx].transformSBH);
+  sDrawLists[dlh.idx] = {};
+
+  sRenderer->drawListDestroy(dlh);
+  HandleProvider<DrawListHandle>::free(dlh);
+}
+
+// @brief Orders items as their list draws them.
+static bool DrawItemLess(uint32_t a, uint32_t b) {
+  const ShaderProgramCommand &cmdA = sDrawItems[a].cmd;
+  const ShaderProgramCommand &cmdB = sDrawItems[b].cmd;
+  if (cmdA.sortKey != cmdB.sortKey) {
+    return cmdA.sortKey < cmdB.sortKey;
+  }
+
+  return cmdA.submissionID < cmdB.submissionID;
+}
+
+static void DrawItemInsert(DrawItemChunk &chunk, uint32_t itemIdx) {
+  chunk.order.insert(std::lower_bound(chunk.order.begin(), chunk.order.end(),
+                                      itemIdx, DrawItemLess),
+                     itemIdx);
+  chunk.dirty = true;
+}
+
+static void DrawItemRemove(DrawItemChunk &chunk, uint32_t itemIdx) {
+  auto it = std::lower_bound(chunk.order.begin(), chunk.order.end(), itemIdx,
+                             DrawItemLess);
+  if (it != chunk.order.end() && *it == itemIdx) {
+    chunk.order.erase(it);
+  }
+  chunk.dirty = true;
+}
+
+// @brief Takes a free slot of 'itemTarget', adding a chunk if all are full.
+// @returns false if no chunk could be created.
+static bool DrawItemSlotAllocate(DrawItemTarget &itemTarget, uint32_t *chunkIdx,
+                                 uint32_t *slot) {
+  for (uint32_t idx = 0; idx < itemTarget.chunks.size(); idx++) {
+    DrawItemChunk &chunk = itemTarget.chunks[idx];
+    if (!chunk.freeSlots.empty()) {
+      *chunkIdx = idx;
+      *slot = chunk.freeSlots.back();
+      chunk.freeSlots.pop_back();
+      return true;
+    }
+
+    if (chunk.slotCount < DRAW_ITEM_CHUNK_SIZE) {
+      *chunkIdx = idx;
+      *slot = chunk.slotCount++;
+      return true;
+    }
+  }
+
+  DrawItemChunk chunk;
+  chunk.dlh = DrawListCreate("DrawItems");
+  if (chunk.dlh.idx == CBZ_INVALID_HANDLE) {
+    return false;
+  }
+
+  DrawList &drawList = sDrawLists[chunk.dlh.idx];
+  drawList.transforms.resize(DRAW_ITEM_CHUNK_SIZE);
+  drawList.transformSBH = StructuredBufferCreate(
+      CBZ_UNIFORM_TYPE_MAT4, DRAW_ITEM_CHUNK_SIZE * MAT4_PER_TRANSFORM,
+      drawList.transforms.data(), CBZ_BUFFER_READ_ONLY);
+
+  *chunkIdx = static_cast<uint32_t>(itemTarget.chunks.size());
+  *slot = chunk.slotCount++;
+  itemTarget.chunks.push_back(std::move(chunk));
+  return true;
+}
+
+// @brief Writes the transform of 'slot' and uploads only that slot.
+static void DrawItemTransformWrite(DrawList &drawList, uint32_t slot,
+                                   const float *transform,
+                                   const float *inverseTransform) {
+  TransformData &data = drawList.transforms[slot];
+  memcpy(data.transform, transform, sizeof(data.transform));
+  memcpy(data.inverseTransform, inverseTransform,
+         sizeof(data.inverseTransform));
+
+  StructuredBufferUpdate(drawList.transformSBH, MAT4_PER_TRANSFORM, &data,
+                         slot * MAT4_PER_TRANSFORM);
+}
+
+// @brief Moves the state set for the next submission into 'cmd'.
+static Result DrawItemCapture(ShaderProgramCommand &cmd,
+                              const DrawList &drawList, uint8_t target,
+                              GraphicsProgramHandle gph, uint32_t slot) {
+  ShaderProgramCommand &pending = sShaderProgramCmds[sNextShaderProgramCmdIdx];
+
+  // Two bindings are left for the transforms and the camera.
+  if (pending.bindings.size() + 2 >
+      static_cast<uint64_t>(MAX_COMMAND_BINDINGS)) {
+    sLogger->error("Draw item exceeding max bindings {} + 2 > {}",
+                   pending.bindings.size(),
+                   static_cast<uint32_t>(MAX_COMMAND_BINDINGS));
+    ShaderProgramCommandClear(pending);
+    return Result::eFailure;
+  }
+
+  if (pending.pushConstantsSize > 0) {
+    // Render bundles can not set push constants.
+    sLogger->warn("Draw items can not set push constants!");
+  }
+
+  cmd = std::move(pending);
+  ShaderProgramCommandClear(pending);
+
+  Binding binding = {};
+  binding.type = BindingType::eStructuredBuffer;
+  binding.value.storageBuffer.slot =
+      static_cast<uint8_t>(CBZ_BUFFER_GLOBAL_TRANSFORM);
+  binding.value.storageBuffer.handle = drawList.transformSBH;
+  cmd.bindings.push_back(binding);
+
+  // Replaced by the camera of each replay.
+  binding.value.storageBuffer.slot =
+      static_cast<uint8_t>(CBZ_BUFFER_GLOBAL_CAMERA);
+  binding.value.storageBuffer.handle = {CBZ_INVALID_HANDLE};
+  cmd.bindings.push_back(binding);
+
+  cmd.programType = CBZ_TARGET_TYPE_GRAPHICS;
+  cmd.pushConstantsSize = 0;
+  cmd.program.graphics.ph = gph;
+  cmd.target = target;
+
+  cmd.sortKey = GraphicsSortKey(cmd, gph);
+  cmd.submissionID = slot;
+  return Result::eSuccess;
+}
+
+DrawItemHandle DrawItemCreate(uint8_t target, GraphicsProgramHandle gph) {
+  if (!HandleProvider<GraphicsProgramHandle>::isValid(gph)) {
+    sLogger->error("Attempting to create draw item with invalid program!");
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  if (sDrawItemTargets.size() < target + 1u) {
+    sDrawItemTargets.resize(target + 1u);
+  }
+
+  DrawItemTarget &itemTarget = sDrawItemTargets[target];
+
+  DrawItemHandle dih = HandleProvider<DrawItemHandle>::write();
+  if (dih.idx == CBZ_INVALID_HANDLE) {
+    sLogger->error("Failed to create draw item!");
+    return dih;
+  }
+
+  if (sDrawItems.size() < dih.idx + 1u) {
+    sDrawItems.resize(dih.idx + 1u);
+  }
+
+  uint32_t chunkIdx;
+  uint32_t slot;
+  if (!DrawItemSlotAllocate(itemTarget, &chunkIdx, &slot)) {
+    ShaderProgramCommandClear(sShaderProgramCmds[sNextShaderProgramCmdIdx]);
+    HandleProvider<DrawItemHandle>::free(dih);
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  DrawItemChunk &chunk = itemTarget.chunks[chunkIdx];
+  DrawList &drawList = sDrawLists[chunk.dlh.idx];
+
+  DrawItem &item = sDrawItems[dih.idx];
+  if (DrawItemCapture(item.cmd, drawList, target, gph, slot) !=
+      Result::eSuccess) {
+    chunk.freeSlots.push_back(slot);
+    HandleProvider<DrawItemHandle>::free(dih);
+    return {CBZ_INVALID_HANDLE};
+  }
+  item.chunk = chunkIdx;
+
+  const TransformData &pendingTransform = sTransforms[sNextShaderProgramCmdIdx];
+  DrawItemTransformWrite(drawList, slot, pendingTransform.transform,
+                         pendingTransform.inverseTransform);
+
+  DrawItemInsert(chunk, dih.idx);
+  return dih;
+}
+
+void DrawItemUpdate(DrawItemHandle dih, GraphicsProgramHandle gph) {
+  if (!HandleProvider<DrawItemHandle>::isValid(dih) ||
+      !HandleProvider<GraphicsProgramHandle>::isValid(gph)) {
+    sLogger->error("Attempting to update draw item with invalid handles!");
+    return;
+  }
+
+  DrawItem &item = sDrawItems[dih.idx];
+  const uint8_t target = item.cmd.target;
+  const uint32_t slot = item.cmd.submissionID;
+  DrawItemChunk &chunk = sDrawItemTargets[target].chunks[item.chunk];
+
+  ShaderProgramCommand cmd;
+  if (DrawItemCapture(cmd, sDrawLists[chunk.dlh.idx], target, gph, slot) !=
+      Result::eSuccess) {
+    return;
+  }
+
+  // Unchanged state keeps the chunk's bundle.
+  if (cmd.sortKey == item.cmd.sortKey &&
+      cmd.bindings.size() == item.cmd.bindings.size() &&
+      memcmp(cmd.bindings.data(), item.cmd.bindings.data(),
+             cmd.bindings.size() * sizeof(Binding)) == 0 &&
+      memcmp(&cmd.program.graphics, &item.cmd.program.graphics,
+             sizeof(cmd.program.graphics)) == 0) {
+    return;
+  }
+
+  // Re-keyed items move to their new position.
+  DrawItemRemove(chunk, dih.idx);
+  item.cmd = std::move(cmd);
+  DrawItemInsert(chunk, dih.idx);
+}
+
+void DrawItemTransformSet(DrawItemHandle dih, const float *transform) {
+  if (!HandleProvider<DrawItemHandle>::isValid(dih)) {
+    sLogger->error("Attempting to move invalid draw item handle!");
+    return;
+  }
+
+  const DrawItem &item = sDrawItems[dih.idx];
+  const ShaderProgramCommand &cmd = item.cmd;
+  DrawList &drawList =
+      sDrawLists[sDrawItemTargets[cmd.target].chunks[item.chunk].dlh.idx];
+
+  const glm::mat4 inverseTransform = glm::inverse(glm::make_mat4(transform));
+  DrawItemTransformWrite(drawList, cmd.submissionID, transform,
+                         glm::value_ptr(inverseTransform));
+}
+
+void DrawItemsSubmit(uint8_t target) {
+  // All chunks draw with the camera set for this submission.
+  const StructuredBufferHandle cameraSBH =
+      CameraBufferGet(sTransforms[sNextShaderProgramCmdIdx]);
+  ShaderProgramCommandClear(sShaderProgramCmds[sNextShaderProgramCmdIdx]);
+
+  if (target >= sDrawItemTargets.size()) {
+    return;
+  }
+
+  for (DrawItemChunk &chunk : sDrawItemTargets[target].chunks) {
+    if (chunk.dirty) {
+      std::vector<ShaderProgramCommand> cmds;
+      cmds.reserve(chunk.order.size());
+      for (uint32_t itemIdx : chunk.order) {
+        cmds.push_back(sDrawItems[itemIdx].cmd);
+      }
+
+      sRenderer->drawListUpdate(chunk.dlh, std::move(cmds));
+      chunk.dirty = false;
+    }
+
+    if (!chunk.order.empty()) {
+      DrawListSubmit(target, chunk.dlh, cameraSBH);
+    }
+  }
+}
+
+void DrawItemDestroy(DrawItemHandle dih) {
+  if (!HandleProvider<DrawItemHandle>::isValid(dih)) {
+    sLogger->warn("Attempting to destroy invalid 'DrawItemHandle'!");
+    return;
+  }
+
+  DrawItem &item = sDrawItems[dih.idx];
+  DrawItemChunk &chunk = sDrawItemTargets[item.cmd.target].chunks[item.chunk];
+  DrawItemRemove(chunk, dih.idx);
+  chunk.freeSlots.push_back(item.cmd.submissionID);
+
+  item = {};
+  HandleProvider<DrawItemHandle>::free(dih);
+}
+
+ReadbackHandle ReadBufferAsync(StructuredBufferHandle sbh,
+                               std::function<void(const void *data)> callback,
+                               uint32_t offset, uint32_t size) {
   if (sbh.idx == CBZ_INVALID_HANDLE) {
     sLogger->error("Attempting to read buffer with invalid handle!");
-    return;
+    return {0};
+  }
+
+  return {sRenderer->readBufferAsync(sbh, callback, offset, size)};
+}
+
+CBZReadbackStatus ReadbackStatusGet(ReadbackHandle rbh) {
+  if (!rbh) {
+    return CBZ_READBACK_STATUS_INVALID;
   }
 
-  sRenderer->readBufferAsync(sbh, callback);
+  return sRenderer->readbackStatusGet(rbh.idx);
 }
 
-void TextureReadAsync(ImageHandle imgh, const Origin3D *origin,
-                      const TextureExtent *extent,
-                      std::function<void(const void *data)> callback) {
+uint32_t ReadbackDataCopy(ReadbackHandle rbh, void *dst, uint32_t dstSize) {
+  if (!rbh || !dst) {
+    return 0;
+  }
+
+  return sRenderer->readbackDataCopy(rbh.idx, dst, dstSize);
+}
+
+ReadbackHandle
+TextureReadAsync(ImageHandle imgh, const Origin3D *origin,
+                 const TextureExtent *extent,
+                 std::function<void(std::vector<uint8_t> &&data)> callback) {
   if (imgh.idx == CBZ_INVALID_HANDLE) {
-    sLogger->error("Attempting to read buffer with invalid handle!");
+    sLogger->error("Attempting to read texture with invalid handle!");
+    return {0};
+  }
+
+  if (!origin || !extent) {
+    sLogger->error("Texture read requires origin and extent!");
+    return {0};
+  }
+
+  return {sRenderer->textureReadAsync(imgh, origin, extent, callback)};
+}
+
+void CreationBudgetSet(uint32_t maxCreations, float maxMilliseconds) {
+  sRenderer->setCreationBudget(maxCreations, maxMilliseconds);
+}
+
+RendererStats GetStats() { return sRenderer->getStats(); }
+
+void PresentModeSet(CBZPresentMode presentMode) {
+  sRenderer->presentModeSet(presentMode);
+}
+
+void DynamicResolutionSet(const DynamicResolutionDesc &desc) {
+  if (desc.targetFrameMs <= 0.0f || desc.minScale <= 0.0f ||
+      desc.minScale > desc.maxScale) {
+    sLogger->error("Invalid dynamic resolution settings!");
+    return;
+  }
+
+  sRenderer->dynamicResolutionSet(desc);
+}
+
+void UpscaleSourceSet(ImageHandle imgh) { sRenderer->upscaleSourceSet(imgh); }
+
+void TextureStreamingBudgetSet(uint64_t bytes) {
+  sRenderer->textureStreamingBudgetSet(bytes);
+}
+
+TextureStreamingStats TextureStreamingStatsGet() {
+  return sRenderer->textureStreamingStatsGet();
+}
+
+BufferPoolStats BufferPoolStatsGet(CBZBufferPool pool) {
+  if (pool >= CBZ_BUFFER_POOL_COUNT) {
+    sLogger->error("Invalid buffer pool {}!", static_cast<uint32_t>(pool));
+    return {};
+  }
+
+  return sRenderer->bufferPoolStatsGet(pool);
+}
+
+// @brief Starts the encoder once the captured image has storage.
+static Result CaptureStart() {
+  CBZTextureFormat format;
+  if (sRenderer->imageGetInfo(sCaptureDesc.imgh, &format, &sCaptureWidth,
+                              &sCaptureHeight) != Result::eSuccess) {
+    return Result::eFailure;
+  }
+
+  return sCaptureEncoder.begin(sCaptureDesc, sCaptureWidth, sCaptureHeight,
+                               format);
+}
+
+static void CaptureFrame() {
+  if (sCapturePending) {
+    if (CaptureStart() != Result::eSuccess) {
+      return;
+    }
+
+    sCapturePending = false;
+  }
+
+  if (!sCaptureEncoder.isActive()) {
     return;
   }
 
-  sRenderer->textureReadAsync(imgh, origin, extent, callback);
+  sCaptureReads.erase(std::remove_if(sCaptureReads.begin(),
+                                     sCaptureReads.end(),
+                                     [](ReadbackHandle rbh) {
+                                       switch (ReadbackStatusGet(rbh)) {
+                                       case CBZ_READBACK_STATUS_PENDING:
+                                         return false;
+                                       case CBZ_READBACK_STATUS_FAILED:
+                                         sCaptureEncoder.drop();
+                                         return true;
+                                       default:
+                                         return true;
+                                       }
+                                     }),
+                      sCaptureReads.end());
+
+  if (sCaptureReads.size() >= MAX_CAPTURE_READS_IN_FLIGHT) {
+    sCaptureEncoder.drop();
+    return;
+  }
+
+  const Origin3D origin = {0, 0, 0};
+  const TextureExtent extent = {static_cast<int>(sCaptureWidth),
+                                static_cast<int>(sCaptureHeight), 1};
+
+  ReadbackHandle rbh = TextureReadAsync(
+      sCaptureDesc.imgh, &origin, &extent, [](std::vector<uint8_t> &&texels) {
+        sCaptureEncoder.push(std::move(texels));
+      });
+
+  if (!rbh) {
+    sCaptureEncoder.drop();
+    return;
+  }
+
+  sCaptureReads.push_back(rbh);
+}
+
+Result CaptureBegin(const CaptureDesc &desc) {
+  if (sCaptureEncoder.isActive() || sCapturePending) {
+    sLogger->error("Capture already in progress!");
+    return Result::eFailure;
+  }
+
+  sCapturePath = desc.path ? desc.path : "capture";
+  sCaptureDesc = desc;
+  sCaptureDesc.path = sCapturePath.c_str();
+  if (!HandleProvider<ImageHandle>::isValid(sCaptureDesc.imgh)) {
+    sCaptureDesc.imgh = sSurfaceIMGH;
+  }
+
+  CBZTextureFormat format;
+  uint32_t width, height;
+  if (sRenderer->imageGetInfo(sCaptureDesc.imgh, &format, &width, &height) !=
+      Result::eSuccess) {
+    // Retried each frame until the image has storage.
+    sCapturePending = true;
+    return Result::eSuccess;
+  }
+
+  return CaptureStart();
+}
+
+void CaptureEnd() {
+  sCapturePending = false;
+  sCaptureReads.clear();
+  sCaptureEncoder.end();
 }
 
+CaptureStats CaptureStatsGet() { return sCaptureEncoder.getStats(); }
+
 uint32_t Frame() {
   InputUpdate();
+  CaptureFrame();
 
   const uint32_t submissionCount = sNextShaderProgramCmdIdx;
 
   if (submissionCount > 0) {
-    const uint32_t mat4PerTransform =
-        (sizeof(TransformData) / (sizeof(float) * 16));
-    StructuredBufferUpdate(sTransformSBH, submissionCount * mat4PerTransform,
+    StructuredBufferUpdate(sTransformSBH, submissionCount * MAT4_PER_TRANSFORM,
                            sTransforms.data());
   }
 
@@ -750,7 +1798,12 @@ uint32_t Frame() {
                 return a.target < b.target;
               }
 
-              return a.sortKey < b.sortKey;
+              // Submission order keeps identical draws instanceable.
+              if (a.sortKey != b.sortKey) {
+                return a.sortKey < b.sortKey;
+              }
+
+              return a.submissionID < b.submissionID;
             });
 
   uint32_t frameIdx = sRenderer->submitSorted(
@@ -758,18 +1811,10 @@ uint32_t Frame() {
 
   // Clear submissions
   for (uint32_t i = 0; i < sNextShaderProgramCmdIdx; i++) {
-    // Clear program data
-    memset(&sShaderProgramCmds[i].program, 0,
-           sizeof(sShaderProgramCmds[i].program));
-    sShaderProgramCmds[i].programType = CBZ_TARGET_TYPE_NONE;
-
-    // Clear binding data
-    sShaderProgramCmds[i].bindings.clear();
-
-    // Set sort key to invalid
-    sShaderProgramCmds[i].sortKey = std::numeric_limits<uint64_t>::max();
+    ShaderProgramCommandClear(sShaderProgramCmds[i]);
   }
   sNextShaderProgramCmdIdx = 0;
+  sCameraBufferCount = 0;
 
   glfwPollEvents();
   if (glfwWindowShouldClose(sWindow)) {
@@ -780,9 +1825,20 @@ uint32_t Frame() {
 }
 
 void Shutdown() {
+  CaptureEnd();
   StructuredBufferDestroy(sTransformSBH);
+  for (const CameraBuffer &cameraBuffer : sCameraBuffers) {
+    StructuredBufferDestroy(cameraBuffer.sbh);
+  }
+  sCameraBuffers.clear();
+  sCameraBufferCount = 0;
 
   sRenderer->shutdown();
+  sTextureTableCount = 0;
+  sTextureTableFreeIndices.clear();
+  sDrawLists.clear();
+  sDrawItems.clear();
+  sDrawItemTargets.clear();
 
   glfwDestroyWindow(sWindow);
   glfwTerminate();
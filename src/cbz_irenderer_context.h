@@ -1,10 +1,13 @@
 #ifndef CBZ_IRENDERER_CONTEXT_H_
 #define CBZ_IRENDERER_CONTEXT_H_
 
+#include <cbz_gfx/cbz_gfx.h>
 #include <cbz_gfx/cbz_gfx_defines.h>
 
 #include <spdlog/spdlog.h>
 
+#include <chrono>
+
 namespace cbz {
 
 template <typename HandleT> class HandleProvider {
@@ -71,6 +74,83 @@ private:
   static inline std::vector<HandleT> sFreeList;
 };
 
+// @brief Bounds lazy GPU object creation per frame by count and/or time.
+// @note Texture views are created outside the budget.
+class CreationBudget {
+public:
+  // @brief Grants one creation while the budget lasts; times the creation.
+  class Scope {
+  public:
+    explicit Scope(CreationBudget &budget)
+        : mBudget(budget), mGranted(budget.tryAcquire()) {
+      if (mGranted) {
+        mStart = std::chrono::steady_clock::now();
+      }
+    }
+
+    ~Scope() {
+      if (mGranted) {
+        mBudget.mElapsed += std::chrono::steady_clock::now() - mStart;
+      }
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    explicit operator bool() const { return mGranted; }
+
+  private:
+    CreationBudget &mBudget;
+    bool mGranted;
+    std::chrono::steady_clock::time_point mStart;
+  };
+
+  // @param maxCount creations per frame. 0 is unlimited.
+  // @param maxMilliseconds time spent creating per frame. 0 is unlimited.
+  inline void set(uint32_t maxCount, float maxMilliseconds) {
+    mMaxCount = maxCount;
+    mMaxDuration = std::chrono::duration<float, std::milli>(maxMilliseconds);
+  }
+
+  inline void begin() {
+    mCount = 0;
+    mDeferredCount = 0;
+    mElapsed = {};
+  }
+
+  [[nodiscard]] inline bool isExhausted() const {
+    if (mMaxCount != 0 && mCount >= mMaxCount) {
+      return true;
+    }
+
+    return mMaxDuration.count() > 0.0f && mElapsed >= mMaxDuration;
+  }
+
+  [[nodiscard]] inline uint32_t getCreatedCount() const { return mCount; }
+  [[nodiscard]] inline uint32_t getDeferredCount() const {
+    return mDeferredCount;
+  }
+
+private:
+  [[nodiscard]] inline bool tryAcquire() {
+    if (isExhausted()) {
+      mDeferredCount++;
+      return false;
+    }
+
+    mCount++;
+    return true;
+  }
+
+private:
+  uint32_t mMaxCount = 0;
+  std::chrono::duration<float, std::milli> mMaxDuration{0.0f};
+
+  uint32_t mCount = 0;
+  uint32_t mDeferredCount = 0;
+  std::chrono::duration<float, std::milli> mElapsed{0.0f};
+};
+
 [[nodiscard]] constexpr uint32_t UniformTypeGetSize(CBZUniformType type) {
   switch (type) {
   case CBZ_UNIFORM_TYPE_UINT:
@@ -95,6 +175,8 @@ enum class BindingType {
 
   eTexture2D,
   eTextureCube,
+
+  eTextureTable,
 };
 
 struct BindingDesc {
@@ -102,10 +184,12 @@ struct BindingDesc {
   BindingType type;
 
   uint8_t index;
+  uint8_t group; // Slang register space.
 
   union {
     uint32_t size;
     uint32_t elementSize;
+    uint32_t elementCount; // Texture table entries.
   };
 
   uint32_t padding;
@@ -113,6 +197,7 @@ struct BindingDesc {
 
 struct Binding {
   BindingType type;
+  uint8_t group; // Slang register space; slots are numbered per space.
 
   union {
     struct {
@@ -123,6 +208,8 @@ struct Binding {
     struct {
       uint32_t slot;
       ImageHandle handle;
+      uint16_t baseMipLevel;
+      uint16_t mipLevelCount; // 0 selects the remaining levels.
     } texture;
 
     struct {
@@ -135,6 +222,10 @@ struct Binding {
       CBZUniformType valueType;
       StructuredBufferHandle handle;
     } storageBuffer;
+
+    struct {
+      uint32_t slot;
+    } textureTable;
   } value;
 };
 
@@ -146,28 +237,69 @@ struct ShaderProgramCommand {
       uint32_t instances;
       IndexBufferHandle ibh;
       GraphicsProgramHandle ph;
+
+      // Indirect draws read 'indirectCount' argument records, limited by the
+      // count at the start of 'countSBH' if 'indirectCounted'.
+      StructuredBufferHandle argsSBH;
+      StructuredBufferHandle countSBH;
+      uint32_t argsOffset;
+      uint32_t indirectCount; // 0 draws directly.
+      bool indirectCounted;
     } graphics;
 
     struct {
       uint32_t x, y, z; // dispatchSizes
       ComputeProgramHandle ph;
     } compute;
+
+    // Built-in culling dispatch on a compute target.
+    struct {
+      StructuredBufferHandle boundsSBH;
+      StructuredBufferHandle visibleSBH;
+      StructuredBufferHandle argsSBH;
+      StructuredBufferHandle transformSBH;
+      ImageHandle depthIMGH;
+
+      uint32_t objectCount;
+      uint32_t indexCount;
+      uint32_t firstIndex;
+      int32_t baseVertex;
+
+      float viewProj[16];
+    } cull;
+
+    // Replay of a recorded draw list on a graphics target.
+    struct {
+      DrawListHandle dlh;
+
+      // Bound as the camera of every recorded draw.
+      StructuredBufferHandle cameraSBH;
+    } drawList;
   } program;
 
   CBZTargetType programType;
+  bool isCull = false;
+  bool isDrawList = false;
   std::vector<Binding> bindings;
 
+  uint8_t pushConstants[MAX_PUSH_CONSTANT_SIZE];
+  uint32_t pushConstantsSize = 0;
+
   uint64_t sortKey = 0;
   uint32_t submissionID = 0;
   uint8_t target = 0;
 
-  inline uint32_t getDescriptorHash() const { return sortKey & 0xFFFFFFFF; }
+  // Screen fraction covered by the draw; negative if unknown.
+  float coverage = -1.0f;
 };
 
 // @brief A render target represents a framebuffer or a compute pass.
 struct RenderTarget {
   std::vector<AttachmentDescription> colorAttachments;
   AttachmentDescription depthAttachment = {{}, ImageHandle{CBZ_INVALID_HANDLE}};
+
+  // Single sample attachments render to multisampled companions when > 1.
+  uint32_t sampleCount = 1;
 };
 
 class IRendererContext {
@@ -175,7 +307,7 @@ public:
   IRendererContext() = default;
   virtual ~IRendererContext() = default;
 
-  virtual Result init(uint32_t width, uint32_t height, void *nsfh,
+  virtual Result init(const InitDesc &initDesc, void *nsfh,
                       ImageHandle swapchainIMGH) = 0;
 
   virtual void shutdown() = 0;
@@ -218,20 +350,87 @@ public:
   [[nodiscard]] virtual SamplerHandle
   getSampler(TextureBindingDesc texBindingDesc) = 0;
 
-  [[nodiscard]] virtual Result imageCreate(ImageHandle uh,
-                                           CBZTextureFormat format, uint32_t w,
-                                           uint32_t h, uint32_t depth,
-                                           CBZTextureDimension dimension,
-                                           CBZImageFlags flags) = 0;
+  // @param mipLevelCount levels uploaded with `imageUpdateMip`; ignored when
+  // flags request generated mipmaps.
+  [[nodiscard]] virtual Result
+  imageCreate(ImageHandle uh, CBZTextureFormat format, uint32_t w, uint32_t h,
+              uint32_t depth, CBZTextureDimension dimension,
+              CBZImageFlags flags, uint32_t mipLevelCount = 1,
+              uint32_t sampleCount = 1) = 0;
 
   virtual void imageUpdate(ImageHandle th, void *data, uint32_t count) = 0;
 
+  // @brief Uploads all layers of one mip level, tightly packed in blocks.
+  [[nodiscard]] virtual Result imageUpdateMip(ImageHandle th,
+                                              uint32_t mipLevel,
+                                              const void *data,
+                                              uint32_t size) = 0;
+
+  // @returns false for compressed formats missing their device feature.
+  [[nodiscard]] virtual bool
+  imageFormatIsSupported(CBZTextureFormat format) const = 0;
+
+  // @brief Creates a 2D image sized relative to the surface.
+  [[nodiscard]] virtual Result imageCreateRelative(ImageHandle imgh,
+                                                   CBZTextureFormat format,
+                                                   float scale,
+                                                   CBZImageFlags flags) = 0;
+
+  // @brief Creates an image whose mip levels stream from a KTX2 file.
+  [[nodiscard]] virtual Result imageStreamCreate(ImageHandle imgh,
+                                                 const std::string &path,
+                                                 CBZImageFlags flags) = 0;
+
+  // @param priority negative restores the coverage derived priority.
+  virtual void imageStreamPrioritySet(ImageHandle imgh, float priority) = 0;
+
+  virtual void presentModeSet(CBZPresentMode presentMode) = 0;
+
+  virtual void dynamicResolutionSet(const DynamicResolutionDesc &desc) = 0;
+
+  virtual void upscaleSourceSet(ImageHandle imgh) = 0;
+
+  virtual void textureStreamingBudgetSet(uint64_t bytes) = 0;
+
+  [[nodiscard]] virtual TextureStreamingStats
+  textureStreamingStatsGet() const = 0;
+
+  [[nodiscard]] virtual BufferPoolStats
+  bufferPoolStatsGet(CBZBufferPool pool) const = 0;
+
   virtual void imageDestroy(ImageHandle th) = 0;
 
+  // @param imgh image at 'index' of the texture table; invalid clears it.
+  virtual void textureTableSet(uint32_t index, ImageHandle imgh) = 0;
+
+  // @brief Replaces the submissions of 'dlh'; bundles are encoded when the
+  // list is next replayed.
+  // @param cmds submissions ordered by sort key, then submission ID.
+  virtual void drawListUpdate(DrawListHandle dlh,
+                              std::vector<ShaderProgramCommand> &&cmds) = 0;
+
+  virtual void drawListDestroy(DrawListHandle dlh) = 0;
+
+  // @brief Queries the size and format of an image.
+  // @returns failure if the image has no storage yet (e.g. the surface
+  // before the first frame).
+  [[nodiscard]] virtual Result imageGetInfo(ImageHandle th,
+                                            CBZTextureFormat *format,
+                                            uint32_t *width,
+                                            uint32_t *height) const = 0;
+
   [[nodiscard]] virtual Result shaderCreate(ShaderHandle sh,
                                             CBZShaderFlags flags,
                                             const std::string &path) = 0;
 
+  // @brief Queues loading on a worker. The shader stays pending until its
+  // module is created on the device thread.
+  [[nodiscard]] virtual Result shaderCreateAsync(ShaderHandle sh,
+                                                 CBZShaderFlags flags,
+                                                 const std::string &path) = 0;
+
+  [[nodiscard]] virtual bool shaderIsReady(ShaderHandle sh) const = 0;
+
   virtual void shaderDestroy(ShaderHandle sh) = 0;
 
   [[nodiscard]] virtual Result graphicsProgramCreate(GraphicsProgramHandle gph,
@@ -239,20 +438,39 @@ public:
                                                      int flags) = 0;
   virtual void graphicsProgramDestroy(GraphicsProgramHandle gph) = 0;
 
+  [[nodiscard]] virtual bool
+  graphicsProgramIsReady(GraphicsProgramHandle gph) const = 0;
+
   [[nodiscard]] virtual Result computeProgramCreate(ComputeProgramHandle cph,
                                                     ShaderHandle sh) = 0;
 
-  virtual void
+  [[nodiscard]] virtual bool
+  computeProgramIsReady(ComputeProgramHandle cph) const = 0;
+
+  // @returns readback id, 0 on failure.
+  [[nodiscard]] virtual uint32_t
   readBufferAsync(StructuredBufferHandle sbh,
-                  std::function<void(const void *data)> callback) = 0;
+                  std::function<void(const void *data)> callback,
+                  uint32_t offset, uint32_t size) = 0;
 
-  virtual void
-  textureReadAsync(ImageHandle imgh, const Origin3D *origin,
-                   const TextureExtent *extent,
-                   std::function<void(const void *data)> callback) = 0;
+  [[nodiscard]] virtual CBZReadbackStatus
+  readbackStatusGet(uint32_t readbackId) const = 0;
+
+  [[nodiscard]] virtual uint32_t
+  readbackDataCopy(uint32_t readbackId, void *dst, uint32_t dstSize) = 0;
+
+  // @returns readback id, 0 on failure.
+  [[nodiscard]] virtual uint32_t textureReadAsync(
+      ImageHandle imgh, const Origin3D *origin, const TextureExtent *extent,
+      std::function<void(std::vector<uint8_t> &&data)> callback) = 0;
 
   virtual void computeProgramDestroy(ComputeProgramHandle cph) = 0;
 
+  virtual void setCreationBudget(uint32_t maxCount, float maxMilliseconds) = 0;
+
+  // @returns statistics of the last submitted frame.
+  [[nodiscard]] virtual RendererStats getStats() const = 0;
+
   virtual uint32_t submitSorted(const std::vector<RenderTarget> &renderTargets,
                                 const ShaderProgramCommand *sortedCmds,
                                 uint32_t count) = 0;
@@ -0,0 +1,243 @@
+#include "cbz_ktx2.h"
+
+#include <cbz/cbz_file.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace cbz {
+
+static constexpr uint8_t sKTX2Identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Identifier, header and index; the level index follows.
+static constexpr size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+static constexpr size_t KTX2_LEVEL_INDEX_STRIDE = 24;
+
+static inline uint32_t ReadU32(const uint8_t *src) {
+  uint32_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+static inline uint64_t ReadU64(const uint8_t *src) {
+  uint64_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+// @returns texture format of a 'VkFormat', CBZ_TEXTURE_FORMAT_UNDEFINED if it
+// has no WebGPU equivalent.
+static CBZTextureFormat VkFormatToCBZ(uint32_t vkFormat) {
+  switch (vkFormat) {
+  case 9: // VK_FORMAT_R8_UNORM
+    return CBZ_TEXTURE_FORMAT_R8UNORM;
+  case 16: // VK_FORMAT_R8G8_UNORM
+    return CBZ_TEXTURE_FORMAT_RG8UNORM;
+  case 37: // VK_FORMAT_R8G8B8A8_UNORM
+    return CBZ_TEXTURE_FORMAT_RGBA8UNORM;
+  case 43: // VK_FORMAT_R8G8B8A8_SRGB
+    return CBZ_TEXTURE_FORMAT_RGBA8UNORMSRGB;
+  case 44: // VK_FORMAT_B8G8R8A8_UNORM
+    return CBZ_TEXTURE_FORMAT_BGRA8UNORM;
+  case 50: // VK_FORMAT_B8G8R8A8_SRGB
+    return CBZ_TEXTURE_FORMAT_BGRA8UNORMSRGB;
+  case 76: // VK_FORMAT_R16_SFLOAT
+    return CBZ_TEXTURE_FORMAT_R16FLOAT;
+  case 83: // VK_FORMAT_R16G16_SFLOAT
+    return CBZ_TEXTURE_FORMAT_RG16FLOAT;
+  case 97: // VK_FORMAT_R16G16B16A16_SFLOAT
+    return CBZ_TEXTURE_FORMAT_RGBA16FLOAT;
+  case 100: // VK_FORMAT_R32_SFLOAT
+    return CBZ_TEXTURE_FORMAT_R32FLOAT;
+  case 103: // VK_FORMAT_R32G32_SFLOAT
+    return CBZ_TEXTURE_FORMAT_RG32FLOAT;
+  case 109: // VK_FORMAT_R32G32B32A32_SFLOAT
+    return CBZ_TEXTURE_FORMAT_RGBA32FLOAT;
+  case 122: // VK_FORMAT_B10G11R11_UFLOAT_PACK32
+    return CBZ_TEXTURE_FORMAT_RG11B10UFLOAT;
+  case 123: // VK_FORMAT_E5B9G9R9_UFLOAT_PACK32
+    return CBZ_TEXTURE_FORMAT_RGB9E5UFLOAT;
+
+  // BC1 RGB shares the block layout of BC1 RGBA.
+  case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+    return CBZ_TEXTURE_FORMAT_BC1RGBAUNORM;
+  case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+    return CBZ_TEXTURE_FORMAT_BC1RGBAUNORMSRGB;
+  default:
+    break;
+  }
+
+  // BC1 RGBA through ASTC 12x12 are in the same order in both enums.
+  if (vkFormat >= 133 && vkFormat <= 184) {
+    return static_cast<CBZTextureFormat>(CBZ_TEXTURE_FORMAT_BC1RGBAUNORM +
+                                         (vkFormat - 133));
+  }
+
+  return CBZ_TEXTURE_FORMAT_UNDEFINED;
+}
+
+Result KTX2Load(const std::string &path, KTX2Image *image) {
+  std::vector<uint8_t> data;
+  if (LoadFileAsBinary(path, data) != Result::eSuccess) {
+    spdlog::error("Failed to load KTX2 file '{}'!", path);
+    return Result::eFailure;
+  }
+
+  if (KTX2Parse(std::move(data), image) != Result::eSuccess) {
+    spdlog::error("Failed to parse KTX2 file '{}'!", path);
+    return Result::eFailure;
+  }
+
+  return Result::eSuccess;
+}
+
+// @brief Parses the header and level index at the start of a file of
+// 'fileSize' bytes.
+static Result ParseHeader(const uint8_t *data, size_t size, uint64_t fileSize,
+                          KTX2Image *image) {
+  if (size < KTX2_LEVEL_INDEX_OFFSET ||
+      memcmp(data, sKTX2Identifier, sizeof(sKTX2Identifier)) != 0) {
+    spdlog::error("Invalid KTX2 identifier!");
+    return Result::eFailure;
+  }
+
+  const uint8_t *header = data + sizeof(sKTX2Identifier);
+  const uint32_t vkFormat = ReadU32(header + 0);
+  const uint32_t pixelWidth = ReadU32(header + 8);
+  const uint32_t pixelHeight = ReadU32(header + 12);
+  const uint32_t pixelDepth = ReadU32(header + 16);
+  const uint32_t layerCount = ReadU32(header + 20);
+  const uint32_t faceCount = ReadU32(header + 24);
+  const uint32_t levelCount = std::max(ReadU32(header + 28), 1u);
+  const uint32_t supercompressionScheme = ReadU32(header + 32);
+
+  const CBZTextureFormat format = VkFormatToCBZ(vkFormat);
+  if (format == CBZ_TEXTURE_FORMAT_UNDEFINED) {
+    spdlog::error("Unsupported KTX2 vkFormat {}!", vkFormat);
+    return Result::eFailure;
+  }
+
+  if (supercompressionScheme != 0) {
+    spdlog::error("Supercompressed KTX2 (scheme {}) is not supported!",
+                  supercompressionScheme);
+    return Result::eFailure;
+  }
+
+  if (pixelWidth == 0 || pixelDepth > 1 || (faceCount != 1 && faceCount != 6)) {
+    spdlog::error("Only 2D and cube KTX2 textures are supported!");
+    return Result::eFailure;
+  }
+
+  if (size < KTX2_LEVEL_INDEX_OFFSET + KTX2_LEVEL_INDEX_STRIDE * levelCount) {
+    spdlog::error("Truncated KTX2 level index!");
+    return Result::eFailure;
+  }
+
+  image->format = format;
+  image->width = pixelWidth;
+  image->height = std::max(pixelHeight, 1u);
+  image->faceCount = faceCount;
+  image->layerCount = std::max(layerCount, 1u) * faceCount;
+  image->levels.resize(levelCount);
+
+  const uint32_t blockWidth = TextureFormatGetBlockWidth(format);
+  const uint32_t blockHeight = TextureFormatGetBlockHeight(format);
+  const uint32_t blockSize = TextureFormatGetSize(format);
+
+  for (uint32_t level = 0; level < levelCount; level++) {
+    const uint8_t *entry =
+        data + KTX2_LEVEL_INDEX_OFFSET + KTX2_LEVEL_INDEX_STRIDE * level;
+
+    KTX2Level &dst = image->levels[level];
+    dst.offset = ReadU64(entry + 0);
+    dst.size = ReadU64(entry + 8);
+
+    const uint64_t blocksX =
+        (std::max(image->width >> level, 1u) + blockWidth - 1) / blockWidth;
+    const uint64_t blocksY =
+        (std::max(image->height >> level, 1u) + blockHeight - 1) / blockHeight;
+    const uint64_t expectedSize =
+        blocksX * blocksY * blockSize * image->layerCount;
+
+    if (dst.offset > fileSize || dst.size > fileSize - dst.offset ||
+        dst.size < expectedSize) {
+      spdlog::error("Invalid KTX2 level {} ({} bytes, expected {})!", level,
+                    dst.size, expectedSize);
+      return Result::eFailure;
+    }
+  }
+
+  return Result::eSuccess;
+}
+
+Result KTX2Parse(std::vector<uint8_t> &&data, KTX2Image *image) {
+  if (ParseHeader(data.data(), data.size(), data.size(), image) !=
+      Result::eSuccess) {
+    return Result::eFailure;
+  }
+
+  image->data = std::move(data);
+  return Result::eSuccess;
+}
+
+Result KTX2LoadHeader(const std::string &path, KTX2Image *image) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    spdlog::error("Failed to open KTX2 file '{}'!", path);
+    return Result::eFailure;
+  }
+
+  fseek(file, 0, SEEK_END);
+  const long fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  // Fixed header, then as much of the level index as the file holds.
+  std::vector<uint8_t> header(KTX2_LEVEL_INDEX_OFFSET);
+  size_t size = fread(header.data(), 1, header.size(), file);
+  if (size == header.size()) {
+    const uint32_t levelCount =
+        std::max(ReadU32(header.data() + sizeof(sKTX2Identifier) + 28), 1u);
+    header.resize(KTX2_LEVEL_INDEX_OFFSET +
+                  KTX2_LEVEL_INDEX_STRIDE * static_cast<size_t>(levelCount));
+    size += fread(header.data() + size, 1, header.size() - size, file);
+  }
+
+  fclose(file);
+
+  if (fileSize < 0 ||
+      ParseHeader(header.data(), size, static_cast<uint64_t>(fileSize),
+                  image) != Result::eSuccess) {
+    spdlog::error("Failed to parse KTX2 file '{}'!", path);
+    return Result::eFailure;
+  }
+
+  image->data.clear();
+  return Result::eSuccess;
+}
+
+Result KTX2LoadLevel(const std::string &path, const KTX2Level &level,
+                     std::vector<uint8_t> *data) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    spdlog::error("Failed to open KTX2 file '{}'!", path);
+    return Result::eFailure;
+  }
+
+  data->resize(level.size);
+  const bool read =
+      fseek(file, static_cast<long>(level.offset), SEEK_SET) == 0 &&
+      fread(data->data(), 1, data->size(), file) == data->size();
+  fclose(file);
+
+  if (!read) {
+    spdlog::error("Failed to read KTX2 level from '{}'!", path);
+    return Result::eFailure;
+  }
+
+  return Result::eSuccess;
+}
+
+}; // namespace cbz
@@ -0,0 +1,45 @@
+#ifndef CBZ_KTX2_H_
+#define CBZ_KTX2_H_
+
+#include "cbz_gfx/cbz_gfx_defines.h"
+
+#include <string>
+#include <vector>
+
+namespace cbz {
+
+struct KTX2Level {
+  uint64_t offset;
+  uint64_t size;
+};
+
+// @brief Texture payload of a KTX2 container.
+// @note Levels are ordered from the base level down and each holds every
+// layer and face, tightly packed in blocks.
+struct KTX2Image {
+  CBZTextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t layerCount; // Array layers * faces.
+  uint32_t faceCount;
+
+  std::vector<KTX2Level> levels;
+  std::vector<uint8_t> data;
+};
+
+// @brief Parses an uncompressed (no supercompression) 2D or cube KTX2 file.
+[[nodiscard]] Result KTX2Load(const std::string &path, KTX2Image *image);
+
+[[nodiscard]] Result KTX2Parse(std::vector<uint8_t> &&data, KTX2Image *image);
+
+// @brief Reads the header and level index only; 'data' is left empty.
+[[nodiscard]] Result KTX2LoadHeader(const std::string &path, KTX2Image *image);
+
+// @brief Reads the payload of one level of a file parsed by KTX2LoadHeader.
+[[nodiscard]] Result KTX2LoadLevel(const std::string &path,
+                                   const KTX2Level &level,
+                                   std::vector<uint8_t> *data);
+
+}; // namespace cbz
+
+#endif
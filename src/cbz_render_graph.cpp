@@ -0,0 +1,557 @@
+#include "cbz_gfx/cbz_render_graph.h"
+
+#include "cbz_gfx/cbz_gfx.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace cbz {
+
+static std::shared_ptr<spdlog::logger> sLogger;
+
+// Builds a pooled image may stay unused before it is destroyed.
+static constexpr uint32_t RENDER_GRAPH_IDLE_BUILDS = 8;
+
+static bool ImageDescEqual(const RenderGraphImageDesc &a,
+                           const RenderGraphImageDesc &b) {
+  return a.format == b.format && a.width == b.width && a.height == b.height &&
+         a.scale == b.scale && a.flags == b.flags &&
+         a.sampleCount == b.sampleCount;
+}
+
+bool RenderGraphBuilder::isValid(RenderGraphResource resource,
+                                 bool image) const {
+  if (resource >= mGraph.mResources.size()) {
+    sLogger->error("Pass '{}' accesses invalid resource {}!",
+                  mGraph.mPasses[mPass].name, resource);
+    return false;
+  }
+
+  if (image && mGraph.mResources[resource].buffer) {
+    sLogger->error("Pass '{}' uses buffer '{}' as an attachment!",
+                  mGraph.mPasses[mPass].name,
+                  mGraph.mResources[resource].name);
+    return false;
+  }
+
+  return true;
+}
+
+void RenderGraphBuilder::read(RenderGraphResource resource) {
+  if (isValid(resource, false)) {
+    mGraph.mPasses[mPass].reads.push_back(resource);
+  }
+}
+
+void RenderGraphBuilder::write(RenderGraphResource resource) {
+  if (isValid(resource, false)) {
+    mGraph.mPasses[mPass].writes.push_back(resource);
+  }
+}
+
+void RenderGraphBuilder::colorAttachment(RenderGraphResource image,
+                                         int flags) {
+  if (!isValid(image, true)) {
+    return;
+  }
+
+  RenderGraph::Pass &pass = mGraph.mPasses[mPass];
+  if (pass.colorAttachments.size() >= MAX_TARGET_COLOR_ATTACHMENTS) {
+    sLogger->error("Pass '{}' exceeds {} color attachments!", pass.name,
+                  static_cast<uint32_t>(MAX_TARGET_COLOR_ATTACHMENTS));
+    return;
+  }
+
+  pass.colorAttachments.push_back({image, flags});
+  pass.writes.push_back(image);
+
+  if ((flags & CBZ_RENDER_ATTACHMENT_LOAD) == CBZ_RENDER_ATTACHMENT_LOAD) {
+    pass.reads.push_back(image);
+  }
+}
+
+void RenderGraphBuilder::depthAttachment(RenderGraphResource image,
+                                         int flags) {
+  if (!isValid(image, true)) {
+    return;
+  }
+
+  RenderGraph::Pass &pass = mGraph.mPasses[mPass];
+  pass.depthAttachment = {image, flags};
+  pass.writes.push_back(image);
+
+  if ((flags & CBZ_RENDER_ATTACHMENT_LOAD) == CBZ_RENDER_ATTACHMENT_LOAD) {
+    pass.reads.push_back(image);
+  }
+}
+
+void RenderGraphBuilder::surface() { mGraph.mPasses[mPass].surface = true; }
+
+void RenderGraphBuilder::sideEffect() {
+  mGraph.mPasses[mPass].sideEffect = true;
+}
+
+RenderGraph::RenderGraph(uint8_t firstTarget) : mFirstTarget(firstTarget) {
+  // Logs through the library's logger once Init() registered it.
+  if (!sLogger) {
+    sLogger = spdlog::get("cbz");
+  }
+
+  if (!sLogger) {
+    sLogger = spdlog::default_logger();
+  }
+}
+
+RenderGraph::~RenderGraph() {
+  for (const PooledImage &image : mImages) {
+    ImageDestroy(image.imgh);
+  }
+}
+
+RenderGraphResource RenderGraph::createImage(const char *name,
+                                             const RenderGraphImageDesc &desc) {
+  if ((desc.width == 0) != (desc.height == 0) ||
+      (desc.width == 0 && (desc.scale <= 0.0f || desc.sampleCount != 1))) {
+    sLogger->error("Invalid render graph image '{}'!", name);
+    return INVALID_RESOURCE;
+  }
+
+  Resource resource = {};
+  resource.name = name;
+  resource.desc = desc;
+  resource.desc.flags |= CBZ_IMAGE_RENDER_ATTACHMENT;
+  resource.imgh = {CBZ_INVALID_HANDLE};
+  resource.sbh = {CBZ_INVALID_HANDLE};
+  mResources.push_back(std::move(resource));
+
+  mCompiled = false;
+  return static_cast<RenderGraphResource>(mResources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importImage(const char *name,
+                                             ImageHandle imgh) {
+  Resource resource = {};
+  resource.name = name;
+  resource.imported = true;
+  resource.imgh = imgh;
+  resource.sbh = {CBZ_INVALID_HANDLE};
+  mResources.push_back(std::move(resource));
+
+  mCompiled = false;
+  return static_cast<RenderGraphResource>(mResources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const char *name,
+                                              StructuredBufferHandle sbh) {
+  Resource resource = {};
+  resource.name = name;
+  resource.imported = true;
+  resource.buffer = true;
+  resource.imgh = {CBZ_INVALID_HANDLE};
+  resource.sbh = sbh;
+  mResources.push_back(std::move(resource));
+
+  mCompiled = false;
+  return static_cast<RenderGraphResource>(mResources.size() - 1);
+}
+
+void RenderGraph::addPass(const char *name, CBZTargetType type,
+                          const SetupFunc &setup, ExecuteFunc execute) {
+  Pass pass = {};
+  pass.name = name;
+  pass.type = type;
+  pass.execute = std::move(execute);
+  mPasses.push_back(std::move(pass));
+
+  RenderGraphBuilder builder(*this, static_cast<uint32_t>(mPasses.size() - 1));
+  setup(builder);
+
+  mCompiled = false;
+}
+
+Result RenderGraph::compile() {
+  mCompiled = false;
+
+  cull();
+
+  if (sort() != Result::eSuccess || allocateImages() != Result::eSuccess ||
+      assignTargets() != Result::eSuccess) {
+    return Result::eFailure;
+  }
+
+  mCompiled = true;
+  return Result::eSuccess;
+}
+
+void RenderGraph::execute() const {
+  if (!mCompiled) {
+    sLogger->error("Render graph executed without a successful compile!");
+    return;
+  }
+
+  for (uint32_t passIdx : mOrder) {
+    const Pass &pass = mPasses[passIdx];
+    if (pass.execute) {
+      pass.execute(*this, pass.target);
+    }
+  }
+}
+
+void RenderGraph::reset() {
+  mResources.clear();
+  mPasses.clear();
+  mOrder.clear();
+  mCompiled = false;
+}
+
+ImageHandle RenderGraph::getImage(RenderGraphResource resource) const {
+  if (resource >= mResources.size() || mResources[resource].buffer) {
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  const Resource &image = mResources[resource];
+  if (image.imported) {
+    return image.imgh;
+  }
+
+  if (image.pooledImage == UNUSED) {
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  return mImages[image.pooledImage].imgh;
+}
+
+StructuredBufferHandle
+RenderGraph::getBuffer(RenderGraphResource resource) const {
+  if (resource >= mResources.size() || !mResources[resource].buffer) {
+    return {CBZ_INVALID_HANDLE};
+  }
+
+  return mResources[resource].sbh;
+}
+
+RenderGraphStats RenderGraph::getStats() const {
+  RenderGraphStats stats = {};
+  stats.passCount = static_cast<uint32_t>(mPasses.size());
+  stats.culledPassCount =
+      static_cast<uint32_t>(mPasses.size() - mOrder.size());
+  stats.physicalImageCount = static_cast<uint32_t>(mImages.size());
+
+  for (const Resource &resource : mResources) {
+    if (!resource.imported) {
+      stats.transientImageCount++;
+    }
+  }
+
+  return stats;
+}
+
+bool RenderGraph::reads(const Pass &pass, RenderGraphResource resource) const {
+  return std::find(pass.reads.begin(), pass.reads.end(), resource) !=
+         pass.reads.end();
+}
+
+bool RenderGraph::writes(const Pass &pass,
+                         RenderGraphResource resource) const {
+  return std::find(pass.writes.begin(), pass.writes.end(), resource) !=
+         pass.writes.end();
+}
+
+void RenderGraph::cull() {
+  std::vector<uint32_t> worklist;
+
+  for (uint32_t passIdx = 0; passIdx < mPasses.size(); passIdx++) {
+    Pass &pass = mPasses[passIdx];
+    pass.kept = pass.surface || pass.sideEffect;
+
+    // Imported resources are observed outside the graph.
+    for (RenderGraphResource resource : pass.writes) {
+      pass.kept |= mResources[resource].imported;
+    }
+
+    if (pass.kept) {
+      worklist.push_back(passIdx);
+    }
+  }
+
+  // Keep the writers of the versions kept passes read.
+  while (!worklist.empty()) {
+    const uint32_t passIdx = worklist.back();
+    worklist.pop_back();
+
+    for (RenderGraphResource resource : mPasses[passIdx].reads) {
+      const uint32_t producerIdx = findProducer(passIdx, resource);
+      if (producerIdx == UNUSED || mPasses[producerIdx].kept) {
+        continue;
+      }
+
+      mPasses[producerIdx].kept = true;
+      worklist.push_back(producerIdx);
+    }
+  }
+}
+
+uint32_t RenderGraph::findProducer(uint32_t passIdx,
+                                   RenderGraphResource resource) const {
+  for (uint32_t writerIdx = passIdx; writerIdx-- > 0;) {
+    if (writes(mPasses[writerIdx], resource)) {
+      return writerIdx;
+    }
+  }
+
+  // Imported resources are read as they come in.
+  if (mResources[resource].imported) {
+    return UNUSED;
+  }
+
+  // Graph owned images read before any write see the first one.
+  for (uint32_t writerIdx = passIdx + 1; writerIdx < mPasses.size();
+       writerIdx++) {
+    if (writes(mPasses[writerIdx], resource)) {
+      return writerIdx;
+    }
+  }
+
+  return UNUSED;
+}
+
+Result RenderGraph::sort() {
+  const uint32_t passCount = static_cast<uint32_t>(mPasses.size());
+
+  std::vector<std::vector<uint32_t>> successors(passCount);
+  std::vector<uint32_t> predecessorCounts(passCount, 0);
+
+  auto addEdge = [&](uint32_t from, uint32_t to) {
+    successors[from].push_back(to);
+    predecessorCounts[to]++;
+  };
+
+  // Each write makes a new version of the resource. Readers follow the
+  // writer of the version they read; the next writer follows the writer
+  // before it and every reader of the previous version.
+  for (uint32_t resource = 0; resource < mResources.size(); resource++) {
+    uint32_t previousWriter = UNUSED;
+    std::vector<uint32_t> readers;
+
+    for (uint32_t passIdx = 0; passIdx < passCount; passIdx++) {
+      const Pass &pass = mPasses[passIdx];
+      if (!pass.kept) {
+        continue;
+      }
+
+      const bool writer = writes(pass, resource);
+      if (reads(pass, resource)) {
+        const uint32_t producerIdx = findProducer(passIdx, resource);
+        if (producerIdx != UNUSED) {
+          addEdge(producerIdx, passIdx);
+        }
+
+        // Reads of a later first write do not hold that write back.
+        if (!writer && (producerIdx == UNUSED || producerIdx < passIdx)) {
+          readers.push_back(passIdx);
+        }
+      }
+
+      if (!writer) {
+        continue;
+      }
+
+      if (previousWriter != UNUSED) {
+        addEdge(previousWriter, passIdx);
+      }
+
+      for (uint32_t readerIdx : readers) {
+        addEdge(readerIdx, passIdx);
+      }
+
+      readers.clear();
+      previousWriter = passIdx;
+    }
+  }
+
+  // Ready passes run in declaration order.
+  mOrder.clear();
+  std::vector<bool> scheduled(passCount, false);
+  uint32_t keptCount = 0;
+
+  for (const Pass &pass : mPasses) {
+    keptCount += pass.kept ? 1 : 0;
+  }
+
+  while (mOrder.size() < keptCount) {
+    uint32_t next = UNUSED;
+    for (uint32_t passIdx = 0; passIdx < passCount; passIdx++) {
+      if (mPasses[passIdx].kept && !scheduled[passIdx] &&
+          predecessorCounts[passIdx] == 0) {
+        next = passIdx;
+        break;
+      }
+    }
+
+    if (next == UNUSED) {
+      sLogger->error("Render graph has a dependency cycle!");
+      mOrder.clear();
+      return Result::eFailure;
+    }
+
+    scheduled[next] = true;
+    mOrder.push_back(next);
+
+    for (uint32_t successor : successors[next]) {
+      predecessorCounts[successor]--;
+    }
+  }
+
+  return Result::eSuccess;
+}
+
+Result RenderGraph::allocateImages() {
+  for (Resource &resource : mResources) {
+    resource.firstUse = UNUSED;
+    resource.lastUse = 0;
+    resource.pooledImage = UNUSED;
+  }
+
+  for (uint32_t position = 0; position < mOrder.size(); position++) {
+    const Pass &pass = mPasses[mOrder[position]];
+
+    for (const std::vector<RenderGraphResource> *accesses :
+         {&pass.reads, &pass.writes}) {
+      for (RenderGraphResource resource : *accesses) {
+        Resource &used = mResources[resource];
+        used.firstUse = std::min(used.firstUse, position);
+        used.lastUse = std::max(used.lastUse, position);
+      }
+    }
+  }
+
+  // Transient images in order of first use.
+  std::vector<uint32_t> transients;
+  for (uint32_t resource = 0; resource < mResources.size(); resource++) {
+    if (!mResources[resource].imported &&
+        mResources[resource].firstUse != UNUSED) {
+      transients.push_back(resource);
+    }
+  }
+
+  std::sort(transients.begin(), transients.end(),
+            [this](uint32_t a, uint32_t b) {
+              return mResources[a].firstUse < mResources[b].firstUse;
+            });
+
+  for (PooledImage &image : mImages) {
+    image.busyUntil = UNUSED;
+  }
+
+  for (uint32_t resourceIdx : transients) {
+    Resource &resource = mResources[resourceIdx];
+
+    // Any pooled image of the same description free by the first use.
+    for (uint32_t imageIdx = 0; imageIdx < mImages.size(); imageIdx++) {
+      const PooledImage &image = mImages[imageIdx];
+      if (ImageDescEqual(image.desc, resource.desc) &&
+          (image.busyUntil == UNUSED || image.busyUntil < resource.firstUse)) {
+        resource.pooledImage = imageIdx;
+        break;
+      }
+    }
+
+    if (resource.pooledImage == UNUSED) {
+      const RenderGraphImageDesc &desc = resource.desc;
+      const ImageHandle imgh =
+          desc.width == 0
+              ? Image2DCreateRelative(desc.format, desc.scale, desc.flags)
+              : Image2DCreate(desc.format, desc.width, desc.height, desc.flags,
+                              desc.sampleCount);
+
+      if (imgh.idx == CBZ_INVALID_HANDLE) {
+        sLogger->error("Failed to create render graph image '{}'!",
+                      resource.name);
+        return Result::eFailure;
+      }
+
+      mImages.push_back({desc, imgh, 0, UNUSED});
+      resource.pooledImage = static_cast<uint32_t>(mImages.size() - 1);
+    }
+
+    mImages[resource.pooledImage].busyUntil = resource.lastUse;
+  }
+
+  // Release images no build has used for a while.
+  for (size_t imageIdx = mImages.size(); imageIdx-- > 0;) {
+    PooledImage &image = mImages[imageIdx];
+    if (image.busyUntil != UNUSED) {
+      image.idleBuilds = 0;
+      continue;
+    }
+
+    if (++image.idleBuilds <= RENDER_GRAPH_IDLE_BUILDS) {
+      continue;
+    }
+
+    ImageDestroy(image.imgh);
+    mImages.erase(mImages.begin() + imageIdx);
+
+    for (Resource &resource : mResources) {
+      if (resource.pooledImage != UNUSED && resource.pooledImage > imageIdx) {
+        resource.pooledImage--;
+      }
+    }
+  }
+
+  return Result::eSuccess;
+}
+
+Result RenderGraph::assignTargets() {
+  uint32_t target = mFirstTarget;
+
+  for (uint32_t passIdx : mOrder) {
+    Pass &pass = mPasses[passIdx];
+
+    if (pass.surface) {
+      pass.target = CBZ_DEFAULT_RENDER_TARGET;
+      continue;
+    }
+
+    if (target >= MAX_TARGETS || target >= CBZ_DEFAULT_RENDER_TARGET) {
+      sLogger->error("Render graph exceeds the available targets at pass '{}'!",
+                    pass.name);
+      return Result::eFailure;
+    }
+
+    pass.target = static_cast<uint8_t>(target++);
+
+    if (pass.type != CBZ_TARGET_TYPE_GRAPHICS) {
+      continue;
+    }
+
+    uint32_t sampleCount = 1;
+    std::vector<AttachmentDescription> colorAttachments;
+    for (const Attachment &attachment : pass.colorAttachments) {
+      AttachmentDescription desc = {};
+      desc.imgh = getImage(attachment.resource);
+      desc.flags = attachment.flags;
+      colorAttachments.push_back(desc);
+
+      if (!mResources[attachment.resource].imported) {
+        sampleCount = mResources[attachment.resource].desc.sampleCount;
+      }
+    }
+
+    AttachmentDescription depthAttachment = {};
+    depthAttachment.imgh = {CBZ_INVALID_HANDLE};
+    if (pass.depthAttachment.resource != INVALID_RESOURCE) {
+      depthAttachment.imgh = getImage(pass.depthAttachment.resource);
+      depthAttachment.flags = pass.depthAttachment.flags;
+    }
+
+    RenderTargetSet(pass.target, colorAttachments.data(),
+                    static_cast<uint32_t>(colorAttachments.size()),
+                    &depthAttachment, sampleCount);
+  }
+
+  return Result::eSuccess;
+}
+
+}; // namespace cbz
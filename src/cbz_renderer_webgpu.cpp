@@ -5,12 +5,18 @@
 #include "cbz_gfx/cbz_gfx_defines.h"
 #include "cbz_gfx/net/cbz_net_http.h"
 #include "cbz_irenderer_context.h"
+#include "cbz_worker_pool.h"
 
 #include <cbz/cbz_file.h>
 
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <limits>
 #include <murmurhash/MurmurHash3.h>
 #include <nlohmann/json.hpp>
@@ -19,7 +25,9 @@
 #include <backends/imgui_impl_wgpu.h>
 
 #include <fstream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <webgpu/webgpu.h>
 
 constexpr static WGPUTextureDimension
@@ -60,25 +68,130 @@ static std::unique_ptr<cbz::net::IHttpClient> sShaderHttpClient;
 static WGPUDevice sDevice;
 static WGPULimits sLimits;
 
+// Native features enabled on the device.
+static bool sMultiDrawIndirect = false;
+static bool sMultiDrawIndirectCount = false;
+static bool sPushConstants = false;
+static bool sTextureBindingArrays = false;
+
 static WGPUQueue sQueue;
 
 static WGPUSurface sSurface;
-static WGPUTextureFormat sSurfaceFormat;
 static cbz::ImageHandle sSurfaceIMGH;
 
 static std::vector<cbz::VertexBufferWebGPU> sVertexBuffers;
 static std::vector<cbz::IndexBufferWebGPU> sIndexBuffers;
 static std::vector<cbz::UniformBufferWebWGPU> sUniformBuffers;
 static std::vector<cbz::StorageBufferWebWGPU> sStorageBuffers;
+static cbz::BufferPoolWebGPU sBufferPools[CBZ_BUFFER_POOL_COUNT];
 
 static std::vector<cbz::TextureWebGPU> sTextures;
+
+// Multisampled attachments rendered in place of single sample images, keyed
+// by image index.
+static std::unordered_map<uint32_t, cbz::TextureWebGPU> sMultisampleTextures;
 static std::unordered_map<uint32_t, WGPUSampler> sSamplers;
+static std::unordered_map<uint32_t, cbz::TextureBindingDesc> sSamplerDescs;
 
 static std::vector<cbz::ShaderWebGPU> sShaders;
 static std::unordered_map<uint32_t, WGPUBindGroup> sBindingGroups;
 
 static std::vector<cbz::GraphicsProgramWebGPU> sGraphicsPrograms;
 static std::vector<cbz::ComputeProgramWebGPU> sComputePrograms;
+static std::vector<cbz::DrawListWebGPU> sDrawLists;
+
+// Bounds pipeline, layout, bind group and sampler creation per frame.
+static cbz::CreationBudget sCreationBudget;
+
+static cbz::StagingBeltWebGPU sStagingBelt;
+static cbz::ReadbackQueueWebGPU sReadbackQueue;
+static cbz::MipmapGeneratorWebGPU sMipmapGenerator;
+static cbz::TextureStreamerWebGPU sTextureStreamer;
+static cbz::SwapchainWebGPU sSwapchain;
+static cbz::DynamicResolutionWebGPU sDynamicResolution;
+static cbz::CullingWebGPU sCulling;
+static cbz::TextureTableWebGPU sTextureTable;
+
+// Bind groups referencing each image; released when the image's texture is
+// replaced or destroyed.
+static std::unordered_map<uint32_t, std::vector<uint32_t>> sImageBindGroups;
+
+// Images referenced by each bind group, to unlink the group once released.
+static std::unordered_map<uint32_t, std::vector<uint32_t>> sBindGroupImages;
+
+// Resources draw list bundles may reference.
+enum class DrawListResource : uint8_t {
+  eVertexBuffer,
+  eIndexBuffer,
+  eUniform,
+  eStructuredBuffer,
+  eImage,
+  eTextureTable,
+  eShader,
+  eGraphicsProgram,
+};
+
+// Advanced when a resource draw list bundles may reference is destroyed or
+// replaced; bundles referencing it are encoded again.
+static uint64_t sDrawListEpoch = 0;
+
+// Epoch each resource last changed at, by its 'DrawListResourceKey'.
+static std::unordered_map<uint64_t, uint64_t> sDrawListResourceEpochs;
+
+static uint64_t DrawListResourceKey(DrawListResource resource, uint32_t idx) {
+  return static_cast<uint64_t>(resource) << 32 | idx;
+}
+
+static void DrawListResourceChanged(DrawListResource resource, uint32_t idx) {
+  sDrawListResourceEpochs[DrawListResourceKey(resource, idx)] =
+      ++sDrawListEpoch;
+}
+
+// @returns epoch the resource of 'key' last changed at, 0 if it never did.
+static uint64_t DrawListResourceEpoch(uint64_t key) {
+  auto it = sDrawListResourceEpochs.find(key);
+  return it != sDrawListResourceEpochs.end() ? it->second : 0;
+}
+
+// --- Async loading ---
+static cbz::WorkerPool sWorkerPool;
+
+struct ShaderLoadRequest {
+  cbz::ShaderHandle sh;
+  uint32_t generation;
+  CBZShaderFlags flags;
+  std::string path;
+
+  cbz::ShaderWebGPU shader;
+  cbz::Result result;
+};
+
+static std::mutex sShaderLoadMutex;
+static std::vector<std::shared_ptr<ShaderLoadRequest>> sCompletedShaderLoads;
+
+// Bumped whenever a shader slot is created or destroyed; loads completing for
+// an older generation are dropped.
+static std::vector<uint32_t> sShaderGenerations;
+
+// --- Parallel encoding ---
+
+// Guards lazily created objects while passes are encoded on workers.
+static std::mutex sEncodeMutex;
+
+// @brief Ranges of a frame's commands claimed by the threads encoding them.
+struct ParallelEncode {
+  std::vector<uint32_t> rangeFirsts;
+  std::atomic<uint32_t> nextRange{0};
+
+  // Results of each range.
+  std::vector<WGPUCommandBuffer> cmdBuffers;
+  std::vector<cbz::RendererStats> stats;
+  std::vector<uint8_t> lastTargets;
+
+  std::mutex mutex;
+  std::condition_variable encoded;
+  uint32_t encodedCount = 0;
+};
 
 // --- ImGui ---
 #include "cbz_gfx/cbz_gfx_imgui.h"
@@ -137,12 +250,15 @@ CheckAndCreateRequiredLimits(WGPUAdapter adapter) {
   requiredLimits.limits.minStorageBufferOffsetAlignment =
       supportedLimits.limits.minStorageBufferOffsetAlignment;
 
-  requiredLimits.limits.maxBindGroups = 2;
+  requiredLimits.limits.maxBindGroups = cbz::MAX_BIND_GROUPS;
+
+  // Counted across the frame, material and draw sets; shaders exceeding them
+  // are rejected when their module is created.
   requiredLimits.limits.maxUniformBuffersPerShaderStage =
-      static_cast<uint32_t>(CBZ_BUFFER_COUNT);
+      supportedLimits.limits.maxUniformBuffersPerShaderStage;
   requiredLimits.limits.maxUniformBufferBindingSize = 65536; // Default
   requiredLimits.limits.maxStorageBuffersPerShaderStage =
-      static_cast<uint32_t>(CBZ_BUFFER_COUNT);
+      supportedLimits.limits.maxStorageBuffersPerShaderStage;
   requiredLimits.limits.maxStorageBufferBindingSize =
       supportedLimits.limits.maxStorageBufferBindingSize;
 
@@ -206,32 +322,501 @@ static void OnWorkDone(WGPUQueueWorkDoneStatus status, void *) {
   }
 }
 
-// TODO: Add offset
-static void AlignedWriteBufferWGPU(WGPUBuffer buffer, const void *data,
-                                   uint32_t size) {
-  // Split write if not aligned
-  uint32_t misalignedSize = size % 4;
-  assert(size > 3);
+// @brief Records that the bind group 'groupHash' references 'images'.
+static void TrackBindGroupImages(uint32_t groupHash,
+                                 const std::vector<uint32_t> &images) {
+  std::vector<uint32_t> &groupImages = sBindGroupImages[groupHash];
+  for (uint32_t imgIdx : images) {
+    if (std::find(groupImages.begin(), groupImages.end(), imgIdx) !=
+        groupImages.end()) {
+      continue;
+    }
 
-  if (misalignedSize > 0) {
-    uint32_t allignedSize = size - misalignedSize;
-    wgpuQueueWriteBuffer(sQueue, buffer, 0, data, allignedSize);
+    groupImages.push_back(imgIdx);
+    sImageBindGroups[imgIdx].push_back(groupHash);
+  }
+}
 
-    std::array<uint32_t, 4> misalignedData;
-    memcpy(misalignedData.data(),
-           static_cast<const uint8_t *>(data) + allignedSize, misalignedSize);
-    wgpuQueueWriteBuffer(sQueue, buffer, allignedSize, misalignedData.data(),
-                         4);
-  } else {
-    wgpuQueueWriteBuffer(sQueue, buffer, 0, data, size);
+// @brief Releases the bind group 'groupHash' and unlinks it from its images.
+static void ReleaseBindGroup(uint32_t groupHash) {
+  if (auto groupIt = sBindingGroups.find(groupHash);
+      groupIt != sBindingGroups.end()) {
+    if (groupIt->second) {
+      wgpuBindGroupRelease(groupIt->second);
+    }
+    sBindingGroups.erase(groupIt);
+  }
+
+  auto imagesIt = sBindGroupImages.find(groupHash);
+  if (imagesIt == sBindGroupImages.end()) {
+    return;
+  }
+
+  for (uint32_t imgIdx : imagesIt->second) {
+    auto it = sImageBindGroups.find(imgIdx);
+    if (it == sImageBindGroups.end()) {
+      continue;
+    }
+
+    std::vector<uint32_t> &groups = it->second;
+    groups.erase(std::remove(groups.begin(), groups.end(), groupHash),
+                 groups.end());
+    if (groups.empty()) {
+      sImageBindGroups.erase(it);
+    }
+  }
+
+  sBindGroupImages.erase(imagesIt);
+}
+
+static void InvalidateBindGroups(cbz::ImageHandle imgh) {
+  auto it = sImageBindGroups.find(imgh.idx);
+  if (it == sImageBindGroups.end()) {
+    return;
+  }
+
+  DrawListResourceChanged(DrawListResource::eImage, imgh.idx);
+
+  // Releasing a group unlinks it from this list.
+  const std::vector<uint32_t> groupHashes = it->second;
+  for (uint32_t groupHash : groupHashes) {
+    ReleaseBindGroup(groupHash);
+  }
+}
+
+// @returns false for compressed formats missing their device feature.
+static bool TextureFormatIsSupported(CBZTextureFormat format) {
+  if (format >= CBZ_TEXTURE_FORMAT_BC1RGBAUNORM &&
+      format <= CBZ_TEXTURE_FORMAT_BC7RGBAUNORMSRGB) {
+    return wgpuDeviceHasFeature(sDevice, WGPUFeatureName_TextureCompressionBC);
+  }
+
+  if (format >= CBZ_TEXTURE_FORMAT_ETC2RGB8UNORM &&
+      format <= CBZ_TEXTURE_FORMAT_EACRG11SNORM) {
+    return wgpuDeviceHasFeature(sDevice,
+                                WGPUFeatureName_TextureCompressionETC2);
+  }
+
+  if (format >= CBZ_TEXTURE_FORMAT_ASTC4X4UNORM &&
+      format <= CBZ_TEXTURE_FORMAT_ASTC12X12UNORMSRGB) {
+    return wgpuDeviceHasFeature(sDevice,
+                                WGPUFeatureName_TextureCompressionASTC);
+  }
+
+  return format != CBZ_TEXTURE_FORMAT_UNDEFINED;
+}
+
+static bool TextureFormatHasStencil(WGPUTextureFormat format) {
+  return format == WGPUTextureFormat_Stencil8 ||
+         format == WGPUTextureFormat_Depth24PlusStencil8 ||
+         format == WGPUTextureFormat_Depth32FloatStencil8;
+}
+
+static bool TextureFormatIsDepth(WGPUTextureFormat format) {
+  return format == WGPUTextureFormat_Depth16Unorm ||
+         format == WGPUTextureFormat_Depth24Plus ||
+         format == WGPUTextureFormat_Depth24PlusStencil8 ||
+         format == WGPUTextureFormat_Depth32Float ||
+         format == WGPUTextureFormat_Depth32FloatStencil8;
+}
+
+static WGPULoadOp AttachmentLoadOp(int flags) {
+  // Don't care clears; WebGPU has no undefined load.
+  return (flags & CBZ_RENDER_ATTACHMENT_LOAD) == CBZ_RENDER_ATTACHMENT_LOAD
+             ? WGPULoadOp_Load
+             : WGPULoadOp_Clear;
+}
+
+static WGPUStoreOp AttachmentStoreOp(int flags) {
+  return (flags & CBZ_RENDER_ATTACHMENT_DISCARD) ==
+                 CBZ_RENDER_ATTACHMENT_DISCARD
+             ? WGPUStoreOp_Discard
+             : WGPUStoreOp_Store;
+}
+
+// @returns whether the attachments of 'next' continue the render pass begun
+// for 'first': the same views, loaded by 'next' and not discarded by 'first'.
+static bool RenderPassContinues(const cbz::RenderTarget &first,
+                                const cbz::RenderTarget &next) {
+  auto continues = [](const cbz::AttachmentDescription &a,
+                      const cbz::AttachmentDescription &b) {
+    if (a.imgh.idx != b.imgh.idx || a.baseArrayLayer != b.baseArrayLayer ||
+        a.arrayLayerCount != b.arrayLayerCount) {
+      return false;
+    }
+
+    const int readOnly = CBZ_RENDER_ATTACHMENT_READ_ONLY;
+    if ((a.flags & readOnly) != (b.flags & readOnly)) {
+      return false;
+    }
+
+    return (a.flags & readOnly) ||
+           ((a.flags & CBZ_RENDER_ATTACHMENT_DISCARD) == 0 &&
+            (b.flags & CBZ_RENDER_ATTACHMENT_LOAD) != 0);
+  };
+
+  if (first.sampleCount != next.sampleCount ||
+      first.colorAttachments.size() != next.colorAttachments.size() ||
+      first.depthAttachment.imgh.idx != next.depthAttachment.imgh.idx) {
+    return false;
+  }
+
+  for (size_t i = 0; i < first.colorAttachments.size(); i++) {
+    if (!continues(first.colorAttachments[i], next.colorAttachments[i])) {
+      return false;
+    }
+  }
+
+  return first.depthAttachment.imgh.idx == CBZ_INVALID_HANDLE ||
+         continues(first.depthAttachment, next.depthAttachment);
+}
+
+// @returns whether a multisampled target loads or reads the companion of
+// 'imgh'. Targets persist across frames, so this covers later passes of the
+// frame and those of the next.
+static bool
+MultisampleCompanionLoaded(const std::vector<cbz::RenderTarget> &renderTargets,
+                           cbz::ImageHandle imgh) {
+  const int loads =
+      CBZ_RENDER_ATTACHMENT_LOAD | CBZ_RENDER_ATTACHMENT_READ_ONLY;
+  for (const cbz::RenderTarget &renderTarget : renderTargets) {
+    if (renderTarget.sampleCount <= 1) {
+      continue;
+    }
+
+    for (const cbz::AttachmentDescription &attachment :
+         renderTarget.colorAttachments) {
+      if (attachment.imgh.idx == imgh.idx && (attachment.flags & loads)) {
+        return true;
+      }
+    }
+
+    if (renderTarget.depthAttachment.imgh.idx == imgh.idx &&
+        (renderTarget.depthAttachment.flags & loads)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// @returns view of the multisampled texture rendered in place of 'imgh'.
+// @note Recreated when the image is resized or the sample count changes.
+static WGPUTextureView FindOrCreateMultisampleView(cbz::ImageHandle imgh,
+                                                   uint32_t sampleCount,
+                                                   WGPUTextureAspect aspect) {
+  const cbz::TextureWebGPU &image = sTextures[imgh.idx];
+  cbz::TextureWebGPU &multisample = sMultisampleTextures[imgh.idx];
+
+  const WGPUExtent3D extent = image.getExtent();
+  if (multisample.getTexture()) {
+    const WGPUExtent3D multisampleExtent = multisample.getExtent();
+    if (multisample.getFormat() != image.getFormat() ||
+        multisample.getSampleCount() != sampleCount ||
+        multisampleExtent.width != extent.width ||
+        multisampleExtent.height != extent.height) {
+      multisample.destroy();
+      multisample = {};
+    }
+  }
+
+  if (!multisample.getTexture()) {
+    if (multisample.create(extent.width, extent.height, 1,
+                           WGPUTextureDimension_2D, image.getFormat(),
+                           WGPUTextureUsage_RenderAttachment, 1,
+                           "MultisampleAttachment",
+                           sampleCount) != cbz::Result::eSuccess) {
+      return NULL;
+    }
+  }
+
+  return multisample.findOrCreateTextureView(aspect);
+}
+
+// @returns true if 'binding' binds the camera of its submission.
+static bool BindingIsCamera(const cbz::Binding &binding) {
+  return binding.group == 0 &&
+         binding.type == cbz::BindingType::eStructuredBuffer &&
+         binding.value.storageBuffer.slot == CBZ_BUFFER_GLOBAL_CAMERA;
+}
+
+// @returns the command binding of 'bindingDesc', null if it is not set.
+// Uniforms match by name, other bindings by type, group and slot.
+static const cbz::Binding *BindingFind(const cbz::BindingDesc &bindingDesc,
+                                       const cbz::Binding *bindings,
+                                       uint32_t bindingCount) {
+  using cbz::BindingType;
+
+  for (uint32_t bindingIdx = 0; bindingIdx < bindingCount; bindingIdx++) {
+    const cbz::Binding &binding = bindings[bindingIdx];
+    if (bindingDesc.type != BindingType::eUniformBuffer &&
+        binding.group != bindingDesc.group) {
+      continue;
+    }
+
+    switch (bindingDesc.type) {
+    case BindingType::eUniformBuffer: {
+      if (binding.type == BindingType::eUniformBuffer &&
+          bindingDesc.name ==
+              cbz::HandleProvider<cbz::UniformHandle>::getName(
+                  binding.value.uniformBuffer.handle)) {
+        return &binding;
+      }
+    } break;
+
+    case BindingType::eRWStructuredBuffer:
+    case BindingType::eStructuredBuffer: {
+      if ((binding.type == BindingType::eRWStructuredBuffer ||
+           binding.type == BindingType::eStructuredBuffer) &&
+          binding.value.storageBuffer.slot == bindingDesc.index) {
+        return &binding;
+      }
+    } break;
+
+    case BindingType::eTexture2D:
+    case BindingType::eTextureCube: {
+      if (binding.type == bindingDesc.type &&
+          binding.value.texture.slot == bindingDesc.index) {
+        return &binding;
+      }
+    } break;
+
+    case BindingType::eSampler: {
+      if (binding.type == BindingType::eSampler &&
+          binding.value.sampler.slot == bindingDesc.index) {
+        return &binding;
+      }
+    } break;
+
+    case BindingType::eTextureTable: {
+      if (binding.type == BindingType::eTextureTable &&
+          binding.value.textureTable.slot == bindingDesc.index) {
+        return &binding;
+      }
+    } break;
+
+    case BindingType::eNone:
+      break;
+    }
   }
+
+  return nullptr;
+}
+
+#ifdef WEBGPU_BACKEND_WGPU
+// Stages push constants are visible to in graphics pipelines.
+static constexpr WGPUShaderStageFlags PUSH_CONSTANT_STAGES =
+    WGPUShaderStage_Vertex | WGPUShaderStage_Fragment;
+
+// Binding arrays back the global texture table.
+static constexpr WGPUFeatureName TEXTURE_BINDING_ARRAY_FEATURES[] = {
+    static_cast<WGPUFeatureName>(WGPUNativeFeature_TextureBindingArray),
+    static_cast<WGPUFeatureName>(
+        WGPUNativeFeature_SampledTextureAndStorageBufferArrayNonUniformIndexing),
 };
+#endif
+
+// @returns length of the run of draws starting at 'first' that differ only in
+// their transforms, which follow in submission order.
+static uint32_t InstanceRunLength(const cbz::ShaderProgramCommand *cmds,
+                                  uint32_t first, uint32_t count) {
+  const cbz::ShaderProgramCommand &head = cmds[first];
+  const auto &graphics = head.program.graphics;
+
+  if (head.programType != CBZ_TARGET_TYPE_GRAPHICS || head.isCull ||
+      head.isDrawList || graphics.instances != 1 ||
+      graphics.indirectCount > 0) {
+    return 1;
+  }
+
+  uint32_t runLength = 1;
+  for (uint32_t cmdIdx = first + 1; cmdIdx < count; cmdIdx++, runLength++) {
+    const cbz::ShaderProgramCommand &cmd = cmds[cmdIdx];
+    const auto &other = cmd.program.graphics;
+
+    if (cmd.target != head.target || cmd.sortKey != head.sortKey ||
+        cmd.isDrawList || cmd.submissionID != head.submissionID + runLength) {
+      break;
+    }
+
+    if (other.instances != 1 || other.indirectCount > 0 ||
+        other.ibh.idx != graphics.ibh.idx ||
+        other.vbCount != graphics.vbCount ||
+        memcmp(other.vbhs, graphics.vbhs,
+               sizeof(cbz::VertexBufferHandle) * graphics.vbCount) != 0) {
+      break;
+    }
+
+    if (cmd.pushConstantsSize != head.pushConstantsSize ||
+        memcmp(cmd.pushConstants, head.pushConstants,
+               head.pushConstantsSize) != 0) {
+      break;
+    }
+  }
+
+  return runLength;
+}
+
+// Commands below which a frame is encoded on one thread.
+static constexpr uint32_t PARALLEL_ENCODE_MIN_COMMANDS = 256;
+
+// @brief Splits sorted commands into at most 'maxRanges' ranges of about equal
+// size, each beginning a pass.
+// @returns first command of each range.
+static std::vector<uint32_t>
+PassRanges(const std::vector<cbz::RenderTarget> &renderTargets,
+           const cbz::ShaderProgramCommand *cmds, uint32_t count,
+           uint32_t maxRanges) {
+  const uint32_t rangeSize = (count + maxRanges - 1) / maxRanges;
+  std::vector<uint32_t> rangeFirsts = {0};
+
+  uint8_t target = CBZ_INVALID_RENDER_TARGET;
+  uint8_t passTarget = CBZ_INVALID_RENDER_TARGET;
+  CBZTargetType targetType = CBZ_TARGET_TYPE_NONE;
+  for (uint32_t cmdIdx = 0; cmdIdx < count; cmdIdx++) {
+    const cbz::ShaderProgramCommand &cmd = cmds[cmdIdx];
+    if (cmd.target == target) {
+      continue;
+    }
+
+    // Targets continue the open pass as they do when encoding.
+    bool continuePass = false;
+    if (targetType == cmd.programType) {
+      continuePass = targetType == CBZ_TARGET_TYPE_COMPUTE ||
+                     (targetType == CBZ_TARGET_TYPE_GRAPHICS &&
+                      passTarget != CBZ_DEFAULT_RENDER_TARGET &&
+                      cmd.target != CBZ_DEFAULT_RENDER_TARGET &&
+                      RenderPassContinues(renderTargets[passTarget],
+                                          renderTargets[cmd.target]));
+    }
+
+    target = cmd.target;
+    if (continuePass) {
+      continue;
+    }
+
+    passTarget = cmd.target;
+    targetType = cmd.programType;
+    if (cmdIdx - rangeFirsts.back() >= rangeSize) {
+      rangeFirsts.push_back(cmdIdx);
+    }
+  }
+
+  return rangeFirsts;
+}
+
+// @brief Finishes and releases 'encoder'.
+static WGPUCommandBuffer FinishEncoder(WGPUCommandEncoder encoder,
+                                       const std::string &label) {
+  WGPUCommandBufferDescriptor cmdDesc = {};
+  cmdDesc.nextInChain = nullptr;
+  cmdDesc.label = label.c_str();
+
+  WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(encoder, &cmdDesc);
+  wgpuCommandEncoderRelease(encoder);
+  return cmd;
+}
+
+// @brief Adds the counters recorded while encoding a range to 'dst'.
+static void AccumulateStats(cbz::RendererStats &dst,
+                            const cbz::RendererStats &src) {
+  dst.drawCalls += src.drawCalls;
+  dst.dispatches += src.dispatches;
+  dst.submissionsDeferred += src.submissionsDeferred;
+  dst.passesCoalesced += src.passesCoalesced;
+  dst.bindGroupsSet += src.bindGroupsSet;
+  dst.submissionsInstanced += src.submissionsInstanced;
+}
+
+// Index count, instance count, first index, base vertex and first instance.
+static constexpr uint64_t INDIRECT_ARGS_SIZE = sizeof(uint32_t) * 5;
+
+// @brief Draws 'count' indexed indirect records, limited by the first uint32
+// of 'countBuffer' if given.
+// @returns encoder calls recorded.
+static uint32_t
+DrawIndexedIndirect(WGPURenderPassEncoder renderPassEncoder,
+                    const cbz::StorageBufferWebWGPU &args, uint64_t argsOffset,
+                    uint32_t count,
+                    const cbz::StorageBufferWebWGPU *countBuffer) {
+  const uint64_t offset = args.getOffset() + argsOffset;
+
+#ifdef WEBGPU_BACKEND_WGPU
+  if (countBuffer && sMultiDrawIndirectCount) {
+    wgpuRenderPassEncoderMultiDrawIndexedIndirectCount(
+        renderPassEncoder, args.getBuffer(), offset, countBuffer->getBuffer(),
+        countBuffer->getOffset(), count);
+    return 1;
+  }
+
+  if (count > 1 && sMultiDrawIndirect) {
+    wgpuRenderPassEncoderMultiDrawIndexedIndirect(
+        renderPassEncoder, args.getBuffer(), offset, count);
+    return 1;
+  }
+#endif
+
+  // Without count support every record is drawn.
+  for (uint32_t drawIdx = 0; drawIdx < count; drawIdx++) {
+    wgpuRenderPassEncoderDrawIndexedIndirect(
+        renderPassEncoder, args.getBuffer(),
+        offset + drawIdx * INDIRECT_ARGS_SIZE);
+  }
+
+  return count;
+}
+
+// @brief Surface textures only live while a frame is recorded; their info is
+// taken from the surface configuration instead.
+static bool ImageGetInfo(cbz::ImageHandle imgh, WGPUTextureFormat *format,
+                         WGPUExtent3D *extent) {
+  if (imgh.idx == sSurfaceIMGH.idx) {
+    *format = sSwapchain.getFormat();
+    *extent = sSwapchain.getExtent();
+    return true;
+  }
+
+  if (imgh.idx >= sTextures.size() || !sTextures[imgh.idx].getTexture()) {
+    return false;
+  }
+
+  *format = sTextures[imgh.idx].getFormat();
+  *extent = sTextures[imgh.idx].getExtent();
+  return true;
+}
+
+// @returns target describing the surface to pipelines and bundles.
+static const cbz::RenderTarget &SurfaceRenderTarget() {
+  static cbz::RenderTarget sSurfaceRenderTarget{};
+  sSurfaceRenderTarget.colorAttachments.resize(1);
+  sSurfaceRenderTarget.colorAttachments[0].imgh = sSurfaceIMGH;
+  return sSurfaceRenderTarget;
+}
+
+// @brief Fills a buffer created with mappedAtCreation and unmaps it.
+static void MappedBufferWrite(WGPUBuffer buffer, const void *data,
+                              uint64_t size) {
+  void *mapped = wgpuBufferGetMappedRange(buffer, 0, wgpuBufferGetSize(buffer));
+  memcpy(mapped, data, size);
+  wgpuBufferUnmap(buffer);
+}
+
+[[nodiscard]] static constexpr uint64_t AlignUp(uint64_t value,
+                                                uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// @returns whether [a, a + aSize) and [b, b + bSize) intersect.
+[[nodiscard]] static constexpr bool RangesOverlap(uint64_t a, uint64_t aSize,
+                                                  uint64_t b, uint64_t bSize) {
+  return a < b ? b - a < aSize : a - b < bSize;
+}
 
 namespace cbz {
 
 class RendererContextWebGPU : public IRendererContext {
 public:
-  Result init(uint32_t width, uint32_t height, void *nwh,
+  Result init(const InitDesc &initDesc, void *nwh,
               ImageHandle swapchainIMGH) override;
 
   [[nodiscard]] Result vertexBufferCreate(VertexBufferHandle vbh,
@@ -278,15 +863,75 @@ public:
   [[nodiscard]] Result imageCreate(ImageHandle th, CBZTextureFormat format,
                                    uint32_t w, uint32_t h, uint32_t depth,
                                    CBZTextureDimension dimension,
-                                   CBZImageFlags flags) override;
+                                   CBZImageFlags flags, uint32_t mipLevelCount,
+                                   uint32_t sampleCount) override;
 
   void imageUpdate(ImageHandle th, void *data, uint32_t count) override;
 
+  [[nodiscard]] Result imageUpdateMip(ImageHandle th, uint32_t mipLevel,
+                                      const void *data,
+                                      uint32_t size) override;
+
+  [[nodiscard]] bool
+  imageFormatIsSupported(CBZTextureFormat format) const override;
+
+  [[nodiscard]] Result imageCreateRelative(ImageHandle imgh,
+                                           CBZTextureFormat format, float scale,
+                                           CBZImageFlags flags) override;
+
+  [[nodiscard]] Result imageStreamCreate(ImageHandle imgh,
+                                         const std::string &path,
+                                         CBZImageFlags flags) override;
+
+  void imageStreamPrioritySet(ImageHandle imgh, float priority) override;
+
+  void presentModeSet(CBZPresentMode presentMode) override;
+
+  void dynamicResolutionSet(const DynamicResolutionDesc &desc) override;
+
+  void upscaleSourceSet(ImageHandle imgh) override;
+
+  void textureStreamingBudgetSet(uint64_t bytes) override;
+
+  [[nodiscard]] TextureStreamingStats textureStreamingStatsGet() const override;
+
+  [[nodiscard]] BufferPoolStats
+  bufferPoolStatsGet(CBZBufferPool pool) const override;
+
   void imageDestroy(ImageHandle th) override;
 
+  void textureTableSet(uint32_t index, ImageHandle imgh) override;
+
+  void drawListUpdate(DrawListHandle dlh,
+                      std::vector<ShaderProgramCommand> &&cmds) override;
+
+  void drawListDestroy(DrawListHandle dlh) override;
+
+  [[nodiscard]] Result imageGetInfo(ImageHandle th, CBZTextureFormat *format,
+                                    uint32_t *width,
+                                    uint32_t *height) const override {
+    WGPUTextureFormat textureFormat;
+    WGPUExtent3D extent;
+    if (!ImageGetInfo(th, &textureFormat, &extent)) {
+      return Result::eFailure;
+    }
+
+    *format = static_cast<CBZTextureFormat>(textureFormat);
+    *width = extent.width;
+    *height = extent.height;
+    return Result::eSuccess;
+  }
+
   [[nodiscard]] Result shaderCreate(ShaderHandle sh, CBZShaderFlags flags,
                                     const std::string &path) override;
 
+  [[nodiscard]] Result shaderCreateAsync(ShaderHandle sh, CBZShaderFlags flags,
+                                         const std::string &path) override;
+
+  [[nodiscard]] bool shaderIsReady(ShaderHandle sh) const override {
+    return sh.idx < sShaders.size() && sShaders[sh.idx].isReady();
+  }
+
   void shaderDestroy(ShaderHandle sh) override;
 
   [[nodiscard]] Result graphicsProgramCreate(GraphicsProgramHandle gph,
@@ -295,69 +940,74 @@ public:
 
   void graphicsProgramDestroy(GraphicsProgramHandle gph) override;
 
+  [[nodiscard]] bool
+  graphicsProgramIsReady(GraphicsProgramHandle gph) const override {
+    return gph.idx < sGraphicsPrograms.size() &&
+           shaderIsReady(sGraphicsPrograms[gph.idx].getShader());
+  }
+
   [[nodiscard]] Result computeProgramCreate(ComputeProgramHandle cph,
                                             ShaderHandle sh) override;
 
+  [[nodiscard]] bool
+  computeProgramIsReady(ComputeProgramHandle cph) const override {
+    return cph.idx < sComputePrograms.size() &&
+           shaderIsReady(sComputePrograms[cph.idx].getShader());
+  }
+
   void computeProgramDestroy(ComputeProgramHandle cph) override;
 
-  void
+  [[nodiscard]] uint32_t
   readBufferAsync(StructuredBufferHandle sbh,
-                  std::function<void(const void *data)> callback) override {
-    struct BufferReadRequest {
-      StructuredBufferHandle sbh;
-      uint32_t frameFinished;
-      cbz::Result result;
-      std::function<void(const void *data)> callback;
-    } bufferReadRequest = {};
+                  std::function<void(const void *data)> callback,
+                  uint32_t offset, uint32_t size) override {
+    const StorageBufferWebWGPU &sb = sStorageBuffers[sbh.idx];
+    if (size == 0 && offset < sb.getSize()) {
+      size = sb.getSize() - offset;
+    }
 
-    bufferReadRequest.callback = callback;
-    bufferReadRequest.sbh = sbh;
+    if (size == 0 || static_cast<uint64_t>(offset) + size > sb.getSize()) {
+      sLogger->error("Buffer read out of bounds: offset ({}) + size ({}) "
+                     "exceeds buffer size ({}).",
+                     offset, size, sb.getSize());
+      return 0;
+    }
 
-    wgpuBufferMapAsync(
-        sStorageBuffers[sbh.idx].mBuffer, WGPUBufferUsage_MapRead, 0,
-        sStorageBuffers[sbh.idx].getSize(),
-        [](WGPUBufferMapAsyncStatus status, void *userdata) {
-          BufferReadRequest *request =
-              static_cast<BufferReadRequest *>(userdata);
-          // request->frameFinished = mFrameCounter;
-
-          switch (status) {
-          case WGPUBufferMapAsyncStatus_Success: {
-            const void *data = wgpuBufferGetConstMappedRange(
-                sStorageBuffers[request->sbh.idx].mBuffer, 0,
-                sStorageBuffers[request->sbh.idx].getSize());
-
-            if (request->callback) {
-              request->callback(data);
-            };
-
-            wgpuBufferUnmap(sStorageBuffers[request->sbh.idx].mBuffer);
-            request->result = Result::eSuccess;
-          } break;
-
-          default: {
-            request->result = Result::eFailure;
-            sLogger->error("Failed to read buffer {:X}!", (int)status);
-          } break;
-          };
-        },
-        &bufferReadRequest);
+    return sReadbackQueue.readBuffer(sb.mAllocation.buffer,
+                                     sb.mAllocation.offset + offset, size,
+                                     std::move(callback));
+  }
+
+  [[nodiscard]] CBZReadbackStatus
+  readbackStatusGet(uint32_t readbackId) const override {
+    return sReadbackQueue.getStatus(readbackId);
+  }
+
+  [[nodiscard]] uint32_t readbackDataCopy(uint32_t readbackId, void *dst,
+                                          uint32_t dstSize) override {
+    return sReadbackQueue.copy(readbackId, dst, dstSize);
   }
 
-  void
-  textureReadAsync(ImageHandle imgh, const Origin3D *origin,
-                   const TextureExtent *extent,
-                   std::function<void(const void *data)> callback) override {
-    const size_t textureSize =
-        sTextures[imgh.idx].getExtent().width *
-        sTextures[imgh.idx].getExtent().height *
-        TextureFormatGetSize(
-            static_cast<CBZTextureFormat>(sTextures[imgh.idx].getFormat()));
+  [[nodiscard]] uint32_t textureReadAsync(
+      ImageHandle imgh, const Origin3D *origin, const TextureExtent *extent,
+      std::function<void(std::vector<uint8_t> &&data)> callback) override {
+    WGPUTextureFormat textureFormat;
+    WGPUExtent3D textureExtent;
+    if (!ImageGetInfo(imgh, &textureFormat, &textureExtent)) {
+      sLogger->error("Attempting to read uninitialized texture!");
+      return 0;
+    }
 
-    const size_t textureAreaSize =
-        extent->width * extent->height *
-        TextureFormatGetSize(
-            static_cast<CBZTextureFormat>(sTextures[imgh.idx].getFormat()));
+    if (extent->width <= 0 || extent->height <= 0 || extent->layers <= 0 ||
+        origin->x + extent->width > textureExtent.width ||
+        origin->y + extent->height > textureExtent.height ||
+        origin->z + extent->layers > textureExtent.depthOrArrayLayers) {
+      sLogger->error("Texture read out of bounds! origin: {} {} {} extent {} "
+                     "{} {}",
+                     origin->x, origin->y, origin->z, extent->width,
+                     extent->height, extent->layers);
+      return 0;
+    }
 
     WGPUExtent3D extent3D = {};
     extent3D.width = extent->width;
@@ -369,69 +1019,16 @@ public:
     origin3D.y = origin->y;
     origin3D.z = origin->z;
 
-    WGPUBuffer tempStagingBuffer =
-        getTransientDestinationBuffer(textureAreaSize);
-    copyTextureToBuffer(sTextures[imgh.idx].mTexture, &origin3D,
-                        tempStagingBuffer, &extent3D);
-
-    const size_t textureBufferOffset =
-        (origin->y * sTextures[imgh.idx].getExtent().width + origin->x) *
-        TextureFormatGetSize(
-            static_cast<CBZTextureFormat>(sTextures[imgh.idx].getFormat()));
-
-    if (textureBufferOffset + textureAreaSize > textureSize) {
-      spdlog::warn("Overflow! Attempting to read beyond {}!", textureSize);
-      spdlog::warn("Discarding texture read origin: {} {} {} extent {} {} {}!",
-                   origin->x, origin->y, origin->z, extent->width,
-                   extent->height, extent->layers);
-      return;
-    }
-
-    // TODO: Store/Keep alive in request queue
-    static struct TextureReadRequest {
-      uint32_t frameFinished;
-      WGPUBuffer stagingBuffer;
-      size_t textureSize;
-      std::function<void(const void *data)> callback;
-      cbz::Result result;
-    } textureReadRequest = {};
-
-    textureReadRequest.textureSize = textureAreaSize;
-    textureReadRequest.callback = callback;
-    textureReadRequest.stagingBuffer = tempStagingBuffer;
-
-    wgpuBufferMapAsync(
-        tempStagingBuffer, WGPUBufferUsage_MapRead, textureBufferOffset,
-        textureAreaSize,
-        [](WGPUBufferMapAsyncStatus status, void *userdata) {
-          TextureReadRequest *request =
-              static_cast<TextureReadRequest *>(userdata);
-          // request->frameFinished = mFrameCounter;
-
-          switch (status) {
-          case WGPUBufferMapAsyncStatus_Success: {
-            const void *data = wgpuBufferGetConstMappedRange(
-                request->stagingBuffer, 0, request->textureSize);
-
-            if (request->callback) {
-              request->callback(data);
-            };
-
-            wgpuBufferUnmap(request->stagingBuffer);
-            request->result = Result::eSuccess;
-          } break;
-
-          default: {
-            request->result = Result::eFailure;
-            sLogger->error("Failed to read buffer 0x{:X}!", (int)status);
-          } break;
-          };
-        },
-        &textureReadRequest);
+    return sReadbackQueue.readTexture(imgh, origin3D, extent3D,
+                                      std::move(callback));
+  }
 
-    PollEvents(false);
+  void setCreationBudget(uint32_t maxCount, float maxMilliseconds) override {
+    sCreationBudget.set(maxCount, maxMilliseconds);
   }
 
+  [[nodiscard]] RendererStats getStats() const override { return mStats; }
+
   uint32_t submitSorted(const std::vector<RenderTarget> &renderTargets,
                         const ShaderProgramCommand *sortedCmds,
                         uint32_t count) override;
@@ -439,470 +1036,3658 @@ public:
   void shutdown() override;
 
 private:
-  void copyTextureToBuffer(WGPUTexture src, const WGPUOrigin3D *origin,
-                           WGPUBuffer dst, const WGPUExtent3D *extent) {
-    WGPUImageCopyTexture srcTexture = {};
-    srcTexture.nextInChain = nullptr;
-    srcTexture.texture = src;
-    srcTexture.mipLevel = 0;
-    srcTexture.origin = {origin->x, origin->y, origin->z};
-    srcTexture.aspect = WGPUTextureAspect_All;
-
-    const uint32_t textureFormatSize = TextureFormatGetSize(
-        static_cast<CBZTextureFormat>(wgpuTextureGetFormat(src)));
-
-    WGPUImageCopyBuffer dstBuffer = {};
-    dstBuffer.nextInChain = nullptr;
-    dstBuffer.layout = {};
-    dstBuffer.layout.nextInChain = nullptr;
-    dstBuffer.layout.offset = {};
-    dstBuffer.layout.bytesPerRow = extent->width * textureFormatSize;
-    dstBuffer.layout.rowsPerImage = extent->height;
-    dstBuffer.buffer = dst;
-
-    WGPUCommandEncoderDescriptor descriptor = {};
-    WGPUCommandEncoder cmdEncoder =
-        wgpuDeviceCreateCommandEncoder(sDevice, &descriptor);
-    wgpuCommandEncoderCopyTextureToBuffer(cmdEncoder, &srcTexture, &dstBuffer,
-                                          extent);
-
-    WGPUCommandBufferDescriptor cmdDesc = {};
-    cmdDesc.nextInChain = nullptr;
-    std::string commandBufferLabel = "CopyCommandBuffer";
-    cmdDesc.label = commandBufferLabel.c_str();
-    WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(cmdEncoder, &cmdDesc);
-    wgpuCommandEncoderRelease(cmdEncoder);
-
-    wgpuQueueSubmit(sQueue, 1, &cmd);
-    wgpuCommandBufferRelease(cmd);
-  }
-  // TODO: Create multiple staging buffers for different uses.
-  [[nodiscard]] WGPUBuffer getTransientDestinationBuffer(size_t len,
-                                                         void *data = nullptr) {
-    // Create if non. Resize of lesss
-    if (!mStagingBuffer || wgpuBufferGetSize(mStagingBuffer) < len) {
-      if (mStagingBuffer) {
-        wgpuBufferDestroy(mStagingBuffer);
-        mStagingBuffer = nullptr;
-      }
-
-      WGPUBufferDescriptor bufferDesc = {};
-      bufferDesc.nextInChain = nullptr;
-      // bufferDesc.label = name.c_str(); // TODO: Name for use case
-      bufferDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
-      bufferDesc.size = (len + 3) & ~3; // Pad to multiple of 4
-      bufferDesc.mappedAtCreation = false;
-
-      mStagingBuffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
-      if (!mStagingBuffer) {
-        spdlog::error("Failed to create stagingBuffer!");
-        return nullptr;
-      }
-
-      if (data) {
-        AlignedWriteBufferWGPU(mStagingBuffer, data,
-                               static_cast<uint32_t>(len));
-      }
-
-      sLogger->trace("Staging buffer resized to {}", len);
-    }
+  // @brief Creates modules for shaders finished loading on workers.
+  void processShaderLoads();
 
-    return mStagingBuffer;
-  }
+  [[nodiscard]] WGPUSampler findOrCreateSampler(SamplerHandle sh);
 
+  // @param bindings bindings of 'group' only; groups are cached by their own
+  // bindings, so sets whose resources did not change are reused.
   [[nodiscard]] WGPUBindGroup findOrCreateBindGroup(ShaderHandle sh,
-                                                    uint32_t descriptorHash,
+                                                    uint8_t group,
                                                     const Binding *bindings,
                                                     uint32_t bindingCount);
 
-  WGPUBuffer mStagingBuffer = NULL;
+  // @brief Finds or creates the group of each set 'sh' declares.
+  // @returns false if a group could not be created.
+  [[nodiscard]] bool findOrCreateBindGroups(ShaderHandle sh,
+                                            const Binding *bindings,
+                                            uint32_t bindingCount,
+                                            WGPUBindGroup *bindGroups);
+
+  // @brief Finds or encodes the bundle of 'dlh' for 'target', with the camera
+  // of 'cameraSBH'.
+  // @returns null if the list is empty or its objects could not be created.
+  [[nodiscard]] WGPURenderBundle
+  findOrCreateBundle(DrawListHandle dlh, StructuredBufferHandle cameraSBH,
+                     uint8_t target, const RenderTarget &renderTarget,
+                     RendererStats &stats);
+
+  // @brief Encodes sortedCmds[first, last) into 'encoder'; 'first' must begin
+  // a pass and 'last' end one.
+  // @returns target of the trailing pass.
+  uint8_t encodeCommands(WGPUCommandEncoder encoder,
+                         const std::vector<RenderTarget> &renderTargets,
+                         const ShaderProgramCommand *sortedCmds, uint32_t first,
+                         uint32_t last, WGPUTextureView swapchainTextureView,
+                         RendererStats &stats);
+
+  // @brief Encodes each range into its own command buffer on the worker pool
+  // and appends the buffers in command order.
+  // @param rangeFirsts first command of each range, see PassRanges().
+  // @returns target of the trailing pass.
+  uint8_t encodeParallel(const std::vector<RenderTarget> &renderTargets,
+                         const ShaderProgramCommand *sortedCmds, uint32_t count,
+                         const std::vector<uint32_t> &rangeFirsts,
+                         WGPUTextureView swapchainTextureView,
+                         RendererStats &stats,
+                         std::vector<WGPUCommandBuffer> &cmdBuffers);
+
   uint32_t mFrameCounter = 0;
+
+  RendererStats mStats = {};
 };
 
-Result VertexBufferWebGPU::create(const VertexLayout &vertexLayout,
-                                  uint32_t count, const void *data,
-                                  const std::string &name) {
-  mVertexLayout = vertexLayout;
+void StagingBeltWebGPU::init(uint64_t chunkSize) { mChunkSize = chunkSize; }
+
+StagingBeltWebGPU::Chunk *
+StagingBeltWebGPU::allocate(uint64_t size, uint64_t alignment,
+                            uint64_t *outOffset) {
+  for (std::unique_ptr<Chunk> &chunk : mChunks) {
+    if (chunk->state != ChunkState::eMapped || !chunk->mapped) {
+      continue;
+    }
+
+    const uint64_t offset = AlignUp(chunk->offset, alignment);
+    if (offset + size <= chunk->size) {
+      chunk->offset = offset + size;
+      *outOffset = offset;
+      return chunk.get();
+    }
+  }
+
+  // Oversized writes get a dedicated chunk released once consumed.
+  const uint64_t chunkSize = std::max(mChunkSize, AlignUp(size, 4));
+
+  WGPUBufferDescriptor bufferDesc = {};
+  bufferDesc.nextInChain = nullptr;
+  bufferDesc.label = "StagingBeltChunk";
+  bufferDesc.usage = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc;
+  bufferDesc.size = chunkSize;
+  bufferDesc.mappedAtCreation = true;
+
+  std::unique_ptr<Chunk> chunk = std::make_unique<Chunk>();
+  chunk->buffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
+  if (!chunk->buffer) {
+    sLogger->error("Failed to create staging chunk of size {}!", chunkSize);
+    return nullptr;
+  }
+
+  chunk->size = chunkSize;
+  chunk->offset = size;
+  chunk->mapped = static_cast<uint8_t *>(
+      wgpuBufferGetMappedRange(chunk->buffer, 0, chunkSize));
+  chunk->state = ChunkState::eMapped;
+
+  *outOffset = 0;
+  mChunks.push_back(std::move(chunk));
+  return mChunks.back().get();
+}
+
+void StagingBeltWebGPU::writeBuffer(WGPUBuffer dst, uint64_t offset,
+                                    const void *data, uint64_t size) {
+  if (!dst || !data || size == 0) {
+    return;
+  }
+
+  if (offset % 4 != 0) {
+    sLogger->error("Buffer write offset {} is not a multiple of 4!", offset);
+    return;
+  }
+
+  // Copies are whole words; the tail is padded with zeros.
+  const uint64_t alignedSize = AlignUp(size, 4);
+
+  uint64_t srcOffset = 0;
+  Chunk *chunk = allocate(alignedSize, 4, &srcOffset);
+  if (!chunk) {
+    return;
+  }
+
+  memcpy(chunk->mapped + srcOffset, data, size);
+  memset(chunk->mapped + srcOffset + size, 0, alignedSize - size);
+  mBufferCopies.push_back({chunk, srcOffset, dst, offset, alignedSize});
+}
+
+void StagingBeltWebGPU::writeTexture(const WGPUImageCopyTexture &dst,
+                                     const void *data, uint32_t bytesPerRow,
+                                     uint32_t rowsPerImage,
+                                     const WGPUExtent3D &extent) {
+  if (!dst.texture || !data || bytesPerRow == 0) {
+    return;
+  }
+
+  const uint64_t alignedBytesPerRow =
+      AlignUp(bytesPerRow, COPY_BYTES_PER_ROW_ALIGNMENT);
+  const uint64_t rowCount =
+      static_cast<uint64_t>(rowsPerImage) * extent.depthOrArrayLayers;
+
+  uint64_t srcOffset = 0;
+  Chunk *chunk = allocate(alignedBytesPerRow * rowCount,
+                          COPY_BYTES_PER_ROW_ALIGNMENT, &srcOffset);
+  if (!chunk) {
+    return;
+  }
+
+  const uint8_t *src = static_cast<const uint8_t *>(data);
+  uint8_t *staging = chunk->mapped + srcOffset;
+  if (alignedBytesPerRow == bytesPerRow) {
+    memcpy(staging, src, bytesPerRow * rowCount);
+  } else {
+    for (uint64_t row = 0; row < rowCount; row++) {
+      memcpy(staging + row * alignedBytesPerRow, src + row * bytesPerRow,
+             bytesPerRow);
+    }
+  }
+
+  TextureCopy &copy = mTextureCopies.emplace_back();
+  copy.chunk = chunk;
+  copy.layout = {};
+  copy.layout.nextInChain = nullptr;
+  copy.layout.offset = srcOffset;
+  copy.layout.bytesPerRow = static_cast<uint32_t>(alignedBytesPerRow);
+  copy.layout.rowsPerImage = rowsPerImage;
+  copy.dst = dst;
+  copy.extent = extent;
+}
+
+void StagingBeltWebGPU::flush(WGPUCommandEncoder encoder) {
+  // Copies into the same destination are contiguous more often than not.
+  for (size_t copyIdx = 0; copyIdx < mBufferCopies.size(); copyIdx++) {
+    BufferCopy copy = mBufferCopies[copyIdx];
+
+    while (copyIdx + 1 < mBufferCopies.size()) {
+      const BufferCopy &next = mBufferCopies[copyIdx + 1];
+      if (next.chunk != copy.chunk || next.dst != copy.dst ||
+          next.srcOffset != copy.srcOffset + copy.size ||
+          next.dstOffset != copy.dstOffset + copy.size) {
+        break;
+      }
+
+      copy.size += next.size;
+      copyIdx++;
+    }
+
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, copy.chunk->buffer,
+                                         copy.srcOffset, copy.dst,
+                                         copy.dstOffset, copy.size);
+  }
+
+  for (const TextureCopy &copy : mTextureCopies) {
+    WGPUImageCopyBuffer src = {};
+    src.nextInChain = nullptr;
+    src.buffer = copy.chunk->buffer;
+    src.layout = copy.layout;
+
+    wgpuCommandEncoderCopyBufferToTexture(encoder, &src, &copy.dst,
+                                          &copy.extent);
+  }
+
+  mBufferCopies.clear();
+  mTextureCopies.clear();
+
+  for (std::unique_ptr<Chunk> &chunk : mChunks) {
+    if (chunk->state != ChunkState::eMapped || chunk->offset == 0) {
+      continue;
+    }
+
+    wgpuBufferUnmap(chunk->buffer);
+    chunk->mapped = nullptr;
+    chunk->state = ChunkState::eInFlight;
+    chunk->serial = mSubmittedSerial + 1;
+    mHasUnsubmittedChunks = true;
+  }
+}
+
+void StagingBeltWebGPU::submitted() {
+  if (!mHasUnsubmittedChunks) {
+    return;
+  }
+
+  mHasUnsubmittedChunks = false;
+  mSubmittedSerial++;
+
+  // Work done callbacks fire in submission order.
+  wgpuQueueOnSubmittedWorkDone(
+      sQueue,
+      [](WGPUQueueWorkDoneStatus status, void *userdata) {
+        if (status != WGPUQueueWorkDoneStatus_Success) {
+          sLogger->error("Staging belt submission failed {:#08x}!",
+                         static_cast<uint32_t>(status));
+        }
+
+        static_cast<StagingBeltWebGPU *>(userdata)->mCompletedSerial++;
+      },
+      this);
+}
+
+void StagingBeltWebGPU::recall() {
+  for (auto it = mChunks.begin(); it != mChunks.end();) {
+    Chunk *chunk = it->get();
+
+    if (chunk->state != ChunkState::eInFlight ||
+        chunk->serial > mCompletedSerial) {
+      ++it;
+      continue;
+    }
+
+    if (chunk->size > mChunkSize) {
+      wgpuBufferRelease(chunk->buffer);
+      it = mChunks.erase(it);
+      continue;
+    }
+
+    chunk->state = ChunkState::eMapping;
+    wgpuBufferMapAsync(
+        chunk->buffer, WGPUMapMode_Write, 0, chunk->size,
+        [](WGPUBufferMapAsyncStatus status, void *userdata) {
+          Chunk *chunk = static_cast<Chunk *>(userdata);
+
+          if (status != WGPUBufferMapAsyncStatus_Success) {
+            sLogger->error("Failed to map staging chunk {:#08x}!",
+                           static_cast<uint32_t>(status));
+            return;
+          }
+
+          chunk->mapped = static_cast<uint8_t *>(
+              wgpuBufferGetMappedRange(chunk->buffer, 0, chunk->size));
+          chunk->offset = 0;
+          chunk->state = ChunkState::eMapped;
+        },
+        chunk);
+
+    ++it;
+  }
+}
+
+void StagingBeltWebGPU::discard(WGPUBuffer dst, uint64_t offset,
+                                uint64_t size) {
+  mBufferCopies.erase(std::remove_if(mBufferCopies.begin(),
+                                     mBufferCopies.end(),
+                                     [=](const BufferCopy &copy) {
+                                       return copy.dst == dst &&
+                                              RangesOverlap(copy.dstOffset,
+                                                            copy.size, offset,
+                                                            size);
+                                     }),
+                      mBufferCopies.end());
+}
+
+void StagingBeltWebGPU::discard(WGPUTexture dst) {
+  mTextureCopies.erase(std::remove_if(mTextureCopies.begin(),
+                                      mTextureCopies.end(),
+                                      [=](const TextureCopy &copy) {
+                                        return copy.dst.texture == dst;
+                                      }),
+                       mTextureCopies.end());
+}
+
+void StagingBeltWebGPU::destroy() {
+  mBufferCopies.clear();
+  mTextureCopies.clear();
+
+  for (std::unique_ptr<Chunk> &chunk : mChunks) {
+    wgpuBufferRelease(chunk->buffer);
+  }
+  mChunks.clear();
+}
+
+void ReadbackQueueWebGPU::init(uint32_t capacity) {
+  mRequests.clear();
+  mRequests.resize(capacity);
+}
+
+ReadbackQueueWebGPU::Request *ReadbackQueueWebGPU::acquireRequest() {
+  const uint32_t capacity = static_cast<uint32_t>(mRequests.size());
+  const uint32_t first = mNextId % capacity;
+
+  // Free slots first; otherwise unclaimed results of the oldest finished
+  // request are dropped.
+  uint32_t slot = capacity;
+  for (uint32_t i = 0; i < capacity && slot == capacity; i++) {
+    if (mRequests[(first + i) % capacity].state == RequestState::eFree) {
+      slot = (first + i) % capacity;
+    }
+  }
+
+  for (uint32_t i = 0; i < capacity && slot == capacity; i++) {
+    const RequestState state = mRequests[(first + i) % capacity].state;
+    if (state == RequestState::eReady || state == RequestState::eFailed) {
+      slot = (first + i) % capacity;
+    }
+  }
+
+  if (slot == capacity) {
+    sLogger->error("Readback queue full! {} requests in flight.", capacity);
+    return nullptr;
+  }
+
+  // Ids map to their slot; skip ahead to the next id landing on it, and
+  // restart past 0 on overflow.
+  uint64_t id = static_cast<uint64_t>(mNextId) +
+                (slot + capacity - first) % capacity;
+  if (id > std::numeric_limits<uint32_t>::max()) {
+    id = slot + capacity;
+  }
+
+  Request &request = mRequests[slot];
+  request = {};
+  request.id = static_cast<uint32_t>(id);
+
+  mNextId = request.id + 1;
+  if (mNextId == 0) {
+    mNextId = 1;
+  }
+
+  return &request;
+}
+
+bool ReadbackQueueWebGPU::acquireStaging(uint64_t size, uint32_t *outIdx) {
+  uint32_t bestIdx = std::numeric_limits<uint32_t>::max();
+
+  for (uint32_t i = 0; i < mStagingBuffers.size(); i++) {
+    const StagingBuffer &staging = mStagingBuffers[i];
+    if (staging.inUse || staging.size < size) {
+      continue;
+    }
+
+    if (bestIdx == std::numeric_limits<uint32_t>::max() ||
+        staging.size < mStagingBuffers[bestIdx].size) {
+      bestIdx = i;
+    }
+  }
+
+  if (bestIdx == std::numeric_limits<uint32_t>::max()) {
+    uint64_t stagingSize = 256;
+    while (stagingSize < size) {
+      stagingSize <<= 1;
+    }
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain = nullptr;
+    bufferDesc.label = "ReadbackStaging";
+    bufferDesc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+    bufferDesc.size = stagingSize;
+    bufferDesc.mappedAtCreation = false;
+
+    WGPUBuffer buffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
+    if (!buffer) {
+      sLogger->error("Failed to create readback buffer of size {}!",
+                     stagingSize);
+      return false;
+    }
+
+    bestIdx = static_cast<uint32_t>(mStagingBuffers.size());
+    mStagingBuffers.push_back({buffer, stagingSize, false});
+  }
+
+  mStagingBuffers[bestIdx].inUse = true;
+  *outIdx = bestIdx;
+  return true;
+}
+
+void ReadbackQueueWebGPU::releaseStaging(Request &request) {
+  if (request.stagingIdx == UINT32_MAX) {
+    return;
+  }
+
+  mStagingBuffers[request.stagingIdx].inUse = false;
+  request.stagingIdx = UINT32_MAX;
+}
+
+uint32_t ReadbackQueueWebGPU::readBuffer(
+    WGPUBuffer src, uint64_t offset, uint64_t size,
+    std::function<void(const void *data)> callback) {
+  const uint64_t srcSize = wgpuBufferGetSize(src);
+  if (size == 0 && offset < srcSize) {
+    size = srcSize - offset;
+  }
+
+  if (size == 0 || offset + size > srcSize) {
+    sLogger->error("Buffer read out of bounds: offset ({}) + size ({}) "
+                   "exceeds buffer size ({}).",
+                   offset, size, srcSize);
+    return 0;
+  }
+
+  Request *request = acquireRequest();
+  if (!request) {
+    return 0;
+  }
+
+  // Copies require 4 byte aligned offsets and sizes.
+  request->src = src;
+  request->srcOffset = offset & ~uint64_t(3);
+  request->copySize = AlignUp(offset + size, 4) - request->srcOffset;
+  request->dataOffset = offset - request->srcOffset;
+  request->dataSize = size;
+  request->callback = std::move(callback);
+
+  if (!acquireStaging(request->copySize, &request->stagingIdx)) {
+    request->state = RequestState::eFailed;
+    return request->id;
+  }
+
+  request->state = RequestState::eRecorded;
+  return request->id;
+}
+
+uint32_t ReadbackQueueWebGPU::readTexture(
+    ImageHandle imgh, const WGPUOrigin3D &origin, const WGPUExtent3D &extent,
+    std::function<void(std::vector<uint8_t> &&data)> callback) {
+  Request *request = acquireRequest();
+  if (!request) {
+    return 0;
+  }
+
+  WGPUTextureFormat format;
+  WGPUExtent3D textureExtent;
+  if (!ImageGetInfo(imgh, &format, &textureExtent)) {
+    request->state = RequestState::eFailed;
+    return request->id;
+  }
+
+  const uint32_t texelSize =
+      TextureFormatGetSize(static_cast<CBZTextureFormat>(format));
+
+  request->isTexture = true;
+  request->imgh = imgh;
+  request->origin = origin;
+  request->extent = extent;
+  request->bytesPerRow = extent.width * texelSize;
+  request->alignedBytesPerRow = static_cast<uint32_t>(
+      AlignUp(request->bytesPerRow, COPY_BYTES_PER_ROW_ALIGNMENT));
+  request->copySize = static_cast<uint64_t>(request->alignedBytesPerRow) *
+                      extent.height * extent.depthOrArrayLayers;
+  request->dataSize = static_cast<uint64_t>(request->bytesPerRow) *
+                      extent.height * extent.depthOrArrayLayers;
+  request->textureCallback = std::move(callback);
+
+  if (!acquireStaging(request->copySize, &request->stagingIdx)) {
+    request->state = RequestState::eFailed;
+    return request->id;
+  }
+
+  request->state = RequestState::eRecorded;
+  return request->id;
+}
+
+void ReadbackQueueWebGPU::flush(WGPUCommandEncoder encoder) {
+  for (Request &request : mRequests) {
+    if (request.state != RequestState::eRecorded) {
+      continue;
+    }
+
+    if (request.isTexture) {
+      // Resolved late; the surface texture changes every frame.
+      WGPUImageCopyTexture src = {};
+      src.nextInChain = nullptr;
+      src.texture = sTextures[request.imgh.idx].getTexture();
+      src.mipLevel = 0;
+      src.origin = request.origin;
+      src.aspect = WGPUTextureAspect_All;
+
+      if (!src.texture) {
+        releaseStaging(request);
+        request.state = RequestState::eFailed;
+        continue;
+      }
+
+      WGPUImageCopyBuffer dst = {};
+      dst.nextInChain = nullptr;
+      dst.buffer = mStagingBuffers[request.stagingIdx].buffer;
+      dst.layout.nextInChain = nullptr;
+      dst.layout.offset = 0;
+      dst.layout.bytesPerRow = request.alignedBytesPerRow;
+      dst.layout.rowsPerImage = request.extent.height;
+
+      wgpuCommandEncoderCopyTextureToBuffer(encoder, &src, &dst,
+                                            &request.extent);
+      request.state = RequestState::eCopying;
+      continue;
+    }
+
+    wgpuCommandEncoderCopyBufferToBuffer(
+        encoder, request.src, request.srcOffset,
+        mStagingBuffers[request.stagingIdx].buffer, 0, request.copySize);
+    request.state = RequestState::eCopying;
+  }
+}
+
+void ReadbackQueueWebGPU::submitted() {
+  for (Request &request : mRequests) {
+    if (request.state != RequestState::eCopying) {
+      continue;
+    }
+
+    request.state = RequestState::eMapping;
+    wgpuBufferMapAsync(
+        mStagingBuffers[request.stagingIdx].buffer, WGPUMapMode_Read, 0,
+        request.copySize,
+        [](WGPUBufferMapAsyncStatus status, void *userdata) {
+          Request *request = static_cast<Request *>(userdata);
+
+          if (status != WGPUBufferMapAsyncStatus_Success) {
+            sLogger->error("Failed to read buffer {:#08x}!",
+                           static_cast<uint32_t>(status));
+            request->state = RequestState::eFailed;
+            return;
+          }
+
+          request->state = RequestState::eMapped;
+        },
+        &request);
+  }
+}
+
+void ReadbackQueueWebGPU::process() {
+  for (Request &request : mRequests) {
+    switch (request.state) {
+    case RequestState::eFailed: {
+      // Staging of a failed map may be reused.
+      releaseStaging(request);
+    } break;
+
+    case RequestState::eMapped: {
+      WGPUBuffer buffer = mStagingBuffers[request.stagingIdx].buffer;
+      const uint8_t *data = static_cast<const uint8_t *>(
+          wgpuBufferGetConstMappedRange(buffer, 0, request.copySize));
+
+      if (!data) {
+        wgpuBufferUnmap(buffer);
+        releaseStaging(request);
+        request.state = RequestState::eFailed;
+        break;
+      }
+
+      if (request.isTexture) {
+        // Stays mapped until the worker finished repacking.
+        std::shared_ptr<RepackJob> job = std::make_shared<RepackJob>();
+        request.repack = job;
+        request.state = RequestState::eRepacking;
+
+        const uint64_t rowCount = static_cast<uint64_t>(request.extent.height) *
+                                  request.extent.depthOrArrayLayers;
+        const uint32_t bytesPerRow = request.bytesPerRow;
+        const uint32_t alignedBytesPerRow = request.alignedBytesPerRow;
+
+        sWorkerPool.submit(
+            [job, data, rowCount, bytesPerRow, alignedBytesPerRow]() {
+              job->data.resize(rowCount * bytesPerRow);
+              for (uint64_t row = 0; row < rowCount; row++) {
+                memcpy(job->data.data() + row * bytesPerRow,
+                       data + row * alignedBytesPerRow, bytesPerRow);
+              }
+
+              job->done.store(true, std::memory_order_release);
+            });
+        break;
+      }
+
+      data += request.dataOffset;
+
+      // Callbacks may issue new reads into this slot.
+      const uint32_t stagingIdx = request.stagingIdx;
+      request.stagingIdx = UINT32_MAX;
+
+      std::function<void(const void *data)> callback =
+          std::move(request.callback);
+      if (!callback) {
+        request.result.assign(data, data + request.dataSize);
+      }
+
+      request.state = RequestState::eReady;
+      if (callback) {
+        callback(data);
+      }
+
+      wgpuBufferUnmap(buffer);
+      mStagingBuffers[stagingIdx].inUse = false;
+    } break;
+
+    case RequestState::eRepacking: {
+      if (!request.repack->done.load(std::memory_order_acquire)) {
+        break;
+      }
+
+      wgpuBufferUnmap(mStagingBuffers[request.stagingIdx].buffer);
+      releaseStaging(request);
+
+      std::shared_ptr<RepackJob> job = std::move(request.repack);
+      std::function<void(std::vector<uint8_t> &&data)> callback =
+          std::move(request.textureCallback);
+
+      request.state = RequestState::eReady;
+      if (callback) {
+        callback(std::move(job->data));
+      } else {
+        request.result = std::move(job->data);
+      }
+    } break;
+
+    default:
+      break;
+    }
+  }
+}
+
+CBZReadbackStatus ReadbackQueueWebGPU::getStatus(uint32_t id) const {
+  if (mRequests.empty()) {
+    return CBZ_READBACK_STATUS_INVALID;
+  }
+
+  const Request &request = mRequests[id % mRequests.size()];
+  if (request.id != id) {
+    return CBZ_READBACK_STATUS_INVALID;
+  }
+
+  switch (request.state) {
+  case RequestState::eFree:
+    return CBZ_READBACK_STATUS_INVALID;
+
+  case RequestState::eRecorded:
+  case RequestState::eCopying:
+  case RequestState::eMapping:
+  case RequestState::eMapped:
+  case RequestState::eRepacking:
+    return CBZ_READBACK_STATUS_PENDING;
+
+  case RequestState::eReady:
+    return CBZ_READBACK_STATUS_READY;
+
+  case RequestState::eFailed:
+    return CBZ_READBACK_STATUS_FAILED;
+  }
+
+  return CBZ_READBACK_STATUS_INVALID;
+}
+
+uint32_t ReadbackQueueWebGPU::copy(uint32_t id, void *dst, uint32_t dstSize) {
+  if (getStatus(id) != CBZ_READBACK_STATUS_READY) {
+    return 0;
+  }
+
+  Request &request = mRequests[id % mRequests.size()];
+  const uint32_t size = static_cast<uint32_t>(
+      std::min<uint64_t>(dstSize, request.result.size()));
+  memcpy(dst, request.result.data(), size);
+
+  request = {};
+  return size;
+}
+
+void ReadbackQueueWebGPU::discard(WGPUBuffer src, uint64_t offset,
+                                  uint64_t size) {
+  for (Request &request : mRequests) {
+    if (request.state == RequestState::eRecorded && !request.isTexture &&
+        request.src == src &&
+        RangesOverlap(request.srcOffset, request.copySize, offset, size)) {
+      releaseStaging(request);
+      request.callback = nullptr;
+      request.state = RequestState::eFailed;
+    }
+  }
+}
+
+void ReadbackQueueWebGPU::discard(ImageHandle src) {
+  for (Request &request : mRequests) {
+    if (request.state == RequestState::eRecorded && request.isTexture &&
+        request.imgh.idx == src.idx) {
+      releaseStaging(request);
+      request.textureCallback = nullptr;
+      request.state = RequestState::eFailed;
+    }
+  }
+}
+
+void ReadbackQueueWebGPU::destroy() {
+  for (StagingBuffer &staging : mStagingBuffers) {
+    wgpuBufferRelease(staging.buffer);
+  }
+
+  mStagingBuffers.clear();
+  mRequests.clear();
+}
+
+// Box filters 2x2 texels of the previous level into one texel of the next.
+// Odd edges clamp to the last texel.
+static const char *sMipmapWGSL = R"(
+@group(0) @binding(0) var src : texture_2d<f32>;
+@group(0) @binding(1) var dst : texture_storage_2d<{FORMAT}, write>;
+
+@compute @workgroup_size(8, 8)
+fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+  let dstSize = textureDimensions(dst);
+  if (id.x >= dstSize.x || id.y >= dstSize.y) {
+    return;
+  }
+
+  let srcMax = vec2<i32>(textureDimensions(src, 0)) - vec2<i32>(1);
+  let base = vec2<i32>(id.xy) * 2;
+
+  let c = textureLoad(src, min(base, srcMax), 0) +
+          textureLoad(src, min(base + vec2<i32>(1, 0), srcMax), 0) +
+          textureLoad(src, min(base + vec2<i32>(0, 1), srcMax), 0) +
+          textureLoad(src, min(base + vec2<i32>(1, 1), srcMax), 0);
+
+  textureStore(dst, vec2<i32>(id.xy), c * 0.25);
+}
+)";
+
+// Same filter for sRGB images, which are not storage formats. Loads decode to
+// linear and the attachment re-encodes on write.
+static const char *sMipmapRenderWGSL = R"(
+@group(0) @binding(0) var src : texture_2d<f32>;
+
+@vertex
+fn vertexMain(@builtin(vertex_index) vertexIndex : u32)
+    -> @builtin(position) vec4<f32> {
+  let uv = vec2<f32>(f32((vertexIndex << 1u) & 2u), f32(vertexIndex & 2u));
+  return vec4<f32>(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+
+@fragment
+fn fragmentMain(@builtin(position) position : vec4<f32>)
+    -> @location(0) vec4<f32> {
+  let srcMax = vec2<i32>(textureDimensions(src, 0)) - vec2<i32>(1);
+  let base = vec2<i32>(position.xy) * 2;
+
+  let c = textureLoad(src, min(base, srcMax), 0) +
+          textureLoad(src, min(base + vec2<i32>(1, 0), srcMax), 0) +
+          textureLoad(src, min(base + vec2<i32>(0, 1), srcMax), 0) +
+          textureLoad(src, min(base + vec2<i32>(1, 1), srcMax), 0);
+
+  return c * 0.25;
+}
+)";
+
+static const char *StorageFormatToWGSL(WGPUTextureFormat format) {
+  switch (format) {
+  case WGPUTextureFormat_RGBA8Unorm:
+    return "rgba8unorm";
+  case WGPUTextureFormat_RGBA16Float:
+    return "rgba16float";
+  case WGPUTextureFormat_RGBA32Float:
+    return "rgba32float";
+  case WGPUTextureFormat_R32Float:
+    return "r32float";
+  case WGPUTextureFormat_RG32Float:
+    return "rg32float";
+  default:
+    return nullptr;
+  }
+}
+
+// @returns whether mips of 'format' are downsampled in render passes.
+static bool MipmapIsRenderFormat(WGPUTextureFormat format) {
+  return format == WGPUTextureFormat_RGBA8UnormSrgb ||
+         format == WGPUTextureFormat_BGRA8UnormSrgb;
+}
+
+bool MipmapGeneratorWebGPU::IsFormatSupported(WGPUTextureFormat format) {
+  return GetUsage(format) != WGPUTextureUsage_None;
+}
+
+WGPUTextureUsageFlags
+MipmapGeneratorWebGPU::GetUsage(WGPUTextureFormat format) {
+  if (MipmapIsRenderFormat(format)) {
+    return WGPUTextureUsage_RenderAttachment;
+  }
+
+  return StorageFormatToWGSL(format) ? WGPUTextureUsage_StorageBinding
+                                     : WGPUTextureUsage_None;
+}
+
+void MipmapGeneratorWebGPU::enqueue(ImageHandle imgh) {
+  auto it = std::find_if(
+      mQueued.begin(), mQueued.end(),
+      [imgh](const ImageHandle &queued) { return queued.idx == imgh.idx; });
+
+  if (it == mQueued.end()) {
+    mQueued.push_back(imgh);
+  }
+}
+
+void MipmapGeneratorWebGPU::flush(WGPUCommandEncoder encoder) {
+  for (ImageHandle imgh : mQueued) {
+    if (imgh.idx >= sTextures.size() || !sTextures[imgh.idx].getTexture()) {
+      continue;
+    }
+
+    generate(encoder, sTextures[imgh.idx].getTexture());
+  }
+
+  mQueued.clear();
+}
+
+void MipmapGeneratorWebGPU::generate(WGPUCommandEncoder encoder,
+                                     WGPUTexture texture) {
+  const WGPUTextureFormat format = wgpuTextureGetFormat(texture);
+  const Pipeline *pipeline = findOrCreatePipeline(format);
+  if (!pipeline) {
+    return;
+  }
+
+  // Storage formats downsample every level in one compute pass; sRGB levels
+  // are each a render pass.
+  WGPUComputePassEncoder computePassEncoder = NULL;
+  if (pipeline->computePipeline) {
+    WGPUComputePassDescriptor computePassDesc = {};
+    computePassDesc.nextInChain = nullptr;
+    computePassDesc.label = "MipmapPass";
+    computePassDesc.timestampWrites = nullptr;
+
+    computePassEncoder =
+        wgpuCommandEncoderBeginComputePass(encoder, &computePassDesc);
+    wgpuComputePassEncoderSetPipeline(computePassEncoder,
+                                      pipeline->computePipeline);
+  }
+
+  const uint32_t mipLevelCount = wgpuTextureGetMipLevelCount(texture);
+  const uint32_t layerCount = wgpuTextureGetDepthOrArrayLayers(texture);
+  uint32_t width = wgpuTextureGetWidth(texture);
+  uint32_t height = wgpuTextureGetHeight(texture);
+
+  for (uint32_t mip = 1; mip < mipLevelCount; mip++) {
+    width = std::max(width >> 1, 1u);
+    height = std::max(height >> 1, 1u);
+
+    for (uint32_t layer = 0; layer < layerCount; layer++) {
+      WGPUTextureViewDescriptor viewDesc = {};
+      viewDesc.nextInChain = nullptr;
+      viewDesc.format = format;
+      viewDesc.dimension = WGPUTextureViewDimension_2D;
+      viewDesc.aspect = WGPUTextureAspect_All;
+      viewDesc.baseArrayLayer = layer;
+      viewDesc.arrayLayerCount = 1;
+      viewDesc.mipLevelCount = 1;
+
+      viewDesc.baseMipLevel = mip - 1;
+      WGPUTextureView srcView = wgpuTextureCreateView(texture, &viewDesc);
+
+      viewDesc.baseMipLevel = mip;
+      WGPUTextureView dstView = wgpuTextureCreateView(texture, &viewDesc);
+
+      std::array<WGPUBindGroupEntry, 2> entries = {};
+      entries[0].nextInChain = nullptr;
+      entries[0].binding = 0;
+      entries[0].textureView = srcView;
+
+      entries[1].nextInChain = nullptr;
+      entries[1].binding = 1;
+      entries[1].textureView = dstView;
+
+      WGPUBindGroupDescriptor bindGroupDesc = {};
+      bindGroupDesc.nextInChain = nullptr;
+      bindGroupDesc.label = nullptr;
+      bindGroupDesc.layout = pipeline->bindGroupLayout;
+      bindGroupDesc.entryCount = computePassEncoder ? 2 : 1;
+      bindGroupDesc.entries = entries.data();
+
+      WGPUBindGroup bindGroup =
+          wgpuDeviceCreateBindGroup(sDevice, &bindGroupDesc);
+
+      if (computePassEncoder) {
+        wgpuComputePassEncoderSetBindGroup(computePassEncoder, 0, bindGroup,
+                                           0, nullptr);
+        wgpuComputePassEncoderDispatchWorkgroups(
+            computePassEncoder, (width + 7) / 8, (height + 7) / 8, 1);
+      } else {
+        WGPURenderPassColorAttachment colorAttachment = {};
+        colorAttachment.nextInChain = nullptr;
+        colorAttachment.view = dstView;
+        colorAttachment.loadOp = WGPULoadOp_Clear;
+        colorAttachment.storeOp = WGPUStoreOp_Store;
+        colorAttachment.clearValue = {0.0f, 0.0f, 0.0f, 0.0f};
+
+#ifndef WEBGPU_BACKEND_WGPU
+        colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+#endif // NOT WEBGPU_BACKEND_WGPU
+
+        WGPURenderPassDescriptor renderPassDesc = {};
+        renderPassDesc.nextInChain = nullptr;
+        renderPassDesc.label = "MipmapPass";
+        renderPassDesc.colorAttachmentCount = 1;
+        renderPassDesc.colorAttachments = &colorAttachment;
+        renderPassDesc.depthStencilAttachment = nullptr;
+        renderPassDesc.occlusionQuerySet = nullptr;
+        renderPassDesc.timestampWrites = nullptr;
+
+        WGPURenderPassEncoder renderPassEncoder =
+            wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+        wgpuRenderPassEncoderSetPipeline(renderPassEncoder,
+                                         pipeline->renderPipeline);
+        wgpuRenderPassEncoderSetBindGroup(renderPassEncoder, 0, bindGroup, 0,
+                                          nullptr);
+        wgpuRenderPassEncoderDraw(renderPassEncoder, 3, 1, 0, 0);
+        wgpuRenderPassEncoderEnd(renderPassEncoder);
+        wgpuRenderPassEncoderRelease(renderPassEncoder);
+      }
+
+      mViews.push_back(srcView);
+      mViews.push_back(dstView);
+      mBindGroups.push_back(bindGroup);
+    }
+  }
+
+  if (computePassEncoder) {
+    wgpuComputePassEncoderEnd(computePassEncoder);
+    wgpuComputePassEncoderRelease(computePassEncoder);
+  }
+}
+
+const MipmapGeneratorWebGPU::Pipeline *
+MipmapGeneratorWebGPU::findOrCreatePipeline(WGPUTextureFormat format) {
+  if (auto it = mPipelines.find(static_cast<uint32_t>(format));
+      it != mPipelines.end()) {
+    return it->second.computePipeline || it->second.renderPipeline
+               ? &it->second
+               : nullptr;
+  }
+
+  // Failed formats are cached as empty pipelines.
+  Pipeline &pipeline = mPipelines[static_cast<uint32_t>(format)];
+
+  const bool render = MipmapIsRenderFormat(format);
+  const char *wgslFormat = StorageFormatToWGSL(format);
+  if (!render && !wgslFormat) {
+    sLogger->error("Mipmap generation does not support texture format {}!",
+                   static_cast<uint32_t>(format));
+    return nullptr;
+  }
+
+  std::string code = render ? sMipmapRenderWGSL : sMipmapWGSL;
+  if (!render) {
+    code.replace(code.find("{FORMAT}"), strlen("{FORMAT}"), wgslFormat);
+  }
+
+  WGPUShaderModuleWGSLDescriptor wgslCodeDesc = {};
+  wgslCodeDesc.chain.next = nullptr;
+  wgslCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+  wgslCodeDesc.code = code.c_str();
+
+  WGPUShaderModuleDescriptor shaderModuleDesc = {};
+  shaderModuleDesc.nextInChain = &wgslCodeDesc.chain;
+  shaderModuleDesc.label = "Mipmap";
+
+  pipeline.module = wgpuDeviceCreateShaderModule(sDevice, &shaderModuleDesc);
+  if (!pipeline.module) {
+    return nullptr;
+  }
+
+  std::array<WGPUBindGroupLayoutEntry, 2> entries = {};
+  entries[0].nextInChain = nullptr;
+  entries[0].binding = 0;
+  entries[0].visibility =
+      render ? WGPUShaderStage_Fragment : WGPUShaderStage_Compute;
+  entries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+  entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+  entries[0].texture.multisampled = false;
+
+  entries[1].nextInChain = nullptr;
+  entries[1].binding = 1;
+  entries[1].visibility = WGPUShaderStage_Compute;
+  entries[1].storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+  entries[1].storageTexture.format = format;
+  entries[1].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+
+  WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+  bindGroupLayoutDesc.nextInChain = nullptr;
+  bindGroupLayoutDesc.label = "Mipmap";
+  bindGroupLayoutDesc.entryCount = render ? 1 : 2;
+  bindGroupLayoutDesc.entries = entries.data();
+
+  pipeline.bindGroupLayout =
+      wgpuDeviceCreateBindGroupLayout(sDevice, &bindGroupLayoutDesc);
+
+  WGPUPipelineLayoutDescriptor pipelineLayoutDesc = {};
+  pipelineLayoutDesc.nextInChain = nullptr;
+  pipelineLayoutDesc.label = "Mipmap";
+  pipelineLayoutDesc.bindGroupLayoutCount = 1;
+  pipelineLayoutDesc.bindGroupLayouts = &pipeline.bindGroupLayout;
+
+  pipeline.pipelineLayout =
+      wgpuDeviceCreatePipelineLayout(sDevice, &pipelineLayoutDesc);
+
+  if (!render) {
+    WGPUComputePipelineDescriptor pipelineDesc = {};
+    pipelineDesc.nextInChain = nullptr;
+    pipelineDesc.label = "Mipmap";
+    pipelineDesc.layout = pipeline.pipelineLayout;
+    pipelineDesc.compute.module = pipeline.module;
+    pipelineDesc.compute.entryPoint = "main";
+
+    pipeline.computePipeline =
+        wgpuDeviceCreateComputePipeline(sDevice, &pipelineDesc);
+    return pipeline.computePipeline ? &pipeline : nullptr;
+  }
+
+  WGPURenderPipelineDescriptor pipelineDesc = {};
+  pipelineDesc.nextInChain = nullptr;
+  pipelineDesc.label = "Mipmap";
+  pipelineDesc.layout = pipeline.pipelineLayout;
+
+  pipelineDesc.vertex.nextInChain = nullptr;
+  pipelineDesc.vertex.module = pipeline.module;
+  pipelineDesc.vertex.entryPoint = "vertexMain";
+  pipelineDesc.vertex.constantCount = 0;
+  pipelineDesc.vertex.constants = nullptr;
+  pipelineDesc.vertex.bufferCount = 0;
+  pipelineDesc.vertex.buffers = nullptr;
+
+  pipelineDesc.primitive.nextInChain = nullptr;
+  pipelineDesc.primitive.topology = WGPUPrimitiveTopology_TriangleList;
+  pipelineDesc.primitive.stripIndexFormat = WGPUIndexFormat_Undefined;
+  pipelineDesc.primitive.frontFace = WGPUFrontFace_CCW;
+  pipelineDesc.primitive.cullMode = WGPUCullMode_None;
+
+  pipelineDesc.depthStencil = nullptr;
+
+  pipelineDesc.multisample.nextInChain = nullptr;
+  pipelineDesc.multisample.count = 1;
+  pipelineDesc.multisample.mask = ~0u;
+  pipelineDesc.multisample.alphaToCoverageEnabled = false;
+
+  WGPUColorTargetState colorTarget = {};
+  colorTarget.nextInChain = nullptr;
+  colorTarget.format = format;
+  colorTarget.blend = nullptr;
+  colorTarget.writeMask = WGPUColorWriteMask_All;
+
+  WGPUFragmentState fragmentState = {};
+  fragmentState.nextInChain = nullptr;
+  fragmentState.module = pipeline.module;
+  fragmentState.entryPoint = "fragmentMain";
+  fragmentState.constantCount = 0;
+  fragmentState.constants = nullptr;
+  fragmentState.targetCount = 1;
+  fragmentState.targets = &colorTarget;
+  pipelineDesc.fragment = &fragmentState;
+
+  pipeline.renderPipeline =
+      wgpuDeviceCreateRenderPipeline(sDevice, &pipelineDesc);
+  return pipeline.renderPipeline ? &pipeline : nullptr;
+}
+
+void MipmapGeneratorWebGPU::submitted() {
+  for (WGPUBindGroup bindGroup : mBindGroups) {
+    wgpuBindGroupRelease(bindGroup);
+  }
+  mBindGroups.clear();
+
+  for (WGPUTextureView view : mViews) {
+    wgpuTextureViewRelease(view);
+  }
+  mViews.clear();
+}
+
+void MipmapGeneratorWebGPU::discard(ImageHandle imgh) {
+  mQueued.erase(std::remove_if(mQueued.begin(), mQueued.end(),
+                               [imgh](const ImageHandle &queued) {
+                                 return queued.idx == imgh.idx;
+                               }),
+                mQueued.end());
+}
+
+void MipmapGeneratorWebGPU::destroy() {
+  submitted();
+
+  for (auto &it : mPipelines) {
+    Pipeline &pipeline = it.second;
+
+    if (pipeline.computePipeline) {
+      wgpuComputePipelineRelease(pipeline.computePipeline);
+    }
+
+    if (pipeline.renderPipeline) {
+      wgpuRenderPipelineRelease(pipeline.renderPipeline);
+    }
+
+    if (pipeline.pipelineLayout) {
+      wgpuPipelineLayoutRelease(pipeline.pipelineLayout);
+    }
+
+    if (pipeline.bindGroupLayout) {
+      wgpuBindGroupLayoutRelease(pipeline.bindGroupLayout);
+    }
+
+    if (pipeline.module) {
+      wgpuShaderModuleRelease(pipeline.module);
+    }
+  }
+
+  mPipelines.clear();
+  mQueued.clear();
+}
+
+void BufferPoolWebGPU::init(WGPUBufferUsageFlags usage, uint64_t blockSize,
+                            uint64_t alignment, const char *name) {
+  mUsage = usage;
+  mAlignment = std::max<uint64_t>(alignment, 4);
+  mBlockSize = blockSize & ~(mAlignment - 1);
+  mName = name;
+}
+
+Result BufferPoolWebGPU::allocate(uint64_t size, Allocation *allocation,
+                                  WGPUBufferUsageFlags usage, bool dedicated) {
+  // Copies and bindings require sizes in multiples of 4.
+  size = AlignUp(size, 4);
+  if (size == 0) {
+    sLogger->error("Cannot allocate {} range of size 0!", mName);
+    return Result::eWGPUError;
+  }
+
+  dedicated = dedicated || size > mBlockSize || (usage & ~mUsage) != 0;
+
+  uint32_t blockIdx = UINT32_MAX;
+  uint32_t node = TLSFAllocator::INVALID_NODE;
+  uint64_t offset = 0;
+
+  if (!dedicated) {
+    for (uint32_t idx = 0; idx < mBlocks.size(); idx++) {
+      Block &block = mBlocks[idx];
+      if (!block.buffer || block.dedicated) {
+        continue;
+      }
+
+      node = block.allocator.allocate(size, &offset);
+      if (node != TLSFAllocator::INVALID_NODE) {
+        blockIdx = idx;
+        break;
+      }
+    }
+  }
+
+  if (blockIdx == UINT32_MAX) {
+    blockIdx = createBlock(dedicated ? size : mBlockSize, mUsage | usage,
+                           dedicated);
+    if (blockIdx == UINT32_MAX) {
+      return Result::eWGPUError;
+    }
+
+    node = mBlocks[blockIdx].allocator.allocate(size, &offset);
+  }
+
+  allocation->buffer = mBlocks[blockIdx].buffer;
+  allocation->offset = offset;
+  allocation->size = size;
+  allocation->block = blockIdx;
+  allocation->node = node;
+  return Result::eSuccess;
+}
+
+void BufferPoolWebGPU::free(Allocation &allocation) {
+  if (allocation.block >= mBlocks.size() ||
+      !mBlocks[allocation.block].buffer) {
+    return;
+  }
+
+  // Pending transfers must not land in whatever reuses the range.
+  sStagingBelt.discard(allocation.buffer, allocation.offset, allocation.size);
+  sReadbackQueue.discard(allocation.buffer, allocation.offset,
+                         allocation.size);
+
+  Block &block = mBlocks[allocation.block];
+  block.allocator.free(allocation.node);
+
+  if (block.allocator.empty()) {
+    // Keep one shared block to avoid churn when buffers are recreated.
+    uint32_t sharedBlockCount = 0;
+    for (const Block &other : mBlocks) {
+      sharedBlockCount += other.buffer && !other.dedicated ? 1 : 0;
+    }
+
+    if (block.dedicated || sharedBlockCount > 1) {
+      releaseBlock(allocation.block);
+    }
+  }
+
+  allocation = {};
+}
+
+void BufferPoolWebGPU::destroy() {
+  for (uint32_t blockIdx = 0; blockIdx < mBlocks.size(); blockIdx++) {
+    if (mBlocks[blockIdx].buffer) {
+      releaseBlock(blockIdx);
+    }
+  }
+
+  mBlocks.clear();
+  mUnusedBlocks.clear();
+}
+
+BufferPoolStats BufferPoolWebGPU::getStats() const {
+  BufferPoolStats stats = {};
+  uint64_t freeBytes = 0;
+
+  for (const Block &block : mBlocks) {
+    if (!block.buffer) {
+      continue;
+    }
+
+    const uint64_t capacity = block.allocator.getCapacity();
+    stats.reservedBytes += capacity;
+    stats.allocatedBytes += capacity - block.allocator.getFreeBytes();
+    stats.largestFreeRange = std::max(stats.largestFreeRange,
+                                      block.allocator.getLargestFreeRange());
+    stats.blockCount++;
+    stats.allocationCount += block.allocator.getAllocationCount();
+    freeBytes += block.allocator.getFreeBytes();
+  }
+
+  if (freeBytes > 0) {
+    stats.fragmentation =
+        1.0f - static_cast<float>(static_cast<double>(stats.largestFreeRange) /
+                                  static_cast<double>(freeBytes));
+  }
+
+  return stats;
+}
+
+uint32_t BufferPoolWebGPU::createBlock(uint64_t size,
+                                       WGPUBufferUsageFlags usage,
+                                       bool dedicated) {
+  size = AlignUp(size, mAlignment);
+  if (size > sLimits.maxBufferSize) {
+    sLogger->error("Cannot create {} block with size > maxBufferSize({})!",
+                   mName, sLimits.maxBufferSize);
+    return UINT32_MAX;
+  }
+
+  WGPUBufferDescriptor bufferDesc = {};
+  bufferDesc.nextInChain = nullptr;
+  bufferDesc.label = mName.c_str();
+  bufferDesc.usage = usage;
+  bufferDesc.size = size;
+  bufferDesc.mappedAtCreation = false;
+
+  WGPUBuffer buffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
+  if (!buffer) {
+    sLogger->error("Failed to create {} block!", mName);
+    return UINT32_MAX;
+  }
+
+  uint32_t blockIdx;
+  if (!mUnusedBlocks.empty()) {
+    blockIdx = mUnusedBlocks.back();
+    mUnusedBlocks.pop_back();
+  } else {
+    blockIdx = static_cast<uint32_t>(mBlocks.size());
+    mBlocks.emplace_back();
+  }
+
+  Block &block = mBlocks[blockIdx];
+  block.buffer = buffer;
+  block.dedicated = dedicated;
+  block.allocator.init(size, mAlignment);
+  return blockIdx;
+}
+
+void BufferPoolWebGPU::releaseBlock(uint32_t blockIdx) {
+  Block &block = mBlocks[blockIdx];
+
+  sStagingBelt.discard(block.buffer);
+  sReadbackQueue.discard(block.buffer);
+  wgpuBufferDestroy(block.buffer);
+  wgpuBufferRelease(block.buffer);
+
+  block.buffer = NULL;
+  block.dedicated = false;
+  mUnusedBlocks.push_back(blockIdx);
+}
+
+Result VertexBufferWebGPU::create(const VertexLayout &vertexLayout,
+                                  uint32_t count, const void *data,
+                                  const std::string &name) {
+  mVertexLayout = vertexLayout;
 
   uint32_t size = count *= mVertexLayout.stride;
 
-  if (size <= 0) {
-    sLogger->error("Cannot create vertex buffer with size 0!");
-    return Result::eWGPUError;
+  if (size <= 0) {
+    sLogger->error("Cannot create vertex buffer with size 0!");
+    return Result::eWGPUError;
+  }
+
+  if (size > sLimits.maxBufferSize) {
+    sLogger->error("Cannot create vertex buffer with size > maxBufferSize({})!",
+                   sLimits.maxBufferSize);
+    return Result::eWGPUError;
+  }
+
+  mVertexCount = size / vertexLayout.stride;
+  if (mVertexCount * vertexLayout.stride != size) {
+    sLogger->warn("VertexBuffer size and layout do not match!");
+  }
+
+  if (sBufferPools[CBZ_BUFFER_POOL_VERTEX].allocate(size, &mAllocation) !=
+      Result::eSuccess) {
+    spdlog::error("Failed to create VertexBuffer '{}'!", name);
+    return Result::eWGPUError;
+  }
+
+  if (data) {
+    sStagingBelt.writeBuffer(mAllocation.buffer, mAllocation.offset, data,
+                             size);
+  }
+
+  return Result::eSuccess;
+};
+
+void VertexBufferWebGPU::update(const void *data, uint32_t elementCount,
+                                uint32_t elementOffset) {
+  const uint64_t size =
+      static_cast<uint64_t>(elementCount) * mVertexLayout.stride;
+  const uint64_t offset =
+      static_cast<uint64_t>(elementOffset) * mVertexLayout.stride;
+
+  // The allocation is padded; only the requested vertices are addressable.
+  const uint64_t bufferSize =
+      static_cast<uint64_t>(mVertexCount) * mVertexLayout.stride;
+  if (offset + size > bufferSize) {
+    sLogger->error("Vertex buffer update out of bounds: offset ({}) + size "
+                   "({}) exceeds buffer size ({}).",
+                   offset, size, bufferSize);
+    return;
+  }
+
+  if (data) {
+    sStagingBelt.writeBuffer(mAllocation.buffer, mAllocation.offset + offset,
+                             data, size);
+  }
+}
+
+Result VertexBufferWebGPU::bind(WGPURenderPassEncoder renderPassEncoder,
+                                uint32_t slot) const {
+  wgpuRenderPassEncoderSetVertexBuffer(renderPassEncoder, slot,
+                                       mAllocation.buffer, mAllocation.offset,
+                                       mAllocation.size);
+
+  return Result::eSuccess;
+}
+
+Result VertexBufferWebGPU::bind(WGPURenderBundleEncoder bundleEncoder,
+                                uint32_t slot) const {
+  wgpuRenderBundleEncoderSetVertexBuffer(bundleEncoder, slot,
+                                         mAllocation.buffer, mAllocation.offset,
+                                         mAllocation.size);
+
+  return Result::eSuccess;
+}
+
+void VertexBufferWebGPU::destroy() {
+  if (!mAllocation.buffer) {
+    spdlog::warn("Attempting to destroy invalid vertex buffer");
+    return;
+  }
+
+  sBufferPools[CBZ_BUFFER_POOL_VERTEX].free(mAllocation);
+}
+
+Result IndexBufferWebGPU::create(WGPUIndexFormat format, uint32_t count,
+                                 const void *data, const std::string &name) {
+  const uint32_t size =
+      IndexFormatGetSize(static_cast<WGPUIndexFormat>(format)) * count;
+
+  if (size <= 0) {
+    sLogger->error("Cannot create index buffer with size 0!");
+    return Result::eWGPUError;
+  }
+
+  if (size > sLimits.maxBufferSize) {
+    sLogger->error("Cannot create index buffer with size > maxBufferSize({})!",
+                   sLimits.maxBufferSize);
+    return Result::eWGPUError;
+  }
+
+  mIndexCount = size / IndexFormatGetSize(format);
+  if (mIndexCount * IndexFormatGetSize(format) != size) {
+    sLogger->warn("Index size and format do not match!");
+  }
+  mFormat = format;
+
+  if (sBufferPools[CBZ_BUFFER_POOL_INDEX].allocate(size, &mAllocation) !=
+      Result::eSuccess) {
+    spdlog::error("Failed to create IndexBuffer '{}'!", name);
+    return Result::eWGPUError;
+  }
+
+  if (data) {
+    sStagingBelt.writeBuffer(mAllocation.buffer, mAllocation.offset, data,
+                             size);
+  }
+
+  return Result::eSuccess;
+}
+
+Result IndexBufferWebGPU::bind(WGPURenderPassEncoder renderPassEncoder) const {
+  wgpuRenderPassEncoderSetIndexBuffer(renderPassEncoder, mAllocation.buffer,
+                                      mFormat, mAllocation.offset,
+                                      mAllocation.size);
+
+  return Result::eSuccess;
+}
+
+Result IndexBufferWebGPU::bind(WGPURenderBundleEncoder bundleEncoder) const {
+  wgpuRenderBundleEncoderSetIndexBuffer(bundleEncoder, mAllocation.buffer,
+                                        mFormat, mAllocation.offset,
+                                        mAllocation.size);
+
+  return Result::eSuccess;
+}
+
+void IndexBufferWebGPU::destroy() {
+  if (!mAllocation.buffer) {
+    spdlog::warn("Attempting to destroy invalid index buffer");
+    return;
+  }
+
+  sBufferPools[CBZ_BUFFER_POOL_INDEX].free(mAllocation);
+}
+
+[[nodiscard]] Result UniformBufferWebWGPU::create(CBZUniformType type,
+                                                  uint16_t num,
+                                                  const void *data,
+                                                  const std::string &name) {
+  mElementType = type;
+  mElementCount = num;
+  uint32_t size = UniformTypeGetSize(mElementType) * mElementCount;
+
+  if (size <= 0) {
+    sLogger->error("Cannot create uniform '{}' buffer with size 0!", name);
+    return Result::eWGPUError;
+  }
+
+  if (size > sLimits.maxUniformBufferBindingSize) {
+    sLogger->error("Cannot create uniform buffer with size > "
+                   "maxUniformBufferBindingSize({})!",
+                   sLimits.maxBufferSize);
+    return Result::eWGPUError;
+  }
+
+  WGPUBufferDescriptor bufferDesc = {};
+  bufferDesc.nextInChain = nullptr;
+  bufferDesc.label = name.c_str();
+  bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+  bufferDesc.size = (size + 3) & ~3; // Pad to multiple of 4
+  bufferDesc.mappedAtCreation = data != nullptr;
+
+  mBuffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
+  if (!mBuffer) {
+    spdlog::error("Failed to create Uniform buffer!");
+    return Result::eWGPUError;
+  }
+
+  if (data) {
+    MappedBufferWrite(mBuffer, data, size);
+  }
+
+  return Result::eSuccess;
+}
+
+void UniformBufferWebWGPU::update(const void *data, uint16_t num) {
+  uint32_t size = UniformTypeGetSize(mElementType) * num;
+
+  if (num == 0) {
+    size = UniformTypeGetSize(mElementType) * mElementCount;
+  }
+
+  sStagingBelt.writeBuffer(mBuffer, 0, data, size);
+}
+
+void UniformBufferWebWGPU::destroy() {
+  if (!mBuffer) {
+    spdlog::warn("Attempting to destroy invalid uniform buffer");
+    return;
+  }
+
+  sStagingBelt.discard(mBuffer);
+  wgpuBufferDestroy(mBuffer);
+  mBuffer = NULL;
+}
+
+Result StorageBufferWebWGPU::create(CBZUniformType type, uint32_t elementCount,
+                                    const void *data,
+                                    WGPUBufferUsageFlags usage,
+                                    bool readOnly, const std::string &name) {
+  mElementType = type;
+  mElementCount = elementCount;
+  mReadOnly = readOnly;
+  uint32_t size = UniformTypeGetSize(mElementType) * mElementCount;
+
+  if (size <= 0) {
+    sLogger->error("Cannot create uniform '{}' buffer with size 0!", name);
+    return Result::eWGPUError;
+  }
+
+  if (size > sLimits.maxStorageBufferBindingSize) {
+    sLogger->error("Cannot create uniform buffer with size > "
+                   "maxStorageBufferBindingSize({})!",
+                   sLimits.maxBufferSize);
+    return Result::eWGPUError;
+  }
+
+  if (sBufferPools[CBZ_BUFFER_POOL_STORAGE].allocate(size, &mAllocation, usage,
+                                                    !readOnly) !=
+      Result::eSuccess) {
+    spdlog::error("Failed to create storage buffer '{}'!", name);
+    return Result::eWGPUError;
+  }
+
+  if (data) {
+    sStagingBelt.writeBuffer(mAllocation.buffer, mAllocation.offset, data,
+                             size);
+  }
+
+  return Result::eSuccess;
+}
+
+void StorageBufferWebWGPU::update(const void *data, uint32_t elementCount,
+                                  uint32_t elementOffset) {
+  uint32_t size = UniformTypeGetSize(mElementType) * elementCount;
+
+  // 0 is considered whole size;
+  if (elementCount == 0) {
+    size = UniformTypeGetSize(mElementType) * mElementCount;
+  }
+
+  uint64_t offset = UniformTypeGetSize(mElementType) * elementOffset;
+
+  if (size + offset > getSize()) {
+    sLogger->error("Buffer update out of bounds: offset ({}) + size ({}) "
+                   "exceeds buffer size ({}).",
+                   offset, size, getSize());
+    return;
+  }
+
+  sStagingBelt.writeBuffer(mAllocation.buffer, mAllocation.offset + offset,
+                           data, size);
+}
+
+void StorageBufferWebWGPU::destroy() {
+  if (!mAllocation.buffer) {
+    spdlog::warn("Attempting to destroy invalid storage buffer!");
+    return;
+  }
+
+  sBufferPools[CBZ_BUFFER_POOL_STORAGE].free(mAllocation);
+}
+
+Result TextureWebGPU::create(uint32_t w, uint32_t h, uint32_t depth,
+                             WGPUTextureDimension dimension,
+                             WGPUTextureFormat format,
+                             WGPUTextureUsageFlags usage,
+                             uint32_t mipLevelCount,
+                             const std::string &name, uint32_t sampleCount) {
+  WGPUTextureDescriptor textDesc = {};
+  textDesc.nextInChain = nullptr;
+  textDesc.label = name.c_str();
+
+  textDesc.usage =
+      sampleCount > 1
+          ? WGPUTextureUsage_RenderAttachment | usage
+          : WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding | usage;
+  textDesc.dimension = dimension;
+  textDesc.size.width = w;
+  textDesc.size.height = h;
+  textDesc.size.depthOrArrayLayers = depth;
+  textDesc.format = format;
+  textDesc.mipLevelCount = mipLevelCount;
+  textDesc.sampleCount = sampleCount;
+  textDesc.viewFormatCount = 0;
+  textDesc.viewFormats = nullptr;
+
+  mTexture = wgpuDeviceCreateTexture(sDevice, &textDesc);
+  return Result::eSuccess;
+}
+
+Result TextureWebGPU::create(WGPUTexture texture) {
+  mTexture = texture;
+  return Result::eSuccess;
+}
+
+TextureWebGPU::MipCopyLayout
+TextureWebGPU::getMipCopyLayout(uint32_t mipLevel) const {
+  const CBZTextureFormat format = static_cast<CBZTextureFormat>(getFormat());
+  const uint32_t blockWidth = TextureFormatGetBlockWidth(format);
+  const uint32_t blockHeight = TextureFormatGetBlockHeight(format);
+
+  const uint32_t width =
+      std::max(wgpuTextureGetWidth(mTexture) >> mipLevel, 1u);
+  const uint32_t height =
+      std::max(wgpuTextureGetHeight(mTexture) >> mipLevel, 1u);
+  uint32_t depth = wgpuTextureGetDepthOrArrayLayers(mTexture);
+  if (wgpuTextureGetDimension(mTexture) == WGPUTextureDimension_3D) {
+    depth = std::max(depth >> mipLevel, 1u);
+  }
+
+  const uint32_t blocksPerRow = (width + blockWidth - 1) / blockWidth;
+
+  MipCopyLayout layout = {};
+  layout.bytesPerRow = blocksPerRow * TextureFormatGetSize(format);
+  layout.rowsPerImage = (height + blockHeight - 1) / blockHeight;
+  layout.extent = {blocksPerRow * blockWidth, layout.rowsPerImage * blockHeight,
+                   depth};
+  return layout;
+}
+
+void TextureWebGPU::update(const void *data, uint32_t mipLevel) {
+  const MipCopyLayout layout = getMipCopyLayout(mipLevel);
+
+  WGPUImageCopyTexture destination = {};
+  destination.nextInChain = nullptr;
+  destination.texture = mTexture;
+  destination.mipLevel = mipLevel;
+  destination.origin = {0, 0, 0};
+
+  switch (getFormat()) {
+  case WGPUTextureFormat_Depth16Unorm:
+  case WGPUTextureFormat_Depth24Plus:
+  case WGPUTextureFormat_Depth24PlusStencil8:
+  case WGPUTextureFormat_Depth32Float:
+  case WGPUTextureFormat_Depth32FloatStencil8: {
+    destination.aspect = WGPUTextureAspect_DepthOnly;
+  } break;
+  default: {
+    destination.aspect = WGPUTextureAspect_All;
+  } break;
+  }
+  destination.aspect = WGPUTextureAspect_All;
+
+  sStagingBelt.writeTexture(destination, data, layout.bytesPerRow,
+                            layout.rowsPerImage, layout.extent);
+}
+
+WGPUTextureView TextureWebGPU::findOrCreateTextureView(
+    WGPUTextureAspect aspect, uint32_t baseArrayLayer, uint32_t arrayLayerCount,
+    CBZTextureViewDimension viewDimension, uint32_t baseMipLevel,
+    uint32_t mipLevelCount) {
+  // Clamp the requested mip range to the chain; 0 selects the remaining
+  // levels.
+  const uint32_t textureMipLevelCount = getMipLevelCount();
+  baseMipLevel = std::min(baseMipLevel, textureMipLevelCount - 1);
+  if (mipLevelCount == 0 ||
+      baseMipLevel + mipLevelCount > textureMipLevelCount) {
+    mipLevelCount = textureMipLevelCount - baseMipLevel;
+  }
+
+  uint32_t textureViewKey[]{static_cast<uint32_t>(aspect),
+                            baseArrayLayer,
+                            arrayLayerCount,
+                            static_cast<uint32_t>(viewDimension),
+                            baseMipLevel,
+                            mipLevelCount};
+  uint32_t textureViewHash;
+  MurmurHash3_x86_32(textureViewKey, sizeof(textureViewKey), 0,
+                     &textureViewHash);
+
+  if (mViews.find(textureViewHash) != mViews.end()) {
+    return mViews[textureViewHash];
+  }
+
+  WGPUTextureViewDescriptor textureView = {};
+  textureView.nextInChain = nullptr;
+
+  textureView.format = wgpuTextureGetFormat(mTexture);
+
+  textureView.aspect = aspect;
+
+  switch (viewDimension) {
+  case CBZ_TEXTURE_VIEW_DIMENSION_2D:
+    textureView.dimension = WGPUTextureViewDimension_2D;
+    break;
+  case CBZ_TEXTURE_VIEW_DIMENSION_CUBE:
+    textureView.dimension = WGPUTextureViewDimension_Cube;
+    break;
+  }
+  textureView.baseMipLevel = baseMipLevel;
+  textureView.mipLevelCount = mipLevelCount;
+  textureView.baseArrayLayer = baseArrayLayer;
+  textureView.arrayLayerCount = arrayLayerCount;
+  textureView.aspect = aspect;
+
+  return mViews[textureViewHash] =
+             wgpuTextureCreateView(mTexture, &textureView);
+}
+
+void TextureWebGPU::destroyTextureViews() {
+  for (auto it : mViews) {
+    WGPUTextureView view = it.second;
+    wgpuTextureViewRelease(view);
+  }
+}
+
+void TextureWebGPU::destroy() {
+  if (!mTexture) {
+    sLogger->warn("Attempting to release uninitialized texture!");
+    return;
+  }
+
+  destroyTextureViews();
+
+  sStagingBelt.discard(mTexture);
+  wgpuTextureRelease(mTexture);
+  mTexture = NULL;
+}
+
+void TextureStreamerWebGPU::init(uint64_t budget) { mBudget = budget; }
+
+Result TextureStreamerWebGPU::create(ImageHandle imgh, const std::string &path,
+                                     WGPUTextureUsageFlags usage) {
+  StreamedImage image = {};
+  image.path = path;
+  image.usage = usage | WGPUTextureUsage_CopySrc;
+
+  if (KTX2LoadHeader(path, &image.source) != Result::eSuccess) {
+    return Result::eFailure;
+  }
+
+  if (!TextureFormatIsSupported(image.source.format)) {
+    sLogger->error("'{}' format {} is not supported by the device!", path,
+                   static_cast<uint32_t>(image.source.format));
+    return Result::eFailure;
+  }
+
+  const uint32_t levelCount =
+      static_cast<uint32_t>(image.source.levels.size());
+
+  image.lowestBase = 0;
+  while (image.lowestBase + 1 < levelCount &&
+         std::max(image.source.width >> image.lowestBase,
+                  image.source.height >> image.lowestBase) >
+             STREAMING_RESIDENT_SIZE) {
+    image.lowestBase++;
+  }
+
+  // The full chain is allocated once so the image keeps its size; bindings
+  // are clamped to the resident levels.
+  TextureWebGPU texture;
+  if (texture.create(image.source.width, image.source.height,
+                     image.source.layerCount, WGPUTextureDimension_2D,
+                     static_cast<WGPUTextureFormat>(image.source.format),
+                     image.usage, levelCount, path) != Result::eSuccess ||
+      !texture.getTexture()) {
+    return Result::eFailure;
+  }
+
+  // Lowest levels are small; load them before the image is first used.
+  std::vector<uint8_t> data;
+  for (uint32_t level = image.lowestBase; level < levelCount; level++) {
+    if (KTX2LoadLevel(path, image.source.levels[level], &data) !=
+        Result::eSuccess) {
+      texture.destroy();
+      return Result::eFailure;
+    }
+
+    texture.update(data.data(), level);
+  }
+
+  image.residentBase = image.lowestBase;
+  image.loadedBase = image.lowestBase;
+  image.targetBase = image.lowestBase;
+  mResidentBytes += getResidentSize(image, image.residentBase);
+
+  sTextures[imgh.idx] = texture;
+  mImages[imgh.idx] = std::move(image);
+  return Result::eSuccess;
+}
+
+void TextureStreamerWebGPU::setPriority(ImageHandle imgh, float priority) {
+  auto it = mImages.find(imgh.idx);
+  if (it == mImages.end()) {
+    sLogger->warn("Image '{}' is not streamed!",
+                  HandleProvider<ImageHandle>::getName(imgh));
+    return;
+  }
+
+  it->second.priority = priority;
+}
+
+void TextureStreamerWebGPU::use(ImageHandle imgh, float coverage) {
+  auto it = mImages.find(imgh.idx);
+  if (it == mImages.end()) {
+    return;
+  }
+
+  StreamedImage &image = it->second;
+
+  // Unknown coverage requests the full resolution.
+  coverage = coverage < 0.0f ? 1.0f : coverage;
+  if (image.lastUsedFrame != mFrame || image.coverage < 0.0f) {
+    image.coverage = coverage;
+  } else {
+    image.coverage = std::max(image.coverage, coverage);
+  }
+
+  image.lastUsedFrame = mFrame;
+}
+
+float TextureStreamerWebGPU::getPriority(const StreamedImage &image) const {
+  if (image.priority >= 0.0f) {
+    return image.priority;
+  }
+
+  if (image.coverage < 0.0f ||
+      mFrame - image.lastUsedFrame > STREAMING_IDLE_FRAMES) {
+    return 0.0f;
+  }
+
+  return image.coverage;
+}
+
+uint32_t
+TextureStreamerWebGPU::getTargetBase(const StreamedImage &image) const {
+  const bool idle = image.coverage < 0.0f ||
+                    mFrame - image.lastUsedFrame > STREAMING_IDLE_FRAMES;
+
+  // Idle images keep the levels their explicit priority asks for, read as a
+  // screen fraction like coverage.
+  float coverage = image.coverage;
+  if (idle) {
+    if (image.priority <= 0.0f) {
+      return image.lowestBase;
+    }
+
+    coverage = image.priority;
+  }
+
+  // Highest level whose texels still cover the pixels drawn.
+  const WGPUExtent3D surfaceExtent = sSwapchain.getExtent();
+  const float pixels = coverage *
+                       static_cast<float>(surfaceExtent.width) *
+                       static_cast<float>(surfaceExtent.height);
+
+  uint32_t base = 0;
+  while (base < image.lowestBase) {
+    const float texels =
+        static_cast<float>(std::max(image.source.width >> (base + 1), 1u)) *
+        static_cast<float>(std::max(image.source.height >> (base + 1), 1u));
+
+    if (texels < pixels) {
+      break;
+    }
+
+    base++;
+  }
+
+  return base;
+}
+
+uint64_t TextureStreamerWebGPU::getResidentSize(const StreamedImage &image,
+                                                uint32_t base) const {
+  const CBZTextureFormat format = image.source.format;
+  const uint32_t blockWidth = TextureFormatGetBlockWidth(format);
+  const uint32_t blockHeight = TextureFormatGetBlockHeight(format);
+
+  uint64_t size = 0;
+  for (uint32_t level = base; level < image.source.levels.size(); level++) {
+    const uint64_t blocksX =
+        (std::max(image.source.width >> level, 1u) + blockWidth - 1) /
+        blockWidth;
+    const uint64_t blocksY =
+        (std::max(image.source.height >> level, 1u) + blockHeight - 1) /
+        blockHeight;
+
+    size += blocksX * blocksY * TextureFormatGetSize(format) *
+            image.source.layerCount;
+  }
+
+  return size;
+}
+
+void TextureStreamerWebGPU::clampView(ImageHandle imgh,
+                                      uint32_t *baseMipLevel,
+                                      uint32_t *mipLevelCount) const {
+  auto it = mImages.find(imgh.idx);
+  if (it == mImages.end() || *baseMipLevel >= it->second.residentBase) {
+    return;
+  }
+
+  // Levels above the resident base are not loaded; keep the view's last level
+  // and start at the resident base.
+  const uint32_t residentBase = it->second.residentBase;
+  if (*mipLevelCount != 0) {
+    *mipLevelCount =
+        std::max(*baseMipLevel + *mipLevelCount, residentBase + 1) -
+        residentBase;
+  }
+  *baseMipLevel = residentBase;
+}
+
+void TextureStreamerWebGPU::flush() {
+  // Budget lowered since the last frame.
+  if (mResidentBytes > mBudget) {
+    makeRoom(0, std::numeric_limits<float>::max(), UINT32_MAX);
+  }
+
+  for (auto &[imgIdx, image] : mImages) {
+    if (!image.load || !image.load->done.load(std::memory_order_acquire)) {
+      continue;
+    }
+
+    std::shared_ptr<LevelLoad> load = std::move(image.load);
+    mLoadsInFlight--;
+
+    // Stale if residency changed while loading.
+    if (load->failed || load->level + 1 != image.residentBase) {
+      continue;
+    }
+
+    image.targetBase = getTargetBase(image);
+    if (load->level < image.targetBase) {
+      continue;
+    }
+
+    const uint64_t bytes = getResidentSize(image, load->level) -
+                           getResidentSize(image, image.residentBase);
+    if (!makeRoom(bytes, getPriority(image), imgIdx)) {
+      continue;
+    }
+
+    sTextures[imgIdx].update(load->data.data(), load->level);
+    image.loadedBase = load->level;
+    setResidentBase(imgIdx, image, load->level);
+    mLevelsLoaded++;
+  }
+
+  std::vector<std::pair<float, uint32_t>> candidates;
+  for (auto &[imgIdx, image] : mImages) {
+    image.targetBase = getTargetBase(image);
+    if (!image.load && image.targetBase < image.residentBase) {
+      candidates.push_back({getPriority(image), imgIdx});
+    }
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  for (const auto &[priority, imgIdx] : candidates) {
+    if (mLoadsInFlight >= MAX_STREAMING_LOADS_IN_FLIGHT) {
+      break;
+    }
+
+    StreamedImage &image = mImages[imgIdx];
+
+    // Evicted levels keep their contents and are bound again without a load.
+    if (image.loadedBase < image.residentBase) {
+      const uint32_t base = std::max(image.loadedBase, image.targetBase);
+      const uint64_t bytes = getResidentSize(image, base) -
+                             getResidentSize(image, image.residentBase);
+      if (makeRoom(bytes, priority, imgIdx)) {
+        setResidentBase(imgIdx, image, base);
+      }
+      continue;
+    }
+
+    // One level at a time; each load becomes resident before the next.
+    std::shared_ptr<LevelLoad> load = std::make_shared<LevelLoad>();
+    load->level = image.residentBase - 1;
+    image.load = load;
+    mLoadsInFlight++;
+
+    sWorkerPool.submit(
+        [load, path = image.path, level = image.source.levels[load->level]]() {
+          load->failed =
+              KTX2LoadLevel(path, level, &load->data) != Result::eSuccess;
+          load->done.store(true, std::memory_order_release);
+        });
+  }
+
+  mFrame++;
+}
+
+bool TextureStreamerWebGPU::makeRoom(uint64_t bytes, float priority,
+                                     uint32_t requester) {
+  if (mResidentBytes + bytes <= mBudget) {
+    return true;
+  }
+
+  std::vector<std::pair<float, uint32_t>> victims;
+  for (const auto &[imgIdx, image] : mImages) {
+    const float victimPriority = getPriority(image);
+    if (imgIdx != requester && image.residentBase < image.lowestBase &&
+        victimPriority < priority) {
+      victims.push_back({victimPriority, imgIdx});
+    }
+  }
+
+  std::sort(victims.begin(), victims.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  for (const auto &[victimPriority, imgIdx] : victims) {
+    if (mResidentBytes + bytes <= mBudget) {
+      break;
+    }
+
+    StreamedImage &image = mImages[imgIdx];
+    const uint64_t residentSize = getResidentSize(image, image.residentBase);
+
+    uint32_t base = image.residentBase;
+    while (base < image.lowestBase &&
+           mResidentBytes - residentSize + getResidentSize(image, base) +
+                   bytes >
+               mBudget) {
+      base++;
+    }
+
+    mLevelsEvicted += base - image.residentBase;
+    setResidentBase(imgIdx, image, base);
+  }
+
+  return mResidentBytes + bytes <= mBudget;
+}
+
+void TextureStreamerWebGPU::setResidentBase(uint32_t imgIdx,
+                                            StreamedImage &image,
+                                            uint32_t base) {
+  mResidentBytes = mResidentBytes -
+                   getResidentSize(image, image.residentBase) +
+                   getResidentSize(image, base);
+  image.residentBase = base;
+
+  // Bound views are clamped to the previous base.
+  InvalidateBindGroups(ImageHandle{static_cast<uint16_t>(imgIdx)});
+}
+
+void TextureStreamerWebGPU::discard(ImageHandle imgh) {
+  auto it = mImages.find(imgh.idx);
+  if (it == mImages.end()) {
+    return;
+  }
+
+  // A pending load finishes on its worker and is dropped.
+  if (it->second.load) {
+    mLoadsInFlight--;
+  }
+
+  mResidentBytes -= getResidentSize(it->second, it->second.residentBase);
+  mImages.erase(it);
+}
+
+void TextureStreamerWebGPU::destroy() {
+  mImages.clear();
+  mResidentBytes = 0;
+  mLoadsInFlight = 0;
+}
+
+TextureStreamingStats TextureStreamerWebGPU::getStats() const {
+  TextureStreamingStats stats = {};
+  stats.residentBytes = mResidentBytes;
+  stats.budgetBytes = mBudget;
+  stats.streamedImages = static_cast<uint32_t>(mImages.size());
+  stats.loadsInFlight = mLoadsInFlight;
+  stats.levelsLoaded = mLevelsLoaded;
+  stats.levelsEvicted = mLevelsEvicted;
+  return stats;
+}
+
+Result SwapchainWebGPU::init(WGPUSurface surface, WGPUAdapter adapter,
+                             void *nwh, const InitDesc &initDesc) {
+  mSurface = surface;
+  mWindow = nwh;
+  mFormat = WGPUTextureFormat_BGRA8UnormSrgb;
+  mMaxFramesInFlight = std::clamp<uint32_t>(initDesc.maxFramesInFlight, 1,
+                                            MAX_FRAMES_IN_FLIGHT);
+
+#ifdef WEBGPU_BACKEND_WGPU
+  WGPUSurfaceCapabilities capabilities = {};
+  wgpuSurfaceGetCapabilities(mSurface, adapter, &capabilities);
+  mSupportedPresentModes.assign(capabilities.presentModes,
+                                capabilities.presentModes +
+                                    capabilities.presentModeCount);
+  wgpuSurfaceCapabilitiesFreeMembers(capabilities);
+#else
+  (void)adapter;
+  mSupportedPresentModes = {WGPUPresentMode_Fifo};
+#endif
+
+  setPresentMode(initDesc.presentMode);
+
+  int fbWidth, fbHeight;
+  glfwGetFramebufferSize(static_cast<GLFWwindow *>(mWindow), &fbWidth,
+                         &fbHeight);
+  if (fbWidth <= 0 || fbHeight <= 0) {
+    sLogger->error("Invalid framebuffer size {}x{}!", fbWidth, fbHeight);
+    return Result::eFailure;
+  }
+
+  configure(static_cast<uint32_t>(fbWidth), static_cast<uint32_t>(fbHeight));
+  return Result::eSuccess;
+}
+
+void SwapchainWebGPU::setPresentMode(CBZPresentMode presentMode) {
+  WGPUPresentMode wgpuPresentMode = static_cast<WGPUPresentMode>(presentMode);
+
+  if (std::find(mSupportedPresentModes.begin(), mSupportedPresentModes.end(),
+                wgpuPresentMode) == mSupportedPresentModes.end()) {
+    sLogger->warn("Present mode {} is not supported, falling back to fifo.",
+                  static_cast<uint32_t>(presentMode));
+    wgpuPresentMode = WGPUPresentMode_Fifo;
+  }
+
+  if (wgpuPresentMode != mPresentMode) {
+    mPresentMode = wgpuPresentMode;
+    mOutdated = true;
+  }
+}
+
+bool SwapchainWebGPU::acquire(TextureWebGPU *image) {
+  throttle();
+
+  int fbWidth, fbHeight;
+  glfwGetFramebufferSize(static_cast<GLFWwindow *>(mWindow), &fbWidth,
+                         &fbHeight);
+
+  // Minimized.
+  if (fbWidth <= 0 || fbHeight <= 0) {
+    return false;
+  }
+
+  if (mOutdated || static_cast<uint32_t>(fbWidth) != mWidth ||
+      static_cast<uint32_t>(fbHeight) != mHeight) {
+    configure(static_cast<uint32_t>(fbWidth), static_cast<uint32_t>(fbHeight));
+  }
+
+  // Acquiring may wait for a vertical blank.
+  WGPUSurfaceTexture surfaceTexture;
+  sDynamicResolution.beginWait();
+  wgpuSurfaceGetCurrentTexture(mSurface, &surfaceTexture);
+  sDynamicResolution.endWait();
+  switch (surfaceTexture.status) {
+  case WGPUSurfaceGetCurrentTextureStatus_Success:
+    break;
+
+  case WGPUSurfaceGetCurrentTextureStatus_Timeout:
+  case WGPUSurfaceGetCurrentTextureStatus_Outdated:
+  case WGPUSurfaceGetCurrentTextureStatus_Lost:
+    // Skip the frame; the next acquire reconfigures.
+    if (surfaceTexture.texture) {
+      wgpuTextureRelease(surfaceTexture.texture);
+    }
+    mOutdated = true;
+    return false;
+
+  case WGPUSurfaceGetCurrentTextureStatus_OutOfMemory:
+  case WGPUSurfaceGetCurrentTextureStatus_DeviceLost:
+  case WGPUSurfaceGetCurrentTextureStatus_Force32:
+    sLogger->error("Failed to get surface texture!");
+    return false;
+  }
+
+  if (surfaceTexture.suboptimal) {
+    mOutdated = true;
+  }
+
+  *image = {};
+  return image->create(surfaceTexture.texture) == Result::eSuccess;
+}
+
+void SwapchainWebGPU::submitted(uint64_t submissionIndex) {
+  mInFlight.push_back(submissionIndex);
+}
+
+void SwapchainWebGPU::present(TextureWebGPU *image) {
+#ifndef __EMSCRIPTEN__
+  sDynamicResolution.beginWait();
+  wgpuSurfacePresent(mSurface);
+  sDynamicResolution.endWait();
+#endif
+
+  if (image->getTexture()) {
+    image->destroy();
+  }
+
+  *image = {};
+}
+
+void SwapchainWebGPU::destroy() {
+  if (mSurface) {
+    wgpuSurfaceUnconfigure(mSurface);
+  }
+
+  mInFlight.clear();
+  mSurface = NULL;
+}
+
+void SwapchainWebGPU::configure(uint32_t width, uint32_t height) {
+  mWidth = width;
+  mHeight = height;
+  mOutdated = false;
+
+  WGPUSurfaceConfiguration surfaceConfig = {};
+  surfaceConfig.nextInChain = nullptr;
+  surfaceConfig.device = sDevice;
+  surfaceConfig.format = mFormat;
+  // CopySrc allows readback and capture of the presented image.
+  surfaceConfig.usage = WGPUTextureUsage_RenderAttachment |
+                        WGPUTextureUsage_CopyDst | WGPUTextureUsage_CopySrc;
+  surfaceConfig.viewFormatCount = 0;
+  surfaceConfig.viewFormats = nullptr;
+  surfaceConfig.alphaMode = WGPUCompositeAlphaMode_Auto;
+  surfaceConfig.width = mWidth;
+  surfaceConfig.height = mHeight;
+  surfaceConfig.presentMode = mPresentMode;
+
+#ifdef WEBGPU_BACKEND_WGPU
+  WGPUSurfaceConfigurationExtras surfaceConfigExtras = {};
+  surfaceConfigExtras.chain.next = nullptr;
+  surfaceConfigExtras.chain.sType =
+      static_cast<WGPUSType>(WGPUSType_SurfaceConfigurationExtras);
+  surfaceConfigExtras.desiredMaximumFrameLatency = mMaxFramesInFlight;
+  surfaceConfig.nextInChain = &surfaceConfigExtras.chain;
+#endif
+
+  wgpuSurfaceConfigure(mSurface, &surfaceConfig);
+  sLogger->info("Surface configured {}x{}, present mode {}.", mWidth, mHeight,
+                static_cast<uint32_t>(mPresentMode));
+}
+
+void SwapchainWebGPU::throttle() {
+#ifdef WEBGPU_BACKEND_WGPU
+  while (mInFlight.size() >= mMaxFramesInFlight) {
+    WGPUWrappedSubmissionIndex submission = {sQueue, mInFlight.front()};
+    mInFlight.pop_front();
+
+    // Returns true once nothing is left in flight.
+    if (wgpuDevicePoll(sDevice, true, &submission)) {
+      mInFlight.clear();
+    }
+  }
+#endif
+}
+
+// Largest relative change of the resolution scale per adjustment.
+static constexpr float RESOLUTION_SCALE_STEP = 0.1f;
+
+// Scales snap to multiples of this to limit distinct texture sizes.
+static constexpr float RESOLUTION_SCALE_QUANTUM = 0.05f;
+
+// Weight of the newest sample in smoothed frame times.
+static constexpr float FRAME_TIME_SMOOTHING = 0.1f;
+
+static void SmoothFrameTime(float *average, float sampleMs) {
+  *average = *average == 0.0f
+                 ? sampleMs
+                 : *average + (sampleMs - *average) * FRAME_TIME_SMOOTHING;
+}
+
+// Fullscreen triangle sampling the source with uvs of the covered area.
+static const char *sUpscaleWGSL = R"(
+@group(0) @binding(0) var src : texture_2d<f32>;
+@group(0) @binding(1) var srcSampler : sampler;
+
+struct VertexOutput {
+  @builtin(position) position : vec4<f32>,
+  @location(0) uv : vec2<f32>,
+};
+
+@vertex
+fn vertexMain(@builtin(vertex_index) vertexIndex : u32) -> VertexOutput {
+  let uv = vec2<f32>(f32((vertexIndex << 1u) & 2u), f32(vertexIndex & 2u));
+
+  var out : VertexOutput;
+  out.position = vec4<f32>(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, 0.0, 1.0);
+  out.uv = uv;
+  return out;
+}
+
+@fragment
+fn fragmentMain(in : VertexOutput) -> @location(0) vec4<f32> {
+  return textureSample(src, srcSampler, in.uv);
+}
+)";
+
+Result DynamicResolutionWebGPU::create(ImageHandle imgh,
+                                       WGPUTextureFormat format,
+                                       WGPUTextureUsageFlags usage,
+                                       float scale, bool dynamic,
+                                       WGPUExtent3D surfaceExtent) {
+  const RelativeImage image = {format, usage, scale, dynamic};
+
+  sTextures[imgh.idx] = {};
+  if (acquireTexture(imgh, image, getExtent(image, surfaceExtent),
+                     &sTextures[imgh.idx]) != Result::eSuccess) {
+    return Result::eFailure;
+  }
+
+  mImages[imgh.idx] = image;
+  return Result::eSuccess;
+}
+
+void DynamicResolutionWebGPU::setDesc(const DynamicResolutionDesc &desc) {
+  mDesc = desc;
+  mScale = std::clamp(mScale, mDesc.minScale, mDesc.maxScale);
+  mFramesSinceAdjust = 0;
+}
+
+void DynamicResolutionWebGPU::beginFrame() { mFrameBegin = Clock::now(); }
+
+void DynamicResolutionWebGPU::acquired(WGPUExtent3D surfaceExtent) {
+  // Waiting on the surface is idle time; measure from the previous acquire.
+  const Clock::time_point now = Clock::now();
+  if (mLastAcquired != Clock::time_point{}) {
+    const std::chrono::duration<float, std::milli> cpuTime =
+        mFrameBegin - mLastAcquired;
+    SmoothFrameTime(&mCpuFrameMs, cpuTime.count());
+  }
+  mLastAcquired = now;
+
+  if (mDesc.enabled &&
+      ++mFramesSinceAdjust >= DYNAMIC_RESOLUTION_ADJUST_FRAMES) {
+    mFramesSinceAdjust = 0;
+    adjustScale();
+  }
+
+  if (surfaceExtent.width == mSurfaceExtent.width &&
+      surfaceExtent.height == mSurfaceExtent.height &&
+      getScale() == mAppliedScale) {
+    return;
+  }
+
+  mSurfaceExtent = surfaceExtent;
+  mAppliedScale = getScale();
+
+  for (const auto &it : mImages) {
+    const ImageHandle imgh = {static_cast<uint16_t>(it.first)};
+    const WGPUExtent3D extent = getExtent(it.second, surfaceExtent);
+    const WGPUExtent3D currentExtent = sTextures[imgh.idx].getExtent();
+    if (extent.width == currentExtent.width &&
+        extent.height == currentExtent.height) {
+      continue;
+    }
+
+    TextureWebGPU resized = {};
+    if (acquireTexture(imgh, it.second, extent, &resized) !=
+        Result::eSuccess) {
+      sLogger->error("Failed to resize image '{}' to {}x{}!",
+                     HandleProvider<ImageHandle>::getName(imgh), extent.width,
+                     extent.height);
+      continue;
+    }
+
+    // Pending reads were sized for the previous texture.
+    sReadbackQueue.discard(imgh);
+    InvalidateBindGroups(imgh);
+
+    release(sTextures[imgh.idx]);
+    sTextures[imgh.idx] = resized;
+  }
+}
+
+bool DynamicResolutionWebGPU::hasUpscaleSource() const {
+  return mUpscaleSource.idx != CBZ_INVALID_HANDLE &&
+         mUpscaleSource.idx < sTextures.size() &&
+         sTextures[mUpscaleSource.idx].getTexture();
+}
+
+void DynamicResolutionWebGPU::blit(WGPURenderPassEncoder renderPassEncoder,
+                                   WGPUTextureFormat targetFormat) {
+  WGPURenderPipeline pipeline = findOrCreatePipeline(targetFormat);
+  if (!pipeline) {
+    return;
+  }
+
+  std::array<WGPUBindGroupEntry, 2> entries = {};
+  entries[0].nextInChain = nullptr;
+  entries[0].binding = 0;
+  entries[0].textureView =
+      sTextures[mUpscaleSource.idx].findOrCreateTextureView(
+          WGPUTextureAspect_All);
+
+  entries[1].nextInChain = nullptr;
+  entries[1].binding = 1;
+  entries[1].sampler = mSampler;
+
+  WGPUBindGroupDescriptor bindGroupDesc = {};
+  bindGroupDesc.nextInChain = nullptr;
+  bindGroupDesc.label = "Upscale";
+  bindGroupDesc.layout = mBindGroupLayout;
+  bindGroupDesc.entryCount = static_cast<uint32_t>(entries.size());
+  bindGroupDesc.entries = entries.data();
+
+  WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(sDevice, &bindGroupDesc);
+  mBindGroups.push_back(bindGroup);
+
+  wgpuRenderPassEncoderSetPipeline(renderPassEncoder, pipeline);
+  wgpuRenderPassEncoderSetBindGroup(renderPassEncoder, 0, bindGroup, 0,
+                                    nullptr);
+  wgpuRenderPassEncoderDraw(renderPassEncoder, 3, 1, 0, 0);
+}
+
+void DynamicResolutionWebGPU::beginWait() {
+  // Work finished before the wait is timed now.
+  PollEvents(false);
+  mWaitBegin = Clock::now();
+  mWaiting = true;
+}
+
+void DynamicResolutionWebGPU::endWait() {
+  PollEvents(false);
+  mWaiting = false;
+}
+
+void DynamicResolutionWebGPU::beginTimestamps(WGPUCommandEncoder encoder) {
+  if (!mQuerySet &&
+      wgpuDeviceHasFeature(sDevice, WGPUFeatureName_TimestampQuery)) {
+    WGPUQuerySetDescriptor querySetDesc = {};
+    querySetDesc.nextInChain = nullptr;
+    querySetDesc.label = "FrameTimestamps";
+    querySetDesc.type = WGPUQueryType_Timestamp;
+    querySetDesc.count = 2;
+    mQuerySet = wgpuDeviceCreateQuerySet(sDevice, &querySetDesc);
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain = nullptr;
+    bufferDesc.label = "FrameTimestampsResolve";
+    bufferDesc.usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc;
+    bufferDesc.size = 2 * sizeof(uint64_t);
+    bufferDesc.mappedAtCreation = false;
+    mTimestampBuffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
+  }
+
+  mTimestampsWritten = mQuerySet && mTimestampBuffer;
+  if (mTimestampsWritten) {
+    writeTimestamp(encoder, 0, false);
+  }
+}
+
+void DynamicResolutionWebGPU::endTimestamps(WGPUCommandEncoder encoder) {
+  if (!mTimestampsWritten) {
+    return;
+  }
+
+  writeTimestamp(encoder, 1, true);
+  wgpuCommandEncoderResolveQuerySet(encoder, mQuerySet, 0, 2,
+                                    mTimestampBuffer, 0);
+
+  // Resolved timestamps count nanoseconds.
+  static_cast<void>(sReadbackQueue.readBuffer(
+      mTimestampBuffer, 0, 2 * sizeof(uint64_t), [this](const void *data) {
+        uint64_t timestamps[2];
+        std::memcpy(timestamps, data, sizeof(timestamps));
+        if (timestamps[1] > timestamps[0]) {
+          SmoothFrameTime(&mGpuFrameMs,
+                          static_cast<float>(timestamps[1] - timestamps[0]) *
+                              1e-6f);
+        }
+      }));
+}
+
+void DynamicResolutionWebGPU::writeTimestamp(WGPUCommandEncoder encoder,
+                                             uint32_t queryIndex, bool end) {
+  WGPUComputePassTimestampWrites timestampWrites = {};
+  timestampWrites.querySet = mQuerySet;
+  timestampWrites.beginningOfPassWriteIndex =
+      end ? WGPU_QUERY_SET_INDEX_UNDEFINED : queryIndex;
+  timestampWrites.endOfPassWriteIndex =
+      end ? queryIndex : WGPU_QUERY_SET_INDEX_UNDEFINED;
+
+  WGPUComputePassDescriptor computePassDesc = {};
+  computePassDesc.nextInChain = nullptr;
+  computePassDesc.label = "FrameTimestamp";
+  computePassDesc.timestampWrites = &timestampWrites;
+
+  WGPUComputePassEncoder computePassEncoder =
+      wgpuCommandEncoderBeginComputePass(encoder, &computePassDesc);
+  wgpuComputePassEncoderEnd(computePassEncoder);
+  wgpuComputePassEncoderRelease(computePassEncoder);
+}
+
+void DynamicResolutionWebGPU::submitted() {
+  for (WGPUBindGroup bindGroup : mBindGroups) {
+    wgpuBindGroupRelease(bindGroup);
+  }
+  mBindGroups.clear();
+
+  // Timestamps replace the work done estimate.
+  if (mTimestampsWritten) {
+    return;
+  }
+
+  mSubmitTimes.push_back(Clock::now());
+  wgpuQueueOnSubmittedWorkDone(
+      sQueue,
+      [](WGPUQueueWorkDoneStatus, void *userdata) {
+        static_cast<DynamicResolutionWebGPU *>(userdata)->completed();
+      },
+      this);
+}
+
+void DynamicResolutionWebGPU::discard(ImageHandle imgh) {
+  mImages.erase(imgh.idx);
+
+  if (mUpscaleSource.idx == imgh.idx) {
+    mUpscaleSource = {CBZ_INVALID_HANDLE};
+  }
+}
+
+void DynamicResolutionWebGPU::destroy() {
+  for (WGPUBindGroup bindGroup : mBindGroups) {
+    wgpuBindGroupRelease(bindGroup);
+  }
+  mBindGroups.clear();
+
+  for (TextureWebGPU &texture : mPool) {
+    texture.destroy();
+  }
+  mPool.clear();
+  mImages.clear();
+
+  for (auto &it : mPipelines) {
+    if (it.second) {
+      wgpuRenderPipelineRelease(it.second);
+    }
+  }
+  mPipelines.clear();
+
+  if (mSampler) {
+    wgpuSamplerRelease(mSampler);
+    mSampler = NULL;
+  }
+
+  if (mPipelineLayout) {
+    wgpuPipelineLayoutRelease(mPipelineLayout);
+    mPipelineLayout = NULL;
+  }
+
+  if (mBindGroupLayout) {
+    wgpuBindGroupLayoutRelease(mBindGroupLayout);
+    mBindGroupLayout = NULL;
+  }
+
+  if (mModule) {
+    wgpuShaderModuleRelease(mModule);
+    mModule = NULL;
+  }
+
+  if (mTimestampBuffer) {
+    sReadbackQueue.discard(mTimestampBuffer);
+    wgpuBufferDestroy(mTimestampBuffer);
+    wgpuBufferRelease(mTimestampBuffer);
+    mTimestampBuffer = NULL;
+  }
+
+  if (mQuerySet) {
+    wgpuQuerySetDestroy(mQuerySet);
+    wgpuQuerySetRelease(mQuerySet);
+    mQuerySet = NULL;
+  }
+
+  mUpscaleSource = {CBZ_INVALID_HANDLE};
+}
+
+WGPUExtent3D
+DynamicResolutionWebGPU::getExtent(const RelativeImage &image,
+                                   WGPUExtent3D surfaceExtent) const {
+  const float scale = image.scale * (image.dynamic ? getScale() : 1.0f);
+  return {std::max(static_cast<uint32_t>(surfaceExtent.width * scale + 0.5f),
+                   1u),
+          std::max(static_cast<uint32_t>(surfaceExtent.height * scale + 0.5f),
+                   1u),
+          1};
+}
+
+Result DynamicResolutionWebGPU::acquireTexture(ImageHandle imgh,
+                                               const RelativeImage &image,
+                                               WGPUExtent3D extent,
+                                               TextureWebGPU *texture) {
+  auto it = std::find_if(
+      mPool.begin(), mPool.end(), [&](const TextureWebGPU &pooled) {
+        const WGPUExtent3D pooledExtent = pooled.getExtent();
+        return pooled.getFormat() == image.format &&
+               wgpuTextureGetUsage(pooled.getTexture()) == image.usage &&
+               pooledExtent.width == extent.width &&
+               pooledExtent.height == extent.height;
+      });
+
+  if (it != mPool.end()) {
+    *texture = *it;
+    mPool.erase(it);
+    return Result::eSuccess;
+  }
+
+  return texture->create(extent.width, extent.height, 1,
+                         WGPUTextureDimension_2D, image.format, image.usage, 1,
+                         HandleProvider<ImageHandle>::getName(imgh));
+}
+
+void DynamicResolutionWebGPU::release(TextureWebGPU &texture) {
+  mPool.push_back(texture);
+
+  // Oldest sizes are the least likely to return.
+  if (mPool.size() > MAX_POOLED_RESOLUTION_IMAGES) {
+    mPool.front().destroy();
+    mPool.erase(mPool.begin());
+  }
+}
+
+void DynamicResolutionWebGPU::adjustScale() {
+  const float frameMs = std::max(mCpuFrameMs, mGpuFrameMs);
+  if (frameMs <= 0.0f) {
+    return;
+  }
+
+  // Headroom below the target keeps the scale from oscillating.
+  const bool overBudget = frameMs > mDesc.targetFrameMs;
+  if (!overBudget && frameMs > mDesc.targetFrameMs * 0.8f) {
+    return;
   }
 
-  if (size > sLimits.maxBufferSize) {
-    sLogger->error("Cannot create vertex buffer with size > maxBufferSize({})!",
-                   sLimits.maxBufferSize);
-    return Result::eWGPUError;
+  // Frame time is assumed to follow pixel count, the square of the scale.
+  const float step =
+      std::clamp(std::sqrt(mDesc.targetFrameMs / frameMs),
+                 1.0f - RESOLUTION_SCALE_STEP, 1.0f + RESOLUTION_SCALE_STEP);
+
+  // Round away from the current scale so every adjustment moves it.
+  const float quanta = mScale * step / RESOLUTION_SCALE_QUANTUM;
+  const float scale = RESOLUTION_SCALE_QUANTUM *
+                      (overBudget ? std::floor(quanta - 1e-3f)
+                                  : std::ceil(quanta + 1e-3f));
+
+  mScale = std::clamp(scale, mDesc.minScale, mDesc.maxScale);
+}
+
+void DynamicResolutionWebGPU::completed() {
+  if (mSubmitTimes.empty()) {
+    return;
   }
 
-  mVertexCount = size / vertexLayout.stride;
-  if (mVertexCount * vertexLayout.stride != size) {
-    sLogger->warn("VertexBuffer size and layout do not match!");
+  // Queued work starts once the previous submission completes. Work seen
+  // finished after a surface wait is assumed done when the wait began.
+  const Clock::time_point now = mWaiting ? mWaitBegin : Clock::now();
+  const Clock::time_point begin =
+      std::max(mSubmitTimes.front(), mLastCompleted);
+  mSubmitTimes.pop_front();
+  mLastCompleted = now;
+
+  const std::chrono::duration<float, std::milli> gpuTime = now - begin;
+  SmoothFrameTime(&mGpuFrameMs, gpuTime.count());
+}
+
+WGPURenderPipeline
+DynamicResolutionWebGPU::findOrCreatePipeline(WGPUTextureFormat format) {
+  if (auto it = mPipelines.find(static_cast<uint32_t>(format));
+      it != mPipelines.end()) {
+    return it->second;
   }
 
-  WGPUBufferDescriptor bufferDesc = {};
-  bufferDesc.nextInChain = nullptr;
-  bufferDesc.label = name.c_str();
-  bufferDesc.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst;
-  bufferDesc.size = (size + 3) & ~3; // Pad to multiple of 4
-  bufferDesc.mappedAtCreation = false;
+  // Failed formats are cached as NULL pipelines.
+  WGPURenderPipeline &pipeline = mPipelines[static_cast<uint32_t>(format)];
 
-  mBuffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
-  if (!mBuffer) {
-    spdlog::error("Failed to create VertexBuffer!");
-    return Result::eWGPUError;
+  if (!mModule) {
+    WGPUShaderModuleWGSLDescriptor wgslCodeDesc = {};
+    wgslCodeDesc.chain.next = nullptr;
+    wgslCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+    wgslCodeDesc.code = sUpscaleWGSL;
+
+    WGPUShaderModuleDescriptor shaderModuleDesc = {};
+    shaderModuleDesc.nextInChain = &wgslCodeDesc.chain;
+    shaderModuleDesc.label = "Upscale";
+
+    mModule = wgpuDeviceCreateShaderModule(sDevice, &shaderModuleDesc);
+    if (!mModule) {
+      sLogger->error("Failed to create upscale shader!");
+      return NULL;
+    }
+
+    std::array<WGPUBindGroupLayoutEntry, 2> entries = {};
+    entries[0].nextInChain = nullptr;
+    entries[0].binding = 0;
+    entries[0].visibility = WGPUShaderStage_Fragment;
+    entries[0].texture.sampleType = WGPUTextureSampleType_Float;
+    entries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+    entries[0].texture.multisampled = false;
+
+    entries[1].nextInChain = nullptr;
+    entries[1].binding = 1;
+    entries[1].visibility = WGPUShaderStage_Fragment;
+    entries[1].sampler.type = WGPUSamplerBindingType_Filtering;
+
+    WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+    bindGroupLayoutDesc.nextInChain = nullptr;
+    bindGroupLayoutDesc.label = "Upscale";
+    bindGroupLayoutDesc.entryCount = static_cast<uint32_t>(entries.size());
+    bindGroupLayoutDesc.entries = entries.data();
+
+    mBindGroupLayout =
+        wgpuDeviceCreateBindGroupLayout(sDevice, &bindGroupLayoutDesc);
+
+    WGPUPipelineLayoutDescriptor pipelineLayoutDesc = {};
+    pipelineLayoutDesc.nextInChain = nullptr;
+    pipelineLayoutDesc.label = "Upscale";
+    pipelineLayoutDesc.bindGroupLayoutCount = 1;
+    pipelineLayoutDesc.bindGroupLayouts = &mBindGroupLayout;
+
+    mPipelineLayout =
+        wgpuDeviceCreatePipelineLayout(sDevice, &pipelineLayoutDesc);
+
+    WGPUSamplerDescriptor samplerDesc = {};
+    samplerDesc.nextInChain = nullptr;
+    samplerDesc.label = "Upscale";
+    samplerDesc.addressModeU = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeV = WGPUAddressMode_ClampToEdge;
+    samplerDesc.addressModeW = WGPUAddressMode_ClampToEdge;
+    samplerDesc.magFilter = WGPUFilterMode_Linear;
+    samplerDesc.minFilter = WGPUFilterMode_Linear;
+    samplerDesc.mipmapFilter = WGPUMipmapFilterMode_Nearest;
+    samplerDesc.lodMinClamp = 0.0f;
+    samplerDesc.lodMaxClamp = 1.0f;
+    samplerDesc.compare = WGPUCompareFunction_Undefined;
+    samplerDesc.maxAnisotropy = 1;
+
+    mSampler = wgpuDeviceCreateSampler(sDevice, &samplerDesc);
   }
 
-  if (data) {
-    AlignedWriteBufferWGPU(mBuffer, data, size);
+  WGPURenderPipelineDescriptor pipelineDesc = {};
+  pipelineDesc.nextInChain = nullptr;
+  pipelineDesc.label = "Upscale";
+  pipelineDesc.layout = mPipelineLayout;
+
+  pipelineDesc.vertex.nextInChain = nullptr;
+  pipelineDesc.vertex.module = mModule;
+  pipelineDesc.vertex.entryPoint = "vertexMain";
+  pipelineDesc.vertex.constantCount = 0;
+  pipelineDesc.vertex.constants = nullptr;
+  pipelineDesc.vertex.bufferCount = 0;
+  pipelineDesc.vertex.buffers = nullptr;
+
+  pipelineDesc.primitive.nextInChain = nullptr;
+  pipelineDesc.primitive.topology = WGPUPrimitiveTopology_TriangleList;
+  pipelineDesc.primitive.stripIndexFormat = WGPUIndexFormat_Undefined;
+  pipelineDesc.primitive.frontFace = WGPUFrontFace_CCW;
+  pipelineDesc.primitive.cullMode = WGPUCullMode_None;
+
+  pipelineDesc.depthStencil = nullptr;
+
+  pipelineDesc.multisample.nextInChain = nullptr;
+  pipelineDesc.multisample.count = 1;
+  pipelineDesc.multisample.mask = ~0u;
+  pipelineDesc.multisample.alphaToCoverageEnabled = false;
+
+  WGPUColorTargetState colorTarget = {};
+  colorTarget.nextInChain = nullptr;
+  colorTarget.format = format;
+  colorTarget.blend = nullptr;
+  colorTarget.writeMask = WGPUColorWriteMask_All;
+
+  WGPUFragmentState fragmentState = {};
+  fragmentState.nextInChain = nullptr;
+  fragmentState.module = mModule;
+  fragmentState.entryPoint = "fragmentMain";
+  fragmentState.constantCount = 0;
+  fragmentState.constants = nullptr;
+  fragmentState.targetCount = 1;
+  fragmentState.targets = &colorTarget;
+  pipelineDesc.fragment = &fragmentState;
+
+  pipeline = wgpuDeviceCreateRenderPipeline(sDevice, &pipelineDesc);
+  if (!pipeline) {
+    sLogger->error("Failed to create upscale pipeline for format {}!",
+                   static_cast<uint32_t>(format));
   }
 
-  return Result::eSuccess;
+  return pipeline;
+}
+
+// Matches Params of sCullWGSL.
+struct CullParams {
+  float prevViewProj[16];
+  float planes[6][4];
+  float hizSize[2];
+  uint32_t hizLevels;
+  uint32_t objectCount;
+  uint32_t transformIndex;
+  uint32_t occlusion;
+  uint32_t padding[2];
 };
 
-void VertexBufferWebGPU::update(const void *data, uint32_t elementCount,
-                                [[maybe_unused]] uint32_t elementOffset) {
-  uint32_t size = elementCount * mVertexLayout.stride;
+// Mat4s of each submission in the transform buffer.
+static constexpr uint32_t MAT4_PER_TRANSFORM = 6;
+
+static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+
+// Storage bindings are all read-write; read-only buffers may share a backing
+// block, which can not be both read-only and writable in one dispatch.
+static const char *sCullWGSL = R"(
+struct Params {
+  prevViewProj : mat4x4<f32>,
+  planes : array<vec4<f32>, 6>,
+  hizSize : vec2<f32>,
+  hizLevels : u32,
+  objectCount : u32,
+  transformIndex : u32,
+  occlusion : u32,
+}
 
-  if (data) {
-    AlignedWriteBufferWGPU(mBuffer, data, size);
+@group(0) @binding(0) var<uniform> params : Params;
+@group(0) @binding(1) var<storage, read_write> bounds : array<vec4<f32>>;
+@group(0) @binding(2) var<storage, read_write> transforms : array<mat4x4<f32>>;
+@group(0) @binding(3) var<storage, read_write> visible : array<u32>;
+@group(0) @binding(4) var<storage, read_write> args : array<atomic<u32>>;
+@group(0) @binding(5) var hiz : texture_2d<f32>;
+
+fn isOccluded(center : vec3<f32>, radius : f32) -> bool {
+  // Screen rectangle and nearest depth of the bounding box.
+  var uvMin = vec2<f32>(1.0);
+  var uvMax = vec2<f32>(0.0);
+  var nearest = 1.0;
+
+  for (var corner = 0u; corner < 8u; corner++) {
+    let offset = vec3<f32>(f32(corner & 1u), f32((corner >> 1u) & 1u),
+                           f32((corner >> 2u) & 1u)) * 2.0 - 1.0;
+    let clip = params.prevViewProj * vec4<f32>(center + offset * radius, 1.0);
+    if (clip.w <= 0.0) {
+      // Crosses the camera plane.
+      return false;
+    }
+
+    let ndc = clip.xyz / clip.w;
+    let uv = ndc.xy * vec2<f32>(0.5, -0.5) + 0.5;
+    uvMin = min(uvMin, uv);
+    uvMax = max(uvMax, uv);
+    nearest = min(nearest, ndc.z);
   }
-}
 
-Result VertexBufferWebGPU::bind(WGPURenderPassEncoder renderPassEncoder,
-                                uint32_t slot) const {
-  wgpuRenderPassEncoderSetVertexBuffer(renderPassEncoder, slot, mBuffer, 0,
-                                       wgpuBufferGetSize(mBuffer));
+  uvMin = clamp(uvMin, vec2<f32>(0.0), vec2<f32>(1.0));
+  uvMax = clamp(uvMax, vec2<f32>(0.0), vec2<f32>(1.0));
 
-  return Result::eSuccess;
+  // Level the rectangle spans at most 2x2 texels of.
+  let extent = (uvMax - uvMin) * params.hizSize;
+  let level = min(u32(ceil(log2(max(max(extent.x, extent.y), 1.0)))),
+                  params.hizLevels - 1u);
+
+  let levelMax = vec2<i32>(textureDimensions(hiz, level)) - vec2<i32>(1);
+  let texelMin = min(vec2<i32>(uvMin * vec2<f32>(levelMax + 1)), levelMax);
+  let texelMax = min(vec2<i32>(uvMax * vec2<f32>(levelMax + 1)), levelMax);
+
+  let farthest =
+      max(max(textureLoad(hiz, texelMin, level).x,
+              textureLoad(hiz, vec2<i32>(texelMax.x, texelMin.y), level).x),
+          max(textureLoad(hiz, vec2<i32>(texelMin.x, texelMax.y), level).x,
+              textureLoad(hiz, texelMax, level).x));
+
+  return nearest > farthest;
 }
 
-void VertexBufferWebGPU::destroy() {
-  if (!mBuffer) {
-    spdlog::warn("Attempting to destroy invalid vertex buffer");
+@compute @workgroup_size(64)
+fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+  let objectIdx = id.x;
+  if (objectIdx >= params.objectCount) {
     return;
   }
 
-  wgpuBufferDestroy(mBuffer);
+  let model = transforms[params.transformIndex];
+  let sphere = bounds[objectIdx];
+  let center = (model * vec4<f32>(sphere.xyz, 1.0)).xyz;
+  let radius = sphere.w * max(length(model[0].xyz),
+                              max(length(model[1].xyz), length(model[2].xyz)));
+
+  for (var plane = 0u; plane < 6u; plane++) {
+    if (dot(params.planes[plane].xyz, center) + params.planes[plane].w <
+        -radius) {
+      return;
+    }
+  }
+
+  if (params.occlusion != 0u && isOccluded(center, radius)) {
+    return;
+  }
+
+  // Instance count of the draw arguments.
+  let slot = atomicAdd(&args[1], 1u);
+  visible[slot] = objectIdx;
 }
+)";
 
-Result IndexBufferWebGPU::create(WGPUIndexFormat format, uint32_t count,
-                                 const void *data, const std::string &name) {
-  const uint32_t size =
-      IndexFormatGetSize(static_cast<WGPUIndexFormat>(format)) * count;
+// Texels cover their whole footprint in the source, so odd sizes keep the
+// farthest depth of the extra row and column.
+static const char *sHiZReduceWGSL = R"(
+@group(0) @binding(0) var src : {SOURCE};
+@group(0) @binding(1) var dst : texture_storage_2d<r32float, write>;
 
-  if (size <= 0) {
-    sLogger->error("Cannot create index buffer with size 0!");
-    return Result::eWGPUError;
+fn load(coord : vec2<i32>) -> f32 {
+  return {LOAD};
+}
+
+@compute @workgroup_size(8, 8)
+fn main(@builtin(global_invocation_id) id : vec3<u32>) {
+  let dstSize = vec2<i32>(textureDimensions(dst));
+  if (i32(id.x) >= dstSize.x || i32(id.y) >= dstSize.y) {
+    return;
   }
 
-  if (size > sLimits.maxBufferSize) {
-    sLogger->error("Cannot create index buffer with size > maxBufferSize({})!",
-                   sLimits.maxBufferSize);
-    return Result::eWGPUError;
+  let srcSize = vec2<i32>(textureDimensions(src, 0));
+  let begin = vec2<i32>(id.xy) * srcSize / dstSize;
+  let end = max((vec2<i32>(id.xy) + 1) * srcSize / dstSize, begin + 1);
+
+  var depth = 0.0;
+  for (var y = begin.y; y < end.y; y++) {
+    for (var x = begin.x; x < end.x; x++) {
+      depth = max(depth, load(vec2<i32>(x, y)));
+    }
   }
 
-  mIndexCount = size / IndexFormatGetSize(format);
-  if (mIndexCount * IndexFormatGetSize(format) != size) {
-    sLogger->warn("Index size and format do not match!");
+  textureStore(dst, vec2<i32>(id.xy), vec4<f32>(depth, 0.0, 0.0, 0.0));
+}
+)";
+
+// @brief Extracts the normalized frustum planes of a column major view
+// projection. The near plane is taken at z = -w, which contains both depth
+// conventions.
+static void FrustumPlanesExtract(const float *viewProj, float planes[6][4]) {
+  for (uint32_t plane = 0; plane < 6; plane++) {
+    // Left, right, bottom, top, near, far.
+    const uint32_t row = plane / 2;
+    const float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+
+    for (uint32_t col = 0; col < 4; col++) {
+      planes[plane][col] =
+          viewProj[col * 4 + 3] + sign * viewProj[col * 4 + row];
+    }
+
+    const float length = std::sqrt(planes[plane][0] * planes[plane][0] +
+                                   planes[plane][1] * planes[plane][1] +
+                                   planes[plane][2] * planes[plane][2]);
+    if (length > 0.0f) {
+      for (uint32_t col = 0; col < 4; col++) {
+        planes[plane][col] /= length;
+      }
+    }
   }
-  mFormat = format;
+}
 
-  WGPUBufferDescriptor bufferDesc = {};
-  bufferDesc.nextInChain = nullptr;
-  bufferDesc.label = name.c_str();
-  bufferDesc.usage = WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst;
-  bufferDesc.size = (size + 3) & ~3; // Pad to multiple of 4
-  bufferDesc.mappedAtCreation = false;
+void CullingWebGPU::prepare(const ShaderProgramCommand *cmds, uint32_t count) {
+  std::vector<uint32_t> culls;
+  for (uint32_t cmdIdx = 0; cmdIdx < count; cmdIdx++) {
+    if (cmds[cmdIdx].isCull) {
+      culls.push_back(cmdIdx);
+    }
+  }
 
-  mBuffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
-  if (!mBuffer) {
-    spdlog::error("Failed to create IndexBuffer!");
-    return Result::eWGPUError;
+  if (culls.empty() || !createPipelines()) {
+    return;
   }
 
-  if (data) {
-    AlignedWriteBufferWGPU(mBuffer, data, size);
+  const uint64_t paramsStride =
+      AlignUp(sizeof(CullParams), sLimits.minUniformBufferOffsetAlignment);
+  const uint64_t paramsSize = paramsStride * culls.size();
+
+  if (paramsSize > mParamsSize) {
+    if (mParams) {
+      sStagingBelt.discard(mParams);
+      wgpuBufferRelease(mParams);
+    }
+
+    WGPUBufferDescriptor bufferDesc = {};
+    bufferDesc.nextInChain = nullptr;
+    bufferDesc.label = "CullParams";
+    bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
+    bufferDesc.size = paramsSize;
+    bufferDesc.mappedAtCreation = false;
+
+    mParams = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
+    mParamsSize = mParams ? paramsSize : 0;
+    if (!mParams) {
+      sLogger->error("Failed to create cull parameters buffer!");
+      return;
+    }
   }
 
-  return Result::eSuccess;
-}
+  for (uint32_t slot = 0; slot < culls.size(); slot++) {
+    const ShaderProgramCommand &cmd = cmds[culls[slot]];
+    const auto &cull = cmd.program.cull;
 
-Result IndexBufferWebGPU::bind(WGPURenderPassEncoder renderPassEncoder) const {
-  wgpuRenderPassEncoderSetIndexBuffer(renderPassEncoder, mBuffer, mFormat, 0,
-                                      wgpuBufferGetSize(mBuffer));
+    const StorageBufferWebWGPU &bounds = sStorageBuffers[cull.boundsSBH.idx];
+    const StorageBufferWebWGPU &visible = sStorageBuffers[cull.visibleSBH.idx];
+    const StorageBufferWebWGPU &args = sStorageBuffers[cull.argsSBH.idx];
 
-  return Result::eSuccess;
+    if (bounds.getSize() < sizeof(float) * 4 * cull.objectCount ||
+        visible.getSize() < sizeof(uint32_t) * cull.objectCount ||
+        args.getSize() < sizeof(uint32_t) * 5) {
+      sLogger->error("Cull buffers are too small for {} objects!",
+                     cull.objectCount);
+      continue;
+    }
+
+    if ((cull.objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE >
+        sLimits.maxComputeWorkgroupsPerDimension) {
+      sLogger->error("Cannot cull {} objects in one submission!",
+                     cull.objectCount);
+      continue;
+    }
+
+    // Instances are counted by the cull.
+    const uint32_t drawArgs[5] = {cull.indexCount, 0, cull.firstIndex,
+                                  static_cast<uint32_t>(cull.baseVertex), 0};
+    sStagingBelt.writeBuffer(args.getBuffer(), args.getOffset(), drawArgs,
+                             sizeof(drawArgs));
+
+    CullParams params = {};
+    FrustumPlanesExtract(cull.viewProj, params.planes);
+    params.objectCount = cull.objectCount;
+    params.transformIndex = cmd.submissionID * MAT4_PER_TRANSFORM;
+
+    if (HiZ *hiz = findOrCreateHiZ(cull.depthIMGH)) {
+      if (hiz->hasViewProj) {
+        const WGPUExtent3D extent = hiz->texture.getExtent();
+        memcpy(params.prevViewProj, hiz->viewProj, sizeof(hiz->viewProj));
+        params.hizSize[0] = static_cast<float>(extent.width);
+        params.hizSize[1] = static_cast<float>(extent.height);
+        params.hizLevels = hiz->texture.getMipLevelCount();
+        params.occlusion = 1;
+      }
+
+      memcpy(hiz->nextViewProj, cull.viewProj, sizeof(hiz->nextViewProj));
+      hiz->hasNextViewProj = true;
+
+      if (std::find_if(mQueued.begin(), mQueued.end(),
+                       [&cull](const ImageHandle &queued) {
+                         return queued.idx == cull.depthIMGH.idx;
+                       }) == mQueued.end()) {
+        mQueued.push_back(cull.depthIMGH);
+      }
+    }
+
+    sStagingBelt.writeBuffer(mParams, slot * paramsStride, &params,
+                             sizeof(params));
+    mSlots[cmd.submissionID] = slot;
+  }
 }
 
-void IndexBufferWebGPU::destroy() {
-  if (!mBuffer) {
-    spdlog::warn("Attempting to destroy invalid index buffer");
+void CullingWebGPU::flush(WGPUCommandEncoder encoder) {
+  if (mQueued.empty()) {
     return;
   }
 
-  wgpuBufferDestroy(mBuffer);
+  WGPUComputePassDescriptor computePassDesc = {};
+  computePassDesc.nextInChain = nullptr;
+  computePassDesc.label = "HiZPass";
+  computePassDesc.timestampWrites = nullptr;
+
+  WGPUComputePassEncoder computePassEncoder =
+      wgpuCommandEncoderBeginComputePass(encoder, &computePassDesc);
+
+  for (ImageHandle depthIMGH : mQueued) {
+    if (auto it = mHiZs.find(depthIMGH.idx); it != mHiZs.end()) {
+      build(computePassEncoder, depthIMGH, it->second);
+    }
+  }
+
+  wgpuComputePassEncoderEnd(computePassEncoder);
+  wgpuComputePassEncoderRelease(computePassEncoder);
+
+  mQueued.clear();
 }
 
-[[nodiscard]] Result UniformBufferWebWGPU::create(CBZUniformType type,
-                                                  uint16_t num,
-                                                  const void *data,
-                                                  const std::string &name) {
-  mElementType = type;
-  mElementCount = num;
-  uint32_t size = UniformTypeGetSize(mElementType) * mElementCount;
+void CullingWebGPU::dispatch(WGPUComputePassEncoder computePassEncoder,
+                             const ShaderProgramCommand &cmd) {
+  auto slotIt = mSlots.find(cmd.submissionID);
+  if (slotIt == mSlots.end() || cmd.program.cull.objectCount == 0) {
+    return;
+  }
 
-  if (size <= 0) {
-    sLogger->error("Cannot create uniform '{}' buffer with size 0!", name);
-    return Result::eWGPUError;
+  const auto &cull = cmd.program.cull;
+
+  WGPUTextureView hizView = mEmptyHiZ.findOrCreateTextureView(
+      WGPUTextureAspect_All, 0, 1, CBZ_TEXTURE_VIEW_DIMENSION_2D, 0, 0);
+  if (auto it = mHiZs.find(cull.depthIMGH.idx); it != mHiZs.end()) {
+    hizView = it->second.texture.findOrCreateTextureView(
+        WGPUTextureAspect_All, 0, 1, CBZ_TEXTURE_VIEW_DIMENSION_2D, 0, 0);
   }
 
-  if (size > sLimits.maxUniformBufferBindingSize) {
-    sLogger->error("Cannot create uniform buffer with size > "
-                   "maxUniformBufferBindingSize({})!",
-                   sLimits.maxBufferSize);
-    return Result::eWGPUError;
+  std::array<WGPUBindGroupEntry, 6> entries = {};
+  entries[0].nextInChain = nullptr;
+  entries[0].binding = 0;
+  entries[0].buffer = mParams;
+  entries[0].offset =
+      slotIt->second *
+      AlignUp(sizeof(CullParams), sLimits.minUniformBufferOffsetAlignment);
+  entries[0].size = sizeof(CullParams);
+
+  entries[1] = sStorageBuffers[cull.boundsSBH.idx].createBindGroupEntry(1);
+  entries[2] = sStorageBuffers[cull.transformSBH.idx].createBindGroupEntry(2);
+  entries[3] = sStorageBuffers[cull.visibleSBH.idx].createBindGroupEntry(3);
+  entries[4] = sStorageBuffers[cull.argsSBH.idx].createBindGroupEntry(4);
+
+  entries[5].nextInChain = nullptr;
+  entries[5].binding = 5;
+  entries[5].textureView = hizView;
+
+  WGPUBindGroupDescriptor bindGroupDesc = {};
+  bindGroupDesc.nextInChain = nullptr;
+  bindGroupDesc.label = nullptr;
+  bindGroupDesc.layout = mCullPipeline.bindGroupLayout;
+  bindGroupDesc.entryCount = static_cast<uint32_t>(entries.size());
+  bindGroupDesc.entries = entries.data();
+
+  WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(sDevice, &bindGroupDesc);
+  mBindGroups.push_back(bindGroup);
+
+  wgpuComputePassEncoderSetPipeline(computePassEncoder, mCullPipeline.pipeline);
+  wgpuComputePassEncoderSetBindGroup(computePassEncoder, 0, bindGroup, 0,
+                                     nullptr);
+  wgpuComputePassEncoderDispatchWorkgroups(
+      computePassEncoder,
+      (cull.objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+}
+
+void CullingWebGPU::submitted() {
+  for (WGPUBindGroup bindGroup : mBindGroups) {
+    wgpuBindGroupRelease(bindGroup);
+  }
+  mBindGroups.clear();
+  mSlots.clear();
+
+  // The depth drawn this frame is tested with this frame's view projection.
+  for (auto &it : mHiZs) {
+    HiZ &hiz = it.second;
+    if (hiz.hasNextViewProj) {
+      memcpy(hiz.viewProj, hiz.nextViewProj, sizeof(hiz.viewProj));
+      hiz.hasViewProj = true;
+      hiz.hasNextViewProj = false;
+    }
   }
+}
 
-  WGPUBufferDescriptor bufferDesc = {};
-  bufferDesc.nextInChain = nullptr;
-  bufferDesc.label = name.c_str();
-  bufferDesc.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst;
-  bufferDesc.size = size;
-  bufferDesc.mappedAtCreation = false;
+void CullingWebGPU::discard(ImageHandle imgh) {
+  mQueued.erase(std::remove_if(mQueued.begin(), mQueued.end(),
+                               [imgh](const ImageHandle &queued) {
+                                 return queued.idx == imgh.idx;
+                               }),
+                mQueued.end());
 
-  mBuffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
-  if (!mBuffer) {
-    spdlog::error("Failed to create Uniform buffer!");
-    return Result::eWGPUError;
+  if (auto it = mHiZs.find(imgh.idx); it != mHiZs.end()) {
+    it->second.texture.destroy();
+    mHiZs.erase(it);
   }
+}
 
-  if (data) {
-    AlignedWriteBufferWGPU(mBuffer, data, size);
+void CullingWebGPU::destroy() {
+  submitted();
+
+  for (auto &it : mHiZs) {
+    it.second.texture.destroy();
   }
+  mHiZs.clear();
+  mQueued.clear();
 
-  return Result::eSuccess;
+  if (mEmptyHiZ.getTexture()) {
+    mEmptyHiZ.destroy();
+    mEmptyHiZ = {};
+  }
+
+  if (mParams) {
+    wgpuBufferRelease(mParams);
+    mParams = NULL;
+    mParamsSize = 0;
+  }
+
+  destroyPipeline(mCullPipeline);
+  destroyPipeline(mDepthReducePipeline);
+  destroyPipeline(mReducePipeline);
+  mPipelinesFailed = false;
 }
 
-void UniformBufferWebWGPU::update(const void *data, uint16_t num) {
-  uint32_t size = UniformTypeGetSize(mElementType) * num;
+bool CullingWebGPU::createPipelines() {
+  if (mCullPipeline.pipeline) {
+    return true;
+  }
 
-  if (num == 0) {
-    size = UniformTypeGetSize(mElementType) * mElementCount;
+  if (mPipelinesFailed) {
+    return false;
+  }
+
+  std::array<WGPUBindGroupLayoutEntry, 6> cullEntries = {};
+  for (uint32_t binding = 0; binding < cullEntries.size(); binding++) {
+    cullEntries[binding].nextInChain = nullptr;
+    cullEntries[binding].binding = binding;
+    cullEntries[binding].visibility = WGPUShaderStage_Compute;
+    cullEntries[binding].buffer.type = WGPUBufferBindingType_Storage;
+  }
+
+  cullEntries[0].buffer.type = WGPUBufferBindingType_Uniform;
+  cullEntries[0].buffer.minBindingSize = sizeof(CullParams);
+
+  cullEntries[5].buffer.type = WGPUBufferBindingType_Undefined;
+  cullEntries[5].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+  cullEntries[5].texture.viewDimension = WGPUTextureViewDimension_2D;
+  cullEntries[5].texture.multisampled = false;
+
+  std::array<WGPUBindGroupLayoutEntry, 2> reduceEntries = {};
+  reduceEntries[0].nextInChain = nullptr;
+  reduceEntries[0].binding = 0;
+  reduceEntries[0].visibility = WGPUShaderStage_Compute;
+  reduceEntries[0].texture.sampleType = WGPUTextureSampleType_UnfilterableFloat;
+  reduceEntries[0].texture.viewDimension = WGPUTextureViewDimension_2D;
+  reduceEntries[0].texture.multisampled = false;
+
+  reduceEntries[1].nextInChain = nullptr;
+  reduceEntries[1].binding = 1;
+  reduceEntries[1].visibility = WGPUShaderStage_Compute;
+  reduceEntries[1].storageTexture.access = WGPUStorageTextureAccess_WriteOnly;
+  reduceEntries[1].storageTexture.format = WGPUTextureFormat_R32Float;
+  reduceEntries[1].storageTexture.viewDimension = WGPUTextureViewDimension_2D;
+
+  std::string reduceCode = sHiZReduceWGSL;
+  reduceCode.replace(reduceCode.find("{SOURCE}"), strlen("{SOURCE}"),
+                     "texture_2d<f32>");
+  reduceCode.replace(reduceCode.find("{LOAD}"), strlen("{LOAD}"),
+                     "textureLoad(src, coord, 0).x");
+
+  std::string depthReduceCode = sHiZReduceWGSL;
+  depthReduceCode.replace(depthReduceCode.find("{SOURCE}"),
+                          strlen("{SOURCE}"), "texture_depth_2d");
+  depthReduceCode.replace(depthReduceCode.find("{LOAD}"), strlen("{LOAD}"),
+                          "textureLoad(src, coord, 0)");
+
+  std::array<WGPUBindGroupLayoutEntry, 2> depthReduceEntries = reduceEntries;
+  depthReduceEntries[0].texture.sampleType = WGPUTextureSampleType_Depth;
+
+  if (!createPipeline(sCullWGSL, "Cull", cullEntries.data(),
+                      static_cast<uint32_t>(cullEntries.size()),
+                      &mCullPipeline) ||
+      !createPipeline(reduceCode.c_str(), "HiZReduce", reduceEntries.data(),
+                      static_cast<uint32_t>(reduceEntries.size()),
+                      &mReducePipeline) ||
+      !createPipeline(depthReduceCode.c_str(), "HiZDepthReduce",
+                      depthReduceEntries.data(),
+                      static_cast<uint32_t>(depthReduceEntries.size()),
+                      &mDepthReducePipeline)) {
+    sLogger->error("Failed to create culling pipelines!");
+    destroyPipeline(mCullPipeline);
+    destroyPipeline(mReducePipeline);
+    destroyPipeline(mDepthReducePipeline);
+    mPipelinesFailed = true;
+    return false;
   }
 
-  AlignedWriteBufferWGPU(mBuffer, data, size);
+  return mEmptyHiZ.create(1, 1, 1, WGPUTextureDimension_2D,
+                          WGPUTextureFormat_R32Float, 0, 1,
+                          "EmptyHiZ") == Result::eSuccess;
 }
 
-void UniformBufferWebWGPU::destroy() {
-  if (!mBuffer) {
-    spdlog::warn("Attempting to destroy invalid uniform buffer");
-    return;
+bool CullingWebGPU::createPipeline(const char *code, const char *label,
+                                   const WGPUBindGroupLayoutEntry *entries,
+                                   uint32_t entryCount, Pipeline *pipeline) {
+  WGPUShaderModuleWGSLDescriptor wgslCodeDesc = {};
+  wgslCodeDesc.chain.next = nullptr;
+  wgslCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+  wgslCodeDesc.code = code;
+
+  WGPUShaderModuleDescriptor shaderModuleDesc = {};
+  shaderModuleDesc.nextInChain = &wgslCodeDesc.chain;
+  shaderModuleDesc.label = label;
+
+  pipeline->module = wgpuDeviceCreateShaderModule(sDevice, &shaderModuleDesc);
+  if (!pipeline->module) {
+    return false;
   }
 
-  wgpuBufferDestroy(mBuffer);
-  mBuffer = NULL;
+  WGPUBindGroupLayoutDescriptor bindGroupLayoutDesc = {};
+  bindGroupLayoutDesc.nextInChain = nullptr;
+  bindGroupLayoutDesc.label = label;
+  bindGroupLayoutDesc.entryCount = entryCount;
+  bindGroupLayoutDesc.entries = entries;
+
+  pipeline->bindGroupLayout =
+      wgpuDeviceCreateBindGroupLayout(sDevice, &bindGroupLayoutDesc);
+
+  WGPUPipelineLayoutDescriptor pipelineLayoutDesc = {};
+  pipelineLayoutDesc.nextInChain = nullptr;
+  pipelineLayoutDesc.label = label;
+  pipelineLayoutDesc.bindGroupLayoutCount = 1;
+  pipelineLayoutDesc.bindGroupLayouts = &pipeline->bindGroupLayout;
+
+  pipeline->pipelineLayout =
+      wgpuDeviceCreatePipelineLayout(sDevice, &pipelineLayoutDesc);
+
+  WGPUComputePipelineDescriptor pipelineDesc = {};
+  pipelineDesc.nextInChain = nullptr;
+  pipelineDesc.label = label;
+  pipelineDesc.layout = pipeline->pipelineLayout;
+  pipelineDesc.compute.module = pipeline->module;
+  pipelineDesc.compute.entryPoint = "main";
+
+  pipeline->pipeline = wgpuDeviceCreateComputePipeline(sDevice, &pipelineDesc);
+  return pipeline->pipeline != NULL;
 }
 
-Result StorageBufferWebWGPU::create(CBZUniformType type, uint32_t elementCount,
-                                    const void *data,
-                                    WGPUBufferUsageFlags usage,
-                                    const std::string &name) {
-  mElementType = type;
-  mElementCount = elementCount;
-  uint32_t size = UniformTypeGetSize(mElementType) * mElementCount;
+CullingWebGPU::HiZ *CullingWebGPU::findOrCreateHiZ(ImageHandle depthIMGH) {
+  if (depthIMGH.idx >= sTextures.size() ||
+      !sTextures[depthIMGH.idx].getTexture()) {
+    return nullptr;
+  }
 
-  if (size <= 0) {
-    sLogger->error("Cannot create uniform '{}' buffer with size 0!", name);
-    return Result::eWGPUError;
+  const TextureWebGPU &depth = sTextures[depthIMGH.idx];
+  if (!TextureFormatIsDepth(depth.getFormat()) ||
+      depth.getSampleCount() > 1 ||
+      (wgpuTextureGetUsage(depth.getTexture()) &
+       WGPUTextureUsage_TextureBinding) == 0) {
+    sLogger->error("Occlusion culling requires a single sample depth image "
+                   "created with CBZ_IMAGE_BINDING!");
+    return nullptr;
   }
 
-  if (size > sLimits.maxStorageBufferBindingSize) {
-    sLogger->error("Cannot create uniform buffer with size > "
-                   "maxStorageBufferBindingSize({})!",
-                   sLimits.maxBufferSize);
-    return Result::eWGPUError;
+  const WGPUExtent3D depthExtent = depth.getExtent();
+  const uint32_t width = std::max(depthExtent.width / 2, 1u);
+  const uint32_t height = std::max(depthExtent.height / 2, 1u);
+
+  HiZ &hiz = mHiZs[depthIMGH.idx];
+  if (hiz.texture.getTexture()) {
+    const WGPUExtent3D extent = hiz.texture.getExtent();
+    if (extent.width == width && extent.height == height) {
+      return &hiz;
+    }
+
+    // Resized depth no longer holds the previous frame.
+    hiz.texture.destroy();
+    hiz.texture = {};
+    hiz.hasViewProj = false;
   }
 
-  WGPUBufferDescriptor bufferDesc = {};
-  bufferDesc.nextInChain = nullptr;
-  bufferDesc.label = name.c_str();
-  // TODO : Remove copy dst copy src
-  bufferDesc.usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst |
-                     WGPUBufferUsage_CopySrc | usage;
-  bufferDesc.size = size;
-  bufferDesc.mappedAtCreation = false;
+  const uint32_t mipLevelCount =
+      static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) +
+      1;
+
+  if (hiz.texture.create(width, height, 1, WGPUTextureDimension_2D,
+                         WGPUTextureFormat_R32Float,
+                         WGPUTextureUsage_StorageBinding, mipLevelCount,
+                         "HiZ") != Result::eSuccess ||
+      !hiz.texture.getTexture()) {
+    sLogger->error("Failed to create depth pyramid!");
+    mHiZs.erase(depthIMGH.idx);
+    return nullptr;
+  }
 
-  mBuffer = wgpuDeviceCreateBuffer(sDevice, &bufferDesc);
-  if (!mBuffer) {
-    spdlog::error("Failed to create Uniform buffer!");
-    return Result::eWGPUError;
+  return &hiz;
+}
+
+void CullingWebGPU::build(WGPUComputePassEncoder computePassEncoder,
+                          ImageHandle depthIMGH, HiZ &hiz) {
+  const uint32_t mipLevelCount = hiz.texture.getMipLevelCount();
+  WGPUExtent3D extent = hiz.texture.getExtent();
+
+  for (uint32_t mip = 0; mip < mipLevelCount; mip++) {
+    const Pipeline &pipeline =
+        mip == 0 ? mDepthReducePipeline : mReducePipeline;
+
+    WGPUTextureView srcView =
+        mip == 0 ? sTextures[depthIMGH.idx].findOrCreateTextureView(
+                       WGPUTextureAspect_DepthOnly)
+                 : hiz.texture.findOrCreateTextureView(
+                       WGPUTextureAspect_All, 0, 1,
+                       CBZ_TEXTURE_VIEW_DIMENSION_2D, mip - 1, 1);
+    WGPUTextureView dstView = hiz.texture.findOrCreateTextureView(
+        WGPUTextureAspect_All, 0, 1, CBZ_TEXTURE_VIEW_DIMENSION_2D, mip, 1);
+
+    std::array<WGPUBindGroupEntry, 2> entries = {};
+    entries[0].nextInChain = nullptr;
+    entries[0].binding = 0;
+    entries[0].textureView = srcView;
+
+    entries[1].nextInChain = nullptr;
+    entries[1].binding = 1;
+    entries[1].textureView = dstView;
+
+    WGPUBindGroupDescriptor bindGroupDesc = {};
+    bindGroupDesc.nextInChain = nullptr;
+    bindGroupDesc.label = nullptr;
+    bindGroupDesc.layout = pipeline.bindGroupLayout;
+    bindGroupDesc.entryCount = static_cast<uint32_t>(entries.size());
+    bindGroupDesc.entries = entries.data();
+
+    WGPUBindGroup bindGroup =
+        wgpuDeviceCreateBindGroup(sDevice, &bindGroupDesc);
+    mBindGroups.push_back(bindGroup);
+
+    wgpuComputePassEncoderSetPipeline(computePassEncoder, pipeline.pipeline);
+    wgpuComputePassEncoderSetBindGroup(computePassEncoder, 0, bindGroup, 0,
+                                       nullptr);
+    wgpuComputePassEncoderDispatchWorkgroups(computePassEncoder,
+                                             (extent.width + 7) / 8,
+                                             (extent.height + 7) / 8, 1);
+
+    extent.width = std::max(extent.width >> 1, 1u);
+    extent.height = std::max(extent.height >> 1, 1u);
+  }
+}
+
+void CullingWebGPU::destroyPipeline(Pipeline &pipeline) {
+  if (pipeline.pipeline) {
+    wgpuComputePipelineRelease(pipeline.pipeline);
+  }
+
+  if (pipeline.pipelineLayout) {
+    wgpuPipelineLayoutRelease(pipeline.pipelineLayout);
+  }
+
+  if (pipeline.bindGroupLayout) {
+    wgpuBindGroupLayoutRelease(pipeline.bindGroupLayout);
   }
 
-  if (data) {
-    AlignedWriteBufferWGPU(mBuffer, data, size);
+  if (pipeline.module) {
+    wgpuShaderModuleRelease(pipeline.module);
   }
 
-  return Result::eSuccess;
+  pipeline = {};
 }
 
-void StorageBufferWebWGPU::update(const void *data, uint32_t elementCount,
-                                  uint32_t elementOffset) {
-  uint32_t size = UniformTypeGetSize(mElementType) * elementCount;
+void TextureTableWebGPU::set(uint32_t index, ImageHandle imgh) {
+  if (index >= MAX_TEXTURE_TABLE_SIZE) {
+    sLogger->error("Texture table index {} out of range!", index);
+    return;
+  }
 
-  // 0 is considered whole size;
-  if (elementCount == 0) {
-    size = UniformTypeGetSize(mElementType) * mElementCount;
+  if (mImages.empty()) {
+    mImages.resize(MAX_TEXTURE_TABLE_SIZE, {CBZ_INVALID_HANDLE});
   }
 
-  uint64_t offset = UniformTypeGetSize(mElementType) * elementOffset;
+  mImages[index] = imgh;
+  invalidate();
+}
 
-  if (size + offset > getSize()) {
-    sLogger->error("Buffer update out of bounds: offset ({}) + size ({}) "
-                   "exceeds buffer size ({}).",
-                   offset, size, getSize());
-    return;
+void TextureTableWebGPU::discard(ImageHandle imgh) {
+  bool found = false;
+  for (ImageHandle &image : mImages) {
+    if (image.idx == imgh.idx) {
+      image = {CBZ_INVALID_HANDLE};
+      found = true;
+    }
   }
 
-  // TODO: Aligned write w offset
-  wgpuQueueWriteBuffer(sQueue, mBuffer, offset, data, size);
+  if (found) {
+    invalidate();
+  }
 }
 
-void StorageBufferWebWGPU::destroy() {
-  if (!mBuffer) {
-    spdlog::warn("Attempting to destroy invalid storage buffer!");
-    return;
+bool TextureTableWebGPU::getViews(uint32_t groupHash, uint32_t count,
+                                  std::vector<WGPUTextureView> *views,
+                                  std::vector<uint32_t> *images) {
+  if (!mPlaceholder.getTexture() &&
+      mPlaceholder.create(1, 1, 1, WGPUTextureDimension_2D,
+                          WGPUTextureFormat_RGBA8Unorm,
+                          WGPUTextureUsage_TextureBinding, 1,
+                          "TextureTablePlaceholder") != Result::eSuccess) {
+    sLogger->error("Failed to create texture table placeholder!");
+    return false;
   }
 
-  wgpuBufferDestroy(mBuffer);
-}
+  WGPUTextureView placeholderView = mPlaceholder.findOrCreateTextureView(
+      WGPUTextureAspect_All, 0, 1, CBZ_TEXTURE_VIEW_DIMENSION_2D);
 
-Result TextureWebGPU::create(uint32_t w, uint32_t h, uint32_t depth,
-                             WGPUTextureDimension dimension,
-                             WGPUTextureFormat format,
-                             WGPUTextureUsageFlags usage,
-                             const std::string &name) {
-  WGPUTextureDescriptor textDesc = {};
-  textDesc.nextInChain = nullptr;
-  textDesc.label = name.c_str();
+  views->assign(count, placeholderView);
+  for (uint32_t index = 0; index < count && index < mImages.size(); index++) {
+    const ImageHandle imgh = mImages[index];
+    if (imgh.idx == CBZ_INVALID_HANDLE) {
+      continue;
+    }
 
-  textDesc.usage =
-      WGPUTextureUsage_CopyDst | WGPUTextureUsage_TextureBinding | usage;
-  textDesc.dimension = dimension;
-  textDesc.size.width = w;
-  textDesc.size.height = h;
-  textDesc.size.depthOrArrayLayers = depth;
-  textDesc.format = format;
-  textDesc.mipLevelCount = 1;
-  textDesc.sampleCount = 1;
-  textDesc.viewFormatCount = 0;
-  textDesc.viewFormats = nullptr;
+    // Images that change release the group like any other binding.
+    images->push_back(imgh.idx);
 
-  mTexture = wgpuDeviceCreateTexture(sDevice, &textDesc);
-  return Result::eSuccess;
-}
+    if (sTextures[imgh.idx].getTexture()) {
+      uint32_t baseMipLevel = 0;
+      uint32_t mipLevelCount = 0;
+      sTextureStreamer.clampView(imgh, &baseMipLevel, &mipLevelCount);
 
-Result TextureWebGPU::create(WGPUTexture texture) {
-  mTexture = texture;
-  return Result::eSuccess;
-}
+      (*views)[index] = sTextures[imgh.idx].findOrCreateTextureView(
+          WGPUTextureAspect_All, 0, 1, CBZ_TEXTURE_VIEW_DIMENSION_2D,
+          baseMipLevel, mipLevelCount);
+    }
+  }
 
-void TextureWebGPU::update(void *data, uint32_t count) {
-  const uint32_t formatSize = TextureFormatGetSize(
-      static_cast<CBZTextureFormat>(wgpuTextureGetFormat(mTexture)));
-  const uint32_t size = formatSize * count;
+  if (std::find(mBindGroups.begin(), mBindGroups.end(), groupHash) ==
+      mBindGroups.end()) {
+    mBindGroups.push_back(groupHash);
+  }
+  return true;
+}
 
-  WGPUImageCopyTexture destination = {};
-  destination.nextInChain = nullptr;
-  destination.texture = mTexture;
-  destination.mipLevel = 0;
-  destination.origin = {0, 0, 0};
+void TextureTableWebGPU::destroy() {
+  invalidate();
+  mImages.clear();
 
-  switch (getFormat()) {
-  case WGPUTextureFormat_Depth16Unorm:
-  case WGPUTextureFormat_Depth24Plus:
-  case WGPUTextureFormat_Depth24PlusStencil8:
-  case WGPUTextureFormat_Depth32Float:
-  case WGPUTextureFormat_Depth32FloatStencil8: {
-    destination.aspect = WGPUTextureAspect_DepthOnly;
-  } break;
-  default: {
-    destination.aspect = WGPUTextureAspect_All;
-  } break;
+  if (mPlaceholder.getTexture()) {
+    mPlaceholder.destroy();
+    mPlaceholder = {};
   }
-  destination.aspect = WGPUTextureAspect_All;
+}
 
-  WGPUTextureDataLayout dataLayout = {};
-  dataLayout.nextInChain = nullptr;
-  dataLayout.offset = 0;
-  dataLayout.bytesPerRow = formatSize * wgpuTextureGetWidth(mTexture);
-  dataLayout.rowsPerImage = wgpuTextureGetHeight(mTexture);
+void TextureTableWebGPU::invalidate() {
+  if (!mBindGroups.empty()) {
+    DrawListResourceChanged(DrawListResource::eTextureTable, 0);
+  }
 
-  WGPUExtent3D extent = {};
-  extent.width = wgpuTextureGetWidth(mTexture);
-  extent.height = wgpuTextureGetHeight(mTexture);
-  extent.depthOrArrayLayers = wgpuTextureGetDepthOrArrayLayers(mTexture);
+  for (uint32_t groupHash : mBindGroups) {
+    ReleaseBindGroup(groupHash);
+  }
 
-  wgpuQueueWriteTexture(sQueue, &destination, data, size, &dataLayout, &extent);
+  mBindGroups.clear();
 }
 
-WGPUTextureView TextureWebGPU::findOrCreateTextureView(
-    WGPUTextureAspect aspect, uint32_t baseArrayLayer, uint32_t arrayLayerCount,
-    CBZTextureViewDimension viewDimension) {
-  uint32_t textureViewKey[]{static_cast<uint32_t>(aspect), baseArrayLayer,
-                            arrayLayerCount};
-  uint32_t textureViewHash;
-  MurmurHash3_x86_32(textureViewKey, sizeof(textureViewKey), 0,
-                     &textureViewHash);
+void DrawListWebGPU::update(std::vector<ShaderProgramCommand> &&cmds) {
+  releaseBundles();
+  mCmds = std::move(cmds);
+  mEpoch = sDrawListEpoch;
+  mCheckedEpoch = sDrawListEpoch;
+
+  mResources.clear();
+  for (const ShaderProgramCommand &cmd : mCmds) {
+    const auto &graphics = cmd.program.graphics;
+    const ShaderHandle sh = sGraphicsPrograms[graphics.ph.idx].getShader();
+    mResources.push_back(DrawListResourceKey(
+        DrawListResource::eGraphicsProgram, graphics.ph.idx));
+    mResources.push_back(
+        DrawListResourceKey(DrawListResource::eShader, sh.idx));
+
+    for (uint32_t vbIdx = 0; vbIdx < graphics.vbCount; vbIdx++) {
+      mResources.push_back(DrawListResourceKey(
+          DrawListResource::eVertexBuffer, graphics.vbhs[vbIdx].idx));
+    }
 
-  if (mViews.find(textureViewHash) != mViews.end()) {
-    return mViews[textureViewHash];
+    mResources.push_back(
+        DrawListResourceKey(DrawListResource::eIndexBuffer, graphics.ibh.idx));
+
+    if (graphics.indirectCount > 0) {
+      mResources.push_back(DrawListResourceKey(
+          DrawListResource::eStructuredBuffer, graphics.argsSBH.idx));
+    }
+
+    for (const Binding &binding : cmd.bindings) {
+      switch (binding.type) {
+      case BindingType::eUniformBuffer:
+        mResources.push_back(
+            DrawListResourceKey(DrawListResource::eUniform,
+                                binding.value.uniformBuffer.handle.idx));
+        break;
+      case BindingType::eRWStructuredBuffer:
+      case BindingType::eStructuredBuffer:
+        // Replays bind the camera of their submit instead.
+        if (BindingIsCamera(binding)) {
+          break;
+        }
+
+        mResources.push_back(
+            DrawListResourceKey(DrawListResource::eStructuredBuffer,
+                                binding.value.storageBuffer.handle.idx));
+        break;
+      case BindingType::eTexture2D:
+      case BindingType::eTextureCube:
+        mResources.push_back(DrawListResourceKey(
+            DrawListResource::eImage, binding.value.texture.handle.idx));
+        break;
+      case BindingType::eTextureTable:
+        mResources.push_back(
+            DrawListResourceKey(DrawListResource::eTextureTable, 0));
+        break;
+      case BindingType::eSampler:
+      case BindingType::eNone:
+        break;
+      }
+    }
   }
 
-  WGPUTextureViewDescriptor textureView = {};
-  textureView.nextInChain = nullptr;
+  std::sort(mResources.begin(), mResources.end());
+  mResources.erase(std::unique(mResources.begin(), mResources.end()),
+                   mResources.end());
+}
 
-  textureView.format = wgpuTextureGetFormat(mTexture);
+WGPURenderBundle DrawListWebGPU::findBundle(uint32_t targetHash,
+                                            StructuredBufferHandle cameraSBH) {
+  if (mCheckedEpoch != sDrawListEpoch) {
+    mCheckedEpoch = sDrawListEpoch;
 
-  textureView.aspect = aspect;
+    bool changed = false;
+    for (uint64_t key : mResources) {
+      changed = changed || DrawListResourceEpoch(key) > mEpoch;
+    }
 
-  switch (viewDimension) {
-  case CBZ_TEXTURE_VIEW_DIMENSION_2D:
-    textureView.dimension = WGPUTextureViewDimension_2D;
-    break;
-  case CBZ_TEXTURE_VIEW_DIMENSION_CUBE:
-    textureView.dimension = WGPUTextureViewDimension_Cube;
-    break;
+    for (const auto &[bundleKey, bundle] : mBundles) {
+      changed = changed || DrawListResourceEpoch(DrawListResourceKey(
+                               DrawListResource::eStructuredBuffer,
+                               static_cast<uint32_t>(bundleKey >> 32))) >
+                               mEpoch;
+    }
+
+    if (changed) {
+      releaseBundles();
+      mEpoch = sDrawListEpoch;
+      return nullptr;
+    }
   }
-  textureView.baseMipLevel = 0;
-  textureView.mipLevelCount = 1;
-  textureView.baseArrayLayer = baseArrayLayer;
-  textureView.arrayLayerCount = arrayLayerCount;
-  textureView.aspect = aspect;
 
-  return mViews[textureViewHash] =
-             wgpuTextureCreateView(mTexture, &textureView);
+  auto it = mBundles.find(static_cast<uint64_t>(cameraSBH.idx) << 32 |
+                          targetHash);
+  return it != mBundles.end() ? it->second : nullptr;
 }
 
-void TextureWebGPU::destroyTextureViews() {
-  for (auto it : mViews) {
-    WGPUTextureView view = it.second;
-    wgpuTextureViewRelease(view);
-  }
+void DrawListWebGPU::addBundle(uint32_t targetHash,
+                               StructuredBufferHandle cameraSBH,
+                               WGPURenderBundle bundle) {
+  mBundles[static_cast<uint64_t>(cameraSBH.idx) << 32 | targetHash] = bundle;
 }
 
-void TextureWebGPU::destroy() {
-  if (!mTexture) {
-    sLogger->warn("Attempting to release uninitialized texture!");
-    return;
-  }
+void DrawListWebGPU::destroy() {
+  releaseBundles();
+  mCmds.clear();
+}
 
-  destroyTextureViews();
+void DrawListWebGPU::releaseBundles() {
+  // Passes executing a bundle keep it alive until they complete.
+  for (const auto &[targetHash, bundle] : mBundles) {
+    wgpuRenderBundleRelease(bundle);
+  }
 
-  wgpuTextureRelease(mTexture);
-  mTexture = NULL;
+  mBundles.clear();
 }
 
 void ShaderWebGPU::parseJsonRecursive(const nlohmann::json &varJson,
@@ -916,12 +4701,36 @@ void ShaderWebGPU::parseJsonRecursive(const nlohmann::json &varJson,
     std::string bindingKind =
         bindingJson.value("kind", "<unknown_binding_kind");
 
+    if (bindingKind == "registerSpace" ||
+        bindingKind == "subElementRegisterSpace") {
+      // Parameter blocks bind in their own group.
+      offsets.group = bindingJson.value("index", 0u);
+      offsets.bindingOffset = 0;
+    }
+
+    if (bindingKind == "pushConstantBuffer") {
+      // Push constants live in the pipeline layout, not in the bind group.
+      uint32_t size = 0;
+      if (varJson.contains("type") &&
+          varJson["type"].contains("elementVarLayout") &&
+          varJson["type"]["elementVarLayout"].contains("binding")) {
+        size = varJson["type"]["elementVarLayout"]["binding"].value("size", 0u);
+      }
+      mPushConstantSize = std::max(
+          mPushConstantSize,
+          static_cast<uint32_t>(AlignUp(size, sizeof(uint32_t))));
+
+      sLogger->trace("push constants: '{}' ({} bytes)", name, size);
+      return;
+    }
+
     if (bindingKind == "descriptorTableSlot") {
       const auto &typeJson =
           varJson.contains("type") ? varJson["type"] : varJson;
       std::string typeKind = typeJson.value("kind", "<unknown_kind>");
 
       int bindingIndex = bindingJson.value("index", -1);
+      uint32_t group = offsets.group + bindingJson.value("space", 0u);
       if (typeKind != "struct") {
         uint32_t globalBindingIdx = offsets.bindingOffset + bindingIndex;
         if (globalBindingIdx > std::numeric_limits<uint8_t>::max()) {
@@ -930,6 +4739,7 @@ void ShaderWebGPU::parseJsonRecursive(const nlohmann::json &varJson,
 
         mBindingDescs.push_back({});
         mBindingDescs.back().index = static_cast<uint8_t>(globalBindingIdx);
+        mBindingDescs.back().group = static_cast<uint8_t>(group);
         mBindingDescs.back().name = name;
 
         isNewBinding = true;
@@ -1069,6 +4879,32 @@ void ShaderWebGPU::parseJsonRecursive(const nlohmann::json &varJson,
     return;
   }
 
+  if (typeKind == "array") {
+    const auto &elementTypeJson = typeJson["elementType"];
+
+    // Texture arrays bind the global texture table.
+    if (isNewBinding && elementTypeJson.value("kind", "") == "resource" &&
+        elementTypeJson.value("baseShape", "") == "texture2D") {
+      const uint32_t elementCount = typeJson.value("elementCount", 0u);
+
+      mBindingDescs.back().type = BindingType::eTextureTable;
+      mBindingDescs.back().elementCount =
+          elementCount > 0 ? elementCount : MAX_TEXTURE_TABLE_SIZE;
+
+      sLogger->trace("    - texture table: {}", elementCount);
+      return;
+    }
+  }
+
+  if (typeKind == "parameterBlock") {
+    // Blocks hold resources; uniform fields are not bound.
+    for (const auto &fieldJson : typeJson["elementType"]["fields"]) {
+      parseJsonRecursive(fieldJson, false, offsets);
+    }
+
+    return;
+  }
+
   if (typeKind == "samplerState") {
     if (isNewBinding) {
       mBindingDescs.back().type = BindingType::eSampler;
@@ -1145,6 +4981,18 @@ void ShaderWebGPU::parseJsonRecursive(const nlohmann::json &varJson,
 }
 
 Result ShaderWebGPU::create(const std::string &path, CBZShaderFlags flags) {
+  if (load(path, flags) != Result::eSuccess) {
+    mStatus = ShaderStatus::eFailed;
+    return Result::eFailure;
+  }
+
+  return createModule();
+}
+
+Result ShaderWebGPU::load(const std::string &path, CBZShaderFlags flags) {
+  mPath = path;
+  mFlags = flags;
+
   std::filesystem::path shaderPath = path;
   std::filesystem::path reflectionPath = path;
   reflectionPath.replace_extension(".json");
@@ -1163,10 +5011,54 @@ Result ShaderWebGPU::create(const std::string &path, CBZShaderFlags flags) {
   nlohmann::json reflectionJson = nlohmann::json::parse(reflectionStream);
 
   // Parse uniforms
+  mPushConstantSize = 0;
   for (const auto &paramJson : reflectionJson["parameters"]) {
     parseJsonRecursive(paramJson, false, {});
   }
 
+  mBindGroupCount = 1;
+  for (const BindingDesc &bindingDesc : mBindingDescs) {
+    mBindGroupCount = std::max(mBindGroupCount, bindingDesc.group + 1u);
+  }
+
+  for (const BindingDesc &bindingDesc : mBindingDescs) {
+    if (bindingDesc.type != BindingType::eTextureTable) {
+      continue;
+    }
+
+    if (!sTextureBindingArrays) {
+      sLogger->error("'{}' declares texture arrays, unsupported by the device!",
+                     path);
+      return Result::eFailure;
+    }
+
+    if (bindingDesc.elementCount > MAX_TEXTURE_TABLE_SIZE) {
+      sLogger->error("'{}' texture array '{}' exceeds {} textures!", path,
+                     bindingDesc.name,
+                     static_cast<uint32_t>(MAX_TEXTURE_TABLE_SIZE));
+      return Result::eFailure;
+    }
+  }
+
+  if (mBindGroupCount > MAX_BIND_GROUPS) {
+    sLogger->error("'{}' declares {} bind groups, max is {}!", path,
+                   mBindGroupCount, static_cast<uint32_t>(MAX_BIND_GROUPS));
+    return Result::eFailure;
+  }
+
+  if (mPushConstantSize > MAX_PUSH_CONSTANT_SIZE) {
+    sLogger->error("'{}' declares {} bytes of push constants, max is {}!",
+                   path, mPushConstantSize,
+                   static_cast<uint32_t>(MAX_PUSH_CONSTANT_SIZE));
+    return Result::eFailure;
+  }
+
+  if (mPushConstantSize > 0 && !sPushConstants) {
+    sLogger->error("'{}' declares push constants, unsupported by the device!",
+                   path);
+    return Result::eFailure;
+  }
+
   // Vertex Input scope
   for (const auto &entryPoint : reflectionJson["entryPoints"]) {
     if (entryPoint.value("stage", "") == "fragment") {
@@ -1236,79 +5128,164 @@ Result ShaderWebGPU::create(const std::string &path, CBZShaderFlags flags) {
     }
   }
 
+  if ((flags & CBZ_SHADER_SPIRV) == CBZ_SHADER_SPIRV) {
+    if (LoadFileAsBinary(shaderPath.string(), mSource) != Result::eSuccess) {
+      return Result::eWGPUError;
+    }
+  } else {
+    std::string shaderSrcCode;
+    if (LoadFileAsText(shaderPath.string(), shaderSrcCode) !=
+        Result::eSuccess) {
+      return Result::eWGPUError;
+    }
+
+    // Keep null terminator for WGSL descriptor.
+    mSource.assign(shaderSrcCode.c_str(),
+                   shaderSrcCode.c_str() + shaderSrcCode.size() + 1);
+  }
+
+  return Result::eSuccess;
+}
+
+Result ShaderWebGPU::createModule() {
+  // Bindings are visible to every stage of the shader.
+  uint32_t uniformBufferCount = 0;
+  uint32_t storageBufferCount = 0;
+  for (const BindingDesc &bindingDesc : mBindingDescs) {
+    if (bindingDesc.type == BindingType::eUniformBuffer) {
+      uniformBufferCount++;
+    } else if (bindingDesc.type == BindingType::eStructuredBuffer ||
+               bindingDesc.type == BindingType::eRWStructuredBuffer) {
+      storageBufferCount++;
+    }
+  }
+
+  if (uniformBufferCount > sLimits.maxUniformBuffersPerShaderStage ||
+      storageBufferCount > sLimits.maxStorageBuffersPerShaderStage) {
+    sLogger->error("Shader '{}' binds {} uniform and {} storage buffers, "
+                   "limits are {} and {} per stage!",
+                   mPath, uniformBufferCount, storageBufferCount,
+                   sLimits.maxUniformBuffersPerShaderStage,
+                   sLimits.maxStorageBuffersPerShaderStage);
+    mSource.clear();
+    mStatus = ShaderStatus::eFailed;
+    return Result::eFailure;
+  }
+
   WGPUShaderModuleDescriptor shaderModuleDesc{};
 
-  shaderModuleDesc.label = path.c_str();
+  shaderModuleDesc.label = mPath.c_str();
 #ifdef WEBGPU_BACKEND_WGPU
   shaderModuleDesc.hintCount = 0;
   shaderModuleDesc.hints = nullptr;
 #endif
 
-  if ((flags & CBZ_SHADER_SPIRV) == CBZ_SHADER_SPIRV) {
-    std::vector<uint8_t> shaderSrcCode;
-    if (LoadFileAsBinary(shaderPath.string(), shaderSrcCode) !=
-        Result::eSuccess) {
-      return Result::eWGPUError;
-    }
-
-    WGPUShaderModuleSPIRVDescriptor shaderCodeDesc = {};
-    shaderCodeDesc.chain.next = nullptr;
-    shaderCodeDesc.chain.sType = WGPUSType_ShaderModuleSPIRVDescriptor;
-    shaderCodeDesc.code =
-        reinterpret_cast<const uint32_t *>(shaderSrcCode.data());
-    shaderCodeDesc.codeSize =
-        static_cast<uint32_t>(shaderSrcCode.size()) / sizeof(uint32_t);
-    shaderModuleDesc.nextInChain = &shaderCodeDesc.chain;
+  WGPUShaderModuleSPIRVDescriptor spirvCodeDesc = {};
+  WGPUShaderModuleWGSLDescriptor wgslCodeDesc = {};
 
-    mModule = wgpuDeviceCreateShaderModule(sDevice, &shaderModuleDesc);
-    if (!mModule) {
-      return Result::eFailure;
-    }
+  if ((mFlags & CBZ_SHADER_SPIRV) == CBZ_SHADER_SPIRV) {
+    spirvCodeDesc.chain.next = nullptr;
+    spirvCodeDesc.chain.sType = WGPUSType_ShaderModuleSPIRVDescriptor;
+    spirvCodeDesc.code = reinterpret_cast<const uint32_t *>(mSource.data());
+    spirvCodeDesc.codeSize =
+        static_cast<uint32_t>(mSource.size()) / sizeof(uint32_t);
+    shaderModuleDesc.nextInChain = &spirvCodeDesc.chain;
   } else {
-    std::string shaderSrcCode;
-    if (LoadFileAsText(shaderPath.string(), shaderSrcCode) !=
-        Result::eSuccess) {
-      return Result::eWGPUError;
+    wgslCodeDesc.chain.next = nullptr;
+    wgslCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+    wgslCodeDesc.code = reinterpret_cast<const char *>(mSource.data());
+    shaderModuleDesc.nextInChain = &wgslCodeDesc.chain;
+  }
+
+  mModule = wgpuDeviceCreateShaderModule(sDevice, &shaderModuleDesc);
+
+  // Source is no longer needed once the module exists.
+  mSource.clear();
+  mSource.shrink_to_fit();
+
+  if (!mModule) {
+    mStatus = ShaderStatus::eFailed;
+    return Result::eFailure;
+  }
+
+  mStatus = ShaderStatus::eReady;
+  return Result::eSuccess;
+}
+
+uint32_t ShaderWebGPU::getGroupBindings(uint8_t group, const Binding *bindings,
+                                        uint32_t bindingCount,
+                                        Binding *groupBindings) const {
+  uint32_t groupBindingCount = 0;
+  for (const BindingDesc &bindingDesc : mBindingDescs) {
+    if (bindingDesc.group != group ||
+        groupBindingCount == MAX_COMMAND_BINDINGS) {
+      continue;
     }
 
-    std::string slangSrcCode;
-    if (LoadFileAsText(shaderPath.string(), slangSrcCode) != Result::eSuccess) {
-      return Result::eWGPUError;
+    if (const Binding *binding =
+            BindingFind(bindingDesc, bindings, bindingCount)) {
+      groupBindings[groupBindingCount++] = *binding;
     }
+  }
 
-    WGPUShaderModuleWGSLDescriptor shaderCodeDesc = {};
-    shaderCodeDesc.chain.next = nullptr;
-    shaderCodeDesc.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
-    shaderCodeDesc.code = shaderSrcCode.c_str();
-    shaderModuleDesc.nextInChain = &shaderCodeDesc.chain;
+  return groupBindingCount;
+}
 
-    mModule = wgpuDeviceCreateShaderModule(sDevice, &shaderModuleDesc);
-    if (!mModule) {
-      return Result::eFailure;
+bool ShaderWebGPU::findOrCreateBindGroupLayouts(const Binding *bindings,
+                                                uint32_t bindingCount,
+                                                WGPUBindGroupLayout *layouts) {
+  Binding groupBindings[MAX_COMMAND_BINDINGS];
+
+  for (uint32_t group = 0; group < mBindGroupCount; group++) {
+    const uint32_t groupBindingCount =
+        getGroupBindings(group, bindings, bindingCount, groupBindings);
+
+    layouts[group] =
+        findOrCreateBindGroupLayout(group, groupBindings, groupBindingCount);
+    if (!layouts[group]) {
+      return false;
     }
   }
 
-  return Result::eSuccess;
+  return true;
 }
 
 WGPUBindGroupLayout
-ShaderWebGPU::findOrCreateBindGroupLayout(const Binding *bindings,
+ShaderWebGPU::findOrCreateBindGroupLayout(uint8_t group,
+                                          const Binding *bindings,
                                           uint32_t bindingCount) {
   uint32_t hash;
-  MurmurHash3_x86_32(bindings, sizeof(Binding) * bindingCount, 0, &hash);
+  MurmurHash3_x86_32(bindings, sizeof(Binding) * bindingCount, group, &hash);
 
   if (mBindGroupLayouts.find(hash) != mBindGroupLayouts.end()) {
     return mBindGroupLayouts[hash];
   }
 
-  std::vector<WGPUBindGroupLayoutEntry> bindingEntries(getBindings().size());
+  CreationBudget::Scope creation(sCreationBudget);
+  if (!creation) {
+    return nullptr;
+  }
+
+  std::vector<const BindingDesc *> groupDescs;
+  for (const BindingDesc &bindingDesc : mBindingDescs) {
+    if (bindingDesc.group == group) {
+      groupDescs.push_back(&bindingDesc);
+    }
+  }
+
+  std::vector<WGPUBindGroupLayoutEntry> bindingEntries(groupDescs.size());
+#ifdef WEBGPU_BACKEND_WGPU
+  std::vector<WGPUBindGroupLayoutEntryExtras> bindingEntryExtras(
+      groupDescs.size());
+#endif
 
   for (size_t i = 0; i < bindingEntries.size(); i++) {
+    const BindingDesc &bindingDesc = *groupDescs[i];
+
     bindingEntries[i] = {};
-    bindingEntries[i].binding = mBindingDescs[i].index;
+    bindingEntries[i].binding = bindingDesc.index;
     bindingEntries[i].visibility = getShaderStages();
 
-    const BindingDesc &bindingDesc = getBindings()[i];
     switch (bindingDesc.type) {
     case BindingType::eUniformBuffer:
       bindingEntries[i].buffer.type = WGPUBufferBindingType_Uniform;
@@ -1321,7 +5298,7 @@ ShaderWebGPU::findOrCreateBindGroupLayout(const Binding *bindings,
     case BindingType::eRWStructuredBuffer:
     case BindingType::eStructuredBuffer:
       bindingEntries[i].buffer.type = WGPUBufferBindingType_ReadOnlyStorage;
-      if (mBindingDescs[i].type == BindingType::eRWStructuredBuffer) {
+      if (bindingDesc.type == BindingType::eRWStructuredBuffer) {
         bindingEntries[i].buffer.type = WGPUBufferBindingType_Storage;
       }
 
@@ -1394,9 +5371,23 @@ ShaderWebGPU::findOrCreateBindGroupLayout(const Binding *bindings,
       }
     } break;
 
+    case BindingType::eTextureTable: {
+#ifdef WEBGPU_BACKEND_WGPU
+      bindingEntryExtras[i].chain.next = nullptr;
+      bindingEntryExtras[i].chain.sType =
+          static_cast<WGPUSType>(WGPUSType_BindGroupLayoutEntryExtras);
+      bindingEntryExtras[i].count = bindingDesc.elementCount;
+      bindingEntries[i].nextInChain = &bindingEntryExtras[i].chain;
+#endif
+
+      bindingEntries[i].texture.nextInChain = nullptr;
+      bindingEntries[i].texture.viewDimension = WGPUTextureViewDimension_2D;
+      bindingEntries[i].texture.sampleType = WGPUTextureSampleType_Float;
+    } break;
+
     case BindingType::eNone:
       sLogger->error("Unsupported binding type <{}> for {}",
-                     (uint32_t)getBindings()[i].type);
+                     (uint32_t)bindingDesc.type, bindingDesc.name);
       break;
     }
   }
@@ -1412,8 +5403,12 @@ ShaderWebGPU::findOrCreateBindGroupLayout(const Binding *bindings,
 }
 
 void ShaderWebGPU::destroy() {
-  wgpuShaderModuleRelease(mModule);
+  if (mModule) {
+    wgpuShaderModuleRelease(mModule);
+  }
+
   mModule = NULL;
+  mStatus = ShaderStatus::eNone;
 }
 
 Result GraphicsProgramWebGPU::create(ShaderHandle sh, int flags,
@@ -1425,8 +5420,9 @@ Result GraphicsProgramWebGPU::create(ShaderHandle sh, int flags,
 }
 
 WGPURenderPipeline GraphicsProgramWebGPU::findOrCreatePipeline(
-    const RenderTarget &target, WGPUBindGroupLayout bindGroupLayout,
-    const VertexBufferHandle *vbhs, uint32_t vbCount) {
+    const RenderTarget &target, const WGPUBindGroupLayout *bindGroupLayouts,
+    uint32_t bindGroupLayoutCount, const VertexBufferHandle *vbhs,
+    uint32_t vbCount) {
   uint32_t pipelineId;
 
   struct PipelineKey {
@@ -1434,8 +5430,11 @@ WGPURenderPipeline GraphicsProgramWebGPU::findOrCreatePipeline(
     cbz::ImageHandle color[MAX_TARGET_COLOR_ATTACHMENTS];
     int depthFlags;
     cbz::ImageHandle depth;
+    uint32_t sampleCount;
   } key = {};
 
+  key.sampleCount = target.sampleCount;
+
   for (size_t i = 0; i < target.colorAttachments.size(); i++) {
     key.color[i] = target.colorAttachments[i].imgh;
     key.colorFlags[i] = target.colorAttachments[i].flags;
@@ -1452,13 +5451,36 @@ WGPURenderPipeline GraphicsProgramWebGPU::findOrCreatePipeline(
     return it->second;
   }
 
+  CreationBudget::Scope creation(sCreationBudget);
+  if (!creation) {
+    return nullptr;
+  }
+
   const ShaderWebGPU *shader = &sShaders[mShaderHandle.idx];
 
   WGPUPipelineLayoutDescriptor pipelineLayoutDesc = {};
   pipelineLayoutDesc.nextInChain = nullptr;
   pipelineLayoutDesc.label = nullptr;
-  pipelineLayoutDesc.bindGroupLayoutCount = 1;
-  pipelineLayoutDesc.bindGroupLayouts = &bindGroupLayout;
+  pipelineLayoutDesc.bindGroupLayoutCount = bindGroupLayoutCount;
+  pipelineLayoutDesc.bindGroupLayouts = bindGroupLayouts;
+
+#ifdef WEBGPU_BACKEND_WGPU
+  WGPUPushConstantRange pushConstantRange = {};
+  pushConstantRange.stages = PUSH_CONSTANT_STAGES;
+  pushConstantRange.start = 0;
+  pushConstantRange.end = shader->getPushConstantSize();
+
+  WGPUPipelineLayoutExtras pipelineLayoutExtras = {};
+  pipelineLayoutExtras.chain.next = nullptr;
+  pipelineLayoutExtras.chain.sType =
+      static_cast<WGPUSType>(WGPUSType_PipelineLayoutExtras);
+  pipelineLayoutExtras.pushConstantRangeCount = 1;
+  pipelineLayoutExtras.pushConstantRanges = &pushConstantRange;
+
+  if (shader->getPushConstantSize() > 0) {
+    pipelineLayoutDesc.nextInChain = &pipelineLayoutExtras.chain;
+  }
+#endif
 
   WGPUPipelineLayout pipelineLayout = mPipelineLayouts[pipelineId] =
       wgpuDeviceCreatePipelineLayout(sDevice, &pipelineLayoutDesc);
@@ -1523,8 +5545,8 @@ WGPURenderPipeline GraphicsProgramWebGPU::findOrCreatePipeline(
     depthStencilState.depthWriteEnabled = true;
 
     if ((target.depthAttachment.flags &
-         CBZ_RENDER_ATTACHMENT_DEPTH_WRITE_DISABLE) ==
-        CBZ_RENDER_ATTACHMENT_DEPTH_WRITE_DISABLE) {
+         (CBZ_RENDER_ATTACHMENT_DEPTH_WRITE_DISABLE |
+          CBZ_RENDER_ATTACHMENT_READ_ONLY)) != 0) {
       depthStencilState.depthWriteEnabled = false;
     }
 
@@ -1553,7 +5575,7 @@ WGPURenderPipeline GraphicsProgramWebGPU::findOrCreatePipeline(
 
   WGPUMultisampleState multiSampleState = {};
   multiSampleState.nextInChain = nullptr;
-  multiSampleState.count = 1;
+  multiSampleState.count = target.sampleCount;
   multiSampleState.mask = ~0u;
   multiSampleState.alphaToCoverageEnabled = false;
   pipelineDesc.multisample = multiSampleState;
@@ -1627,17 +5649,27 @@ void GraphicsProgramWebGPU::destroy() {
 
 Result ComputeProgramWebGPU::create(ShaderHandle sh, const std::string &name) {
   mShaderHandle = sh;
+  mName = name;
+
+  if (!sShaders[sh.idx].isReady()) {
+    // Deferred until the shader finishes loading.
+    return Result::eSuccess;
+  }
 
-  const ShaderWebGPU *shader = &sShaders[sh.idx];
+  return createPipeline();
+}
+
+Result ComputeProgramWebGPU::createPipeline() {
+  const ShaderWebGPU *shader = &sShaders[mShaderHandle.idx];
 
   WGPUComputePipelineDescriptor pipelineDesc = {};
   pipelineDesc.nextInChain = nullptr;
-  pipelineDesc.label = name.c_str();
+  pipelineDesc.label = mName.c_str();
 
   pipelineDesc.compute.module = shader->getModule();
   pipelineDesc.compute.entryPoint = "main";
 
-  std::string layoutName = std::string(name) + std::string("_layout");
+  std::string layoutName = mName + std::string("_layout");
   WGPUPipelineLayoutDescriptor pipelineLayoutDesc = {};
   pipelineLayoutDesc.nextInChain = nullptr;
   pipelineLayoutDesc.label = layoutName.c_str();
@@ -1649,11 +5681,29 @@ Result ComputeProgramWebGPU::create(ShaderHandle sh, const std::string &name) {
   pipelineDesc.layout = mPipelineLayout;
 
   mPipeline = wgpuDeviceCreateComputePipeline(sDevice, &pipelineDesc);
+  if (!mPipeline) {
+    return Result::eWGPUError;
+  }
+
   return Result::eSuccess;
 }
 
-Result
-ComputeProgramWebGPU::bind(WGPUComputePassEncoder renderPassEncoder) const {
+Result ComputeProgramWebGPU::bind(WGPUComputePassEncoder renderPassEncoder) {
+  if (!mPipeline) {
+    if (!sShaders[mShaderHandle.idx].isReady()) {
+      return Result::eFailure;
+    }
+
+    CreationBudget::Scope creation(sCreationBudget);
+    if (!creation) {
+      return Result::eFailure;
+    }
+
+    if (createPipeline() != Result::eSuccess) {
+      return Result::eFailure;
+    }
+  }
+
   wgpuComputePassEncoderSetPipeline(renderPassEncoder, mPipeline);
   return Result::eSuccess;
 }
@@ -1672,13 +5722,24 @@ void ComputeProgramWebGPU::destroy() {
   mPipeline = NULL;
 }
 
-Result RendererContextWebGPU::init(uint32_t width, uint32_t height, void *nwh,
+Result RendererContextWebGPU::init(const InitDesc &initDesc, void *nwh,
                                    ImageHandle swapchainIMGH) {
   sLogger = spdlog::stdout_color_mt("cbzrenderer");
   sLogger->set_pattern("[%^%l%$] IRenderer: %v");
 
   mFrameCounter = 0;
 
+  uint32_t workerThreadCount = initDesc.workerThreadCount;
+  if (workerThreadCount == 0) {
+    // Leave a core for the main thread.
+    workerThreadCount =
+        std::max(std::thread::hardware_concurrency(), 2u) - 1u;
+  }
+  sWorkerPool.init(workerThreadCount);
+  sStagingBelt.init(STAGING_BELT_CHUNK_SIZE);
+  sReadbackQueue.init(MAX_READBACKS_IN_FLIGHT);
+  sTextureStreamer.init(STREAMING_DEFAULT_BUDGET);
+
   // net::Endpoint cbzEndPoint = {
   //     net::Address("192.168.1.4"),
   //     net::Port(6000),
@@ -1785,10 +5846,73 @@ Result RendererContextWebGPU::init(uint32_t width, uint32_t height, void *nwh,
     return requiredLimitsRes;
   }
   sLimits = requiredLimits.limits;
+
+  // Texture compression is optional; enable every family the adapter has.
+  // Timestamp queries measure GPU frame time for dynamic resolution.
+  std::vector<WGPUFeatureName> requiredFeatures;
+  for (WGPUFeatureName feature : {WGPUFeatureName_TextureCompressionBC,
+                                  WGPUFeatureName_TextureCompressionETC2,
+                                  WGPUFeatureName_TextureCompressionASTC,
+                                  WGPUFeatureName_TimestampQuery}) {
+    if (wgpuAdapterHasFeature(adapter, feature)) {
+      requiredFeatures.push_back(feature);
+    }
+  }
+
+#ifdef WEBGPU_BACKEND_WGPU
+  // Multi draw indirect collapses indirect draw loops into one call.
+  for (WGPUNativeFeature feature : {WGPUNativeFeature_MultiDrawIndirect,
+                                    WGPUNativeFeature_MultiDrawIndirectCount}) {
+    if (wgpuAdapterHasFeature(adapter,
+                              static_cast<WGPUFeatureName>(feature))) {
+      requiredFeatures.push_back(static_cast<WGPUFeatureName>(feature));
+    }
+  }
+
+  // Push constants carry small per draw data without buffer uploads.
+  WGPUSupportedLimitsExtras supportedLimitsExtras = {};
+  supportedLimitsExtras.chain.next = nullptr;
+  supportedLimitsExtras.chain.sType =
+      static_cast<WGPUSType>(WGPUSType_SupportedLimitsExtras);
+
+  WGPUSupportedLimits nativeSupportedLimits = {};
+  nativeSupportedLimits.nextInChain = &supportedLimitsExtras.chain;
+  wgpuAdapterGetLimits(adapter, &nativeSupportedLimits);
+
+  WGPURequiredLimitsExtras requiredLimitsExtras = {};
+  requiredLimitsExtras.chain.next = nullptr;
+  requiredLimitsExtras.chain.sType =
+      static_cast<WGPUSType>(WGPUSType_RequiredLimitsExtras);
+  requiredLimitsExtras.limits = supportedLimitsExtras.limits;
+  requiredLimitsExtras.limits.maxPushConstantSize = MAX_PUSH_CONSTANT_SIZE;
+
+  if (std::all_of(std::begin(TEXTURE_BINDING_ARRAY_FEATURES),
+                  std::end(TEXTURE_BINDING_ARRAY_FEATURES),
+                  [&](WGPUFeatureName feature) {
+                    return wgpuAdapterHasFeature(adapter, feature);
+                  }) &&
+      requiredLimits.limits.maxSampledTexturesPerShaderStage >=
+          MAX_TEXTURE_TABLE_SIZE) {
+    requiredFeatures.insert(requiredFeatures.end(),
+                            std::begin(TEXTURE_BINDING_ARRAY_FEATURES),
+                            std::end(TEXTURE_BINDING_ARRAY_FEATURES));
+  }
+
+  const WGPUFeatureName pushConstantsFeature =
+      static_cast<WGPUFeatureName>(WGPUNativeFeature_PushConstants);
+  if (wgpuAdapterHasFeature(adapter, pushConstantsFeature) &&
+      supportedLimitsExtras.limits.maxPushConstantSize >=
+          MAX_PUSH_CONSTANT_SIZE) {
+    requiredFeatures.push_back(pushConstantsFeature);
+    requiredLimits.nextInChain = &requiredLimitsExtras.chain;
+  }
+#endif
+
   WGPUDeviceDescriptor deviceDesc = {};
   deviceDesc.nextInChain = nullptr;
   deviceDesc.label = "WGPUDevice";
-  deviceDesc.requiredFeatures = nullptr;
+  deviceDesc.requiredFeatureCount = requiredFeatures.size();
+  deviceDesc.requiredFeatures = requiredFeatures.data();
   deviceDesc.requiredLimits = &requiredLimits;
   deviceDesc.defaultQueue.nextInChain = nullptr;
   deviceDesc.defaultQueue.label = "DefaultQueue";
@@ -1832,32 +5956,46 @@ Result RendererContextWebGPU::init(uint32_t width, uint32_t height, void *nwh,
 
   sDevice = deviceRequest.device;
 
+#ifdef WEBGPU_BACKEND_WGPU
+  sMultiDrawIndirect = wgpuDeviceHasFeature(
+      sDevice,
+      static_cast<WGPUFeatureName>(WGPUNativeFeature_MultiDrawIndirect));
+  sMultiDrawIndirectCount = wgpuDeviceHasFeature(
+      sDevice,
+      static_cast<WGPUFeatureName>(WGPUNativeFeature_MultiDrawIndirectCount));
+  sPushConstants = wgpuDeviceHasFeature(
+      sDevice, static_cast<WGPUFeatureName>(WGPUNativeFeature_PushConstants));
+  sTextureBindingArrays = std::all_of(
+      std::begin(TEXTURE_BINDING_ARRAY_FEATURES),
+      std::end(TEXTURE_BINDING_ARRAY_FEATURES),
+      [](WGPUFeatureName feature) {
+        return wgpuDeviceHasFeature(sDevice, feature);
+      });
+#endif
+
   wgpuDeviceSetUncapturedErrorCallback(sDevice, UncapturedErrorCallback,
                                        nullptr);
   sQueue = wgpuDeviceGetQueue(sDevice);
   wgpuQueueOnSubmittedWorkDone(sQueue, OnWorkDone, nullptr);
 
-  sSurfaceFormat = WGPUTextureFormat_BGRA8UnormSrgb;
+  const uint64_t blockSize =
+      std::min<uint64_t>(BUFFER_POOL_BLOCK_SIZE, sLimits.maxBufferSize);
+  sBufferPools[CBZ_BUFFER_POOL_VERTEX].init(
+      WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst, blockSize, 4,
+      "VertexBufferPool");
+  sBufferPools[CBZ_BUFFER_POOL_INDEX].init(
+      WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst, blockSize, 4,
+      "IndexBufferPool");
+  sBufferPools[CBZ_BUFFER_POOL_STORAGE].init(
+      WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst |
+          WGPUBufferUsage_CopySrc,
+      blockSize, sLimits.minStorageBufferOffsetAlignment, "StorageBufferPool");
+
+  const Result swapchainRes = sSwapchain.init(sSurface, adapter, nwh, initDesc);
   wgpuAdapterRelease(adapter);
-
-  int fbWidth, fbHeight;
-  glfwGetFramebufferSize(static_cast<GLFWwindow *>(nwh), &fbWidth, &fbHeight);
-
-  WGPUSurfaceConfiguration surfaceConfig = {};
-  surfaceConfig.nextInChain = nullptr;
-  surfaceConfig.device = sDevice;
-  surfaceConfig.format = sSurfaceFormat;
-  surfaceConfig.usage =
-      WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopyDst;
-  surfaceConfig.viewFormatCount = 0;
-  surfaceConfig.viewFormats = nullptr;
-  surfaceConfig.alphaMode = WGPUCompositeAlphaMode_Auto;
-  surfaceConfig.width = width;
-  surfaceConfig.height = height;
-  surfaceConfig.width = fbWidth;
-  surfaceConfig.height = fbHeight;
-  surfaceConfig.presentMode = WGPUPresentMode_Fifo;
-  wgpuSurfaceConfigure(sSurface, &surfaceConfig);
+  if (swapchainRes != Result::eSuccess) {
+    return swapchainRes;
+  }
 
   // Reserve for current swapchain image
   sTextures.resize(swapchainIMGH.idx + 1u);
@@ -1872,54 +6010,218 @@ Result RendererContextWebGPU::init(uint32_t width, uint32_t height, void *nwh,
 
   // Setup Platform/Renderer backends
   ImGui_ImplGlfw_InitForOther(static_cast<GLFWwindow *>(nwh), true);
-  ImGui_ImplWGPU_Init(sDevice, 3, sSurfaceFormat);
+  ImGui_ImplWGPU_Init(sDevice, MAX_FRAMES_IN_FLIGHT, sSwapchain.getFormat());
 
   sLogger->info("Cubozoa initialized!");
   return Result::eSuccess;
 }
 
-uint32_t RendererContextWebGPU::submitSorted(
-    const std::vector<RenderTarget> &renderTargets,
-    const ShaderProgramCommand *sortedCmds, uint32_t count) {
+WGPURenderBundle RendererContextWebGPU::findOrCreateBundle(
+    DrawListHandle dlh, StructuredBufferHandle cameraSBH, uint8_t target,
+    const RenderTarget &renderTarget, RendererStats &stats) {
+  DrawListWebGPU &drawList = sDrawLists[dlh.idx];
+  const std::vector<ShaderProgramCommand> &cmds = drawList.getCommands();
+  if (cmds.empty()) {
+    return nullptr;
+  }
 
-  WGPUSurfaceTexture surfaceTexture;
-  wgpuSurfaceGetCurrentTexture(sSurface, &surfaceTexture);
-  switch (surfaceTexture.status) {
+  // Bundles declare the attachment formats of the passes executing them.
+  std::array<WGPUTextureFormat, MAX_TARGET_COLOR_ATTACHMENTS> colorFormats =
+      {};
+  for (size_t colorIdx = 0; colorIdx < renderTarget.colorAttachments.size();
+       colorIdx++) {
+    const ImageHandle colorIMGH = renderTarget.colorAttachments[colorIdx].imgh;
+    colorFormats[colorIdx] = colorIMGH.idx == sSurfaceIMGH.idx
+                                 ? sSwapchain.getFormat()
+                                 : sTextures[colorIMGH.idx].getFormat();
+  }
 
-  case WGPUSurfaceGetCurrentTextureStatus_Success:
-    break;
-  case WGPUSurfaceGetCurrentTextureStatus_Timeout:
-  case WGPUSurfaceGetCurrentTextureStatus_Outdated:
-  case WGPUSurfaceGetCurrentTextureStatus_Lost:
-  case WGPUSurfaceGetCurrentTextureStatus_OutOfMemory:
-  case WGPUSurfaceGetCurrentTextureStatus_DeviceLost:
-  case WGPUSurfaceGetCurrentTextureStatus_Force32:
-    sLogger->error("Failed to get surface texture!");
-    return mFrameCounter;
+  const AttachmentDescription &depthAttachment = renderTarget.depthAttachment;
+  const bool hasDepth = depthAttachment.imgh.idx != CBZ_INVALID_HANDLE;
+  const bool depthReadOnly =
+      hasDepth && (depthAttachment.flags & CBZ_RENDER_ATTACHMENT_READ_ONLY) ==
+                      CBZ_RENDER_ATTACHMENT_READ_ONLY;
+
+  WGPURenderBundleEncoderDescriptor bundleEncoderDesc = {};
+  bundleEncoderDesc.nextInChain = nullptr;
+  bundleEncoderDesc.label =
+      HandleProvider<DrawListHandle>::getName(dlh).c_str();
+  bundleEncoderDesc.colorFormatCount = renderTarget.colorAttachments.size();
+  bundleEncoderDesc.colorFormats = colorFormats.data();
+  bundleEncoderDesc.depthStencilFormat =
+      hasDepth ? sTextures[depthAttachment.imgh.idx].getFormat()
+               : WGPUTextureFormat_Undefined;
+  bundleEncoderDesc.sampleCount = renderTarget.sampleCount;
+  bundleEncoderDesc.depthReadOnly = depthReadOnly;
+  bundleEncoderDesc.stencilReadOnly = depthReadOnly;
+
+  // Pipelines are created per target, so bundles are too.
+  std::array<uint32_t, MAX_TARGET_COLOR_ATTACHMENTS + 4> targetKey = {
+      target, static_cast<uint32_t>(bundleEncoderDesc.depthStencilFormat),
+      renderTarget.sampleCount, depthReadOnly};
+  std::copy(colorFormats.begin(), colorFormats.end(), targetKey.begin() + 4);
+
+  uint32_t targetHash;
+  MurmurHash3_x86_32(targetKey.data(),
+                     static_cast<uint32_t>(sizeof(uint32_t) * targetKey.size()),
+                     0, &targetHash);
+
+  if (WGPURenderBundle bundle = drawList.findBundle(targetHash, cameraSBH)) {
+    return bundle;
   }
 
-  // Re assign surface texture handle
-  // TODO: Fix. findOrCreateTextureView is cached by image id, but each surface
-  // texture shares the same id. Most likely have to Create abstraction for
-  // swapchain.
-  sTextures[sSurfaceIMGH.idx] = {};
-  sTextures[sSurfaceIMGH.idx].create(surfaceTexture.texture);
-  WGPUTextureView swapchainTextureView =
-      sTextures[sSurfaceIMGH.idx].findOrCreateTextureView(
-          WGPUTextureAspect_All);
+  WGPURenderBundleEncoder bundleEncoder =
+      wgpuDeviceCreateRenderBundleEncoder(sDevice, &bundleEncoderDesc);
 
-  WGPUCommandEncoderDescriptor cmdEncoderDesc = {};
-  cmdEncoderDesc.nextInChain = nullptr;
-  cmdEncoderDesc.label = "CommandEncoderFrameX";
+  const uint32_t count = static_cast<uint32_t>(cmds.size());
+  uint64_t sortKey = std::numeric_limits<uint64_t>::max();
+  WGPUBindGroup boundBindGroups[MAX_BIND_GROUPS] = {};
+  std::vector<Binding> bindings;
+  uint32_t indexCount = 0;
+  bool complete = true;
 
-  WGPUCommandEncoder cmdEncoder =
-      wgpuDeviceCreateCommandEncoder(sDevice, &cmdEncoderDesc);
+  for (uint32_t cmdIdx = 0; cmdIdx < count; cmdIdx++) {
+    const ShaderProgramCommand &cmd = cmds[cmdIdx];
+    const auto &graphics = cmd.program.graphics;
+
+    if (graphics.ibh.idx == CBZ_INVALID_HANDLE) {
+      sLogger->error("Non indexed drawing unsupported!");
+      continue;
+    }
+
+    // Draws of loading programs are encoded once their shader is loaded.
+    if (!graphicsProgramIsReady(graphics.ph)) {
+      continue;
+    }
+
+    if (sortKey != cmd.sortKey) {
+      sortKey = cmd.sortKey;
+
+      // Recorded draws read the camera of this replay.
+      bindings = cmd.bindings;
+      for (Binding &binding : bindings) {
+        if (BindingIsCamera(binding)) {
+          binding.value.storageBuffer.handle = cameraSBH;
+        }
+      }
+
+      GraphicsProgramWebGPU &graphicsProgram =
+          sGraphicsPrograms[graphics.ph.idx];
+      ShaderWebGPU &shader = sShaders[graphicsProgram.getShader().idx];
+
+      WGPUBindGroupLayout bindGroupLayouts[MAX_BIND_GROUPS] = {};
+      WGPURenderPipeline renderPipeline = nullptr;
+      if (shader.findOrCreateBindGroupLayouts(
+              bindings.data(), static_cast<uint32_t>(bindings.size()),
+              bindGroupLayouts)) {
+        renderPipeline = graphicsProgram.findOrCreatePipeline(
+            renderTarget, bindGroupLayouts, shader.getBindGroupCount(),
+            graphics.vbhs, graphics.vbCount);
+      }
+
+      // Partially encoded lists are not kept.
+      WGPUBindGroup bindGroups[MAX_BIND_GROUPS] = {};
+      if (!renderPipeline ||
+          !findOrCreateBindGroups(graphicsProgram.getShader(), bindings.data(),
+                                  static_cast<uint32_t>(bindings.size()),
+                                  bindGroups)) {
+        complete = false;
+        break;
+      }
+
+      wgpuRenderBundleEncoderSetPipeline(bundleEncoder, renderPipeline);
+
+      for (uint32_t group = 0; group < MAX_BIND_GROUPS; group++) {
+        if (!bindGroups[group] || bindGroups[group] == boundBindGroups[group]) {
+          continue;
+        }
 
+        wgpuRenderBundleEncoderSetBindGroup(bundleEncoder, group,
+                                            bindGroups[group], 0, nullptr);
+        boundBindGroups[group] = bindGroups[group];
+      }
+
+      for (uint32_t vbIdx = 0; vbIdx < graphics.vbCount; vbIdx++) {
+        if (sVertexBuffers[graphics.vbhs[vbIdx].idx].bind(
+                bundleEncoder, vbIdx) != Result::eSuccess) {
+          spdlog::error("Failed to bind vertex buffer!");
+        }
+      }
+
+      const IndexBufferWebGPU &ib = sIndexBuffers[graphics.ibh.idx];
+      if (ib.bind(bundleEncoder) != Result::eSuccess) {
+        spdlog::error("Failed to bind index buffer!");
+      }
+      indexCount = ib.getIndexCount();
+    }
+
+    if (graphics.indirectCount > 0) {
+      const StorageBufferWebWGPU &args = sStorageBuffers[graphics.argsSBH.idx];
+
+      const uint64_t argsSize =
+          static_cast<uint64_t>(graphics.indirectCount) * INDIRECT_ARGS_SIZE;
+      if (graphics.argsOffset + argsSize > args.getSize()) {
+        sLogger->error("Indirect draw arguments out of bounds!");
+        continue;
+      }
+
+      // Bundles can not multi draw; counted draws draw every record.
+      for (uint32_t drawIdx = 0; drawIdx < graphics.indirectCount; drawIdx++) {
+        wgpuRenderBundleEncoderDrawIndexedIndirect(
+            bundleEncoder, args.getBuffer(),
+            args.getOffset() + graphics.argsOffset +
+                drawIdx * INDIRECT_ARGS_SIZE);
+      }
+    } else if (graphics.instances > 1) {
+      wgpuRenderBundleEncoderDrawIndexed(bundleEncoder, indexCount,
+                                         graphics.instances, 0, 0,
+                                         cmd.submissionID);
+    } else {
+      const uint32_t runLength = InstanceRunLength(cmds.data(), cmdIdx, count);
+      wgpuRenderBundleEncoderDrawIndexed(bundleEncoder, indexCount, runLength,
+                                         0, 0, cmd.submissionID);
+      cmdIdx += runLength - 1;
+    }
+  }
+
+  WGPURenderBundleDescriptor bundleDesc = {};
+  bundleDesc.nextInChain = nullptr;
+  bundleDesc.label = bundleEncoderDesc.label;
+
+  WGPURenderBundle bundle =
+      wgpuRenderBundleEncoderFinish(bundleEncoder, &bundleDesc);
+  wgpuRenderBundleEncoderRelease(bundleEncoder);
+
+  if (!complete) {
+    wgpuRenderBundleRelease(bundle);
+
+    if (sCreationBudget.isExhausted()) {
+      // Retry next frame.
+      stats.submissionsDeferred++;
+    } else {
+      sLogger->error("Failed to encode draw list '{}'!",
+                     HandleProvider<DrawListHandle>::getName(dlh));
+    }
+    return nullptr;
+  }
+
+  drawList.addBundle(targetHash, cameraSBH, bundle);
+  return bundle;
+}
+
+uint8_t RendererContextWebGPU::encodeCommands(
+    WGPUCommandEncoder encoder, const std::vector<RenderTarget> &renderTargets,
+    const ShaderProgramCommand *sortedCmds, uint32_t first, uint32_t last,
+    WGPUTextureView swapchainTextureView, RendererStats &stats) {
   // Target struct
   uint8_t target = CBZ_INVALID_RENDER_TARGET;
+  uint8_t passTarget = CBZ_INVALID_RENDER_TARGET; // Target that began the pass
   CBZTargetType targetType = CBZ_TARGET_TYPE_NONE;
   uint64_t targetSortKey = std::numeric_limits<uint64_t>::max();
 
+  // Groups bound in the open pass.
+  WGPUBindGroup boundBindGroups[MAX_BIND_GROUPS] = {};
+
   // Compute state
   uint32_t dispatchX = 0;
   uint32_t dispatchY = 0;
@@ -1932,9 +6234,39 @@ uint32_t RendererContextWebGPU::submitSorted(
   bool isIndexed = false;
   WGPURenderPassEncoder renderPassEncoder = nullptr;
 
-  for (uint32_t cmdIdx = 0; cmdIdx < count; cmdIdx++) {
+  for (uint32_t cmdIdx = first; cmdIdx < last; cmdIdx++) {
     const ShaderProgramCommand &renderCmd = sortedCmds[cmdIdx];
 
+    // Adjacent compute targets, or graphics targets loading the attachments
+    // of the open pass, continue it.
+    if (target != renderCmd.target && targetType == renderCmd.programType) {
+      bool continuePass = false;
+      switch (targetType) {
+      case CBZ_TARGET_TYPE_COMPUTE: {
+        continuePass = computePassEncoder != NULL;
+      } break;
+
+      case CBZ_TARGET_TYPE_GRAPHICS: {
+        continuePass = renderPassEncoder != NULL &&
+                       passTarget != CBZ_DEFAULT_RENDER_TARGET &&
+                       renderCmd.target != CBZ_DEFAULT_RENDER_TARGET &&
+                       RenderPassContinues(renderTargets[passTarget],
+                                           renderTargets[renderCmd.target]);
+
+        // Pipelines depend on the attachment flags of each target.
+        targetSortKey = std::numeric_limits<uint64_t>::max();
+      } break;
+
+      case CBZ_TARGET_TYPE_NONE: {
+      } break;
+      }
+
+      if (continuePass) {
+        target = renderCmd.target;
+        stats.passesCoalesced++;
+      }
+    }
+
     // Switch targets
     if (target != renderCmd.target) {
 
@@ -1966,37 +6298,46 @@ uint32_t RendererContextWebGPU::submitSorted(
       } break;
       }
 
+      std::fill(std::begin(boundBindGroups), std::end(boundBindGroups),
+                nullptr);
+
       // Assign new current target
       target = renderCmd.target;
+      passTarget = renderCmd.target;
       targetType = renderCmd.programType;
 
+      // Views and attachments are created lazily.
+      std::lock_guard<std::mutex> lock(sEncodeMutex);
+
       // Begin pass
       switch (renderCmd.programType) {
       case CBZ_TARGET_TYPE_COMPUTE: {
         WGPUComputePassDescriptor computePassDesc = {};
         computePassDesc.nextInChain = nullptr;
 
-        static std::string computePassLabel;
-        computePassLabel = "ComputePass" + std::to_string(renderCmd.target);
+        const std::string computePassLabel =
+            "ComputePass" + std::to_string(renderCmd.target);
         computePassDesc.label = computePassLabel.c_str();
         computePassDesc.timestampWrites = nullptr;
 
         computePassEncoder =
-            wgpuCommandEncoderBeginComputePass(cmdEncoder, &computePassDesc);
+            wgpuCommandEncoderBeginComputePass(encoder, &computePassDesc);
       } break;
 
       case CBZ_TARGET_TYPE_GRAPHICS: {
         if (renderCmd.target != CBZ_DEFAULT_RENDER_TARGET) {
           const RenderTarget &renderTarget = renderTargets[renderCmd.target];
 
-          static std::array<WGPURenderPassColorAttachment,
-                            MAX_TARGET_COLOR_ATTACHMENTS>
+          std::array<WGPURenderPassColorAttachment,
+                     MAX_TARGET_COLOR_ATTACHMENTS>
               colorAttachments;
 
           for (size_t colorAttachmentIdx = 0;
                colorAttachmentIdx <
                renderTargets[renderCmd.target].colorAttachments.size();
                colorAttachmentIdx++) {
+            const AttachmentDescription &colorAttachment =
+                renderTarget.colorAttachments[colorAttachmentIdx];
 
             colorAttachments[colorAttachmentIdx].nextInChain = nullptr;
             colorAttachments[colorAttachmentIdx].view =
@@ -2009,38 +6350,93 @@ uint32_t RendererContextWebGPU::submitSorted(
                         renderTarget.colorAttachments[colorAttachmentIdx]
                             .arrayLayerCount);
 
-            colorAttachments[colorAttachmentIdx].loadOp = WGPULoadOp_Clear;
-
-            if ((renderTarget.colorAttachments[colorAttachmentIdx].flags) &
-                CBZ_RENDER_ATTACHMENT_LOAD) {
-              colorAttachments[colorAttachmentIdx].loadOp = WGPULoadOp_Load;
+            colorAttachments[colorAttachmentIdx].loadOp =
+                AttachmentLoadOp(colorAttachment.flags);
+            colorAttachments[colorAttachmentIdx].storeOp =
+                AttachmentStoreOp(colorAttachment.flags);
+            colorAttachments[colorAttachmentIdx].clearValue = {
+                colorAttachment.clearValue.r, colorAttachment.clearValue.g,
+                colorAttachment.clearValue.b, colorAttachment.clearValue.a};
+
+            // Single sample images are resolved from a multisampled
+            // companion; its samples are kept only if a pass loads them.
+            colorAttachments[colorAttachmentIdx].resolveTarget = nullptr;
+            const ImageHandle colorIMGH = colorAttachment.imgh;
+            if (renderTarget.sampleCount > 1 &&
+                sTextures[colorIMGH.idx].getSampleCount() == 1) {
+              colorAttachments[colorAttachmentIdx].resolveTarget =
+                  colorAttachments[colorAttachmentIdx].view;
+              colorAttachments[colorAttachmentIdx].view =
+                  FindOrCreateMultisampleView(colorIMGH,
+                                              renderTarget.sampleCount,
+                                              WGPUTextureAspect_All);
+
+              if (!MultisampleCompanionLoaded(renderTargets, colorIMGH)) {
+                colorAttachments[colorAttachmentIdx].storeOp =
+                    WGPUStoreOp_Discard;
+              }
             }
-
-            colorAttachments[colorAttachmentIdx].storeOp = WGPUStoreOp_Store;
-            colorAttachments[colorAttachmentIdx].clearValue = {0.0f, 0.0f, 0.0f,
-                                                               1.0f};
           }
 
           WGPURenderPassDepthStencilAttachment depthStencilAttachment = {};
           if (renderTarget.depthAttachment.imgh.idx != CBZ_INVALID_HANDLE) {
-            depthStencilAttachment.view =
-                sTextures[renderTarget.depthAttachment.imgh.idx]
-                    .findOrCreateTextureView(WGPUTextureAspect_DepthOnly);
+            const AttachmentDescription &depthAttachment =
+                renderTarget.depthAttachment;
+            const TextureWebGPU &depthTexture =
+                sTextures[depthAttachment.imgh.idx];
+
+            // Combined formats attach both aspects.
+            const bool hasStencil =
+                TextureFormatHasStencil(depthTexture.getFormat());
+            const WGPUTextureAspect aspect = hasStencil
+                                                 ? WGPUTextureAspect_All
+                                                 : WGPUTextureAspect_DepthOnly;
 
-            depthStencilAttachment.depthLoadOp = WGPULoadOp_Clear;
-            if ((renderTarget.depthAttachment.flags) &
-                CBZ_RENDER_ATTACHMENT_LOAD) {
-              depthStencilAttachment.depthLoadOp = WGPULoadOp_Load;
+            depthStencilAttachment.view =
+                sTextures[depthAttachment.imgh.idx].findOrCreateTextureView(
+                    aspect);
+
+            depthStencilAttachment.depthLoadOp =
+                AttachmentLoadOp(depthAttachment.flags);
+            depthStencilAttachment.depthStoreOp =
+                AttachmentStoreOp(depthAttachment.flags);
+            depthStencilAttachment.depthClearValue =
+                depthAttachment.depthClearValue;
+
+            // Depth can not be resolved; the companion is the only copy.
+            if (renderTarget.sampleCount > 1 &&
+                depthTexture.getSampleCount() == 1) {
+              depthStencilAttachment.view = FindOrCreateMultisampleView(
+                  depthAttachment.imgh, renderTarget.sampleCount, aspect);
+
+              if (!MultisampleCompanionLoaded(renderTargets,
+                                              depthAttachment.imgh)) {
+                depthStencilAttachment.depthStoreOp = WGPUStoreOp_Discard;
+              }
             }
 
-            depthStencilAttachment.depthStoreOp = WGPUStoreOp_Store;
-            depthStencilAttachment.depthClearValue = 1.0f;
-            depthStencilAttachment.depthReadOnly = false;
-
-            depthStencilAttachment.stencilClearValue = 0;
-            depthStencilAttachment.stencilLoadOp = WGPULoadOp_Clear;
-            depthStencilAttachment.stencilStoreOp = WGPUStoreOp_Store;
-            depthStencilAttachment.stencilReadOnly = true;
+            // Stencil shares the ops of depth.
+            depthStencilAttachment.stencilLoadOp =
+                hasStencil ? depthStencilAttachment.depthLoadOp
+                           : WGPULoadOp_Undefined;
+            depthStencilAttachment.stencilStoreOp =
+                hasStencil ? depthStencilAttachment.depthStoreOp
+                           : WGPUStoreOp_Undefined;
+            depthStencilAttachment.stencilClearValue =
+                depthAttachment.stencilClearValue;
+
+            // Read only aspects must leave their ops undefined.
+            const bool readOnly = (depthAttachment.flags &
+                                   CBZ_RENDER_ATTACHMENT_READ_ONLY) ==
+                                  CBZ_RENDER_ATTACHMENT_READ_ONLY;
+            depthStencilAttachment.depthReadOnly = readOnly;
+            depthStencilAttachment.stencilReadOnly = readOnly;
+            if (readOnly) {
+              depthStencilAttachment.depthLoadOp = WGPULoadOp_Undefined;
+              depthStencilAttachment.depthStoreOp = WGPUStoreOp_Undefined;
+              depthStencilAttachment.stencilLoadOp = WGPULoadOp_Undefined;
+              depthStencilAttachment.stencilStoreOp = WGPUStoreOp_Undefined;
+            }
           }
 
 #ifndef WEBGPU_BACKEND_WGPU
@@ -2050,8 +6446,8 @@ uint32_t RendererContextWebGPU::submitSorted(
           WGPURenderPassDescriptor renderPassDesc = {};
           renderPassDesc.nextInChain = nullptr;
 
-          static std::string renderPassLabel;
-          renderPassLabel = "RenderPass" + std::to_string(renderCmd.target);
+          const std::string renderPassLabel =
+              "RenderPass" + std::to_string(renderCmd.target);
           renderPassDesc.label = renderPassLabel.c_str();
           renderPassDesc.colorAttachmentCount =
               renderTarget.colorAttachments.size();
@@ -2064,7 +6460,7 @@ uint32_t RendererContextWebGPU::submitSorted(
           renderPassDesc.timestampWrites = nullptr;
 
           renderPassEncoder =
-              wgpuCommandEncoderBeginRenderPass(cmdEncoder, &renderPassDesc);
+              wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
         } else { // Render to swapchain; target is 'CBZ_DEFAULT_RENDER_TARGET'
           WGPURenderPassColorAttachment renderPassColorAttachmentDesc = {};
           renderPassColorAttachmentDesc.nextInChain = nullptr;
@@ -2088,7 +6484,11 @@ uint32_t RendererContextWebGPU::submitSorted(
           renderPassDesc.timestampWrites = nullptr;
 
           renderPassEncoder =
-              wgpuCommandEncoderBeginRenderPass(cmdEncoder, &renderPassDesc);
+              wgpuCommandEncoderBeginRenderPass(encoder, &renderPassDesc);
+
+          if (sDynamicResolution.hasUpscaleSource()) {
+            sDynamicResolution.blit(renderPassEncoder, sSwapchain.getFormat());
+          }
         }
       }
 
@@ -2100,25 +6500,60 @@ uint32_t RendererContextWebGPU::submitSorted(
     // Execute cmds
     switch (targetType) {
     case CBZ_TARGET_TYPE_COMPUTE: {
+      if (renderCmd.isCull) {
+        {
+          std::lock_guard<std::mutex> lock(sEncodeMutex);
+          sCulling.dispatch(computePassEncoder, renderCmd);
+        }
+
+        // Culling binds its own pipeline and group.
+        targetSortKey = std::numeric_limits<uint64_t>::max();
+        boundBindGroups[0] = nullptr;
+        stats.dispatches++;
+        break;
+      }
+
       if (targetSortKey != renderCmd.sortKey) {
         targetSortKey = renderCmd.sortKey;
 
-        const ComputeProgramWebGPU &computeProgram =
+        // Pipelines and groups are created lazily.
+        std::lock_guard<std::mutex> lock(sEncodeMutex);
+
+        ComputeProgramWebGPU &computeProgram =
             sComputePrograms[renderCmd.program.compute.ph.idx];
 
         if (computeProgram.bind(computePassEncoder) != Result::eSuccess) {
+          if (sCreationBudget.isExhausted()) {
+            stats.submissionsDeferred++;
+          }
+
+          targetSortKey = std::numeric_limits<uint64_t>::max();
           continue;
         }
 
-        const WGPUBindGroup computeBindGroup = findOrCreateBindGroup(
-            computeProgram.getShader(), renderCmd.getDescriptorHash(),
-            renderCmd.bindings.data(),
-            static_cast<uint32_t>(renderCmd.bindings.size()));
+        WGPUBindGroup computeBindGroups[MAX_BIND_GROUPS] = {};
+        if (!findOrCreateBindGroups(
+                computeProgram.getShader(), renderCmd.bindings.data(),
+                static_cast<uint32_t>(renderCmd.bindings.size()),
+                computeBindGroups) &&
+            sCreationBudget.isExhausted()) {
+          // Retry next frame.
+          stats.submissionsDeferred++;
+          targetSortKey = std::numeric_limits<uint64_t>::max();
+          continue;
+        }
+
+        for (uint32_t group = 0; group < MAX_BIND_GROUPS; group++) {
+          // Sets whose bindings did not change stay bound.
+          if (!computeBindGroups[group] ||
+              computeBindGroups[group] == boundBindGroups[group]) {
+            continue;
+          }
 
-        if (computeBindGroup) {
-          uint32_t offsets = 0;
-          wgpuComputePassEncoderSetBindGroup(computePassEncoder, 0,
-                                             computeBindGroup, 0, &offsets);
+          wgpuComputePassEncoderSetBindGroup(
+              computePassEncoder, group, computeBindGroups[group], 0, nullptr);
+          boundBindGroups[group] = computeBindGroups[group];
+          stats.bindGroupsSet++;
         }
 
         dispatchX = renderCmd.program.compute.x;
@@ -2128,12 +6563,44 @@ uint32_t RendererContextWebGPU::submitSorted(
 
       wgpuComputePassEncoderDispatchWorkgroups(computePassEncoder, dispatchX,
                                                dispatchY, dispatchZ);
+      stats.dispatches++;
     } break;
 
     case CBZ_TARGET_TYPE_GRAPHICS: {
+      if (renderCmd.isDrawList) {
+        {
+          // Executed under the lock; re-encoding the list for another target
+          // releases its previous bundles.
+          std::lock_guard<std::mutex> lock(sEncodeMutex);
+
+          const RenderTarget &renderTarget =
+              renderCmd.target != CBZ_DEFAULT_RENDER_TARGET
+                  ? renderTargets[renderCmd.target]
+                  : SurfaceRenderTarget();
+
+          const auto &drawList = renderCmd.program.drawList;
+          WGPURenderBundle bundle =
+              findOrCreateBundle(drawList.dlh, drawList.cameraSBH,
+                                 renderCmd.target, renderTarget, stats);
+          if (bundle) {
+            wgpuRenderPassEncoderExecuteBundles(renderPassEncoder, 1, &bundle);
+            stats.bundlesExecuted++;
+          }
+        }
+
+        // Bundles leave the pass without pipeline, groups or buffers.
+        targetSortKey = std::numeric_limits<uint64_t>::max();
+        std::fill(std::begin(boundBindGroups), std::end(boundBindGroups),
+                  nullptr);
+        break;
+      }
+
       if (targetSortKey != renderCmd.sortKey) {
         targetSortKey = renderCmd.sortKey;
 
+        // Pipelines and groups are created lazily.
+        std::lock_guard<std::mutex> lock(sEncodeMutex);
+
         GraphicsProgramWebGPU &graphicsProgram =
             sGraphicsPrograms[renderCmd.program.graphics.ph.idx];
 
@@ -2152,31 +6619,40 @@ uint32_t RendererContextWebGPU::submitSorted(
         // }
         //
 
-        WGPUBindGroupLayout bindGroupLayout =
-            sShaders[graphicsProgram.getShader().idx]
-                .findOrCreateBindGroupLayout(
-                    renderCmd.bindings.data(),
-                    static_cast<uint32_t>(renderCmd.bindings.size()));
-
-        WGPURenderPipeline renderPipeline = nullptr;
-        if (renderCmd.target != CBZ_DEFAULT_RENDER_TARGET) {
-          renderPipeline = graphicsProgram.findOrCreatePipeline(
-              renderTargets[renderCmd.target], bindGroupLayout,
-              renderCmd.program.graphics.vbhs,
-              renderCmd.program.graphics.vbCount);
-        } else {
-          // Surface render target
-          static RenderTarget sSurfaceRenderTarget{};
-          sSurfaceRenderTarget.colorAttachments.resize(1);
-          sSurfaceRenderTarget.colorAttachments[0].imgh = sSurfaceIMGH;
-
-          renderPipeline = graphicsProgram.findOrCreatePipeline(
-              sSurfaceRenderTarget, bindGroupLayout,
-              renderCmd.program.graphics.vbhs,
-              renderCmd.program.graphics.vbCount);
+        ShaderWebGPU &shader = sShaders[graphicsProgram.getShader().idx];
+
+        WGPUBindGroupLayout bindGroupLayouts[MAX_BIND_GROUPS] = {};
+        if (!shader.findOrCreateBindGroupLayouts(
+                renderCmd.bindings.data(),
+                static_cast<uint32_t>(renderCmd.bindings.size()),
+                bindGroupLayouts) &&
+            sCreationBudget.isExhausted()) {
+          // Retry next frame.
+          stats.submissionsDeferred++;
+          targetSortKey = std::numeric_limits<uint64_t>::max();
+          continue;
         }
 
+        const RenderTarget &renderTarget =
+            renderCmd.target != CBZ_DEFAULT_RENDER_TARGET
+                ? renderTargets[renderCmd.target]
+                : SurfaceRenderTarget();
+
+        WGPURenderPipeline renderPipeline =
+            graphicsProgram.findOrCreatePipeline(
+                renderTarget, bindGroupLayouts, shader.getBindGroupCount(),
+                renderCmd.program.graphics.vbhs,
+                renderCmd.program.graphics.vbCount);
+
         if (!renderPipeline) {
+          targetSortKey = std::numeric_limits<uint64_t>::max();
+
+          if (sCreationBudget.isExhausted()) {
+            // Retry next frame.
+            stats.submissionsDeferred++;
+            continue;
+          }
+
           sLogger->error("Failed to create render pipeline !");
           sLogger->error("Discarding draw...");
           continue;
@@ -2184,21 +6660,37 @@ uint32_t RendererContextWebGPU::submitSorted(
 
         wgpuRenderPassEncoderSetPipeline(renderPassEncoder, renderPipeline);
 
-        const WGPUBindGroup graphicsBindGroup = findOrCreateBindGroup(
-            graphicsProgram.getShader(), renderCmd.getDescriptorHash(),
-            renderCmd.bindings.data(),
-            static_cast<uint32_t>(renderCmd.bindings.size()));
+        WGPUBindGroup graphicsBindGroups[MAX_BIND_GROUPS] = {};
+        if (!findOrCreateBindGroups(
+                graphicsProgram.getShader(), renderCmd.bindings.data(),
+                static_cast<uint32_t>(renderCmd.bindings.size()),
+                graphicsBindGroups)) {
+          if (sCreationBudget.isExhausted()) {
+            // Retry next frame.
+            stats.submissionsDeferred++;
+            targetSortKey = std::numeric_limits<uint64_t>::max();
+            continue;
+          }
 
-        if (graphicsBindGroup) {
-          uint32_t offsets = 0;
-          wgpuRenderPassEncoderSetBindGroup(renderPassEncoder, 0,
-                                            graphicsBindGroup, 0, &offsets);
-        } else {
           sLogger->error("Failed to create bind group for {}!",
                          HandleProvider<GraphicsProgramHandle>::getName(
                              renderCmd.program.graphics.ph));
         }
 
+        for (uint32_t group = 0; group < MAX_BIND_GROUPS; group++) {
+          // Sets whose bindings did not change stay bound.
+          if (!graphicsBindGroups[group] ||
+              graphicsBindGroups[group] == boundBindGroups[group]) {
+            continue;
+          }
+
+          wgpuRenderPassEncoderSetBindGroup(renderPassEncoder, group,
+                                            graphicsBindGroups[group], 0,
+                                            nullptr);
+          boundBindGroups[group] = graphicsBindGroups[group];
+          stats.bindGroupsSet++;
+        }
+
         // Bind all vertex buffers
         for (uint32_t vbIdx = 0; vbIdx < renderCmd.program.graphics.vbCount;
              vbIdx++) {
@@ -2224,21 +6716,68 @@ uint32_t RendererContextWebGPU::submitSorted(
         }
       };
 
-      if (isIndexed) {
+#ifdef WEBGPU_BACKEND_WGPU
+      if (renderCmd.pushConstantsSize > 0) {
+        const ShaderWebGPU &shader =
+            sShaders[sGraphicsPrograms[renderCmd.program.graphics.ph.idx]
+                         .getShader()
+                         .idx];
+
+        // Programs read at most the block they declare.
+        const uint32_t pushConstantsSize = std::min(
+            renderCmd.pushConstantsSize, shader.getPushConstantSize());
+        if (pushConstantsSize > 0) {
+          wgpuRenderPassEncoderSetPushConstants(
+              renderPassEncoder, PUSH_CONSTANT_STAGES, 0, pushConstantsSize,
+              renderCmd.pushConstants);
+        }
+      }
+#endif
+
+      if (isIndexed && renderCmd.program.graphics.indirectCount > 0) {
+        const auto &graphics = renderCmd.program.graphics;
+        const StorageBufferWebWGPU &args =
+            sStorageBuffers[graphics.argsSBH.idx];
+
+        const uint64_t argsSize =
+            static_cast<uint64_t>(graphics.indirectCount) * INDIRECT_ARGS_SIZE;
+        if (graphics.argsOffset + argsSize > args.getSize()) {
+          sLogger->error("Indirect draw arguments out of bounds!");
+          continue;
+        }
+
+        stats.drawCalls += DrawIndexedIndirect(
+            renderPassEncoder, args, graphics.argsOffset,
+            graphics.indirectCount,
+            graphics.indirectCounted ? &sStorageBuffers[graphics.countSBH.idx]
+                                     : nullptr);
+        continue;
+      } else if (isIndexed) {
         if (renderCmd.program.graphics.instances > 1) {
+          // Instances index transforms from the submission's own.
           wgpuRenderPassEncoderDrawIndexed(renderPassEncoder, indexCount,
                                            renderCmd.program.graphics.instances,
-                                           0, 0, 0);
+                                           0, 0, renderCmd.submissionID);
         } else {
+          // Transforms are indexed by instance, so a run of identical draws
+          // is one draw starting at the first transform.
+          const uint32_t runLength =
+              InstanceRunLength(sortedCmds, cmdIdx, last);
+
           wgpuRenderPassEncoderDrawIndexed(renderPassEncoder, indexCount,
-                                           renderCmd.program.graphics.instances,
-                                           0, 0, renderCmd.submissionID);
+                                           runLength, 0, 0,
+                                           renderCmd.submissionID);
+
+          cmdIdx += runLength - 1;
+          stats.submissionsInstanced += runLength - 1;
         }
       } else {
         wgpuRenderPassEncoderDraw(renderPassEncoder, vertexCount, 1, 0,
                                   renderCmd.submissionID);
         spdlog::error("Non indexed drawing unsupported!");
       }
+
+      stats.drawCalls++;
     } break;
 
     case CBZ_TARGET_TYPE_NONE: {
@@ -2251,18 +6790,8 @@ uint32_t RendererContextWebGPU::submitSorted(
   switch (targetType) {
   case CBZ_TARGET_TYPE_GRAPHICS: {
     if (renderPassEncoder != NULL) {
+      // The frame's ui was built before encoding began.
       if (target == CBZ_DEFAULT_RENDER_TARGET) {
-        ImGui_ImplWGPU_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        // User defined imgui render
-        if (sImguiRenderfunc) {
-          sImguiRenderfunc();
-        }
-
-        ImGui::EndFrame();
-        ImGui::Render();
         ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), renderPassEncoder);
       }
 
@@ -2278,32 +6807,258 @@ uint32_t RendererContextWebGPU::submitSorted(
       wgpuComputePassEncoderRelease(computePassEncoder);
       computePassEncoder = nullptr;
     }
-  } break;
+  } break;
+
+  case CBZ_TARGET_TYPE_NONE:
+    break;
+  }
+
+  return target;
+}
+
+uint8_t RendererContextWebGPU::encodeParallel(
+    const std::vector<RenderTarget> &renderTargets,
+    const ShaderProgramCommand *sortedCmds, uint32_t count,
+    const std::vector<uint32_t> &rangeFirsts,
+    WGPUTextureView swapchainTextureView, RendererStats &stats,
+    std::vector<WGPUCommandBuffer> &cmdBuffers) {
+  std::shared_ptr<ParallelEncode> encode = std::make_shared<ParallelEncode>();
+  encode->rangeFirsts = rangeFirsts;
+  encode->cmdBuffers.resize(rangeFirsts.size(), nullptr);
+  encode->stats.resize(rangeFirsts.size(), {});
+  encode->lastTargets.resize(rangeFirsts.size(), CBZ_INVALID_RENDER_TARGET);
+
+  // Jobs starting after all ranges were claimed return without touching the
+  // frame's commands.
+  auto encodeRanges = [this, encode, targets = &renderTargets, sortedCmds,
+                       count, swapchainTextureView]() {
+    const uint32_t rangeCount =
+        static_cast<uint32_t>(encode->rangeFirsts.size());
+
+    for (uint32_t rangeIdx = encode->nextRange.fetch_add(1);
+         rangeIdx < rangeCount; rangeIdx = encode->nextRange.fetch_add(1)) {
+      const uint32_t first = encode->rangeFirsts[rangeIdx];
+      const uint32_t last = rangeIdx + 1 < rangeCount
+                                ? encode->rangeFirsts[rangeIdx + 1]
+                                : count;
+
+      const std::string encoderLabel =
+          "CommandEncoderRange" + std::to_string(rangeIdx);
+
+      WGPUCommandEncoderDescriptor encoderDesc = {};
+      encoderDesc.nextInChain = nullptr;
+      encoderDesc.label = encoderLabel.c_str();
+
+      WGPUCommandEncoder encoder =
+          wgpuDeviceCreateCommandEncoder(sDevice, &encoderDesc);
+
+      encode->lastTargets[rangeIdx] =
+          encodeCommands(encoder, *targets, sortedCmds, first, last,
+                         swapchainTextureView, encode->stats[rangeIdx]);
+      encode->cmdBuffers[rangeIdx] = FinishEncoder(
+          encoder, "CommandBufferRange" + std::to_string(rangeIdx));
+
+      std::lock_guard<std::mutex> lock(encode->mutex);
+      encode->encodedCount++;
+      encode->encoded.notify_one();
+    }
+  };
+
+  const uint32_t rangeCount = static_cast<uint32_t>(rangeFirsts.size());
+
+  // This thread claims ranges too; busy workers never stall the frame.
+  for (uint32_t jobIdx = 1; jobIdx < rangeCount; jobIdx++) {
+    sWorkerPool.submit(encodeRanges);
+  }
+  encodeRanges();
+
+  {
+    std::unique_lock<std::mutex> lock(encode->mutex);
+    encode->encoded.wait(
+        lock, [&]() { return encode->encodedCount == rangeCount; });
+  }
+
+  // Buffers keep the order of the sorted commands.
+  for (uint32_t rangeIdx = 0; rangeIdx < rangeCount; rangeIdx++) {
+    cmdBuffers.push_back(encode->cmdBuffers[rangeIdx]);
+    AccumulateStats(stats, encode->stats[rangeIdx]);
+  }
+
+  return encode->lastTargets.back();
+}
+
+uint32_t RendererContextWebGPU::submitSorted(
+    const std::vector<RenderTarget> &renderTargets,
+    const ShaderProgramCommand *sortedCmds, uint32_t count) {
+  processShaderLoads();
+  sStagingBelt.recall();
+
+  sDynamicResolution.beginFrame();
+  if (!sSwapchain.acquire(&sTextures[sSurfaceIMGH.idx])) {
+    return mFrameCounter;
+  }
+
+  // Relative images resize before any pass references them.
+  sDynamicResolution.acquired(sSwapchain.getExtent());
+
+  WGPUTextureView swapchainTextureView =
+      sTextures[sSurfaceIMGH.idx].findOrCreateTextureView(
+          WGPUTextureAspect_All);
+
+  WGPUCommandEncoderDescriptor cmdEncoderDesc = {};
+  cmdEncoderDesc.nextInChain = nullptr;
+  cmdEncoderDesc.label = "CommandEncoderFrameX";
+
+  WGPUCommandEncoder cmdEncoder =
+      wgpuDeviceCreateCommandEncoder(sDevice, &cmdEncoderDesc);
+  sDynamicResolution.beginTimestamps(cmdEncoder);
+
+  if (!sTextureStreamer.empty()) {
+    auto useTextures = [](const ShaderProgramCommand &cmd) {
+      for (const Binding &binding : cmd.bindings) {
+        if (binding.type == BindingType::eTexture2D ||
+            binding.type == BindingType::eTextureCube) {
+          sTextureStreamer.use(binding.value.texture.handle, cmd.coverage);
+        }
+      }
+    };
+
+    for (uint32_t cmdIdx = 0; cmdIdx < count; cmdIdx++) {
+      if (!sortedCmds[cmdIdx].isDrawList) {
+        useTextures(sortedCmds[cmdIdx]);
+        continue;
+      }
+
+      // Replayed lists keep their textures resident.
+      const DrawListHandle dlh = sortedCmds[cmdIdx].program.drawList.dlh;
+      for (const ShaderProgramCommand &listCmd :
+           sDrawLists[dlh.idx].getCommands()) {
+        useTextures(listCmd);
+      }
+    }
+
+    // Residency changes queue uploads of their new levels.
+    sTextureStreamer.flush();
+  }
+
+  // Culls stage their argument resets with the frame's uploads.
+  sCulling.prepare(sortedCmds, count);
+
+  // Uploads staged since the last frame precede all passes.
+  sStagingBelt.flush(cmdEncoder);
+  sMipmapGenerator.flush(cmdEncoder);
+  sCulling.flush(cmdEncoder);
+
+  sCreationBudget.begin();
+  RendererStats stats = {};
+
+  // The ui is built on this thread; the pass drawing it may be encoded on a
+  // worker.
+  if (count > 0 && sortedCmds[count - 1].target == CBZ_DEFAULT_RENDER_TARGET) {
+    ImGui_ImplWGPU_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    // User defined imgui render
+    if (sImguiRenderfunc) {
+      sImguiRenderfunc();
+    }
 
-  case CBZ_TARGET_TYPE_NONE:
-    break;
+    ImGui::EndFrame();
+    ImGui::Render();
   }
 
-  WGPUCommandBufferDescriptor cmdDesc = {};
-  cmdDesc.nextInChain = nullptr;
-  std::string commandBufferLabel =
-      "CommandBuffer" + std::to_string(mFrameCounter);
-  cmdDesc.label = commandBufferLabel.c_str();
+  std::vector<uint32_t> rangeFirsts = {0};
+  if (count >= PARALLEL_ENCODE_MIN_COMMANDS) {
+    rangeFirsts = PassRanges(renderTargets, sortedCmds, count,
+                             sWorkerPool.getThreadCount() + 1);
+  }
 
-  WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(cmdEncoder, &cmdDesc);
-  wgpuCommandEncoderRelease(cmdEncoder);
+  std::vector<WGPUCommandBuffer> cmdBuffers;
+  WGPUCommandEncoder tailEncoder = cmdEncoder;
+  uint8_t lastTarget = CBZ_INVALID_RENDER_TARGET;
 
-  wgpuQueueSubmit(sQueue, 1, &cmd);
-  wgpuCommandBufferRelease(cmd);
+  if (rangeFirsts.size() > 1) {
+    // Uploads precede every range in the submission.
+    cmdBuffers.push_back(FinishEncoder(cmdEncoder, "CommandBufferUploads"));
 
-#ifndef __EMSCRIPTEN__
-  wgpuSurfacePresent(sSurface);
-#endif
+    lastTarget =
+        encodeParallel(renderTargets, sortedCmds, count, rangeFirsts,
+                       swapchainTextureView, stats, cmdBuffers);
+
+    cmdEncoderDesc.label = "CommandEncoderFrameTail";
+    tailEncoder = wgpuDeviceCreateCommandEncoder(sDevice, &cmdEncoderDesc);
+  } else {
+    lastTarget = encodeCommands(cmdEncoder, renderTargets, sortedCmds, 0,
+                                count, swapchainTextureView, stats);
+  }
+
+  // Frames without surface draws still present the upscaled image.
+  if (lastTarget != CBZ_DEFAULT_RENDER_TARGET &&
+      sDynamicResolution.hasUpscaleSource()) {
+    WGPURenderPassColorAttachment colorAttachment = {};
+    colorAttachment.nextInChain = nullptr;
+    colorAttachment.view = swapchainTextureView;
+    colorAttachment.loadOp = WGPULoadOp_Clear;
+    colorAttachment.storeOp = WGPUStoreOp_Store;
+    colorAttachment.clearValue = {0.0f, 0.0f, 0.0f, 1.0f};
+
+#ifndef WEBGPU_BACKEND_WGPU
+    colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+#endif // NOT WEBGPU_BACKEND_WGPU
+
+    WGPURenderPassDescriptor renderPassDesc = {};
+    renderPassDesc.nextInChain = nullptr;
+    renderPassDesc.label = "UpscalePass";
+    renderPassDesc.colorAttachmentCount = 1;
+    renderPassDesc.colorAttachments = &colorAttachment;
+    renderPassDesc.depthStencilAttachment = nullptr;
+    renderPassDesc.occlusionQuerySet = nullptr;
+    renderPassDesc.timestampWrites = nullptr;
+
+    WGPURenderPassEncoder renderPassEncoder =
+        wgpuCommandEncoderBeginRenderPass(tailEncoder, &renderPassDesc);
+    sDynamicResolution.blit(renderPassEncoder, sSwapchain.getFormat());
+    wgpuRenderPassEncoderEnd(renderPassEncoder);
+    wgpuRenderPassEncoderRelease(renderPassEncoder);
+  }
+
+  // Reads observe all work of this frame.
+  sDynamicResolution.endTimestamps(tailEncoder);
+  sReadbackQueue.flush(tailEncoder);
 
-  wgpuTextureRelease(surfaceTexture.texture);
-  wgpuTextureViewRelease(swapchainTextureView);
+  cmdBuffers.push_back(FinishEncoder(
+      tailEncoder, "CommandBuffer" + std::to_string(mFrameCounter)));
+
+  // One submission keeps the frame's buffers in order.
+#ifdef WEBGPU_BACKEND_WGPU
+  sSwapchain.submitted(wgpuQueueSubmitForIndex(sQueue, cmdBuffers.size(),
+                                               cmdBuffers.data()));
+#else
+  wgpuQueueSubmit(sQueue, cmdBuffers.size(), cmdBuffers.data());
+#endif
+  for (WGPUCommandBuffer cmd : cmdBuffers) {
+    wgpuCommandBufferRelease(cmd);
+  }
+  sStagingBelt.submitted();
+  sReadbackQueue.submitted();
+  sMipmapGenerator.submitted();
+  sDynamicResolution.submitted();
+  sCulling.submitted();
+
+  stats.commandBuffers = static_cast<uint32_t>(cmdBuffers.size());
+  stats.objectsCreated = sCreationBudget.getCreatedCount();
+  stats.creationsDeferred = sCreationBudget.getDeferredCount();
+  stats.cpuFrameMs = sDynamicResolution.getCpuFrameMs();
+  stats.gpuFrameMs = sDynamicResolution.getGpuFrameMs();
+  stats.resolutionScale = sDynamicResolution.getScale();
+  mStats = stats;
+
+  sSwapchain.present(&sTextures[sSurfaceIMGH.idx]);
 
   PollEvents(false);
+  sReadbackQueue.process();
+
   return mFrameCounter++;
 }
 
@@ -2319,6 +7074,7 @@ RendererContextWebGPU::vertexBufferCreate(VertexBufferHandle vbh,
 }
 
 void RendererContextWebGPU::vertexBufferDestroy(VertexBufferHandle vbh) {
+  DrawListResourceChanged(DrawListResource::eVertexBuffer, vbh.idx);
   return sVertexBuffers[vbh.idx].destroy();
 }
 
@@ -2335,6 +7091,7 @@ Result RendererContextWebGPU::indexBufferCreate(IndexBufferHandle ibh,
 }
 
 void RendererContextWebGPU::indexBufferDestroy(IndexBufferHandle ibh) {
+  DrawListResourceChanged(DrawListResource::eIndexBuffer, ibh.idx);
   return sIndexBuffers[ibh.idx].destroy();
 }
 
@@ -2357,6 +7114,7 @@ void RendererContextWebGPU::uniformBufferUpdate(UniformHandle uh,
 }
 
 void RendererContextWebGPU::uniformBufferDestroy(UniformHandle uh) {
+  DrawListResourceChanged(DrawListResource::eUniform, uh.idx);
   return sUniformBuffers[uh.idx].destroy();
 }
 
@@ -2379,8 +7137,14 @@ Result RendererContextWebGPU::structuredBufferCreate(StructuredBufferHandle sbh,
     usageFlags |= WGPUBufferUsage_CopyDst;
   }
 
+  if ((CBZ_BUFFER_INDIRECT & flags) == CBZ_BUFFER_INDIRECT) {
+    usageFlags |= WGPUBufferUsage_Indirect;
+  }
+
+  const bool readOnly = (CBZ_BUFFER_READ_ONLY & flags) == CBZ_BUFFER_READ_ONLY;
+
   return sStorageBuffers[sbh.idx].create(
-      type, elementCount, elementData, usageFlags,
+      type, elementCount, elementData, usageFlags, readOnly,
       HandleProvider<StructuredBufferHandle>::getName(sbh));
 };
 
@@ -2393,18 +7157,37 @@ void RendererContextWebGPU::structuredBufferUpdate(StructuredBufferHandle sbh,
 
 void RendererContextWebGPU::structuredBufferDestroy(
     StructuredBufferHandle sbh) {
-  return sUniformBuffers[sbh.idx].destroy();
+  DrawListResourceChanged(DrawListResource::eStructuredBuffer, sbh.idx);
+  return sStorageBuffers[sbh.idx].destroy();
 }
 
 SamplerHandle
 RendererContextWebGPU::getSampler(TextureBindingDesc texBindingDesc) {
+  // View fields do not affect the sampler.
+  texBindingDesc.baseMipLevel = 0;
+  texBindingDesc.mipLevelCount = 0;
+
   uint32_t samplerID;
   MurmurHash3_x86_32(&texBindingDesc, sizeof(texBindingDesc), 0, &samplerID);
 
-  if (sSamplers.find(samplerID) != sSamplers.end()) {
-    return SamplerHandle{samplerID};
+  // Created on first use by a bind group.
+  sSamplerDescs[samplerID] = texBindingDesc;
+  return SamplerHandle{samplerID};
+};
+
+WGPUSampler RendererContextWebGPU::findOrCreateSampler(SamplerHandle sh) {
+  if (auto it = sSamplers.find(sh.idx); it != sSamplers.end()) {
+    return it->second;
+  }
+
+  auto descIt = sSamplerDescs.find(sh.idx);
+  if (descIt == sSamplerDescs.end()) {
+    sLogger->error("Unknown sampler {}!", sh.idx);
+    return nullptr;
   }
 
+  const TextureBindingDesc &texBindingDesc = descIt->second;
+
   WGPUSamplerDescriptor samplerDesc = {};
   samplerDesc.nextInChain = nullptr;
   samplerDesc.addressModeU =
@@ -2418,26 +7201,30 @@ RendererContextWebGPU::getSampler(TextureBindingDesc texBindingDesc) {
   samplerDesc.minFilter =
       static_cast<WGPUFilterMode>(texBindingDesc.filterMode);
 
-  // samplerDesc.mipmapFilter;
-  // samplerDesc.lodMinClamp;
-  // samplerDesc.lodMaxClamp;
-  // samplerDesc.compare;
-  samplerDesc.maxAnisotropy = 1;
+  samplerDesc.mipmapFilter =
+      static_cast<WGPUMipmapFilterMode>(texBindingDesc.mipmapFilter);
 
-  WGPUSampler sampler = wgpuDeviceCreateSampler(sDevice, &samplerDesc);
-  sSamplers[samplerID] = sampler;
-  return SamplerHandle{samplerID};
-};
+  samplerDesc.lodMinClamp = texBindingDesc.lodMinClamp;
+  samplerDesc.lodMaxClamp = texBindingDesc.lodMaxClamp;
+  if (samplerDesc.lodMaxClamp <= samplerDesc.lodMinClamp) {
+    samplerDesc.lodMaxClamp = 32.0f;
+  }
 
-Result RendererContextWebGPU::imageCreate(ImageHandle th,
-                                          CBZTextureFormat format, uint32_t w,
-                                          uint32_t h, uint32_t depth,
-                                          CBZTextureDimension dimension,
-                                          CBZImageFlags flags) {
-  if (sTextures.size() < th.idx + 1u) {
-    sTextures.resize(th.idx + 1u);
+  // samplerDesc.compare;
+  samplerDesc.maxAnisotropy = static_cast<uint16_t>(
+      std::clamp(texBindingDesc.maxAnisotropy, 1u, 16u));
+
+  if (samplerDesc.maxAnisotropy > 1 &&
+      (texBindingDesc.filterMode != CBZ_FILTER_MODE_LINEAR ||
+       texBindingDesc.mipmapFilter != CBZ_FILTER_MODE_LINEAR)) {
+    sLogger->warn("Anisotropic filtering requires linear filters!");
+    samplerDesc.maxAnisotropy = 1;
   }
 
+  return sSamplers[sh.idx] = wgpuDeviceCreateSampler(sDevice, &samplerDesc);
+}
+
+static WGPUTextureUsageFlags ImageFlagsToWGPUUsage(CBZImageFlags flags) {
   WGPUTextureUsageFlags wgpuUsageFlags = 0;
 
   if ((flags & CBZ_IMAGE_RENDER_ATTACHMENT) == CBZ_IMAGE_RENDER_ATTACHMENT) {
@@ -2452,17 +7239,220 @@ Result RendererContextWebGPU::imageCreate(ImageHandle th,
     wgpuUsageFlags |= WGPUTextureUsage_CopySrc;
   }
 
-  return sTextures[th.idx].create(w, h, depth, TextureDimToWGPU(dimension),
-                                  static_cast<WGPUTextureFormat>(format),
-                                  wgpuUsageFlags);
+  return wgpuUsageFlags;
+}
+
+Result RendererContextWebGPU::imageCreate(ImageHandle th,
+                                          CBZTextureFormat format, uint32_t w,
+                                          uint32_t h, uint32_t depth,
+                                          CBZTextureDimension dimension,
+                                          CBZImageFlags flags,
+                                          uint32_t mipLevelCount,
+                                          uint32_t sampleCount) {
+  if (!imageFormatIsSupported(format)) {
+    sLogger->error("Image '{}' format {} is not supported by the device!",
+                   HandleProvider<ImageHandle>::getName(th),
+                   static_cast<uint32_t>(format));
+    return Result::eFailure;
+  }
+
+  if (sTextures.size() < th.idx + 1u) {
+    sTextures.resize(th.idx + 1u);
+  }
+
+  WGPUTextureUsageFlags wgpuUsageFlags = ImageFlagsToWGPUUsage(flags);
+
+  if (sampleCount > 1) {
+    if (dimension != CBZ_TEXTURE_DIMENSION_2D || depth != 1 ||
+        (flags & ~CBZ_IMAGE_RENDER_ATTACHMENT) != 0) {
+      sLogger->error("Multisampled image '{}' must be a single 2D render "
+                     "attachment!",
+                     HandleProvider<ImageHandle>::getName(th));
+      return Result::eFailure;
+    }
+
+    return sTextures[th.idx].create(
+        w, h, 1, WGPUTextureDimension_2D,
+        static_cast<WGPUTextureFormat>(format), wgpuUsageFlags, 1,
+        HandleProvider<ImageHandle>::getName(th), sampleCount);
+  }
+
+  bool generateMips = false;
+  mipLevelCount = std::max(mipLevelCount, 1u);
+  if ((flags & CBZ_IMAGE_MIPMAPS) == CBZ_IMAGE_MIPMAPS) {
+    if (dimension == CBZ_TEXTURE_DIMENSION_2D &&
+        MipmapGeneratorWebGPU::IsFormatSupported(
+            static_cast<WGPUTextureFormat>(format))) {
+      mipLevelCount = 1;
+      while ((std::max(w, h) >> mipLevelCount) > 0) {
+        mipLevelCount++;
+      }
+      wgpuUsageFlags |= MipmapGeneratorWebGPU::GetUsage(
+          static_cast<WGPUTextureFormat>(format));
+      generateMips = true;
+    } else {
+      sLogger->warn("Image '{}' format {} does not support mipmaps!",
+                    HandleProvider<ImageHandle>::getName(th),
+                    static_cast<uint32_t>(format));
+    }
+  }
+
+  const Result result = sTextures[th.idx].create(
+      w, h, depth, TextureDimToWGPU(dimension),
+      static_cast<WGPUTextureFormat>(format), wgpuUsageFlags, mipLevelCount,
+      HandleProvider<ImageHandle>::getName(th));
+
+  sTextures[th.idx].mGenerateMips = generateMips;
+  return result;
 }
 
 void RendererContextWebGPU::imageUpdate(ImageHandle th, void *data,
-                                        uint32_t count) {
-  sTextures[th.idx].update(data, count);
+                                        [[maybe_unused]] uint32_t count) {
+  sTextures[th.idx].update(data);
+
+  if (sTextures[th.idx].mGenerateMips) {
+    sMipmapGenerator.enqueue(th);
+  }
 };
 
+Result RendererContextWebGPU::imageUpdateMip(ImageHandle th,
+                                             uint32_t mipLevel,
+                                             const void *data,
+                                             uint32_t size) {
+  TextureWebGPU &texture = sTextures[th.idx];
+  if (mipLevel >= texture.getMipLevelCount()) {
+    sLogger->error("Image '{}' has no mip level {}!",
+                   HandleProvider<ImageHandle>::getName(th), mipLevel);
+    return Result::eFailure;
+  }
+
+  const TextureWebGPU::MipCopyLayout layout =
+      texture.getMipCopyLayout(mipLevel);
+  const uint64_t mipSize = static_cast<uint64_t>(layout.bytesPerRow) *
+                           layout.rowsPerImage *
+                           layout.extent.depthOrArrayLayers;
+  if (size < mipSize) {
+    sLogger->error("Image '{}' mip {} requires {} bytes, got {}!",
+                   HandleProvider<ImageHandle>::getName(th), mipLevel, mipSize,
+                   size);
+    return Result::eFailure;
+  }
+
+  texture.update(data, mipLevel);
+  return Result::eSuccess;
+}
+
+bool RendererContextWebGPU::imageFormatIsSupported(
+    CBZTextureFormat format) const {
+  return TextureFormatIsSupported(format);
+}
+
+Result RendererContextWebGPU::imageCreateRelative(ImageHandle imgh,
+                                                  CBZTextureFormat format,
+                                                  float scale,
+                                                  CBZImageFlags flags) {
+  if (!imageFormatIsSupported(format)) {
+    sLogger->error("Image '{}' format {} is not supported by the device!",
+                   HandleProvider<ImageHandle>::getName(imgh),
+                   static_cast<uint32_t>(format));
+    return Result::eFailure;
+  }
+
+  if ((flags & CBZ_IMAGE_MIPMAPS) == CBZ_IMAGE_MIPMAPS) {
+    sLogger->warn("Relative image '{}' does not support mipmaps!",
+                  HandleProvider<ImageHandle>::getName(imgh));
+  }
+
+  if (sTextures.size() < imgh.idx + 1u) {
+    sTextures.resize(imgh.idx + 1u);
+  }
+
+  return sDynamicResolution.create(
+      imgh, static_cast<WGPUTextureFormat>(format),
+      ImageFlagsToWGPUUsage(flags), scale,
+      (flags & CBZ_IMAGE_DYNAMIC_RESOLUTION) == CBZ_IMAGE_DYNAMIC_RESOLUTION,
+      sSwapchain.getExtent());
+}
+
+Result RendererContextWebGPU::imageStreamCreate(ImageHandle imgh,
+                                                const std::string &path,
+                                                CBZImageFlags flags) {
+  if (sTextures.size() < imgh.idx + 1u) {
+    sTextures.resize(imgh.idx + 1u);
+  }
+
+  WGPUTextureUsageFlags wgpuUsageFlags = 0;
+  if ((flags & CBZ_IMAGE_COPY_SRC) == CBZ_IMAGE_COPY_SRC) {
+    wgpuUsageFlags |= WGPUTextureUsage_CopySrc;
+  }
+
+  return sTextureStreamer.create(imgh, path, wgpuUsageFlags);
+}
+
+void RendererContextWebGPU::imageStreamPrioritySet(ImageHandle imgh,
+                                                   float priority) {
+  sTextureStreamer.setPriority(imgh, priority);
+}
+
+void RendererContextWebGPU::presentModeSet(CBZPresentMode presentMode) {
+  sSwapchain.setPresentMode(presentMode);
+}
+
+void RendererContextWebGPU::dynamicResolutionSet(
+    const DynamicResolutionDesc &desc) {
+  sDynamicResolution.setDesc(desc);
+}
+
+void RendererContextWebGPU::upscaleSourceSet(ImageHandle imgh) {
+  sDynamicResolution.setUpscaleSource(imgh);
+}
+
+void RendererContextWebGPU::textureStreamingBudgetSet(uint64_t bytes) {
+  sTextureStreamer.setBudget(bytes);
+}
+
+TextureStreamingStats RendererContextWebGPU::textureStreamingStatsGet() const {
+  return sTextureStreamer.getStats();
+}
+
+BufferPoolStats
+RendererContextWebGPU::bufferPoolStatsGet(CBZBufferPool pool) const {
+  return sBufferPools[pool].getStats();
+}
+
+void RendererContextWebGPU::textureTableSet(uint32_t index,
+                                            ImageHandle imgh) {
+  sTextureTable.set(index, imgh);
+}
+
+void RendererContextWebGPU::drawListUpdate(
+    DrawListHandle dlh, std::vector<ShaderProgramCommand> &&cmds) {
+  if (sDrawLists.size() < dlh.idx + 1u) {
+    sDrawLists.resize(dlh.idx + 1u);
+  }
+
+  sDrawLists[dlh.idx].update(std::move(cmds));
+}
+
+void RendererContextWebGPU::drawListDestroy(DrawListHandle dlh) {
+  sDrawLists[dlh.idx].destroy();
+}
+
 void RendererContextWebGPU::imageDestroy(ImageHandle th) {
+  sReadbackQueue.discard(th);
+  sMipmapGenerator.discard(th);
+  sTextureStreamer.discard(th);
+  sDynamicResolution.discard(th);
+  sCulling.discard(th);
+  sTextureTable.discard(th);
+  InvalidateBindGroups(th);
+
+  if (auto it = sMultisampleTextures.find(th.idx);
+      it != sMultisampleTextures.end()) {
+    it->second.destroy();
+    sMultisampleTextures.erase(it);
+  }
+
   return sTextures[th.idx].destroy();
 };
 
@@ -2471,12 +7461,83 @@ Result RendererContextWebGPU::shaderCreate(ShaderHandle sh,
                                            const std::string &path) {
   if (sShaders.size() < sh.idx + 1u) {
     sShaders.resize(sh.idx + 1u);
+    sShaderGenerations.resize(sh.idx + 1u);
   }
 
+  sShaderGenerations[sh.idx]++;
   return sShaders[sh.idx].create(path, flags);
 }
 
+Result RendererContextWebGPU::shaderCreateAsync(ShaderHandle sh,
+                                                CBZShaderFlags flags,
+                                                const std::string &path) {
+  if (sShaders.size() < sh.idx + 1u) {
+    sShaders.resize(sh.idx + 1u);
+    sShaderGenerations.resize(sh.idx + 1u);
+  }
+
+  sShaders[sh.idx] = {};
+  sShaders[sh.idx].setStatus(ShaderStatus::ePending);
+  sShaderGenerations[sh.idx]++;
+
+  // Loaded into a request owned object; 'sShaders' may be resized while the
+  // worker is running.
+  std::shared_ptr<ShaderLoadRequest> request =
+      std::make_shared<ShaderLoadRequest>();
+  request->sh = sh;
+  request->generation = sShaderGenerations[sh.idx];
+  request->flags = flags;
+  request->path = path;
+  request->result = Result::eFailure;
+
+  sWorkerPool.submit([request]() {
+    request->result = request->shader.load(request->path, request->flags);
+
+    std::lock_guard<std::mutex> lock(sShaderLoadMutex);
+    sCompletedShaderLoads.push_back(request);
+  });
+
+  return Result::eSuccess;
+}
+
+void RendererContextWebGPU::processShaderLoads() {
+  std::vector<std::shared_ptr<ShaderLoadRequest>> completedLoads;
+  {
+    std::lock_guard<std::mutex> lock(sShaderLoadMutex);
+    completedLoads.swap(sCompletedShaderLoads);
+  }
+
+  for (const std::shared_ptr<ShaderLoadRequest> &request : completedLoads) {
+    ShaderWebGPU &shader = sShaders[request->sh.idx];
+
+    // Destroyed or re-created while loading.
+    if (sShaderGenerations[request->sh.idx] != request->generation ||
+        shader.getStatus() != ShaderStatus::ePending) {
+      continue;
+    }
+
+    if (request->result != Result::eSuccess) {
+      sLogger->error("Failed to load shader '{}'!", request->path);
+      shader.setStatus(ShaderStatus::eFailed);
+      continue;
+    }
+
+    shader = std::move(request->shader);
+    if (shader.createModule() != Result::eSuccess) {
+      sLogger->error("Failed to create shader module '{}'!", request->path);
+      continue;
+    }
+
+    sLogger->trace("Shader '{}' loaded.", request->path);
+
+    // Lists encoded while the shader loaded skipped its draws.
+    DrawListResourceChanged(DrawListResource::eShader, request->sh.idx);
+  }
+}
+
 void RendererContextWebGPU::shaderDestroy(ShaderHandle sh) {
+  DrawListResourceChanged(DrawListResource::eShader, sh.idx);
+  sShaderGenerations[sh.idx]++;
   return sShaders[sh.idx].destroy();
 }
 
@@ -2492,6 +7553,7 @@ Result RendererContextWebGPU::graphicsProgramCreate(GraphicsProgramHandle gph,
 }
 
 void RendererContextWebGPU::graphicsProgramDestroy(GraphicsProgramHandle gph) {
+  DrawListResourceChanged(DrawListResource::eGraphicsProgram, gph.idx);
   return sGraphicsPrograms[gph.idx].destroy();
 }
 
@@ -2509,239 +7571,220 @@ void RendererContextWebGPU::computeProgramDestroy(ComputeProgramHandle cph) {
 }
 
 void RendererContextWebGPU::shutdown() {
-  if (mStagingBuffer) {
-    wgpuBufferDestroy(mStagingBuffer);
+  sWorkerPool.shutdown();
+  sStagingBelt.destroy();
+  sReadbackQueue.destroy();
+  sMipmapGenerator.destroy();
+  sTextureStreamer.destroy();
+  sDynamicResolution.destroy();
+  sCulling.destroy();
+  sTextureTable.destroy();
+
+  for (DrawListWebGPU &drawList : sDrawLists) {
+    drawList.destroy();
+  }
+  sDrawLists.clear();
+
+  for (auto &it : sMultisampleTextures) {
+    it.second.destroy();
+  }
+  sMultisampleTextures.clear();
+
+  for (BufferPoolWebGPU &pool : sBufferPools) {
+    pool.destroy();
   }
 
   ImGui_ImplGlfw_Shutdown();
   ImGui_ImplWGPU_Shutdown();
 
+  sSwapchain.destroy();
+
   wgpuSurfaceRelease(sSurface);
   wgpuDeviceRelease(sDevice);
 }
 
-WGPUBindGroup RendererContextWebGPU::findOrCreateBindGroup(
-    ShaderHandle sh, uint32_t descriptorHash, const Binding *bindings,
-    uint32_t bindingCount) {
-  if (!bindingCount || !bindings) {
-    return nullptr;
+bool RendererContextWebGPU::findOrCreateBindGroups(ShaderHandle sh,
+                                                   const Binding *bindings,
+                                                   uint32_t bindingCount,
+                                                   WGPUBindGroup *bindGroups) {
+  const ShaderWebGPU &shader = sShaders[sh.idx];
+  Binding groupBindings[MAX_COMMAND_BINDINGS];
+
+  bool created = true;
+  for (uint32_t group = 0; group < shader.getBindGroupCount(); group++) {
+    const uint32_t groupBindingCount =
+        shader.getGroupBindings(group, bindings, bindingCount, groupBindings);
+
+    bindGroups[group] =
+        findOrCreateBindGroup(sh, group, groupBindings, groupBindingCount);
+    created &= bindGroups[group] != nullptr;
   }
 
-  const std::vector<BindingDesc> &shaderBindingDescs =
-      sShaders[sh.idx].getBindings();
-
-  if (sBindingGroups.find(descriptorHash) == sBindingGroups.end()) {
-
-    WGPUBindGroupDescriptor bindGroupDesc = {};
-    bindGroupDesc.nextInChain = nullptr;
-    bindGroupDesc.label = nullptr;
-    bindGroupDesc.layout =
-        sShaders[sh.idx].findOrCreateBindGroupLayout(bindings, bindingCount);
-
-    std::vector<WGPUBindGroupEntry> bindGroupEntries;
-    for (const BindingDesc &bindingDesc : shaderBindingDescs) {
-      switch (bindingDesc.type) {
-      case BindingType::eUniformBuffer: {
-        const Binding *binding = nullptr;
-
-        // Find uniform by name
-        for (uint32_t inputBindingIdx = 0; inputBindingIdx < bindingCount;
-             inputBindingIdx++) {
-
-          if (bindings[inputBindingIdx].type != BindingType::eUniformBuffer) {
-            continue;
-          }
-
-          if (bindingDesc.name ==
-              HandleProvider<UniformHandle>::getName(
-                  bindings[inputBindingIdx].value.uniformBuffer.handle)) {
-            binding = &bindings[inputBindingIdx];
-            break;
-          }
-        }
-
-        if (!binding) {
-          sLogger->error(
-              "Shader program '{}' has no uniform binding named '{}'",
-              HandleProvider<ShaderHandle>::getName(sh), bindingDesc.name);
-          return nullptr;
-        }
-
-        bindGroupEntries.push_back(
-            sUniformBuffers[binding->value.uniformBuffer.handle.idx]
-                .createBindGroupEntry(bindingDesc.index));
-      } break;
-
-      case BindingType::eRWStructuredBuffer:
-      case BindingType::eStructuredBuffer: {
-        const Binding *binding = nullptr;
-
-        // Find buffer binding by index/slot
-        for (uint32_t inputBindingIdx = 0; inputBindingIdx < bindingCount;
-             inputBindingIdx++) {
-
-          if (bindings[inputBindingIdx].type !=
-                  BindingType::eRWStructuredBuffer &&
-              bindings[inputBindingIdx].type !=
-                  BindingType::eStructuredBuffer) {
-            continue;
-          }
-
-          if (bindingDesc.index ==
-              bindings[inputBindingIdx].value.storageBuffer.slot) {
-            binding = &bindings[inputBindingIdx];
-            break;
-          }
-        }
-
-        if (!binding) {
-          sLogger->error("Shader program '{}' has no buffer binding at {}",
-                         HandleProvider<ShaderHandle>::getName(sh),
-                         bindingDesc.index);
-          return nullptr;
-        }
-
-        StructuredBufferHandle sbh = binding->value.storageBuffer.handle;
-        bindGroupEntries.push_back(
-            sStorageBuffers[sbh.idx].createBindGroupEntry(bindingDesc.index));
-      } break;
-
-      case BindingType::eTexture2D: {
-        const Binding *binding = nullptr;
-
-        // Find texture binding by index/slot
-        for (uint32_t inputBindingIdx = 0; inputBindingIdx < bindingCount;
-             inputBindingIdx++) {
-
-          if (bindings[inputBindingIdx].type != BindingType::eTexture2D) {
-            continue;
-          }
-
-          if (bindingDesc.index ==
-              bindings[inputBindingIdx].value.storageBuffer.slot) {
-            binding = &bindings[inputBindingIdx];
-            break;
-          }
-        }
-
-        if (!binding) {
-          sLogger->error("Shader program '{}' has no texture binding at {}",
-                         HandleProvider<ShaderHandle>::getName(sh),
-                         bindingDesc.index);
-          return nullptr;
-        }
-
-        ImageHandle th = binding->value.texture.handle;
+  return created;
+}
 
-        WGPUBindGroupEntry &entry = bindGroupEntries.emplace_back();
-        entry.nextInChain = nullptr;
-        entry.binding = bindingDesc.index;
-        entry.offset = 0;
-        entry.textureView = sTextures[th.idx].findOrCreateTextureView(
-            WGPUTextureAspect_All, 0, 1, CBZ_TEXTURE_VIEW_DIMENSION_2D);
-      } break;
+WGPUBindGroup RendererContextWebGPU::findOrCreateBindGroup(
+    ShaderHandle sh, uint8_t group, const Binding *bindings,
+    uint32_t bindingCount) {
+  // Layouts and groups are per shader and group.
+  uint32_t groupHash;
+  MurmurHash3_x86_32(bindings, sizeof(Binding) * bindingCount,
+                     static_cast<uint32_t>(sh.idx) << 8 | group, &groupHash);
 
-      case BindingType::eTextureCube: {
-        const Binding *binding = nullptr;
+  if (auto it = sBindingGroups.find(groupHash); it != sBindingGroups.end()) {
+    return it->second;
+  }
 
-        // Find texture binding by index/slot
-        for (uint32_t inputBindingIdx = 0; inputBindingIdx < bindingCount;
-             inputBindingIdx++) {
+  WGPUBindGroupLayout layout =
+      sShaders[sh.idx].findOrCreateBindGroupLayout(group, bindings,
+                                                   bindingCount);
+  if (!layout) {
+    return nullptr;
+  }
 
-          if (bindings[inputBindingIdx].type != BindingType::eTextureCube) {
-            continue;
-          }
+  // Views and samplers referenced by the group count towards its creation.
+  CreationBudget::Scope creation(sCreationBudget);
+  if (!creation) {
+    return nullptr;
+  }
 
-          if (bindingDesc.index ==
-              bindings[inputBindingIdx].value.storageBuffer.slot) {
-            binding = &bindings[inputBindingIdx];
-            break;
-          }
-        }
+  WGPUBindGroupDescriptor bindGroupDesc = {};
+  bindGroupDesc.nextInChain = nullptr;
+  bindGroupDesc.label = nullptr;
+  bindGroupDesc.layout = layout;
 
-        if (!binding) {
-          sLogger->error(
-              "Shader program '{}' has no texture cube binding at {}",
-              HandleProvider<ShaderHandle>::getName(sh), bindingDesc.index);
-          return nullptr;
-        }
+  std::vector<WGPUBindGroupEntry> bindGroupEntries;
 
-        ImageHandle th = binding->value.texture.handle;
+  // Images the group references; tracked once the group exists.
+  std::vector<uint32_t> groupImages;
 
-        WGPUBindGroupEntry &entry = bindGroupEntries.emplace_back();
-        entry.nextInChain = nullptr;
-        entry.binding = bindingDesc.index;
-        entry.offset = 0;
-        entry.textureView = sTextures[th.idx].findOrCreateTextureView(
-            WGPUTextureAspect_All, 0, 6, CBZ_TEXTURE_VIEW_DIMENSION_CUBE);
-      } break;
+  // Texture table views and their chained entries; reserved so entries can
+  // point into them.
+  std::vector<std::vector<WGPUTextureView>> tableViews;
+  tableViews.reserve(sShaders[sh.idx].getBindings().size());
+#ifdef WEBGPU_BACKEND_WGPU
+  std::vector<WGPUBindGroupEntryExtras> tableEntryExtras;
+  tableEntryExtras.reserve(sShaders[sh.idx].getBindings().size());
+#endif
 
-      case BindingType::eSampler: {
-        const Binding *binding = nullptr;
+  for (const BindingDesc &bindingDesc : sShaders[sh.idx].getBindings()) {
+    if (bindingDesc.group != group) {
+      continue;
+    }
 
-        // Find texture binding by index/slot
-        for (uint32_t inputBindingIdx = 0; inputBindingIdx < bindingCount;
-             inputBindingIdx++) {
+    const Binding *binding = BindingFind(bindingDesc, bindings, bindingCount);
+    if (!binding) {
+      sLogger->error("Shader program '{}' has no binding for '{}' at {}",
+                     HandleProvider<ShaderHandle>::getName(sh),
+                     bindingDesc.name, bindingDesc.index);
+      return nullptr;
+    }
 
-          if (bindings[inputBindingIdx].type != BindingType::eSampler) {
-            continue;
-          }
+    switch (bindingDesc.type) {
+    case BindingType::eUniformBuffer: {
+      bindGroupEntries.push_back(
+          sUniformBuffers[binding->value.uniformBuffer.handle.idx]
+              .createBindGroupEntry(bindingDesc.index));
+    } break;
 
-          if (bindingDesc.index ==
-              bindings[inputBindingIdx].value.storageBuffer.slot) {
-            binding = &bindings[inputBindingIdx];
-            break;
-          }
-        }
+    case BindingType::eRWStructuredBuffer:
+    case BindingType::eStructuredBuffer: {
+      StructuredBufferHandle sbh = binding->value.storageBuffer.handle;
+
+      // Read-only buffers share blocks other bindings may read.
+      if (bindingDesc.type == BindingType::eRWStructuredBuffer &&
+          sStorageBuffers[sbh.idx].isReadOnly()) {
+        sLogger->error("Read-only structured buffer '{}' bound to writable "
+                       "'{}'!",
+                       HandleProvider<StructuredBufferHandle>::getName(sbh),
+                       bindingDesc.name);
+        return nullptr;
+      }
 
-        if (!binding) {
-          sLogger->error(
-              "Shader program '{}' has no sampler cube binding at {}",
-              HandleProvider<ShaderHandle>::getName(sh), bindingDesc.index);
-          return nullptr;
-        }
+      bindGroupEntries.push_back(
+          sStorageBuffers[sbh.idx].createBindGroupEntry(bindingDesc.index));
+    } break;
 
-        SamplerHandle samplerHandle = binding->value.sampler.handle;
+    case BindingType::eTexture2D: {
+      ImageHandle th = binding->value.texture.handle;
+      groupImages.push_back(th.idx);
+
+      uint32_t baseMipLevel = binding->value.texture.baseMipLevel;
+      uint32_t mipLevelCount = binding->value.texture.mipLevelCount;
+      sTextureStreamer.clampView(th, &baseMipLevel, &mipLevelCount);
+
+      WGPUBindGroupEntry &entry = bindGroupEntries.emplace_back();
+      entry.nextInChain = nullptr;
+      entry.binding = bindingDesc.index;
+      entry.offset = 0;
+      entry.textureView = sTextures[th.idx].findOrCreateTextureView(
+          WGPUTextureAspect_All, 0, 1, CBZ_TEXTURE_VIEW_DIMENSION_2D,
+          baseMipLevel, mipLevelCount);
+    } break;
 
-        const auto &it = std::find_if(
-            shaderBindingDescs.begin(), shaderBindingDescs.end(),
-            [=](const BindingDesc &bindingDesc) {
-              return bindingDesc.index == binding->value.sampler.slot;
-            });
+    case BindingType::eTextureCube: {
+      ImageHandle th = binding->value.texture.handle;
+      groupImages.push_back(th.idx);
+
+      uint32_t baseMipLevel = binding->value.texture.baseMipLevel;
+      uint32_t mipLevelCount = binding->value.texture.mipLevelCount;
+      sTextureStreamer.clampView(th, &baseMipLevel, &mipLevelCount);
+
+      WGPUBindGroupEntry &entry = bindGroupEntries.emplace_back();
+      entry.nextInChain = nullptr;
+      entry.binding = bindingDesc.index;
+      entry.offset = 0;
+      entry.textureView = sTextures[th.idx].findOrCreateTextureView(
+          WGPUTextureAspect_All, 0, 6, CBZ_TEXTURE_VIEW_DIMENSION_CUBE,
+          baseMipLevel, mipLevelCount);
+    } break;
 
-        if (it->type != BindingType::eSampler) {
-          sLogger->error("Shader program '{}' has type mismatch",
-                         HandleProvider<ShaderHandle>::getName(sh));
-          return nullptr;
-        }
+    case BindingType::eSampler: {
+      WGPUBindGroupEntry &entry = bindGroupEntries.emplace_back();
+      entry.binding = bindingDesc.index;
+      entry.nextInChain = nullptr;
+      entry.sampler = findOrCreateSampler(binding->value.sampler.handle);
+    } break;
 
-        if (it == shaderBindingDescs.end()) {
-          sLogger->error(
-              "Shader program '{}' has no uniform binding of type <Sampler>",
-              HandleProvider<ShaderHandle>::getName(sh));
-          return nullptr;
-        }
+    case BindingType::eTextureTable: {
+#ifdef WEBGPU_BACKEND_WGPU
+      std::vector<WGPUTextureView> &views = tableViews.emplace_back();
+      if (!sTextureTable.getViews(groupHash, bindingDesc.elementCount,
+                                  &views, &groupImages)) {
+        return nullptr;
+      }
 
-        WGPUBindGroupEntry &entry = bindGroupEntries.emplace_back();
-        entry.binding = it->index;
-        entry.nextInChain = nullptr;
-        entry.sampler = sSamplers[samplerHandle.idx];
-      } break;
+      WGPUBindGroupEntryExtras &extras = tableEntryExtras.emplace_back();
+      extras = {};
+      extras.chain.next = nullptr;
+      extras.chain.sType =
+          static_cast<WGPUSType>(WGPUSType_BindGroupEntryExtras);
+      extras.textureViews = views.data();
+      extras.textureViewCount = views.size();
+
+      WGPUBindGroupEntry &entry = bindGroupEntries.emplace_back();
+      entry = {};
+      entry.nextInChain = &extras.chain;
+      entry.binding = bindingDesc.index;
+#else
+      sLogger->error("Texture tables are unsupported!");
+      return nullptr;
+#endif
+    } break;
 
-      case BindingType::eNone: {
-        sLogger->error("Uknown and unsupported binding!");
-      } break;
-      }
+    case BindingType::eNone: {
+      sLogger->error("Uknown and unsupported binding!");
+    } break;
     }
+  }
 
-    bindGroupDesc.entryCount = shaderBindingDescs.size();
-    bindGroupDesc.entries = bindGroupEntries.data();
+  bindGroupDesc.entryCount = bindGroupEntries.size();
+  bindGroupDesc.entries = bindGroupEntries.data();
 
-    return sBindingGroups[descriptorHash] =
-               wgpuDeviceCreateBindGroup(sDevice, &bindGroupDesc);
-  }
+  WGPUBindGroup bindGroup = wgpuDeviceCreateBindGroup(sDevice, &bindGroupDesc);
+  TrackBindGroupImages(groupHash, groupImages);
 
-  return sBindingGroups[descriptorHash];
+  return sBindingGroups[groupHash] = bindGroup;
 }
 
 } // namespace cbz
@@ -3,8 +3,17 @@
 
 #include "cbz_gfx/cbz_gfx_defines.h"
 #include "cbz_irenderer_context.h"
-
+#include "cbz_ktx2.h"
+#include "cbz_tlsf.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -23,14 +32,58 @@
 
 namespace cbz {
 
+enum class ShaderStatus {
+  eNone,
+  ePending, // Loading on a worker or waiting for module creation.
+  eReady,
+  eFailed,
+};
+
 class ShaderWebGPU {
 public:
   [[nodiscard]] Result create(const std::string &path, CBZShaderFlags flags);
 
+  // @brief Reads source and parses reflection. Does not touch the device and
+  // may be called from any thread.
+  [[nodiscard]] Result load(const std::string &path, CBZShaderFlags flags);
+
+  // @brief Creates the shader module from loaded source. Device thread only.
+  [[nodiscard]] Result createModule();
+
   void destroy();
 
+  inline void setStatus(ShaderStatus status) { mStatus = status; }
+
+  [[nodiscard]] inline ShaderStatus getStatus() const { return mStatus; }
+
+  [[nodiscard]] inline bool isReady() const {
+    return mStatus == ShaderStatus::eReady;
+  }
+
+  // @brief Gathers the bindings 'group' declares, in declaration order.
+  // @returns number of bindings written to 'groupBindings', at most
+  // MAX_COMMAND_BINDINGS.
+  [[nodiscard]] uint32_t getGroupBindings(uint8_t group,
+                                          const Binding *bindings,
+                                          uint32_t bindingCount,
+                                          Binding *groupBindings) const;
+
+  // @param bindings bindings of 'group' only; see `getGroupBindings`.
   [[nodiscard]] WGPUBindGroupLayout
-  findOrCreateBindGroupLayout(const Binding *bindings, uint32_t bindingCount);
+  findOrCreateBindGroupLayout(uint8_t group, const Binding *bindings,
+                              uint32_t bindingCount);
+
+  // @brief Finds or creates the layout of each group from a command's
+  // bindings.
+  // @returns false if a layout could not be created.
+  [[nodiscard]] bool findOrCreateBindGroupLayouts(const Binding *bindings,
+                                                  uint32_t bindingCount,
+                                                  WGPUBindGroupLayout *layouts);
+
+  // @returns groups up to the last one the shader declares, at least 1.
+  [[nodiscard]] inline uint32_t getBindGroupCount() const {
+    return mBindGroupCount;
+  };
 
   [[nodiscard]] const inline VertexLayout &getVertexLayout() const {
     return mVertexLayout;
@@ -46,10 +99,16 @@ public:
     return mStages;
   };
 
+  // @returns bytes of the push constant block, 0 if none is declared.
+  [[nodiscard]] inline uint32_t getPushConstantSize() const {
+    return mPushConstantSize;
+  };
+
 private:
   struct ShaderOffsets {
     uint32_t bindingOffset;
     uint32_t padding; // local padding in struct or array
+    uint32_t group;   // register space of the enclosing parameter block
   };
 
   void parseJsonRecursive(const nlohmann::json &varJson, bool isBinding,
@@ -58,11 +117,314 @@ private:
 private:
   std::vector<BindingDesc> mBindingDescs;
   std::unordered_map<uint32_t, WGPUBindGroupLayout> mBindGroupLayouts;
+  uint32_t mBindGroupCount = 1;
 
   VertexLayout mVertexLayout;
 
+  std::string mPath;
+  CBZShaderFlags mFlags = CBZ_SHADER_NONE;
+  std::vector<uint8_t> mSource;
+
+  ShaderStatus mStatus = ShaderStatus::eNone;
+
   WGPUShaderStageFlags mStages = 0;
   WGPUShaderModule mModule = NULL;
+
+  uint32_t mPushConstantSize = 0;
+};
+
+// @brief Upload manager suballocating updates from a pool of mapped staging
+// buffers.
+//
+// Writes are copied into mapped chunks and recorded as transfer commands on
+// the frame's encoder by `flush`. Chunks are remapped and reused once the
+// queue reports the submission that read them as done.
+class StagingBeltWebGPU {
+public:
+  void init(uint64_t chunkSize);
+
+  // @brief Stages a write into dst. Sizes are padded to whole words with
+  // zeros, so dst must own the padding; pooled ranges and uniform buffers are
+  // sized in whole words.
+  // @param offset multiple of 4.
+  void writeBuffer(WGPUBuffer dst, uint64_t offset, const void *data,
+                   uint64_t size);
+
+  // @brief Stages a write of tightly packed texels into dst.
+  void writeTexture(const WGPUImageCopyTexture &dst, const void *data,
+                    uint32_t bytesPerRow, uint32_t rowsPerImage,
+                    const WGPUExtent3D &extent);
+
+  // @brief Records all staged copies into the encoder.
+  void flush(WGPUCommandEncoder encoder);
+
+  // @brief Tracks the chunks flushed since the last submit. Call after the
+  // encoder passed to `flush` is submitted.
+  void submitted();
+
+  // @brief Remaps chunks whose submission completed.
+  void recall();
+
+  void destroy();
+
+  // @brief Drops pending copies targeting dst, or the given range of it. Call
+  // before dst is destroyed or the range is freed.
+  void discard(WGPUBuffer dst, uint64_t offset = 0,
+               uint64_t size = UINT64_MAX);
+  void discard(WGPUTexture dst);
+
+private:
+  enum class ChunkState {
+    eMapped,   // Ready for writes.
+    eInFlight, // Unmapped and referenced by a submission.
+    eMapping,  // Waiting on MapAsync.
+  };
+
+  struct Chunk {
+    WGPUBuffer buffer = NULL;
+    uint64_t size = 0;
+    uint64_t offset = 0;
+    uint8_t *mapped = nullptr;
+
+    ChunkState state = ChunkState::eMapped;
+    uint64_t serial = 0;
+  };
+
+  struct BufferCopy {
+    Chunk *chunk;
+    uint64_t srcOffset;
+    WGPUBuffer dst;
+    uint64_t dstOffset;
+    uint64_t size;
+  };
+
+  struct TextureCopy {
+    Chunk *chunk;
+    WGPUTextureDataLayout layout;
+    WGPUImageCopyTexture dst;
+    WGPUExtent3D extent;
+  };
+
+  // @returns chunk with at least size bytes left at the given alignment.
+  [[nodiscard]] Chunk *allocate(uint64_t size, uint64_t alignment,
+                                uint64_t *outOffset);
+
+private:
+  uint64_t mChunkSize = 0;
+  std::vector<std::unique_ptr<Chunk>> mChunks;
+
+  std::vector<BufferCopy> mBufferCopies;
+  std::vector<TextureCopy> mTextureCopies;
+
+  // Submissions recorded and completed; completion is reported in order.
+  uint64_t mSubmittedSerial = 0;
+  uint64_t mCompletedSerial = 0;
+  bool mHasUnsubmittedChunks = false;
+};
+
+// @brief Ring of asynchronous GPU to CPU reads backed by pooled MapRead
+// buffers.
+//
+// Copies are recorded at the end of the frame's encoder and mapped once
+// submitted; several requests may be in flight across frames.
+class ReadbackQueueWebGPU {
+public:
+  void init(uint32_t capacity);
+
+  // @returns readback id, 0 if the queue is full.
+  [[nodiscard]] uint32_t
+  readBuffer(WGPUBuffer src, uint64_t offset, uint64_t size,
+             std::function<void(const void *data)> callback);
+
+  // @brief Reads a region of an image; resolved to its texture when flushed.
+  // @returns readback id, 0 if the queue is full.
+  [[nodiscard]] uint32_t
+  readTexture(ImageHandle imgh, const WGPUOrigin3D &origin,
+              const WGPUExtent3D &extent,
+              std::function<void(std::vector<uint8_t> &&data)> callback);
+
+  // @brief Records copies of requests made since the last flush.
+  void flush(WGPUCommandEncoder encoder);
+
+  // @brief Maps the staging buffers of flushed requests. Call after the
+  // encoder passed to `flush` is submitted.
+  void submitted();
+
+  // @brief Delivers results of completed maps on the calling thread.
+  void process();
+
+  [[nodiscard]] CBZReadbackStatus getStatus(uint32_t id) const;
+
+  // @returns bytes copied from a ready result, which is then released.
+  [[nodiscard]] uint32_t copy(uint32_t id, void *dst, uint32_t dstSize);
+
+  // @brief Fails requests not yet recorded that read from src, or the given
+  // range of it.
+  void discard(WGPUBuffer src, uint64_t offset = 0,
+               uint64_t size = UINT64_MAX);
+  void discard(ImageHandle src);
+
+  void destroy();
+
+private:
+  enum class RequestState {
+    eFree,
+    eRecorded, // Waiting for flush.
+    eCopying,  // Copy recorded, waiting for submit.
+    eMapping,
+    eMapped,
+    eRepacking, // Texture rows are being repacked on a worker.
+    eReady,
+    eFailed,
+  };
+
+  struct StagingBuffer {
+    WGPUBuffer buffer = NULL;
+    uint64_t size = 0;
+    bool inUse = false;
+  };
+
+  // @brief Tight pitch copy of mapped texture rows made on a worker.
+  struct RepackJob {
+    std::vector<uint8_t> data;
+    std::atomic<bool> done = false;
+  };
+
+  struct Request {
+    uint32_t id = 0;
+    RequestState state = RequestState::eFree;
+
+    WGPUBuffer src = NULL;
+    uint64_t srcOffset = 0;
+    uint64_t copySize = 0;
+
+    // Texture reads
+    bool isTexture = false;
+    ImageHandle imgh = {CBZ_INVALID_HANDLE};
+    WGPUOrigin3D origin = {};
+    WGPUExtent3D extent = {};
+    uint32_t bytesPerRow = 0;
+    uint32_t alignedBytesPerRow = 0;
+    std::shared_ptr<RepackJob> repack;
+    std::function<void(std::vector<uint8_t> &&data)> textureCallback;
+
+    // Requested bytes within the staging buffer.
+    uint64_t dataOffset = 0;
+    uint64_t dataSize = 0;
+
+    uint32_t stagingIdx = UINT32_MAX;
+    std::function<void(const void *data)> callback;
+    std::vector<uint8_t> result;
+  };
+
+  [[nodiscard]] Request *acquireRequest();
+  [[nodiscard]] bool acquireStaging(uint64_t size, uint32_t *outIdx);
+  void releaseStaging(Request &request);
+
+private:
+  std::vector<Request> mRequests;
+  std::vector<StagingBuffer> mStagingBuffers;
+  uint32_t mNextId = 1;
+};
+
+// @brief Regenerates mip chains of updated images with a compute downsampler.
+// @note Only formats usable as storage textures (and sRGB RGBA8 via its
+// linear alias) are supported.
+class MipmapGeneratorWebGPU {
+public:
+  // @returns whether the mip chain of 'format' can be generated.
+  [[nodiscard]] static bool IsFormatSupported(WGPUTextureFormat format);
+
+  // @brief Usage images of 'format' need for their mips to be generated:
+  // storage binding, or render attachment for sRGB formats.
+  [[nodiscard]] static WGPUTextureUsageFlags
+  GetUsage(WGPUTextureFormat format);
+
+  // @brief Queues mip levels 1..N of the image for regeneration.
+  void enqueue(ImageHandle imgh);
+
+  // @brief Records downsample passes of queued images. Call after uploads
+  // to mip 0 are recorded.
+  void flush(WGPUCommandEncoder encoder);
+
+  // @brief Releases transient views and bind groups of the last flush.
+  void submitted();
+
+  void discard(ImageHandle imgh);
+
+  void destroy();
+
+private:
+  struct Pipeline {
+    WGPUShaderModule module = NULL;
+    WGPUBindGroupLayout bindGroupLayout = NULL;
+    WGPUPipelineLayout pipelineLayout = NULL;
+
+    // One of the two, by format.
+    WGPUComputePipeline computePipeline = NULL;
+    WGPURenderPipeline renderPipeline = NULL;
+  };
+
+  [[nodiscard]] const Pipeline *findOrCreatePipeline(WGPUTextureFormat format);
+
+  void generate(WGPUCommandEncoder encoder, WGPUTexture texture);
+
+private:
+  std::vector<ImageHandle> mQueued;
+  std::unordered_map<uint32_t, Pipeline> mPipelines;
+
+  std::vector<WGPUTextureView> mViews;
+  std::vector<WGPUBindGroup> mBindGroups;
+};
+
+// @brief Suballocates buffers of one usage class from shared backing blocks.
+// @note Requests larger than a block, needing usages the pool lacks, or
+// asking for it get a dedicated block of their own.
+class BufferPoolWebGPU {
+public:
+  struct Allocation {
+    WGPUBuffer buffer = NULL;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    uint32_t block = UINT32_MAX;
+    uint32_t node = TLSFAllocator::INVALID_NODE;
+  };
+
+  // @param alignment of allocation offsets; must be a power of two.
+  void init(WGPUBufferUsageFlags usage, uint64_t blockSize, uint64_t alignment,
+            const char *name);
+
+  [[nodiscard]] Result allocate(uint64_t size, Allocation *allocation,
+                                WGPUBufferUsageFlags usage = 0,
+                                bool dedicated = false);
+
+  void free(Allocation &allocation);
+
+  void destroy();
+
+  [[nodiscard]] BufferPoolStats getStats() const;
+
+private:
+  struct Block {
+    WGPUBuffer buffer = NULL;
+    TLSFAllocator allocator;
+    bool dedicated = false;
+  };
+
+  [[nodiscard]] uint32_t createBlock(uint64_t size, WGPUBufferUsageFlags usage,
+                                     bool dedicated);
+
+  void releaseBlock(uint32_t blockIdx);
+
+private:
+  std::vector<Block> mBlocks;
+  std::vector<uint32_t> mUnusedBlocks;
+
+  WGPUBufferUsageFlags mUsage = 0;
+  uint64_t mBlockSize = 0;
+  uint64_t mAlignment = 4;
+  std::string mName;
 };
 
 class VertexBufferWebGPU {
@@ -76,6 +438,8 @@ public:
 
   [[nodiscard]] Result bind(WGPURenderPassEncoder renderPassEncoder,
                             uint32_t slot) const;
+  [[nodiscard]] Result bind(WGPURenderBundleEncoder bundleEncoder,
+                            uint32_t slot) const;
   void destroy();
 
   [[nodiscard]] inline uint32_t getVertexCount() const { return mVertexCount; }
@@ -85,7 +449,7 @@ public:
 
 private:
   VertexLayout mVertexLayout;
-  WGPUBuffer mBuffer = NULL;
+  BufferPoolWebGPU::Allocation mAllocation;
   uint32_t mVertexCount = 0;
 };
 
@@ -96,13 +460,14 @@ public:
                               const std::string &name = "");
 
   [[nodiscard]] Result bind(WGPURenderPassEncoder renderPassEncoder) const;
+  [[nodiscard]] Result bind(WGPURenderBundleEncoder bundleEncoder) const;
 
   void destroy();
 
   [[nodiscard]] inline uint32_t getIndexCount() const { return mIndexCount; }
 
 private:
-  WGPUBuffer mBuffer;
+  BufferPoolWebGPU::Allocation mAllocation;
   WGPUIndexFormat mFormat;
   uint32_t mIndexCount;
 };
@@ -145,9 +510,13 @@ private:
 
 class StorageBufferWebWGPU {
 public:
+  // @param readOnly whether the buffer is never bound writable; only those
+  // share backing blocks, as one buffer can not be read-only and writable in
+  // one usage scope.
   [[nodiscard]] Result create(CBZUniformType type, uint32_t num,
                               const void *data = nullptr,
                               WGPUBufferUsageFlags usage = 0,
+                              bool readOnly = false,
                               const std::string &name = "");
 
   void update(const void *data, uint32_t elementCount,
@@ -159,39 +528,73 @@ public:
     return UniformTypeGetSize(mElementType) * mElementCount;
   }
 
+  [[nodiscard]] inline bool isReadOnly() const { return mReadOnly; }
+
+  [[nodiscard]] inline WGPUBuffer getBuffer() const {
+    return mAllocation.buffer;
+  }
+
+  [[nodiscard]] inline uint64_t getOffset() const {
+    return mAllocation.offset;
+  }
+
   [[nodiscard]] inline WGPUBindGroupEntry
   createBindGroupEntry(uint32_t binding) const {
     WGPUBindGroupEntry entry = {};
     entry.nextInChain = nullptr;
     entry.binding = binding;
-    entry.buffer = mBuffer;
-    entry.offset = 0;
+    entry.buffer = mAllocation.buffer;
+    entry.offset = mAllocation.offset;
     entry.size = getSize();
     return entry;
   }
 
 private:
   friend class RendererContextWebGPU;
-  WGPUBuffer mBuffer;
+  BufferPoolWebGPU::Allocation mAllocation;
 
   CBZUniformType mElementType;
   uint32_t mElementCount;
+  bool mReadOnly = false;
 };
 
 class TextureWebGPU {
 public:
+  // @note Multisampled textures are render attachments only.
   Result create(uint32_t w, uint32_t h, uint32_t depth,
                 WGPUTextureDimension dimension, WGPUTextureFormat format,
-                WGPUTextureUsageFlags usage, const std::string &name = "");
+                WGPUTextureUsageFlags usage, uint32_t mipLevelCount = 1,
+                const std::string &name = "", uint32_t sampleCount = 1);
 
   Result create(WGPUTexture texture);
 
-  void update(void *data, uint32_t count);
+  // @brief Copy layout of one mip level. Rows and row pitch count blocks for
+  // compressed formats; the extent is the block aligned size copies require.
+  struct MipCopyLayout {
+    uint32_t bytesPerRow;
+    uint32_t rowsPerImage;
+    WGPUExtent3D extent;
+  };
+
+  [[nodiscard]] MipCopyLayout getMipCopyLayout(uint32_t mipLevel) const;
+
+  // @brief Uploads all layers of a mip level, tightly packed.
+  void update(const void *data, uint32_t mipLevel = 0);
 
   [[nodiscard]] inline WGPUTextureFormat getFormat() const {
     return wgpuTextureGetFormat(mTexture);
   }
 
+  [[nodiscard]] inline WGPUTexture getTexture() const { return mTexture; }
+
+  [[nodiscard]] inline uint32_t getMipLevelCount() const {
+    return wgpuTextureGetMipLevelCount(mTexture);
+  }
+
+  [[nodiscard]] inline uint32_t getSampleCount() const {
+    return wgpuTextureGetSampleCount(mTexture);
+  }
+
   [[nodiscard]] inline WGPUExtent3D getExtent() const {
     return {wgpuTextureGetWidth(mTexture), wgpuTextureGetHeight(mTexture),
             wgpuTextureGetDepthOrArrayLayers(mTexture)};
@@ -200,7 +603,8 @@ public:
   [[nodiscard]] WGPUTextureView findOrCreateTextureView(
       WGPUTextureAspect aspect, uint32_t baseArrayLayer = 0,
       uint32_t arrayLayerCount = 1,
-      CBZTextureViewDimension viewDimension = CBZ_TEXTURE_VIEW_DIMENSION_2D);
+      CBZTextureViewDimension viewDimension = CBZ_TEXTURE_VIEW_DIMENSION_2D,
+      uint32_t baseMipLevel = 0, uint32_t mipLevelCount = 1);
 
   void destroyTextureViews();
 
@@ -210,9 +614,433 @@ private:
   friend class RendererContextWebGPU;
 
   WGPUTexture mTexture = NULL;
+  bool mGenerateMips = false;
   std::unordered_map<uint32_t, WGPUTextureView> mViews;
 };
 
+// @brief Keeps the mip chains of streamed images partially resident.
+// @note Streamed textures are allocated with their full chain so their size
+// never changes; bindings are clamped to the resident levels. WebGPU has no
+// sparse residency, so the budget bounds the levels loaded and bound rather
+// than the allocation, and evicted levels are bound again without a load.
+class TextureStreamerWebGPU {
+public:
+  void init(uint64_t budget);
+
+  [[nodiscard]] Result create(ImageHandle imgh, const std::string &path,
+                              WGPUTextureUsageFlags usage);
+
+  void setPriority(ImageHandle imgh, float priority);
+
+  // @brief Records a draw sampling the image this frame.
+  // @param coverage screen fraction of the draw; negative if unknown.
+  void use(ImageHandle imgh, float coverage);
+
+  inline void setBudget(uint64_t budget) { mBudget = budget; }
+
+  // @brief Raises 'baseMipLevel' to the image's resident base, keeping the
+  // view's last level. Images that are not streamed are left as is.
+  void clampView(ImageHandle imgh, uint32_t *baseMipLevel,
+                 uint32_t *mipLevelCount) const;
+
+  // @brief Applies finished loads, evicts over budget and starts new loads.
+  // Call before staged uploads are flushed.
+  void flush();
+
+  void discard(ImageHandle imgh);
+
+  void destroy();
+
+  [[nodiscard]] inline bool empty() const { return mImages.empty(); }
+
+  [[nodiscard]] TextureStreamingStats getStats() const;
+
+private:
+  struct LevelLoad {
+    uint32_t level;
+    std::vector<uint8_t> data;
+    std::atomic<bool> done = false;
+    bool failed = false;
+  };
+
+  struct StreamedImage {
+    std::string path;
+    KTX2Image source; // Header and level index only.
+    WGPUTextureUsageFlags usage;
+
+    uint32_t residentBase; // Highest resident level.
+    uint32_t loadedBase;   // Highest level uploaded so far.
+    uint32_t lowestBase;   // Levels from here on are never evicted.
+    uint32_t targetBase;
+
+    float priority = -1.0f; // Explicit; negative derives from coverage.
+    float coverage = -1.0f; // Largest coverage reported this frame.
+    uint32_t lastUsedFrame = 0;
+
+    std::shared_ptr<LevelLoad> load;
+  };
+
+  [[nodiscard]] float getPriority(const StreamedImage &image) const;
+
+  [[nodiscard]] uint32_t getTargetBase(const StreamedImage &image) const;
+
+  [[nodiscard]] uint64_t getResidentSize(const StreamedImage &image,
+                                         uint32_t base) const;
+
+  // @brief Evicts levels of images prioritized below 'priority'.
+  // @returns whether 'bytes' more fit the budget.
+  bool makeRoom(uint64_t bytes, float priority, uint32_t requester);
+
+  // @brief Binds levels from 'base' on; they must have been uploaded.
+  void setResidentBase(uint32_t imgIdx, StreamedImage &image, uint32_t base);
+
+private:
+  std::unordered_map<uint32_t, StreamedImage> mImages;
+
+  uint64_t mBudget = 0;
+  uint64_t mResidentBytes = 0;
+  uint32_t mFrame = 0;
+  uint32_t mLoadsInFlight = 0;
+
+  uint32_t mLevelsLoaded = 0;
+  uint32_t mLevelsEvicted = 0;
+};
+
+// @brief Surface configuration and the image acquired each frame.
+//
+// The surface is reconfigured when the framebuffer is resized or reported
+// outdated. Frames are throttled to `maxFramesInFlight` submissions ahead of
+// the GPU.
+// @note Surface textures are new objects each frame, so views are cached per
+// acquired image and released once it is presented.
+class SwapchainWebGPU {
+public:
+  [[nodiscard]] Result init(WGPUSurface surface, WGPUAdapter adapter,
+                            void *nwh, const InitDesc &initDesc);
+
+  void setPresentMode(CBZPresentMode presentMode);
+
+  // @brief Waits for frames beyond the latency limit and acquires the next
+  // image into 'image'.
+  // @returns false if no image is available this frame.
+  [[nodiscard]] bool acquire(TextureWebGPU *image);
+
+  // @brief Records a submission of the frame for throttling.
+  void submitted(uint64_t submissionIndex);
+
+  // @brief Presents and releases the acquired image and its views.
+  void present(TextureWebGPU *image);
+
+  void destroy();
+
+  [[nodiscard]] inline WGPUTextureFormat getFormat() const { return mFormat; }
+
+  [[nodiscard]] inline WGPUExtent3D getExtent() const {
+    return {mWidth, mHeight, 1};
+  }
+
+private:
+  void configure(uint32_t width, uint32_t height);
+
+  // @brief Waits until fewer than mMaxFramesInFlight frames are in flight.
+  void throttle();
+
+private:
+  WGPUSurface mSurface = NULL;
+  void *mWindow = nullptr;
+
+  WGPUTextureFormat mFormat = WGPUTextureFormat_Undefined;
+  WGPUPresentMode mPresentMode = WGPUPresentMode_Fifo;
+  std::vector<WGPUPresentMode> mSupportedPresentModes;
+  uint32_t mWidth = 0;
+  uint32_t mHeight = 0;
+
+  // Reconfigure before the next acquire.
+  bool mOutdated = false;
+
+  uint32_t mMaxFramesInFlight = 2;
+  std::deque<uint64_t> mInFlight;
+};
+
+// @brief Sizes images relative to the surface and scales them with frame time.
+//
+// Every DYNAMIC_RESOLUTION_ADJUST_FRAMES the scale moves towards the target
+// frame time in bounded steps. Resizes replace the texture behind the image
+// handle; replaced textures are pooled by size and reused on a later resize.
+// @note GPU frame time comes from timestamps written around the frame's
+// commands when the device supports timestamp queries. Otherwise it is
+// measured from submission to the queue work done callback; callbacks seen
+// after waiting on the surface are clipped to the wait's start, so vertical
+// blanks are not counted as GPU time.
+class DynamicResolutionWebGPU {
+public:
+  [[nodiscard]] Result create(ImageHandle imgh, WGPUTextureFormat format,
+                              WGPUTextureUsageFlags usage, float scale,
+                              bool dynamic, WGPUExtent3D surfaceExtent);
+
+  void setDesc(const DynamicResolutionDesc &desc);
+
+  // @brief Records the CPU time since the last acquired frame. Call before
+  // acquiring the surface.
+  void beginFrame();
+
+  // @brief Updates the scale and resizes images to the acquired surface.
+  void acquired(WGPUExtent3D surfaceExtent);
+
+  // @brief Brackets waits on the surface excluded from GPU time.
+  void beginWait();
+  void endWait();
+
+  // @brief Writes the frame's first timestamp. Call before any pass.
+  void beginTimestamps(WGPUCommandEncoder encoder);
+
+  // @brief Writes the frame's last timestamp and reads both back. Call after
+  // all passes, before the readback queue is flushed.
+  void endTimestamps(WGPUCommandEncoder encoder);
+
+  inline void setUpscaleSource(ImageHandle imgh) { mUpscaleSource = imgh; }
+
+  [[nodiscard]] bool hasUpscaleSource() const;
+
+  // @brief Draws the upscale source over the render pass.
+  void blit(WGPURenderPassEncoder renderPassEncoder,
+            WGPUTextureFormat targetFormat);
+
+  // @brief Tracks GPU time of the submitted frame and releases its transient
+  // bind groups.
+  void submitted();
+
+  void discard(ImageHandle imgh);
+
+  void destroy();
+
+  [[nodiscard]] inline float getScale() const {
+    return mDesc.enabled ? mScale : 1.0f;
+  }
+
+  [[nodiscard]] inline float getCpuFrameMs() const { return mCpuFrameMs; }
+
+  [[nodiscard]] inline float getGpuFrameMs() const { return mGpuFrameMs; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct RelativeImage {
+    WGPUTextureFormat format;
+    WGPUTextureUsageFlags usage;
+    float scale;
+    bool dynamic;
+  };
+
+  [[nodiscard]] WGPUExtent3D getExtent(const RelativeImage &image,
+                                       WGPUExtent3D surfaceExtent) const;
+
+  // @brief Takes a pooled texture of matching size or creates one.
+  [[nodiscard]] Result acquireTexture(ImageHandle imgh,
+                                      const RelativeImage &image,
+                                      WGPUExtent3D extent,
+                                      TextureWebGPU *texture);
+
+  void release(TextureWebGPU &texture);
+
+  void adjustScale();
+
+  void completed();
+
+  // @brief Empty compute pass writing timestamp 'queryIndex' at its start or
+  // end.
+  void writeTimestamp(WGPUCommandEncoder encoder, uint32_t queryIndex,
+                      bool end);
+
+  [[nodiscard]] WGPURenderPipeline
+  findOrCreatePipeline(WGPUTextureFormat format);
+
+private:
+  std::unordered_map<uint32_t, RelativeImage> mImages;
+  std::vector<TextureWebGPU> mPool;
+
+  DynamicResolutionDesc mDesc = {};
+  float mScale = 1.0f;
+  WGPUExtent3D mSurfaceExtent = {0, 0, 1};
+  float mAppliedScale = 1.0f;
+  uint32_t mFramesSinceAdjust = 0;
+
+  float mCpuFrameMs = 0.0f;
+  float mGpuFrameMs = 0.0f;
+  Clock::time_point mFrameBegin;
+  Clock::time_point mLastAcquired;
+  std::deque<Clock::time_point> mSubmitTimes;
+  Clock::time_point mLastCompleted;
+  Clock::time_point mWaitBegin;
+  bool mWaiting = false;
+
+  // Null without timestamp query support.
+  WGPUQuerySet mQuerySet = NULL;
+  WGPUBuffer mTimestampBuffer = NULL;
+  bool mTimestampsWritten = false;
+
+  ImageHandle mUpscaleSource = {CBZ_INVALID_HANDLE};
+  WGPUShaderModule mModule = NULL;
+  WGPUBindGroupLayout mBindGroupLayout = NULL;
+  WGPUPipelineLayout mPipelineLayout = NULL;
+  WGPUSampler mSampler = NULL;
+  std::unordered_map<uint32_t, WGPURenderPipeline> mPipelines;
+  std::vector<WGPUBindGroup> mBindGroups;
+};
+
+// @brief Culls batches submitted with CullSubmit against the view frustum
+// and a hierarchical depth (Hi-Z) pyramid, writing compacted visible lists
+// and indexed indirect draw arguments.
+// @note Each depth image culled against gets a pyramid of its farthest depths
+// starting at half its size. Pyramids are rebuilt before the passes of the
+// frame, so they hold the previous frame's depth; the view projection of
+// that frame's cull is kept to test against it.
+class CullingWebGPU {
+public:
+  // @brief Queues argument resets and parameters of the frame's culls. Call
+  // before the staging belt is flushed.
+  void prepare(const ShaderProgramCommand *cmds, uint32_t count);
+
+  // @brief Records pyramid builds of the depth images culled against. Call
+  // before the passes.
+  void flush(WGPUCommandEncoder encoder);
+
+  void dispatch(WGPUComputePassEncoder computePassEncoder,
+                const ShaderProgramCommand &cmd);
+
+  // @brief Releases transient views and bind groups of the frame.
+  void submitted();
+
+  void discard(ImageHandle imgh);
+
+  void destroy();
+
+private:
+  struct Pipeline {
+    WGPUShaderModule module = NULL;
+    WGPUBindGroupLayout bindGroupLayout = NULL;
+    WGPUPipelineLayout pipelineLayout = NULL;
+    WGPUComputePipeline pipeline = NULL;
+  };
+
+  struct HiZ {
+    TextureWebGPU texture;
+
+    // View projection the depth image was last culled and drawn with.
+    float viewProj[16];
+    bool hasViewProj = false;
+
+    // View projection of this frame's cull; applied once submitted.
+    float nextViewProj[16];
+    bool hasNextViewProj = false;
+  };
+
+  [[nodiscard]] bool createPipelines();
+
+  [[nodiscard]] bool createPipeline(const char *code, const char *label,
+                                    const WGPUBindGroupLayoutEntry *entries,
+                                    uint32_t entryCount, Pipeline *pipeline);
+
+  // @returns pyramid of 'depthIMGH', null if it can not be culled against.
+  [[nodiscard]] HiZ *findOrCreateHiZ(ImageHandle depthIMGH);
+
+  void build(WGPUComputePassEncoder computePassEncoder, ImageHandle depthIMGH,
+             HiZ &hiz);
+
+  void destroyPipeline(Pipeline &pipeline);
+
+private:
+  std::unordered_map<uint32_t, HiZ> mHiZs;
+  std::vector<ImageHandle> mQueued;
+
+  // Parameter slot of each cull submission of the frame.
+  std::unordered_map<uint32_t, uint32_t> mSlots;
+  WGPUBuffer mParams = NULL;
+  uint64_t mParamsSize = 0;
+
+  Pipeline mCullPipeline;
+  Pipeline mDepthReducePipeline;
+  Pipeline mReducePipeline;
+  bool mPipelinesFailed = false;
+
+  // Bound in place of a pyramid when occlusion is not tested.
+  TextureWebGPU mEmptyHiZ;
+
+  std::vector<WGPUBindGroup> mBindGroups;
+};
+
+// @brief Global table of sampled 2D images bound as one texture binding
+// array.
+// @note Binding arrays must be fully bound, so empty entries hold a 1x1
+// placeholder. Bind groups built from the table are released when it or one
+// of its images changes.
+class TextureTableWebGPU {
+public:
+  void set(uint32_t index, ImageHandle imgh);
+
+  // @brief Clears the entries of a destroyed image.
+  void discard(ImageHandle imgh);
+
+  // @brief Collects the views of the first 'count' entries for the bind group
+  // 'groupHash' and appends the images they reference to 'images'.
+  // @returns false if the placeholder could not be created.
+  [[nodiscard]] bool getViews(uint32_t groupHash, uint32_t count,
+                              std::vector<WGPUTextureView> *views,
+                              std::vector<uint32_t> *images);
+
+  void destroy();
+
+private:
+  // @brief Releases the bind groups built from the table.
+  void invalidate();
+
+private:
+  std::vector<ImageHandle> mImages;
+  std::vector<uint32_t> mBindGroups;
+
+  TextureWebGPU mPlaceholder;
+};
+
+// @brief Recorded graphics submissions replayed from render bundles.
+class DrawListWebGPU {
+public:
+  // @brief Replaces the submissions and releases the bundles encoding them.
+  // @param cmds submissions ordered by sort key, then submission ID.
+  void update(std::vector<ShaderProgramCommand> &&cmds);
+
+  // @returns bundle encoded for 'targetHash' and 'cameraSBH', null if there is
+  // none or a resource the list references changed since.
+  [[nodiscard]] WGPURenderBundle findBundle(uint32_t targetHash,
+                                            StructuredBufferHandle cameraSBH);
+
+  void addBundle(uint32_t targetHash, StructuredBufferHandle cameraSBH,
+                 WGPURenderBundle bundle);
+
+  // @brief Submissions sorted by state.
+  [[nodiscard]] inline const std::vector<ShaderProgramCommand> &
+  getCommands() const {
+    return mCmds;
+  }
+
+  void destroy();
+
+private:
+  void releaseBundles();
+
+private:
+  std::vector<ShaderProgramCommand> mCmds;
+
+  // Keys of the resources the submissions reference.
+  std::vector<uint64_t> mResources;
+
+  // Bundles by the camera and target they were encoded for, all at 'mEpoch'.
+  std::unordered_map<uint64_t, WGPURenderBundle> mBundles;
+  uint64_t mEpoch = 0;
+
+  // Resources are checked again only after one changed.
+  uint64_t mCheckedEpoch = 0;
+};
+
 class GraphicsProgramWebGPU {
 public:
   [[nodiscard]] Result create(ShaderHandle sh, int flags,
@@ -220,7 +1048,8 @@ public:
 
   [[nodiscard]] WGPURenderPipeline
   findOrCreatePipeline(const RenderTarget &target,
-                       WGPUBindGroupLayout bindGroupLayout,
+                       const WGPUBindGroupLayout *bindGroupLayouts,
+                       uint32_t bindGroupLayoutCount,
                        const VertexBufferHandle *vbhs, uint32_t vbCount);
 
   [[nodiscard]] inline const ShaderHandle getShader() const {
@@ -241,17 +1070,22 @@ class ComputeProgramWebGPU {
 public:
   [[nodiscard]] Result create(ShaderHandle sh, const std::string &name = "");
 
-  [[nodiscard]] Result bind(WGPUComputePassEncoder renderPassEncoder) const;
+  // @note Creates the pipeline on first bind once the shader is ready.
+  [[nodiscard]] Result bind(WGPUComputePassEncoder renderPassEncoder);
 
   [[nodiscard]] inline ShaderHandle getShader() const { return mShaderHandle; };
 
   void destroy();
 
+private:
+  [[nodiscard]] Result createPipeline();
+
 private:
   ShaderHandle mShaderHandle;
+  std::string mName;
 
-  WGPUPipelineLayout mPipelineLayout;
-  WGPUComputePipeline mPipeline;
+  WGPUPipelineLayout mPipelineLayout = NULL;
+  WGPUComputePipeline mPipeline = NULL;
 };
 
 } // namespace cbz
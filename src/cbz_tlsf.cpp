@@ -0,0 +1,245 @@
+#include "cbz_tlsf.h"
+
+#include <algorithm>
+
+namespace cbz {
+
+// @returns index of the highest set bit; v must not be 0.
+static inline uint32_t FindLastSet(uint64_t v) {
+  uint32_t bit = 0;
+  while (v >>= 1) {
+    bit++;
+  }
+  return bit;
+}
+
+// @returns index of the lowest set bit; v must not be 0.
+static inline uint32_t FindFirstSet(uint64_t v) {
+  uint32_t bit = 0;
+  while ((v & 1) == 0) {
+    v >>= 1;
+    bit++;
+  }
+  return bit;
+}
+
+void TLSFAllocator::init(uint64_t capacity, uint64_t granularity) {
+  mNodes.clear();
+  mUnusedNodes.clear();
+
+  for (uint32_t fl = 0; fl < FL_COUNT; fl++) {
+    for (uint32_t sl = 0; sl < SL_COUNT; sl++) {
+      mBins[fl][sl] = INVALID_NODE;
+    }
+    mSecondLevelBitmaps[fl] = 0;
+  }
+  mFirstLevelBitmap = 0;
+
+  mGranularity = std::max<uint64_t>(granularity, 1);
+  mCapacity = capacity & ~(mGranularity - 1);
+  mFreeBytes = mCapacity;
+  mAllocationCount = 0;
+
+  if (mCapacity == 0) {
+    return;
+  }
+
+  const uint32_t node = createNode();
+  mNodes[node].offset = 0;
+  mNodes[node].size = mCapacity;
+  insertFree(node);
+}
+
+uint32_t TLSFAllocator::allocate(uint64_t size, uint64_t *outOffset) {
+  size = (std::max<uint64_t>(size, 1) + mGranularity - 1) & ~(mGranularity - 1);
+  if (size > mFreeBytes) {
+    return INVALID_NODE;
+  }
+
+  const uint32_t node = findFree(size);
+  if (node == INVALID_NODE) {
+    return INVALID_NODE;
+  }
+
+  removeFree(node);
+
+  // Return the tail to the bins.
+  if (mNodes[node].size > size) {
+    const uint32_t remainder = createNode();
+    Node &used = mNodes[node];
+    Node &rest = mNodes[remainder];
+
+    rest.offset = used.offset + size;
+    rest.size = used.size - size;
+    rest.prevPhysical = node;
+    rest.nextPhysical = used.nextPhysical;
+    if (rest.nextPhysical != INVALID_NODE) {
+      mNodes[rest.nextPhysical].prevPhysical = remainder;
+    }
+
+    used.size = size;
+    used.nextPhysical = remainder;
+    insertFree(remainder);
+  }
+
+  mNodes[node].free = false;
+  mFreeBytes -= size;
+  mAllocationCount++;
+
+  *outOffset = mNodes[node].offset;
+  return node;
+}
+
+void TLSFAllocator::free(uint32_t node) {
+  if (node >= mNodes.size() || mNodes[node].free) {
+    return;
+  }
+
+  mFreeBytes += mNodes[node].size;
+  mAllocationCount--;
+
+  const uint32_t prev = mNodes[node].prevPhysical;
+  if (prev != INVALID_NODE && mNodes[prev].free) {
+    removeFree(prev);
+
+    mNodes[prev].size += mNodes[node].size;
+    mNodes[prev].nextPhysical = mNodes[node].nextPhysical;
+    if (mNodes[node].nextPhysical != INVALID_NODE) {
+      mNodes[mNodes[node].nextPhysical].prevPhysical = prev;
+    }
+
+    mUnusedNodes.push_back(node);
+    node = prev;
+  }
+
+  const uint32_t next = mNodes[node].nextPhysical;
+  if (next != INVALID_NODE && mNodes[next].free) {
+    removeFree(next);
+
+    mNodes[node].size += mNodes[next].size;
+    mNodes[node].nextPhysical = mNodes[next].nextPhysical;
+    if (mNodes[next].nextPhysical != INVALID_NODE) {
+      mNodes[mNodes[next].nextPhysical].prevPhysical = node;
+    }
+
+    mUnusedNodes.push_back(next);
+  }
+
+  insertFree(node);
+}
+
+uint64_t TLSFAllocator::getLargestFreeRange() const {
+  if (mFirstLevelBitmap == 0) {
+    return 0;
+  }
+
+  const uint32_t fl = FindLastSet(mFirstLevelBitmap);
+  const uint32_t sl = FindLastSet(mSecondLevelBitmaps[fl]);
+
+  // Ranges within a bin differ in size.
+  uint64_t largest = 0;
+  for (uint32_t node = mBins[fl][sl]; node != INVALID_NODE;
+       node = mNodes[node].nextFree) {
+    largest = std::max(largest, mNodes[node].size);
+  }
+
+  return largest;
+}
+
+void TLSFAllocator::mapping(uint64_t size, uint32_t *fl, uint32_t *sl) {
+  if (size < SL_COUNT) {
+    *fl = 0;
+    *sl = static_cast<uint32_t>(size);
+    return;
+  }
+
+  const uint32_t log2 = FindLastSet(size);
+  *sl = static_cast<uint32_t>(size >> (log2 - SL_LOG2)) - SL_COUNT;
+  *fl = log2 - SL_LOG2 + 1;
+}
+
+uint32_t TLSFAllocator::createNode() {
+  uint32_t node;
+  if (!mUnusedNodes.empty()) {
+    node = mUnusedNodes.back();
+    mUnusedNodes.pop_back();
+  } else {
+    node = static_cast<uint32_t>(mNodes.size());
+    mNodes.emplace_back();
+  }
+
+  mNodes[node] = {0,           0,           INVALID_NODE, INVALID_NODE,
+                  INVALID_NODE, INVALID_NODE, false};
+  return node;
+}
+
+void TLSFAllocator::insertFree(uint32_t node) {
+  uint32_t fl, sl;
+  mapping(mNodes[node].size, &fl, &sl);
+
+  Node &free = mNodes[node];
+  free.free = true;
+  free.prevFree = INVALID_NODE;
+  free.nextFree = mBins[fl][sl];
+  if (free.nextFree != INVALID_NODE) {
+    mNodes[free.nextFree].prevFree = node;
+  }
+
+  mBins[fl][sl] = node;
+  mFirstLevelBitmap |= uint64_t(1) << fl;
+  mSecondLevelBitmaps[fl] |= 1u << sl;
+}
+
+void TLSFAllocator::removeFree(uint32_t node) {
+  uint32_t fl, sl;
+  mapping(mNodes[node].size, &fl, &sl);
+
+  Node &free = mNodes[node];
+  if (free.prevFree != INVALID_NODE) {
+    mNodes[free.prevFree].nextFree = free.nextFree;
+  } else {
+    mBins[fl][sl] = free.nextFree;
+  }
+
+  if (free.nextFree != INVALID_NODE) {
+    mNodes[free.nextFree].prevFree = free.prevFree;
+  }
+
+  free.free = false;
+
+  if (mBins[fl][sl] == INVALID_NODE) {
+    mSecondLevelBitmaps[fl] &= ~(1u << sl);
+    if (mSecondLevelBitmaps[fl] == 0) {
+      mFirstLevelBitmap &= ~(uint64_t(1) << fl);
+    }
+  }
+}
+
+uint32_t TLSFAllocator::findFree(uint64_t size) const {
+  // Round up to the next bin so any range found fits.
+  if (size >= SL_COUNT) {
+    size += (uint64_t(1) << (FindLastSet(size) - SL_LOG2)) - 1;
+  }
+
+  uint32_t fl, sl;
+  mapping(size, &fl, &sl);
+  if (fl >= FL_COUNT) {
+    return INVALID_NODE;
+  }
+
+  uint32_t slBitmap = mSecondLevelBitmaps[fl] & (~0u << sl);
+  if (slBitmap == 0) {
+    const uint64_t flBitmap =
+        fl + 1 < 64 ? mFirstLevelBitmap & (~uint64_t(0) << (fl + 1)) : 0;
+    if (flBitmap == 0) {
+      return INVALID_NODE;
+    }
+
+    fl = FindFirstSet(flBitmap);
+    slBitmap = mSecondLevelBitmaps[fl];
+  }
+
+  return mBins[fl][FindFirstSet(slBitmap)];
+}
+
+}; // namespace cbz
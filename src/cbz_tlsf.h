@@ -0,0 +1,86 @@
+#ifndef CBZ_TLSF_H_
+#define CBZ_TLSF_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace cbz {
+
+// @brief Two level segregated fit allocator of ranges within [0, capacity).
+//
+// Free ranges are binned by the power of two of their size (first level) and
+// SL_COUNT linear steps within it (second level). Bitmaps of non-empty bins
+// make allocation and free constant time; freed ranges merge with free
+// neighbours.
+// @note Only offsets are managed; the memory itself lives elsewhere.
+class TLSFAllocator {
+public:
+  static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+  // @param granularity power of two all offsets and sizes are rounded to.
+  void init(uint64_t capacity, uint64_t granularity);
+
+  // @returns node of the allocation, INVALID_NODE if no free range fits.
+  [[nodiscard]] uint32_t allocate(uint64_t size, uint64_t *outOffset);
+
+  void free(uint32_t node);
+
+  [[nodiscard]] inline uint64_t getCapacity() const { return mCapacity; }
+
+  [[nodiscard]] inline uint64_t getFreeBytes() const { return mFreeBytes; }
+
+  [[nodiscard]] inline uint32_t getAllocationCount() const {
+    return mAllocationCount;
+  }
+
+  [[nodiscard]] uint64_t getLargestFreeRange() const;
+
+  [[nodiscard]] inline bool empty() const { return mAllocationCount == 0; }
+
+private:
+  static constexpr uint32_t SL_LOG2 = 4;
+  static constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+  static constexpr uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+
+  struct Node {
+    uint64_t offset;
+    uint64_t size;
+
+    // Neighbouring ranges by offset.
+    uint32_t prevPhysical;
+    uint32_t nextPhysical;
+
+    // Bin links of free ranges.
+    uint32_t prevFree;
+    uint32_t nextFree;
+
+    bool free;
+  };
+
+  static void mapping(uint64_t size, uint32_t *fl, uint32_t *sl);
+
+  [[nodiscard]] uint32_t createNode();
+
+  void insertFree(uint32_t node);
+
+  void removeFree(uint32_t node);
+
+  [[nodiscard]] uint32_t findFree(uint64_t size) const;
+
+private:
+  std::vector<Node> mNodes;
+  std::vector<uint32_t> mUnusedNodes;
+
+  uint32_t mBins[FL_COUNT][SL_COUNT];
+  uint64_t mFirstLevelBitmap = 0;
+  uint32_t mSecondLevelBitmaps[FL_COUNT];
+
+  uint64_t mCapacity = 0;
+  uint64_t mGranularity = 1;
+  uint64_t mFreeBytes = 0;
+  uint32_t mAllocationCount = 0;
+};
+
+}; // namespace cbz
+
+#endif
@@ -0,0 +1,92 @@
+#include "cbz_worker_pool.h"
+
+#include <spdlog/spdlog.h>
+
+namespace cbz {
+
+void WorkerPool::init(uint32_t threadCount) {
+#ifdef __EMSCRIPTEN__
+  (void)threadCount;
+#else
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRunning) {
+      spdlog::warn("WorkerPool::init() called on running pool!");
+      return;
+    }
+
+    mRunning = true;
+  }
+
+  if (threadCount == 0) {
+    threadCount = 1;
+  }
+
+  mThreads.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    mThreads.emplace_back(&WorkerPool::workerMain, this);
+  }
+#endif
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+#ifdef __EMSCRIPTEN__
+  job();
+#else
+  {
+    // Checked under the lock 'shutdown' clears it under, so no job is queued
+    // once workers are joined.
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mRunning) {
+      // Pool not running; execute on caller.
+      lock.unlock();
+      job();
+      return;
+    }
+
+    mJobs.push_back(std::move(job));
+  }
+
+  mJobAvailable.notify_one();
+#endif
+}
+
+void WorkerPool::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRunning = false;
+    mJobs.clear();
+  }
+
+  mJobAvailable.notify_all();
+
+  for (std::thread &thread : mThreads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  mThreads.clear();
+}
+
+void WorkerPool::workerMain() {
+  while (true) {
+    std::function<void()> job;
+
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mJobAvailable.wait(lock, [this]() { return !mRunning || !mJobs.empty(); });
+
+      if (!mRunning) {
+        return;
+      }
+
+      job = std::move(mJobs.front());
+      mJobs.pop_front();
+    }
+
+    job();
+  }
+}
+
+}; // namespace cbz
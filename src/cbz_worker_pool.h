@@ -0,0 +1,44 @@
+#ifndef CBZ_WORKER_POOL_H_
+#define CBZ_WORKER_POOL_H_
+
+#include <cstdint>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cbz {
+
+// @brief Fixed size pool of threads executing jobs in submission order.
+// @note Without thread support (Emscripten) jobs run inline on submit.
+class WorkerPool {
+public:
+  void init(uint32_t threadCount);
+
+  void submit(std::function<void()> job);
+
+  // @brief Joins all workers. Jobs that have not started are discarded.
+  void shutdown();
+
+  [[nodiscard]] inline uint32_t getThreadCount() const {
+    return static_cast<uint32_t>(mThreads.size());
+  }
+
+private:
+  void workerMain();
+
+private:
+  std::vector<std::thread> mThreads;
+  std::deque<std::function<void()>> mJobs;
+
+  std::mutex mMutex;
+  std::condition_variable mJobAvailable;
+  bool mRunning = false;
+};
+
+}; // namespace cbz
+
+#endif